@@ -167,6 +167,7 @@ mx_int = ctypes.c_int
 mx_float = ctypes.c_float
 mx_float_p = ctypes.POINTER(mx_float)
 PredictorHandle = ctypes.c_void_p
+BatchedPredictorHandle = ctypes.c_void_p
 NDListHandle = ctypes.c_void_p
 
 devstr2type = {'cpu': 1, 'gpu': 2, 'cpu_pinned': 3}
@@ -243,6 +244,7 @@ class Predictor(object):
             ctypes.byref(handle)))
         self.type_dict = type_dict
         self.handle = handle
+        self._input_ptrs = {}
 
     def __del__(self):
         _check_call(_LIB.MXPredFree(self.handle))
@@ -278,6 +280,32 @@ class Predictor(object):
                 mx_uint(v.size)))
         _check_call(_LIB.MXPredForward(self.handle))
 
+    def set_input_ptr(self, key, data):
+        """Bind a numpy array as input of the predictor, without copying.
+        Later writes to the array are seen by the next forward.
+
+        Parameters
+        ----------
+        key : str
+            The name of the input.
+
+        data : numpy.ndarray
+            C contiguous, aligned to 64 bytes and of the dtype and shape of the input.
+            The predictor keeps a reference until another array is bound to the input.
+
+        Examples
+        --------
+        >>> predictor.set_input_ptr('data', aligned_data)
+        >>> predictor.forward()
+        """
+        if not isinstance(data, np.ndarray) or not data.flags['C_CONTIGUOUS']:
+            raise ValueError("Expect C contiguous numpy ndarray as input")
+        _check_call(_LIB.MXPredSetInputPtr(
+            self.handle, c_str(key),
+            data.ctypes.data_as(ctypes.c_void_p),
+            mx_uint(data.size)))
+        self._input_ptrs[key] = data
+
     def reshape(self, input_shapes):
         """Change the input shape of the predictor.
 
@@ -311,6 +339,46 @@ class Predictor(object):
         _check_call(_LIB.MXPredFree(self.handle))
         self.handle = new_handle
 
+    def reshape_in_place(self, input_shapes):
+        """Change the input shape of the predictor, keeping the executors of
+        earlier shapes up to the size set by set_executor_cache_size.
+
+        Parameters
+        ----------
+        input_shapes : dict of str to tuple
+            The new shape of input data.
+
+        Examples
+        --------
+        >>> predictor.reshape_in_place({'data':data_shape_tuple})
+        """
+        indptr = [0]
+        sdata = []
+        keys = []
+        for k, v  in input_shapes.items():
+            if not isinstance(v, tuple):
+                raise ValueError("Expect input_shapes to be dict str->tuple")
+            keys.append(c_str(k))
+            sdata.extend(v)
+            indptr.append(len(sdata))
+
+        _check_call(_LIB.MXPredReshapeInPlace(
+            self.handle,
+            mx_uint(len(indptr) - 1),
+            c_array(ctypes.c_char_p, keys),
+            c_array(mx_uint, indptr),
+            c_array(mx_uint, sdata)))
+
+    def set_executor_cache_size(self, cache_size):
+        """Set how many executors reshape_in_place keeps.
+
+        Parameters
+        ----------
+        cache_size : int
+            The maximum number of cached executors, 0 disables caching.
+        """
+        _check_call(_LIB.MXPredSetExecutorCacheSize(self.handle, mx_uint(cache_size)))
+
     def get_output(self, index):
         """Get the index-th output.
 
@@ -351,6 +419,98 @@ class Predictor(object):
                                                   ctypes.c_int(monitor_all)))
 
 
+class BatchedPredictor(object):
+    """A predictor that joins the requests of concurrent threads into one forward pass.
+
+    Parameters
+    ----------
+    symbol_json_str : str
+        Path to the symbol file.
+
+    param_raw_bytes : str, bytes
+        The raw parameter bytes.
+
+    input_shapes : dict of str to tuple
+        The shape of one row of every input, without the batch dimension.
+
+    output_shapes : list of tuple
+        The shape of one row of every output, without the batch dimension.
+
+    max_batch_size : int
+        The maximum number of rows in one forward pass.
+
+    max_delay_us : int, optional
+        The maximum time in microseconds a request waits for others.
+
+    dev_type : str, optional
+        The device type of the predictor.
+
+    dev_id : int, optional
+        The device id of the predictor.
+    """
+    def __init__(self, symbol_file, param_raw_bytes, input_shapes, output_shapes,
+                 max_batch_size, max_delay_us=1000, dev_type="cpu", dev_id=0):
+        indptr = [0]
+        sdata = []
+        keys = []
+        for k, v in input_shapes.items():
+            if not isinstance(v, tuple):
+                raise ValueError("Expect input_shapes to be dict str->tuple")
+            keys.append(k)
+            sdata.extend((max_batch_size,) + v)
+            indptr.append(len(sdata))
+        handle = BatchedPredictorHandle()
+        param_raw_bytes = bytearray(param_raw_bytes)
+        ptr = (ctypes.c_char * len(param_raw_bytes)).from_buffer(param_raw_bytes)
+        _check_call(_LIB.MXPredCreateBatched(
+            c_str(symbol_file),
+            ptr, len(param_raw_bytes),
+            ctypes.c_int(devstr2type[dev_type]), ctypes.c_int(dev_id),
+            mx_uint(len(keys)),
+            c_array(ctypes.c_char_p, [c_str(k) for k in keys]),
+            c_array(mx_uint, indptr),
+            c_array(mx_uint, sdata),
+            mx_uint(max_batch_size),
+            mx_uint(max_delay_us),
+            ctypes.byref(handle)))
+        self.keys = keys
+        self.output_shapes = [tuple(s) for s in output_shapes]
+        self.handle = handle
+
+    def __del__(self):
+        _check_call(_LIB.MXPredBatchedFree(self.handle))
+
+    def forward(self, **kwargs):
+        """Run prediction for one request, thread safe. Blocks until the batch
+        holding the request completed.
+
+        Parameters
+        ----------
+        **kwargs
+            Keyword arguments of input variable name to data, all with the same
+            number of rows.
+
+        Returns
+        -------
+        out : list of numpy array
+            The outputs of the request.
+
+        Examples
+        --------
+        >>> out = predictor.forward(data=mydata)
+        """
+        inputs = [np.asarray(kwargs[k], dtype=np.float32, order='C') for k in self.keys]
+        num_rows = inputs[0].shape[0]
+        if any(v.shape[0] != num_rows for v in inputs):
+            raise ValueError("Expect the same number of rows in all inputs")
+        outputs = [np.empty((num_rows,) + s, dtype=np.float32) for s in self.output_shapes]
+        _check_call(_LIB.MXPredBatchedForward(
+            self.handle, mx_uint(num_rows),
+            c_array(mx_float_p, [v.ctypes.data_as(mx_float_p) for v in inputs]),
+            c_array(mx_float_p, [v.ctypes.data_as(mx_float_p) for v in outputs])))
+        return outputs
+
+
 def load_ndarray_file(nd_bytes):
     """Load ndarray file and return as list of numpy array.
 
@@ -0,0 +1,66 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+"""Benchmark the CPU reduction of the local kvstore.
+
+Pushes arrays from several CPU contexts to a `local` kvstore, which sums them
+with CommCPU, and reports the achieved reduction bandwidth for a sweep of array
+sizes and device counts. Use MXNET_KVSTORE_REDUCTION_NTHREADS,
+MXNET_KVSTORE_BIGARRAY_BOUND and MXNET_KVSTORE_REDUCTION_STREAM_BOUND to
+compare settings.
+"""
+import argparse
+import time
+import mxnet as mx
+import numpy as np
+
+parser = argparse.ArgumentParser(description='Benchmark CPU kvstore reduction')
+parser.add_argument('--sizes', type=str, default='1000,100000,1000000,10000000,50000000',
+                    help='comma separated number of elements per array')
+parser.add_argument('--num-devices', type=str, default='2,4,8',
+                    help='comma separated number of cpu contexts pushing')
+parser.add_argument('--dtype', type=str, default='float32', help='float32 or float16')
+parser.add_argument('--repeat', type=int, default=20, help='num repeat')
+args = parser.parse_args()
+
+
+def bench(size, num_devices, dtype, repeat):
+    kv = mx.kv.create('local')
+    kv.init(0, mx.nd.zeros((size,), dtype=dtype))
+    vals = [mx.nd.ones((size,), ctx=mx.cpu(i), dtype=dtype) for i in range(num_devices)]
+    out = mx.nd.zeros((size,), dtype=dtype)
+    # warmup, also allocates the merge buffers
+    kv.push(0, vals)
+    kv.pull(0, out=out)
+    out.wait_to_read()
+    start = time.time()
+    for _ in range(repeat):
+        kv.push(0, vals)
+    kv.pull(0, out=out)
+    out.wait_to_read()
+    elapsed = (time.time() - start) / repeat
+    assert np.allclose(out[:10].asnumpy(), num_devices)
+    # every input is read once and the result written once
+    nbytes = size * np.dtype(dtype).itemsize * (num_devices + 1)
+    return elapsed, nbytes / elapsed / 1e9
+
+
+print('%12s %8s %12s %10s' % ('size', 'devices', 'time (ms)', 'GB/s'))
+for num_devices in [int(n) for n in args.num_devices.split(',')]:
+    for size in [int(s) for s in args.sizes.split(',')]:
+        t, bw = bench(size, num_devices, args.dtype, args.repeat)
+        print('%12d %8d %12.3f %10.2f' % (size, num_devices, t * 1e3, bw))
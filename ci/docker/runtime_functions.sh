@@ -1183,6 +1183,10 @@ integrationtest_ubuntu_cpu_dist_kvstore() {
     ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py --no-multiprecision
     ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py --type=compressed_cpu
     ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py --type=compressed_cpu --no-multiprecision
+    MXNET_KVSTORE_SERVER_APPLY_THREADS=3 ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py --type=apply_threads_cpu
+    ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py --type=fused_keys_cpu
+    MXNET_KVSTORE_FUSION_BUCKET_SIZE=4096 ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py --type=fused_keys_cpu
+    MXNET_KVSTORE_FUSION_BUCKET_SIZE=4096 MXNET_KVSTORE_SERVER_APPLY_THREADS=3 ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py --type=fused_keys_cpu
     ../../tools/launch.py -n 3 --launcher local python test_server_profiling.py
     popd
 }
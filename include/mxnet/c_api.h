@@ -676,6 +676,48 @@ MXNET_DLL int MXNDArrayLoad64(const char* fname,
                               int64_t *out_name_size,
                               const char*** out_names);
 
+/*!
+ * \brief Save list of narray into the file in the chunked format, with an index
+ *  of the arrays up front and every array at a 64 byte aligned offset.
+ * \param fname name of the file.
+ * \param num_args number of arguments to save.
+ * \param args the array of NDArrayHandles to be saved.
+ * \param keys the name of the NDArray, optional, can be NULL
+ * \param checksum whether to store a checksum of every array
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArraySaveChunked(const char* fname,
+                                   uint32_t num_args,
+                                   NDArrayHandle* args,
+                                   const char** keys,
+                                   int checksum);
+/*!
+ * \brief Load list of narray from the file, mapping local files in the chunked
+ *  format into memory instead of reading them. Dense cpu arrays point into the
+ *  mapping, so the file must not be modified in place while they are alive;
+ *  MXNDArraySave and MXNDArraySaveChunked replace a file instead.
+ * \param fname name of the file.
+ * \param num_ctx number of contexts to load a copy of every array onto, 0 to
+ *  load the arrays onto the context they were saved from.
+ * \param dev_types device types of the contexts.
+ * \param dev_ids device ids of the contexts.
+ * \param verify whether to check the checksums of a chunked file.
+ * \param out_size number of narray loaded, num_ctx times the arrays in the file if num_ctx > 0.
+ * \param out_arr head of the returning narray handles, all arrays of the first context first.
+ * \param out_name_size size of output name arrray.
+ * \param out_names the names of the arrays in the file, can be NULL
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArrayLoadMapped(const char* fname,
+                                  int num_ctx,
+                                  const int* dev_types,
+                                  const int* dev_ids,
+                                  int verify,
+                                  uint32_t *out_size,
+                                  NDArrayHandle** out_arr,
+                                  uint32_t *out_name_size,
+                                  const char*** out_names);
+
 /*!
  * \brief Load list / dictionary of narrays from file content loaded into memory.
  * This will load a list of ndarrays in a similar
@@ -1259,6 +1301,12 @@ MXNET_DLL int MXCreateCachedOpEx(SymbolHandle handle,
  * \brief free cached operator
  */
 MXNET_DLL int MXFreeCachedOp(CachedOpHandle handle);
+/*!
+ * \brief get the forward and backward graph of a cached operator
+ * \param handle cached operator handle
+ * \param out output symbol handle, the forward outputs followed by the gradients
+ */
+MXNET_DLL int MXCachedOpGetFullSymbol(CachedOpHandle handle, SymbolHandle *out);
 /*!
  * \brief invoke cached operator
  */
@@ -2725,6 +2773,19 @@ typedef void (MXKVStoreStrUpdater)(const char* key,
 MXNET_DLL int MXKVStoreSetUpdater(KVStoreHandle handle,
                                   MXKVStoreUpdater updater,
                                   void *updater_handle);
+/*!
+ * \brief register a push updater that may run for different keys at once, on any thread.
+ *  The apply threads of a kvstore server (MXNET_KVSTORE_SERVER_APPLY_THREADS) run it in
+ *  parallel, while the updaters of MXKVStoreSetUpdater run on the main thread one at a
+ *  time, as python callbacks need.
+ * \param handle handle to the KVStore
+ * \param updater thread safe updater function
+ * \param updater_handle The additional handle used to invoke the updater
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXKVStoreSetThreadSafeUpdater(KVStoreHandle handle,
+                                            MXKVStoreUpdater updater,
+                                            void *updater_handle);
 /*!
  * \brief register a push updater with int keys and one with string keys
  * \param handle handle to the KVStore
@@ -47,6 +47,8 @@ typedef uint32_t mx_uint;
 typedef float mx_float;
 /*! \brief handle to Predictor */
 typedef void *PredictorHandle;
+/*! \brief handle to batched Predictor */
+typedef void *BatchedPredictorHandle;
 /*! \brief handle to NDArray list */
 typedef void *NDListHandle;
 /*! \brief handle to NDArray */
@@ -217,6 +219,34 @@ MXNET_DLL int MXPredReshape(uint32_t num_input_nodes,
                   const uint32_t* input_shape_data,
                   PredictorHandle handle,
                   PredictorHandle* out);
+/*!
+ * \brief Set how many executors a predictor keeps for MXPredReshapeInPlace.
+ * \param handle The predictor handle.
+ * \param cache_size The maximum number of cached executors, 0 disables caching.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredSetExecutorCacheSize(PredictorHandle handle,
+                                         uint32_t cache_size);
+/*!
+ * \brief Change the input shape of an existing predictor in place.
+ *  Executors bound for previous shapes are kept in an LRU cache keyed by the
+ *  input shapes, so switching back to a cached shape is only a lookup.
+ *  All executors share the parameters and one memory pool, which grows to the
+ *  largest shape used; binding the largest shape first avoids growing it later.
+ *  Every executor has input arrays of its own, so set the inputs after each call.
+ *  Pass the same set of input_keys on every call.
+ * \param handle The predictor handle.
+ * \param num_input_nodes Number of input nodes to the net,
+ * \param input_keys The name of input argument.
+ * \param input_shape_indptr Index pointer of shapes of each input node.
+ * \param input_shape_data A flattened data of shapes of each input node.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredReshapeInPlace(PredictorHandle handle,
+                                   uint32_t num_input_nodes,
+                                   const char** input_keys,
+                                   const uint32_t* input_shape_indptr,
+                                   const uint32_t* input_shape_data);
 /*!
  * \brief Get the shape of output node.
  *  The returned shape_data and shape_ndim is only valid before next call to MXPred function.
@@ -255,6 +285,23 @@ MXNET_DLL int MXPredSetInput(PredictorHandle handle,
                              const char* key,
                              const float* data,
                              uint32_t size);
+/*!
+ * \brief Bind a caller-owned buffer as input of the predictor, without copying.
+ *  The first call for a key rebinds the predictor, later calls only replace the
+ *  data pointer, after waiting for pending reads of the previous buffer.
+ *  The buffer must stay valid until it is replaced or the predictor is freed.
+ *  Only supported for CPU predictors.
+ * \param handle The predictor handle.
+ * \param key The name of input node to set.
+ * \param data The buffer, aligned to 64 bytes and holding the input dtype,
+ *     with the shape specified in MXPredCreate.
+ * \param size The number of elements of the buffer, used for safety check.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredSetInputPtr(PredictorHandle handle,
+                                const char* key,
+                                const void* data,
+                                uint32_t size);
 /*!
  * \brief Run a forward pass to get the output.
  * \param handle The handle of the predictor.
@@ -290,12 +337,76 @@ MXNET_DLL int MXPredGetOutput(PredictorHandle handle,
                               uint32_t index,
                               float* data,
                               uint32_t size);
+/*!
+ * \brief Get a pointer to the output of prediction, without copying.
+ *  The pointer is valid until the next forward pass of the predictor.
+ *  Only supported for CPU predictors.
+ * \param handle The handle of the predictor.
+ * \param index The index of output node, set to 0 if there is only one output.
+ * \param data Used to hold the pointer to the output data.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredGetOutputPtr(PredictorHandle handle,
+                                 uint32_t index,
+                                 const void** data);
 /*!
  * \brief Free a predictor handle.
  * \param handle The handle of the predictor.
  * \return 0 when success, -1 when failure.
  */
 MXNET_DLL int MXPredFree(PredictorHandle handle);
+/*!
+ * \brief create a batched predictor, which joins concurrent requests into one forward pass.
+ *  Requests from different threads are packed along the first dimension of every input
+ *  until max_batch_size rows are collected or the first request waited max_delay_us.
+ *  Works with all engine types.
+ * \param symbol_json_str The JSON string of the symbol.
+ * \param param_bytes The in-memory raw bytes of parameter ndarray file.
+ * \param param_size The size of parameter ndarray file.
+ * \param dev_type The device type, 1: cpu, 2:gpu
+ * \param dev_id The device id of the predictor.
+ * \param num_input_nodes Number of input nodes to the net.
+ * \param input_keys The name of input argument.
+ * \param input_shape_indptr Index pointer of shapes of each input node.
+ * \param input_shape_data A flattened data of shapes of each input node.
+ *    The first dimension of every input is the batch dimension, its value is ignored.
+ * \param max_batch_size The maximum number of rows in one forward pass.
+ * \param max_delay_us The maximum time in microseconds a request waits for others.
+ * \param out The created batched predictor handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredCreateBatched(const char* symbol_json_str,
+                                  const void* param_bytes,
+                                  int param_size,
+                                  int dev_type, int dev_id,
+                                  uint32_t num_input_nodes,
+                                  const char** input_keys,
+                                  const uint32_t* input_shape_indptr,
+                                  const uint32_t* input_shape_data,
+                                  uint32_t max_batch_size,
+                                  uint32_t max_delay_us,
+                                  BatchedPredictorHandle* out);
+/*!
+ * \brief Run prediction for one request on a batched predictor, thread safe.
+ *  Blocks until the batch containing the request completed.
+ * \param handle The handle of the batched predictor.
+ * \param num_rows The number of rows of the request, at most max_batch_size.
+ * \param inputs One pointer per input node, in the order of input_keys,
+ *    each holding num_rows rows.
+ * \param outputs One user allocated pointer per output node,
+ *    each large enough to hold num_rows rows.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredBatchedForward(BatchedPredictorHandle handle,
+                                   uint32_t num_rows,
+                                   const float** inputs,
+                                   float** outputs);
+/*!
+ * \brief Free a batched predictor handle.
+ * \param handle The handle of the batched predictor.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredBatchedFree(BatchedPredictorHandle handle);
 /*!
  * \brief Create a NDArray List by loading from ndarray file.
  *     This can be used to load mean image file.
@@ -271,6 +271,19 @@ class KVStore {
     updater_ = updater;
   }
 
+  /*!
+   * \brief set an updater that may run for different keys at once, on any thread
+   *
+   * Same as set_updater, except that the apply threads of a kvstore server
+   * (MXNET_KVSTORE_SERVER_APPLY_THREADS) run it in parallel instead of passing
+   * every update to the main thread.
+   *
+   * \param updater user-defined thread safe updater
+   */
+  virtual void set_thread_safe_updater(const Updater& updater) {
+    set_updater(updater);
+  }
+
   /*!
    * \brief set an updater with string keys
    *
@@ -493,6 +493,17 @@ class NDArray {
    * \param size the size of the source array, in sizeof(DType) not raw btyes.
    */
   void SyncCopyFromCPU(const void *data, size_t size) const;
+  /*!
+   * \brief Point a static NDArray (one constructed over a TBlob) at another
+   *  memory region of the same size, without copying.
+   *
+   *  This function will call WaitToWrite before the pointer is replaced, so
+   *  the previous region is no longer used once it returns. The caller keeps
+   *  ownership of the new region and must keep it alive while it is in use.
+   *
+   * \param data the new memory region.
+   */
+  void SetStaticDataPtr(void *data) const;
 
   /*!
    * \brief Copy from src.data()/aux_data(i) to this->data()/aux_data(j)
@@ -576,6 +587,24 @@ class NDArray {
     return ret;
   }
 
+  /*!
+   * \brief Create an NDArray that shares the memory of the current one from
+   *  byte_offset on, used to carve the arrays of a memory arena.
+   *  The memory is reused, so the new array is not a view.
+   * \param shape new shape
+   * \param dtype The data type.
+   * \param byte_offset offset of the new array in bytes
+   * \return NDArray in new shape and type.
+   */
+  inline NDArray AsArray(const mxnet::TShape &shape, int dtype, size_t byte_offset) const {
+    CHECK_GE(ptr_->shandle.size,
+             byte_offset_ + byte_offset + shape.Size() * mshadow::mshadow_sizeof(dtype))
+        << "NDArray.AsArray: target memory range is out of bound";
+    NDArray ret = AsArray(shape, dtype);
+    ret.byte_offset_ += byte_offset;
+    return ret;
+  }
+
   /*!
    * \brief Create a reference view of NDArray that
    *  represents as DLManagedTensor.
@@ -810,6 +839,37 @@ class NDArray {
   static void Load(dmlc::Stream* fi,
                    std::vector<NDArray>* data,
                    std::vector<std::string>* keys);
+  /*!
+   * \brief Save list of ndarray into the Stream in the chunked format: an index
+   *  of all arrays up front, then every payload at a 64 byte aligned offset.
+   *  Load reads it like the default format, LoadFile maps it into memory.
+   * \param fo The stream of output.
+   * \param data the NDArrays to be saved.
+   * \param names the name of the NDArray, optional, can be zero length.
+   * \param checksum whether to store a checksum of every array.
+   */
+  static void SaveChunked(dmlc::Stream* fo,
+                          const std::vector<NDArray>& data,
+                          const std::vector<std::string>& names,
+                          bool checksum);
+  /*!
+   * \brief Load list of ndarray from a file. Local files in the chunked format
+   *  are mapped into memory, and dense arrays saved from cpu use the mapping
+   *  without a copy; other files are read with Load. The file must not be
+   *  modified in place while arrays point into its mapping.
+   * \param fname The name of the file.
+   * \param ctxs contexts to load a copy of every array onto, copies to
+   *  different devices run in parallel. If empty, arrays are loaded onto the
+   *  context they were saved from.
+   * \param verify whether to check the checksums of a chunked file.
+   * \param data the NDArrays loaded, all arrays for ctxs[0] first when ctxs is given.
+   * \param keys the name of the NDArray, if saved in the file.
+   */
+  static void LoadFile(const std::string& fname,
+                       const std::vector<Context>& ctxs,
+                       bool verify,
+                       std::vector<NDArray>* data,
+                       std::vector<std::string>* keys);
 
  private:
   friend class Imperative;
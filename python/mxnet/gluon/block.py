@@ -548,6 +548,11 @@ class Block(object):
             Optimize for invariant input shapes between iterations. Must also
             set static_alloc to True. Change of input shapes is still allowed
             but slower.
+        backward_mirror_budget_mb : int, default 0
+            Memory budget in MB of the forward pass, counting the outputs kept
+            for backward. Operators are recomputed in backward to fit it, the
+            ones that free the most memory for the least compute first. It is
+            planned once, for the input shapes of the first call. 0 disables it.
         """
         for cld in self._children.values():
             cld.hybridize(active, **kwargs)
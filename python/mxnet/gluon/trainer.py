@@ -21,7 +21,7 @@
 __all__ = ['Trainer']
 
 from .. import optimizer as opt
-from ..model import _create_kvstore, _create_sparse_kvstore
+from ..model import _create_kvstore, _create_sparse_kvstore, _kvstore_key_batches
 from .parameter import ParameterDict, Parameter
 
 class Trainer(object):
@@ -355,13 +355,13 @@ class Trainer(object):
 
     def _allreduce_grads(self):
         if self._kvstore:
-            for i, param in enumerate(self._params):
-                if param.grad_req != 'null':
-
-                    self._kvstore.push(i, param.list_grad(), priority=-i)
-                    if not self._update_on_kvstore:
-                        self._kvstore.pull(i, param.list_grad(), priority=-i,
-                                           ignore_sparse=self._distributed)
+            indices = [i for i, param in enumerate(self._params) if param.grad_req != 'null']
+            for batch in _kvstore_key_batches(self._kvstore, indices):
+                grads = [self._params[i].list_grad() for i in batch]
+                self._kvstore.push(batch, grads, priority=-batch[0])
+                if not self._update_on_kvstore:
+                    self._kvstore.pull(batch, grads, priority=-batch[0],
+                                       ignore_sparse=self._distributed)
 
     def update(self, batch_size, ignore_stale_grad=False):
         """Makes one step of parameter update.
@@ -398,6 +398,7 @@ class Trainer(object):
 
     def _update(self, ignore_stale_grad=False):
         updates = [[] for _ in self._updaters]
+        pulls = []
 
         for i, param in enumerate(self._params):
             if param.grad_req == 'null':
@@ -419,7 +420,7 @@ class Trainer(object):
                 if param._stype == 'default':
                     # 'row_sparse' parameters are not pulled immediately - they're pulled
                     # in `Block.forward`
-                    self._kvstore.pull(i, param.list_data(), priority=-i)
+                    pulls.append(i)
                 continue
 
             for upd, arr, grad in zip(updates, param.list_data(), param.list_grad()):
@@ -427,6 +428,10 @@ class Trainer(object):
                     upd.append((i, grad, arr))
                     arr._fresh_grad = False
 
+        for batch in _kvstore_key_batches(self._kvstore, pulls):
+            self._kvstore.pull(batch, [self._params[i].list_data() for i in batch],
+                               priority=-batch[0])
+
         if not (self._kvstore and self._update_on_kvstore):
             for updater, upd in zip(self._updaters, updates):
                 if upd:
@@ -510,13 +510,20 @@ class KVStore(object):
         a dictionary which includes `threshold` like:
         {'type': '2bit', 'threshold': 0.5}
 
+        Other types of compression keep a residual in the same way.
+        `1bit` sends the sign of each value along with the mean absolute value of
+        every block of 256 values. `topk` sends the values of largest magnitude with
+        their positions, about a fraction `ratio` of all values, like:
+        {'type': 'topk', 'ratio': 0.01}
+        `fp16` and `bf16` send values cast to half precision or bfloat16.
+
         Parameters
         ----------
         compression_params : dict
             A dictionary specifying the type and parameters for gradient compression.
             The key `type` in this dictionary is a
             required string argument and specifies the type of gradient compression.
-            Currently `type` can be only `2bit`
+            `type` can be `2bit`, `1bit`, `topk`, `fp16` or `bf16`.
             Other keys in this dictionary are optional and specific to the type
             of gradient compression.
         """
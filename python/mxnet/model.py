@@ -127,6 +127,18 @@ def _initialize_kvstore(kvstore, param_arrays, arg_params, param_names, update_o
         if update_on_kvstore:
             kvstore.pull(name, param_on_devs, priority=-idx)
 
+def _kvstore_key_batches(kvstore, indices):
+    """Splits the indices of the parameters to push and pull into the lists of keys
+    sent in one kvstore call. A distributed kvstore only fuses the small keys of one
+    call (MXNET_KVSTORE_FUSION_BUCKET_SIZE), so with fusion the keys are sent
+    MXNET_UPDATE_AGGREGATION_SIZE at a time. Otherwise every key is sent on its own,
+    with its own priority."""
+    if kvstore is None or 'dist' not in kvstore.type or \
+            int(os.getenv('MXNET_KVSTORE_FUSION_BUCKET_SIZE', '0')) <= 0:
+        return [[i] for i in indices]
+    batch = int(os.getenv('MXNET_UPDATE_AGGREGATION_SIZE', '16'))
+    return [indices[i:i + batch] for i in range(0, len(indices), batch)]
+
 def _update_params_on_kvstore_nccl(param_arrays, grad_arrays, kvstore, param_names):
     """Perform update of param_arrays from grad_arrays on NCCL kvstore."""
     valid_indices = [index for index, grad_list in
@@ -149,31 +161,34 @@ def _update_params_on_kvstore_nccl(param_arrays, grad_arrays, kvstore, param_nam
 
 def _update_params_on_kvstore(param_arrays, grad_arrays, kvstore, param_names):
     """Perform update of param_arrays from grad_arrays on kvstore."""
-    for index, pair in enumerate(zip(param_arrays, grad_arrays)):
-        arg_list, grad_list = pair
-        if grad_list[0] is None:
-            continue
-        name = param_names[index]
+    valid_indices = [index for index, grad_list in
+                     enumerate(grad_arrays) if grad_list[0] is not None]
+    for batch in _kvstore_key_batches(kvstore, valid_indices):
+        names = [param_names[index] for index in batch]
         # push gradient, priority is negative index
-        kvstore.push(name, grad_list, priority=-index)
+        kvstore.push(names, [grad_arrays[index] for index in batch], priority=-batch[0])
         # pull back the weights
-        kvstore.pull(name, arg_list, priority=-index)
+        kvstore.pull(names, [param_arrays[index] for index in batch], priority=-batch[0])
 
 def _update_params(param_arrays, grad_arrays, updater, num_device,
                    kvstore=None, param_names=None):
     """Perform update of param_arrays from grad_arrays not on kvstore."""
     updates = [[] for _ in range(num_device)]
+    if kvstore:
+        valid_indices = [index for index, grad_list in
+                         enumerate(grad_arrays) if grad_list[0] is not None]
+        for batch in _kvstore_key_batches(kvstore, valid_indices):
+            names = [param_names[index] for index in batch]
+            grads = [grad_arrays[index] for index in batch]
+            # push gradient, priority is negative index
+            kvstore.push(names, grads, priority=-batch[0])
+            # pull back the sum gradients, to the same locations.
+            kvstore.pull(names, grads, priority=-batch[0])
     for i, pair in enumerate(zip(param_arrays, grad_arrays)):
         arg_list, grad_list = pair
         if grad_list[0] is None:
             continue
         index = i
-        if kvstore:
-            name = param_names[index]
-            # push gradient, priority is negative index
-            kvstore.push(name, grad_list, priority=-index)
-            # pull back the sum gradients, to the same locations.
-            kvstore.pull(name, grad_list, priority=-index)
         for k, p in enumerate(zip(arg_list, grad_list)):
             # faked an index here, to make optimizer create diff
             # state for the same index but on diff devs, TODO(mli)
@@ -146,7 +146,7 @@ def array(source_array, ctx=None, dtype=None):
         return _array(source_array, ctx=ctx, dtype=dtype)
 
 
-def load(fname):
+def load(fname, ctx=None, mapped=False, verify=False):
     """Loads an array from file.
 
     See more details in ``save``.
@@ -155,12 +155,23 @@ def load(fname):
     ----------
     fname : str
         The filename.
+    ctx : Context or list of Context, optional
+        Load the arrays onto this context instead of the one they were saved from.
+        With a list, the arrays are loaded onto every context in parallel.
+    mapped : bool, optional
+        Map a local file saved with ``chunked=True`` into memory instead of reading it.
+        Its dense arrays loaded on cpu then point into the mapping, so the file must
+        not be modified in place while they are alive; ``save`` replaces the file
+        instead of overwriting it.
+    verify : bool, optional
+        Check the checksums of a file saved with ``checksum=True`` when `mapped`.
+        Files that are read are always checked.
 
     Returns
     -------
     list of NDArray, RowSparseNDArray or CSRNDArray, or \
     dict of str to NDArray, RowSparseNDArray or CSRNDArray
-        Loaded data.
+        Loaded data, or a list of them, one per context, if `ctx` is a list.
     """
     if not isinstance(fname, string_types):
         raise TypeError('fname required to be a string')
@@ -168,18 +179,51 @@ def load(fname):
     out_name_size = mx_uint()
     handles = ctypes.POINTER(NDArrayHandle)()
     names = ctypes.POINTER(ctypes.c_char_p)()
-    check_call(_LIB.MXNDArrayLoad(c_str(fname),
-                                  ctypes.byref(out_size),
-                                  ctypes.byref(handles),
-                                  ctypes.byref(out_name_size),
-                                  ctypes.byref(names)))
-    if out_name_size.value == 0:
-        return [_ndarray_cls(NDArrayHandle(handles[i])) for i in range(out_size.value)]
+    if not mapped:
+        check_call(_LIB.MXNDArrayLoad(c_str(fname),
+                                      ctypes.byref(out_size),
+                                      ctypes.byref(handles),
+                                      ctypes.byref(out_name_size),
+                                      ctypes.byref(names)))
+        loaded = _load_result(handles, 0, out_size.value, names, out_name_size.value)
+        if ctx is None:
+            return loaded
+        if not isinstance(ctx, (list, tuple)):
+            return _load_as_in_context(loaded, ctx)
+        return [_load_as_in_context(loaded, c) for c in ctx]
+    ctxs = [] if ctx is None else ctx if isinstance(ctx, (list, tuple)) else [ctx]
+    check_call(_LIB.MXNDArrayLoadMapped(c_str(fname),
+                                        ctypes.c_int(len(ctxs)),
+                                        c_array(ctypes.c_int, [c.device_typeid for c in ctxs]),
+                                        c_array(ctypes.c_int, [c.device_id for c in ctxs]),
+                                        ctypes.c_int(verify),
+                                        ctypes.byref(out_size),
+                                        ctypes.byref(handles),
+                                        ctypes.byref(out_name_size),
+                                        ctypes.byref(names)))
+    if not isinstance(ctx, (list, tuple)):
+        return _load_result(handles, 0, out_size.value, names, out_name_size.value)
+    num = out_size.value // len(ctxs)
+    return [_load_result(handles, i * num, num, names, out_name_size.value)
+            for i in range(len(ctxs))]
+
+
+def _load_as_in_context(loaded, ctx):
+    """Copies a loaded list or dict of arrays to ctx, the copies run asynchronously."""
+    if isinstance(loaded, dict):
+        return dict((k, v.as_in_context(ctx)) for k, v in loaded.items())
+    return [v.as_in_context(ctx) for v in loaded]
+
+
+def _load_result(handles, begin, size, names, name_size):
+    """Wraps size loaded handles from begin as a list, or a dict if the file has names."""
+    if name_size == 0:
+        return [_ndarray_cls(NDArrayHandle(handles[begin + i])) for i in range(size)]
     else:
-        assert out_name_size.value == out_size.value
+        assert name_size == size
         return dict(
-            (py_str(names[i]), _ndarray_cls(NDArrayHandle(handles[i])))
-            for i in range(out_size.value))
+            (py_str(names[i]), _ndarray_cls(NDArrayHandle(handles[begin + i])))
+            for i in range(size))
 
 
 def load_frombuffer(buf):
@@ -219,7 +263,7 @@ def load_frombuffer(buf):
             for i in range(out_size.value))
 
 
-def save(fname, data):
+def save(fname, data, chunked=False, checksum=False):
     """Saves a list of arrays or a dict of str->array to file.
 
     Examples of filenames:
@@ -236,6 +280,12 @@ def save(fname, data):
            or list of NDArray, RowSparseNDArray or CSRNDArray, \
            or dict of str to NDArray, RowSparseNDArray or CSRNDArray
         The data to save.
+    chunked : bool, optional
+        Write an index of the arrays up front and every array at an aligned offset,
+        so ``load(fname, mapped=True)`` can map the file into memory instead of
+        reading it.
+    checksum : bool, optional
+        Store a checksum of every array, only with `chunked`.
 
     Examples
     --------
@@ -274,7 +324,14 @@ def save(fname, data):
     else:
         raise ValueError("data needs to either be a NDArray, dict of str, NDArray pairs "
                          "or a list of NDarrays.")
-    check_call(_LIB.MXNDArraySave(c_str(fname),
-                                  mx_uint(len(handles)),
-                                  handles,
-                                  keys))
+    if chunked:
+        check_call(_LIB.MXNDArraySaveChunked(c_str(fname),
+                                             mx_uint(len(handles)),
+                                             handles,
+                                             keys,
+                                             ctypes.c_int(checksum)))
+    else:
+        check_call(_LIB.MXNDArraySave(c_str(fname),
+                                      mx_uint(len(handles)),
+                                      handles,
+                                      keys))
@@ -54,6 +54,13 @@ def set_config(**kwargs):
     aggregate_stats : boolean,
         whether to maintain aggregate stats in memory for console
         dump.  Has some negative performance impact.
+    sample_period : int,
+        if not 0, only profile one in every `sample_period` operators. Sampled
+        operators only feed the aggregate stats, which are then always maintained,
+        and are left out of the trace file. Low overhead enough to leave on in production.
+    sample_interval_us : int,
+        if not 0, profile an operator at least every `sample_interval_us` microseconds,
+        alone or together with `sample_period`.
     profile_process : string
         whether to profile kvstore `server` or `worker`.
         server can only be profiled when kvstore is of type dist.
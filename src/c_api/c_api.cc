@@ -22,6 +22,9 @@
  * \file c_api.cc
  * \brief C API of mxnet
  */
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
 #include <vector>
 #include <sstream>
 #include <string>
@@ -53,6 +56,10 @@
 #include "../operator/tvmop/op_module.h"
 #include "../common/utils.h"
 
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif  // !defined(_WIN32)
+
 using namespace mxnet;
 
 // Internal function to get the information
@@ -357,6 +364,34 @@ int MXNDArrayWaitAll() {
   API_END();
 }
 
+/*!
+ * \brief Write an NDArray file with save. Local files are written to a temporary file
+ *  that replaces fname once complete, so arrays mapped from the old file by
+ *  MXNDArrayLoadMapped keep their data instead of seeing the file truncated.
+ */
+template<typename FSave>
+inline void SaveNDArrayFile(const char* fname, FSave save) {
+  std::string path(fname);
+  if (path.compare(0, 7, "file://") == 0) path = path.substr(7);
+#if !defined(_WIN32)
+  if (path.find("://") == std::string::npos) {
+    const std::string tmp = path + ".tmp" + std::to_string(getpid());
+    try {
+      std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create(tmp.c_str(), "w"));
+      save(fo.get());
+    } catch (...) {
+      std::remove(tmp.c_str());
+      throw;
+    }
+    CHECK_EQ(std::rename(tmp.c_str(), path.c_str()), 0)
+        << "Failed to replace " << path << ": " << strerror(errno);
+    return;
+  }
+#endif  // !defined(_WIN32)
+  std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create(fname, "w"));
+  save(fo.get());
+}
+
 int MXNDArraySave(const char* fname,
                   uint32_t num_args,
                   NDArrayHandle* args,
@@ -373,10 +408,9 @@ int MXNDArraySave(const char* fname,
       names[i] = keys[i];
     }
   }
-  {
-    std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create(fname, "w"));
-    mxnet::NDArray::Save(fo.get(), data, names);
-  }
+  SaveNDArrayFile(fname, [&](dmlc::Stream* fo) {
+    mxnet::NDArray::Save(fo, data, names);
+  });
   API_END();
 }
 
@@ -411,6 +445,65 @@ int MXNDArrayLoad(const char* fname,
   API_END();
 }
 
+int MXNDArraySaveChunked(const char* fname,
+                         uint32_t num_args,
+                         NDArrayHandle* args,
+                         const char** keys,
+                         int checksum) {
+  API_BEGIN();
+  std::vector<NDArray> data(num_args);
+  std::vector<std::string> names;
+  for (uint32_t i = 0; i < num_args; ++i) {
+    data[i] = *static_cast<NDArray*>(args[i]);
+  }
+  if (keys != nullptr) {
+    names.resize(num_args);
+    for (uint32_t i = 0; i < num_args; ++i) {
+      names[i] = keys[i];
+    }
+  }
+  SaveNDArrayFile(fname, [&](dmlc::Stream* fo) {
+    mxnet::NDArray::SaveChunked(fo, data, names, checksum != 0);
+  });
+  API_END();
+}
+
+int MXNDArrayLoadMapped(const char* fname,
+                        int num_ctx,
+                        const int* dev_types,
+                        const int* dev_ids,
+                        int verify,
+                        uint32_t *out_size,
+                        NDArrayHandle** out_arr,
+                        uint32_t *out_name_size,
+                        const char*** out_names) {
+  MXAPIThreadLocalEntry<> *ret = MXAPIThreadLocalStore<>::Get();
+  ret->ret_vec_str.clear();
+  API_BEGIN();
+  std::vector<NDArray> data;
+  std::vector<std::string> &names = ret->ret_vec_str;
+  std::vector<Context> ctxs;
+  for (int i = 0; i < num_ctx; ++i) {
+    ctxs.push_back(Context::Create(static_cast<Context::DeviceType>(dev_types[i]), dev_ids[i]));
+  }
+  mxnet::NDArray::LoadFile(fname, ctxs, verify != 0, &data, &names);
+  ret->ret_handles.resize(data.size());
+  for (size_t i = 0; i < data.size(); ++i) {
+    NDArray *ptr = new NDArray();
+    *ptr = data[i];
+    ret->ret_handles[i] = ptr;
+  }
+  ret->ret_vec_charp.resize(names.size());
+  for (size_t i = 0; i < names.size(); ++i) {
+    ret->ret_vec_charp[i] = names[i].c_str();
+  }
+  *out_size = static_cast<uint32_t>(data.size());
+  *out_arr = dmlc::BeginPtr(ret->ret_handles);
+  *out_name_size = static_cast<uint32_t>(names.size());
+  *out_names = dmlc::BeginPtr(ret->ret_vec_charp);
+  API_END();
+}
+
 int MXNDArrayLoadFromBuffer(const void *ndarray_buffer,
                             size_t size,
                             uint32_t *out_size,
@@ -1210,6 +1303,18 @@ int MXKVStoreSetUpdater(KVStoreHandle handle,
   API_END();
 }
 
+int MXKVStoreSetThreadSafeUpdater(KVStoreHandle handle,
+                                  MXKVStoreUpdater updater,
+                                  void* updater_handle) {
+  API_BEGIN();
+  std::function<void(int, const NDArray&, NDArray*)> updt
+  = [updater, updater_handle](int key, const NDArray& recv, NDArray* local) {
+    updater(key, new NDArray(recv), new NDArray(*local), updater_handle);
+  };
+  static_cast<KVStore*>(handle)->set_thread_safe_updater(updt);
+  API_END();
+}
+
 int MXKVStoreSetUpdaterEx(KVStoreHandle handle,
                           MXKVStoreUpdater updater,
                           MXKVStoreStrUpdater str_updater,
@@ -189,6 +189,13 @@ int MXFreeCachedOp(CachedOpHandle handle) {
   API_END();
 }
 
+int MXCachedOpGetFullSymbol(CachedOpHandle handle, SymbolHandle *out) {
+  API_BEGIN();
+  CachedOpPtr op = *static_cast<CachedOpPtr*>(handle);
+  *out = reinterpret_cast<SymbolHandle>(new nnvm::Symbol(op->GetFullSym()));
+  API_END();
+}
+
 int MXInvokeCachedOp(CachedOpHandle handle,
                      int num_inputs,
                      NDArrayHandle *inputs,
@@ -212,6 +212,8 @@ struct ProfileConfigParam : public dmlc::Parameter<ProfileConfigParam> {
   bool continuous_dump;
   float dump_period;
   bool aggregate_stats;
+  int sample_period;
+  int sample_interval_us;
   int profile_process;
   DMLC_DECLARE_PARAMETER(ProfileConfigParam) {
     DMLC_DECLARE_FIELD(profile_all).set_default(false)
@@ -235,6 +237,13 @@ struct ProfileConfigParam : public dmlc::Parameter<ProfileConfigParam> {
     DMLC_DECLARE_FIELD(aggregate_stats).set_default(false)
       .describe("Maintain aggregate stats, required for MXDumpAggregateStats.  Note that "
       "this can have a negative performance impact. Default is False.");
+    DMLC_DECLARE_FIELD(sample_period).set_default(0).set_lower_bound(0)
+      .describe("Only profile one in every sample_period operators. Sampled operators "
+                "feed the aggregate stats and are left out of the trace, so that "
+                "profiling can stay on in production. Default is 0, profile all.");
+    DMLC_DECLARE_FIELD(sample_interval_us).set_default(0).set_lower_bound(0)
+      .describe("Profile an operator at least every sample_interval_us microseconds, "
+                "alone or together with sample_period. Default is 0, not sampling by time.");
     DMLC_DECLARE_FIELD(profile_process)
       .add_enum("worker", static_cast<int>(ProfileProcess::kWorker))
       .add_enum("server", static_cast<int>(ProfileProcess::kServer))
@@ -297,7 +306,9 @@ int MXSetProcessProfilerConfig(int num_params, const char* const* keys, const ch
                                            std::string(param.filename),
                                            param.continuous_dump,
                                            param.dump_period,
-                                           param.aggregate_stats);
+                                           param.aggregate_stats,
+                                           param.sample_period,
+                                           param.sample_interval_us);
     }
   API_END();
 }
@@ -320,6 +331,8 @@ int MXAggregateProfileStatsPrintEx(const char **out_str, int reset, int format,
       // Register stats up until now
       profiler->DumpProfile(false);
     }
+    // Samples are not in the trace, and may be pulled while the profiler keeps running
+    profiler->FlushSamples();
     std::shared_ptr<profiler::AggregateStats> stats = profiler->GetAggregateStats();
     std::ostringstream os;
     if (stats) {
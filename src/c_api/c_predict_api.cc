@@ -28,7 +28,15 @@
 #include <mxnet/executor.h>
 #include <mxnet/ndarray.h>
 #include <nnvm/pass_functions.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
 #include <unordered_set>
 #include <unordered_map>
 #include "./c_api_common.h"
@@ -52,16 +60,75 @@ struct MXAPIPredictor {
 
   // uint32_t buffer for output shapes
   std::vector<uint32_t> out_shapes_buffer;
+  // default layout copies of outputs handed out by MXPredGetOutputPtr
+  std::vector<NDArray> out_default_arrays;
+  // indices of arguments bound to caller-owned memory by MXPredSetInputPtr
+  std::unordered_set<size_t> zero_copy_args;
+  // executor bound for other input shapes, see MXPredReshapeInPlace
+  struct CachedExecutor {
+    std::string key;
+    std::shared_ptr<Executor> exec;
+    std::vector<NDArray> arg_arrays;
+    std::vector<NDArray> out_arrays;
+    mxnet::ShapeVector out_shapes;
+  };
+  // cached executors, most recently used first
+  std::list<CachedExecutor> exec_cache;
+  // maximum number of cached executors
+  size_t exec_cache_size = 0;
+  // executor owning the memory pool shared by all executors of exec_cache
+  std::shared_ptr<Executor> pool_exec;
   // key to arguments
   std::unordered_map<std::string, size_t> key2arg;
   // executor
-  std::unique_ptr<Executor> exec;
+  std::shared_ptr<Executor> exec;
   // symbol
   nnvm::Symbol sym;
   // Context
   Context ctx;
 };
 
+// predictor that joins concurrent requests into batches
+struct MXAPIBatchedPredictor {
+  // one request, rows [offset, offset + num_rows) of the batch
+  struct Request {
+    const float** inputs;
+    float** outputs;
+    uint32_t num_rows;
+    uint32_t offset;
+  };
+  // a batch that is being formed or run
+  struct Batch {
+    std::vector<Request> requests;
+    uint32_t num_rows = 0;
+    // no more requests can join
+    bool full = false;
+    // outputs are written back
+    bool done = false;
+    // error raised while running the batch
+    std::string error;
+  };
+  // predictor bound with max_batch_size rows
+  std::unique_ptr<MXAPIPredictor> pred;
+  // argument index of each input, in the order requests pass them
+  std::vector<size_t> input_args;
+  // number of elements per row of each input
+  std::vector<size_t> input_row_size;
+  // number of elements per row of each output
+  std::vector<size_t> output_row_size;
+  // maximum number of rows in a batch
+  uint32_t max_batch_size;
+  // how long the first request of a batch waits for others to join
+  std::chrono::microseconds max_delay;
+  // protects open_batch and the state of all batches
+  std::mutex mutex;
+  std::condition_variable cv;
+  // batch new requests join, nullptr if none is open
+  std::shared_ptr<Batch> open_batch;
+  // serializes forward passes over the shared executor
+  std::mutex exec_mutex;
+};
+
 struct MXAPINDList {
   std::vector<std::string> keys;
   mxnet::ShapeVector shapes;
@@ -434,24 +501,13 @@ int MXPredCreateMultiThread(const char* symbol_json_str,
       out);
 }
 
-int MXPredReshape(uint32_t num_input_nodes,
-                  const char** input_keys,
-                  const uint32_t* input_shape_indptr,
-                  const uint32_t* input_shape_data,
-                  PredictorHandle handle,
-                  PredictorHandle* out) {
-  _CreateExecutor(handle);
-  MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
-  std::unique_ptr<MXAPIPredictor> ret(new MXAPIPredictor());
-
-  API_BEGIN();
-  // shape inference
-  std::unordered_map<std::string, mxnet::TShape> new_shape;
-  for (uint32_t i = 0; i < num_input_nodes; ++i) {
-    new_shape[std::string(input_keys[i])] =
-        mxnet::TShape(input_shape_data + input_shape_indptr[i],
-            input_shape_data + input_shape_indptr[i + 1]);
-  }
+// infer the shapes for new input shapes of p and bind ret, sharing parameters and
+// memory with shared_exec. The reshaped inputs get arrays of their own: executors
+// keep the pointers of their inputs, so the arrays of p must not be reallocated.
+inline void _ReshapeAndBind(MXAPIPredictor* p,
+                            const std::unordered_map<std::string, mxnet::TShape>& new_shape,
+                            Executor* shared_exec,
+                            MXAPIPredictor* ret) {
   ret->sym = p->sym;
   std::vector<std::string> arg_names = ret->sym.ListInputNames(Symbol::kReadOnlyArgs);
   std::vector<std::string> aux_names = ret->sym.ListInputNames(Symbol::kAuxiliaryStates);
@@ -465,7 +521,7 @@ int MXPredReshape(uint32_t num_input_nodes,
     in_shapes.reserve(arg_names.size());
     for (std::string key : ret->sym.ListInputNames(Symbol::kAll)) {
       if (new_shape.count(key) != 0) {
-        in_shapes.push_back(new_shape[key]);
+        in_shapes.push_back(new_shape.at(key));
       } else {
         in_shapes.emplace_back();
       }
@@ -488,7 +544,7 @@ int MXPredReshape(uint32_t num_input_nodes,
     mxnet::TShape newShape = arg_shapes[i];
     NDArray &arr = p->arg_arrays[i];
     if (new_shape.count(arg_names[i]) != 0) {
-      ret->arg_arrays[i].ReshapeAndAlloc(newShape);
+      ret->arg_arrays[i] = NDArray(newShape, ret->ctx, false, arr.dtype());
     } else {
        CHECK_EQ(newShape.Size(), arr.shape().Size())
         << "arg " << arg_names[i]
@@ -516,15 +572,121 @@ int MXPredReshape(uint32_t num_input_nodes,
                                    ret->arg_arrays,
                                    grad_store, grad_req,
                                    ret->aux_arrays,
-                                   p->exec.get()));
+                                   shared_exec));
     ret->out_shapes = out_shapes;
     ret->out_arrays = ret->exec->outputs();
     ret->out_dtypes = p->out_dtypes;
   }
+}
+
+int MXPredReshape(uint32_t num_input_nodes,
+                  const char** input_keys,
+                  const uint32_t* input_shape_indptr,
+                  const uint32_t* input_shape_data,
+                  PredictorHandle handle,
+                  PredictorHandle* out) {
+  _CreateExecutor(handle);
+  MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
+  std::unique_ptr<MXAPIPredictor> ret(new MXAPIPredictor());
+
+  API_BEGIN();
+  // shape inference
+  std::unordered_map<std::string, mxnet::TShape> new_shape;
+  for (uint32_t i = 0; i < num_input_nodes; ++i) {
+    new_shape[std::string(input_keys[i])] =
+        mxnet::TShape(input_shape_data + input_shape_indptr[i],
+            input_shape_data + input_shape_indptr[i + 1]);
+  }
+  _ReshapeAndBind(p, new_shape, p->exec.get(), ret.get());
   *out = ret.release();
   API_END();
 }
 
+// key of the executor cache, the shapes of the given inputs in name order
+inline std::string _ShapeCacheKey(const std::map<std::string, mxnet::TShape>& shapes) {
+  std::ostringstream os;
+  for (const auto& kv : shapes) {
+    os << kv.first << kv.second << ';';
+  }
+  return os.str();
+}
+
+int MXPredSetExecutorCacheSize(PredictorHandle handle,
+                               uint32_t cache_size) {
+  MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
+  API_BEGIN();
+  p->exec_cache_size = cache_size;
+  while (p->exec_cache.size() > p->exec_cache_size) {
+    p->exec_cache.pop_back();
+  }
+  API_END();
+}
+
+int MXPredReshapeInPlace(PredictorHandle handle,
+                         uint32_t num_input_nodes,
+                         const char** input_keys,
+                         const uint32_t* input_shape_indptr,
+                         const uint32_t* input_shape_data) {
+  _CreateExecutor(handle);
+  MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
+  API_BEGIN();
+  std::unordered_map<std::string, mxnet::TShape> new_shape;
+  std::map<std::string, mxnet::TShape> new_key, cur_key;
+  for (uint32_t i = 0; i < num_input_nodes; ++i) {
+    std::string name(input_keys[i]);
+    auto it = p->key2arg.find(name);
+    CHECK(it != p->key2arg.end()) << "cannot find input key " << name;
+    new_shape[name] = mxnet::TShape(input_shape_data + input_shape_indptr[i],
+                                    input_shape_data + input_shape_indptr[i + 1]);
+    new_key[name] = new_shape[name];
+    cur_key[name] = p->arg_arrays[it->second].shape();
+  }
+  CHECK(p->zero_copy_args.empty())
+      << "MXPredReshapeInPlace cannot be used after MXPredSetInputPtr";
+  const std::string key = _ShapeCacheKey(new_key);
+  const std::string current = _ShapeCacheKey(cur_key);
+  if (key == current) return 0;
+
+  // the first executor keeps the memory pool that all the others share
+  if (p->pool_exec == nullptr) {
+    p->pool_exec = p->exec;
+  }
+  auto hit = std::find_if(p->exec_cache.begin(), p->exec_cache.end(),
+                          [&key](const MXAPIPredictor::CachedExecutor& e) {
+                            return e.key == key;
+                          });
+  MXAPIPredictor bound;
+  if (hit == p->exec_cache.end()) {
+    _ReshapeAndBind(p, new_shape, p->pool_exec.get(), &bound);
+  }
+  MXAPIPredictor::CachedExecutor active;
+  active.key = current;
+  active.exec = p->exec;
+  active.arg_arrays = std::move(p->arg_arrays);
+  active.out_arrays = std::move(p->out_arrays);
+  active.out_shapes = std::move(p->out_shapes);
+  if (hit != p->exec_cache.end()) {
+    p->exec = hit->exec;
+    p->arg_arrays = std::move(hit->arg_arrays);
+    p->out_arrays = std::move(hit->out_arrays);
+    p->out_shapes = std::move(hit->out_shapes);
+    p->exec_cache.erase(hit);
+  } else {
+    p->exec = bound.exec;
+    p->arg_arrays = std::move(bound.arg_arrays);
+    p->out_arrays = std::move(bound.out_arrays);
+    p->out_shapes = std::move(bound.out_shapes);
+  }
+  p->out_default_arrays.clear();
+  if (p->exec_cache_size > 0) {
+    p->exec_cache.push_front(std::move(active));
+    while (p->exec_cache.size() > p->exec_cache_size) {
+      p->exec_cache.pop_back();
+    }
+  }
+  API_END();
+}
+
 int MXPredGetOutputShape(PredictorHandle handle,
                          uint32_t out_index,
                          uint32_t** shape_data,
@@ -573,6 +735,71 @@ int MXPredSetInput(PredictorHandle handle,
   API_END();
 }
 
+int MXPredSetInputPtr(PredictorHandle handle,
+                      const char* key,
+                      const void* data,
+                      uint32_t size) {
+  _CreateExecutor(handle);
+  MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
+  API_BEGIN();
+  CHECK_EQ(p->ctx.dev_mask(), Context::kCPU)
+      << "Zero-copy input is only supported for CPU predictors";
+  CHECK(p->pool_exec == nullptr)
+      << "MXPredSetInputPtr cannot be used after MXPredReshapeInPlace";
+  // the alignment MKLDNN needs, required in every build so that callers are portable
+  CHECK_EQ(reinterpret_cast<uintptr_t>(data) % 64, 0U)
+      << "Input buffer must be aligned to 64 bytes";
+  auto it = p->key2arg.find(key);
+  if (it == p->key2arg.end()) {
+    LOG(FATAL) << "cannot find input key " << key;
+  }
+  NDArray& nd = p->arg_arrays[it->second];
+  CHECK_EQ(nd.shape().Size(), size)
+      << "Memory size do not match";
+  if (p->zero_copy_args.count(it->second) != 0) {
+    nd.SetStaticDataPtr(const_cast<void*>(data));
+  } else {
+    // first zero-copy use of this input: rebind the executor over a static
+    // array, later calls only swap the data pointer of that array.
+    nd.WaitToWrite();
+    TBlob blob(const_cast<void*>(data), nd.shape(), cpu::kDevMask, nd.dtype(), 0);
+    nd = NDArray(blob, 0);
+    std::map<std::string, Context> ctx_map;
+    std::vector<NDArray> grad_store(p->arg_arrays.size());
+    std::vector<OpReqType> grad_req(p->arg_arrays.size(), kNullOp);
+    p->exec.reset(Executor::Bind(p->sym, p->ctx, ctx_map,
+                                 p->arg_arrays,
+                                 grad_store, grad_req,
+                                 p->aux_arrays,
+                                 p->exec.get()));
+    p->out_arrays = p->exec->outputs();
+    p->zero_copy_args.insert(it->second);
+  }
+  API_END();
+}
+
+int MXPredGetOutputPtr(PredictorHandle handle,
+                       uint32_t index,
+                       const void** data) {
+  MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
+  API_BEGIN();
+  CHECK_LT(index, p->out_arrays.size())
+      << "Output index out of range";
+  CHECK_EQ(p->ctx.dev_mask(), Context::kCPU)
+      << "Zero-copy output is only supported for CPU predictors";
+  NDArray nd = p->out_arrays[index];
+#if MXNET_USE_MKLDNN == 1
+  if (nd.IsMKLDNNData()) {
+    nd = nd.Reorder2Default();
+  }
+#endif
+  p->out_default_arrays.resize(p->out_arrays.size());
+  p->out_default_arrays[index] = nd;
+  nd.WaitToRead();
+  *data = nd.data().dptr_;
+  API_END();
+}
+
 int MXPredForward(PredictorHandle handle) {
   _CreateExecutor(handle);
   MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
@@ -608,6 +835,145 @@ int MXPredFree(PredictorHandle handle) {
   API_END();
 }
 
+int MXPredCreateBatched(const char* symbol_json_str,
+                        const void* param_bytes,
+                        int param_size,
+                        int dev_type, int dev_id,
+                        uint32_t num_input_nodes,
+                        const char** input_keys,
+                        const uint32_t* input_shape_indptr,
+                        const uint32_t* input_shape_data,
+                        uint32_t max_batch_size,
+                        uint32_t max_delay_us,
+                        BatchedPredictorHandle* out) {
+  std::unique_ptr<MXAPIBatchedPredictor> ret(new MXAPIBatchedPredictor());
+  API_BEGIN();
+  CHECK_GT(max_batch_size, 0U) << "max_batch_size must be positive";
+  // bind every input with max_batch_size rows
+  std::vector<uint32_t> batch_shape_data(input_shape_data,
+                                         input_shape_data + input_shape_indptr[num_input_nodes]);
+  for (uint32_t i = 0; i < num_input_nodes; ++i) {
+    CHECK_GT(input_shape_indptr[i + 1], input_shape_indptr[i])
+        << "input " << input_keys[i] << " needs a batch dimension";
+    batch_shape_data[input_shape_indptr[i]] = max_batch_size;
+  }
+  PredictorHandle pred = nullptr;
+  if (_CreatePartialOut(symbol_json_str, param_bytes, param_size, dev_type, dev_id,
+                        num_input_nodes, input_keys, input_shape_indptr,
+                        batch_shape_data.data(), 0, nullptr, 1, false,
+                        0, nullptr, nullptr, &pred) != 0) {
+    return -1;
+  }
+  ret->pred.reset(static_cast<MXAPIPredictor*>(pred));
+  ret->max_batch_size = max_batch_size;
+  ret->max_delay = std::chrono::microseconds(max_delay_us);
+  for (uint32_t i = 0; i < num_input_nodes; ++i) {
+    const size_t idx = ret->pred->key2arg.at(input_keys[i]);
+    ret->input_args.push_back(idx);
+    ret->input_row_size.push_back(ret->pred->arg_arrays[idx].shape().Size() / max_batch_size);
+  }
+  for (const mxnet::TShape& s : ret->pred->out_shapes) {
+    CHECK(s.ndim() > 0 && s[0] == static_cast<dim_t>(max_batch_size))
+        << "All outputs of a batched predictor must have the batch as first dimension";
+    ret->output_row_size.push_back(s.Size() / max_batch_size);
+  }
+  *out = ret.release();
+  API_END();
+}
+
+// copy the requests into the bound inputs, run forward and scatter the outputs
+static void _RunBatch(MXAPIBatchedPredictor* p, MXAPIBatchedPredictor::Batch* batch) {
+  std::lock_guard<std::mutex> exec_lock(p->exec_mutex);
+  try {
+    MXAPIPredictor* pred = p->pred.get();
+    for (size_t i = 0; i < p->input_args.size(); ++i) {
+      const NDArray& nd = pred->arg_arrays[p->input_args[i]];
+      for (const auto& req : batch->requests) {
+        nd.Slice(req.offset, req.offset + req.num_rows)
+            .SyncCopyFromCPU(req.inputs[i], req.num_rows * p->input_row_size[i]);
+      }
+    }
+    pred->exec->Forward(false);
+    for (size_t j = 0; j < pred->out_arrays.size(); ++j) {
+      NDArray nd = pred->out_arrays[j];
+#if MXNET_USE_MKLDNN == 1
+      if (nd.IsMKLDNNData()) {
+        nd = nd.Reorder2Default();
+      }
+#endif
+      for (const auto& req : batch->requests) {
+        nd.Slice(req.offset, req.offset + req.num_rows)
+            .SyncCopyToCPU(req.outputs[j], req.num_rows * p->output_row_size[j]);
+      }
+    }
+  } catch (const std::exception& e) {
+    batch->error = e.what();
+  }
+}
+
+int MXPredBatchedForward(BatchedPredictorHandle handle,
+                         uint32_t num_rows,
+                         const float** inputs,
+                         float** outputs) {
+  MXAPIBatchedPredictor* p = static_cast<MXAPIBatchedPredictor*>(handle);
+  API_BEGIN();
+  CHECK_GT(num_rows, 0U);
+  CHECK_LE(num_rows, p->max_batch_size)
+      << "Request has more rows than max_batch_size";
+  std::unique_lock<std::mutex> lock(p->mutex);
+  std::shared_ptr<MXAPIBatchedPredictor::Batch> batch;
+  bool leader = false;
+  while (batch == nullptr) {
+    if (p->open_batch == nullptr) {
+      p->open_batch = std::make_shared<MXAPIBatchedPredictor::Batch>();
+      leader = true;
+    }
+    auto& open = p->open_batch;
+    if (open->num_rows + num_rows <= p->max_batch_size) {
+      open->requests.push_back({inputs, outputs, num_rows, open->num_rows});
+      open->num_rows += num_rows;
+      batch = open;
+      if (batch->num_rows == p->max_batch_size) {
+        batch->full = true;
+        p->open_batch = nullptr;
+        p->cv.notify_all();
+      }
+    } else {
+      // does not fit, let the open batch go and start a new one
+      open->full = true;
+      p->open_batch = nullptr;
+      p->cv.notify_all();
+      leader = false;
+    }
+  }
+  if (leader) {
+    // the first request of a batch waits for others up to max_delay
+    const auto deadline = std::chrono::steady_clock::now() + p->max_delay;
+    p->cv.wait_until(lock, deadline, [&batch]() { return batch->full; });
+    batch->full = true;
+    if (p->open_batch == batch) {
+      p->open_batch = nullptr;
+    }
+    lock.unlock();
+    _RunBatch(p, batch.get());
+    lock.lock();
+    batch->done = true;
+    p->cv.notify_all();
+  } else {
+    p->cv.wait(lock, [&batch]() { return batch->done; });
+  }
+  if (!batch->error.empty()) {
+    throw dmlc::Error(batch->error);
+  }
+  API_END();
+}
+
+int MXPredBatchedFree(BatchedPredictorHandle handle) {
+  API_BEGIN();
+  delete static_cast<MXAPIBatchedPredictor*>(handle);
+  API_END();
+}
+
 int MXNDListCreate(const char* nd_file_bytes,
                    int nd_file_size,
                    NDListHandle *out,
@@ -313,6 +313,11 @@ inline void LogMemoryPlan(const nnvm::Graph& g) {
       }
     }
   }
+  if (g.attrs.count("storage_planned_bytes")) {
+    LOG(INFO) << "Total " << (g.GetAttr<size_t>("storage_allocated_bytes") >> 10)
+              << " KB allocated, " << (g.GetAttr<size_t>("storage_planned_bytes") >> 10)
+              << " KB planned by live interval packing";
+  }
 }
 
 /* log the static memory plan of the graph. Example:
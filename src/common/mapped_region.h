@@ -0,0 +1,210 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2019 by Contributors
+ * \file mapped_region.h
+ * \brief registry of memory mapped files that arrays may point into, so that
+ *  operators reading a few rows of a large mapped array can fault them in ahead
+ *  and keep the frequently read ones resident
+ */
+#ifndef MXNET_COMMON_MAPPED_REGION_H_
+#define MXNET_COMMON_MAPPED_REGION_H_
+
+#if !defined(_WIN32)
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace mxnet {
+namespace common {
+/*!
+ * \brief a read-mostly file mapping
+ *  Rows are faulted in by the reader and evicted by the page cache. Optionally
+ *  the most read pages are locked in memory, up to a byte budget.
+ */
+class MappedRegion {
+ public:
+  /*!
+   * \param begin start of the mapping
+   * \param size length of the mapping in bytes
+   * \param resident_bytes how much of the mapping may be locked in memory
+   */
+  MappedRegion(char *begin, size_t size, size_t resident_bytes)
+      : begin_(begin), size_(size), page_(sysconf(_SC_PAGESIZE)),
+        resident_pages_(resident_bytes / page_) {}
+  ~MappedRegion() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t page : locked_) munlock(begin_ + page * page_, page_);
+  }
+  inline const char *begin() const {
+    return begin_;
+  }
+  inline size_t size() const {
+    return size_;
+  }
+  /*!
+   * \brief ask for the pages of the rows [offsets[i], offsets[i] + len) at once,
+   *  so that their page faults overlap instead of stalling the reader one by one
+   * \param offsets byte offsets of the rows, sorted in place
+   * \param len length of a row in bytes
+   */
+  inline void WillNeed(std::vector<size_t> *offsets, size_t len) {
+    if (offsets->empty() || len == 0) return;
+    std::sort(offsets->begin(), offsets->end());
+    size_t lo = 0, hi = 0;
+    for (size_t off : *offsets) {
+      const size_t first = off / page_, last = (off + len - 1) / page_ + 1;
+      if (hi != 0 && first <= hi) {
+        hi = std::max(hi, last);
+        continue;
+      }
+      if (hi != 0) madvise(begin_ + lo * page_, (hi - lo) * page_, MADV_WILLNEED);
+      lo = first;
+      hi = last;
+    }
+    madvise(begin_ + lo * page_, (hi - lo) * page_, MADV_WILLNEED);
+    if (resident_pages_ != 0) CountHits(*offsets, len);
+  }
+
+ private:
+  /*! \brief number of rows read between two updates of the locked pages */
+  static const size_t kRebalanceRows = 1 << 16;
+
+  /*! \brief count the reads of every page, and move the locks once in a while */
+  inline void CountHits(const std::vector<size_t> &offsets, size_t len) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t off : offsets) {
+      for (size_t page = off / page_; page <= (off + len - 1) / page_; ++page) ++hits_[page];
+    }
+    rows_ += offsets.size();
+    if (rows_ >= kRebalanceRows) {
+      Rebalance();
+      rows_ = 0;
+    }
+  }
+  /*! \brief lock the most read pages, unlock the ones that fell out of the budget */
+  inline void Rebalance() {
+    std::vector<std::pair<uint32_t, size_t> > ranked;
+    ranked.reserve(hits_.size());
+    for (const auto &kv : hits_) ranked.emplace_back(kv.second, kv.first);
+    const size_t keep = std::min(resident_pages_, ranked.size());
+    std::nth_element(ranked.begin(), ranked.begin() + keep, ranked.end(),
+                     std::greater<std::pair<uint32_t, size_t> >());
+    std::unordered_set<size_t> hot;
+    for (size_t i = 0; i < keep; ++i) hot.insert(ranked[i].second);
+    for (auto it = locked_.begin(); it != locked_.end();) {
+      if (hot.count(*it)) {
+        ++it;
+      } else {
+        munlock(begin_ + *it * page_, page_);
+        it = locked_.erase(it);
+      }
+    }
+    for (size_t page : hot) {
+      if (locked_.count(page)) continue;
+      if (mlock(begin_ + page * page_, page_) != 0) {
+        LOG(WARNING) << "Failed to lock hot rows of a mapped file in memory: "
+                     << strerror(errno) << ", raise RLIMIT_MEMLOCK or lower "
+                     << "MXNET_MAPPED_RESIDENT_MB. Rows are left to the page cache.";
+        for (size_t p : locked_) munlock(begin_ + p * page_, page_);
+        locked_.clear();
+        hits_.clear();
+        resident_pages_ = 0;
+        return;
+      }
+      locked_.insert(page);
+    }
+    // older reads count half, so the locked set follows a drifting workload
+    for (auto it = hits_.begin(); it != hits_.end();) {
+      it->second /= 2;
+      it = it->second == 0 ? hits_.erase(it) : std::next(it);
+    }
+  }
+
+  char *begin_;
+  size_t size_;
+  size_t page_;
+  /*! \brief most pages to lock, 0 to leave everything to the page cache */
+  size_t resident_pages_;
+  std::mutex mutex_;
+  /*! \brief reads of every page, decayed at every rebalance */
+  std::unordered_map<size_t, uint32_t> hits_;
+  /*! \brief pages currently locked */
+  std::unordered_set<size_t> locked_;
+  /*! \brief rows read since the last rebalance */
+  size_t rows_{0};
+};
+
+/*! \brief the mapped files that arrays currently point into */
+class MappedRegistry {
+ public:
+  static MappedRegistry *Get() {
+    static MappedRegistry inst;
+    return &inst;
+  }
+  /*! \brief register a mapping, MXNET_MAPPED_RESIDENT_MB of it may be locked in memory */
+  inline void Add(char *begin, size_t size) {
+    static const size_t resident_bytes =
+        dmlc::GetEnv("MXNET_MAPPED_RESIDENT_MB", size_t(0)) << 20;
+    std::lock_guard<std::mutex> lock(mutex_);
+    regions_[begin] = std::make_shared<MappedRegion>(begin, size, resident_bytes);
+    count_ = regions_.size();
+  }
+  inline void Remove(const char *begin) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    regions_.erase(begin);
+    count_ = regions_.size();
+  }
+  /*! \brief the mapping p points into, nullptr if there is none */
+  inline std::shared_ptr<MappedRegion> Find(const void *p) {
+    if (count_ == 0) return nullptr;
+    const char *ptr = static_cast<const char*>(p);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = regions_.upper_bound(ptr);
+    if (it == regions_.begin()) return nullptr;
+    --it;
+    if (ptr >= it->first + it->second->size()) return nullptr;
+    return it->second;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::map<const char*, std::shared_ptr<MappedRegion> > regions_;
+  /*! \brief number of mappings, read without the lock on the fast path */
+  std::atomic<size_t> count_{0};
+};
+}  // namespace common
+}  // namespace mxnet
+#endif  // !defined(_WIN32)
+#endif  // MXNET_COMMON_MAPPED_REGION_H_
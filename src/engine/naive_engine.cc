@@ -120,7 +120,8 @@ class NaiveEngine final : public Engine {
   void Push(OprHandle op, Context exec_ctx, int priority = 0, bool profiling = false) override {
     profiler::Profiler *profiler = profiler::Profiler::Get();
     NaiveOpr *opr = op->Cast<NaiveOpr>();
-    opr->profiling = profiling && profiler->IsProfiling(profiler::Profiler::kSymbolic);
+    opr->profiling = profiling && profiler->IsProfiling(profiler::Profiler::kSymbolic) &&
+                     (!profiler->IsSampling() || profiler->SampleNext());
     this->PushAsync([&](RunContext ctx, CallbackOnComplete on_complete) {
         if (opr->profiling) {
           std::unique_ptr<profiler::ProfileOperator::Attributes> attrs;
@@ -130,7 +131,10 @@ class NaiveEngine final : public Engine {
           opr->opr_profile.reset(new profiler::ProfileOperator(opr->opr_name, attrs.release()));
           opr->opr_profile->startForDevice(exec_ctx.dev_type, exec_ctx.dev_id);
         }
-        opr->fn(ctx, on_complete);
+        {
+          profiler::MemoryScope memory_scope(opr->profiling ? opr->opr_name : nullptr);
+          opr->fn(ctx, on_complete);
+        }
         if (opr->profiling) {
           opr->opr_profile->stop();
         }
@@ -163,7 +167,8 @@ class NaiveEngine final : public Engine {
       this->DeleteOperator(p);
     };
     std::unique_ptr<NaiveOpr, decltype(opr_deleter)> opr(nullptr, opr_deleter);
-    const bool profiling = opr_name && profiler->IsProfiling(profiler::Profiler::kImperative);
+    const bool profiling = opr_name && profiler->IsProfiling(profiler::Profiler::kImperative) &&
+                           (!profiler->IsSampling() || profiler->SampleNext());
     // GenerateDisplayName() will return a pointer to the correct name of the operator
     const char* display_name = profiling ?
                                profiler::CustomOpProfiler::Get()->GenerateDisplayName(opr_name) :
@@ -179,6 +184,8 @@ class NaiveEngine final : public Engine {
       opr->opr_profile.reset(new profiler::ProfileOperator(opr->opr_name, attrs.release()));
       opr->opr_profile->startForDevice(exec_ctx.dev_type, exec_ctx.dev_id);
     }
+    // allocations made while the operator runs are attributed to it
+    profiler::MemoryScope memory_scope(profiling ? opr->opr_name : nullptr);
     if (exec_ctx.dev_mask() == gpu::kDevMask) {
 #if MXNET_USE_CUDA
       size_t dev_id = static_cast<size_t>(exec_ctx.dev_id);
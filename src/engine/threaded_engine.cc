@@ -49,7 +49,7 @@ ThreadedVar::ThreadedVar(VersionedVarBlock* head) : head_{head} {
 }
 
 inline void ThreadedVar::AppendReadDependency(OprBlock* opr_block) {
-  std::lock_guard<std::mutex> lock{mutex_};
+  std::lock_guard<VarSpinLock> lock{mutex_};
   if (pending_write_ == nullptr) {
     // invariant: is_ready_to_read()
     CHECK_GE(num_pending_reads_, 0);
@@ -71,7 +71,7 @@ inline void ThreadedVar::AppendReadDependency(OprBlock* opr_block) {
 
 inline void ThreadedVar::AppendWriteDependency(OprBlock* opr_block) {
   auto&& new_var_block = VersionedVarBlock::New();
-  std::lock_guard<std::mutex> lock{mutex_};
+  std::lock_guard<VarSpinLock> lock{mutex_};
   // invariant.
   assert(head_->next == nullptr);
   assert(head_->trigger == nullptr);
@@ -102,7 +102,7 @@ inline void ThreadedVar::CompleteReadDependency(Dispatcher dispatcher) {
   OprBlock *trigger = nullptr;
   {
     // this is lock scope
-    std::lock_guard<std::mutex> lock{mutex_};
+    std::lock_guard<VarSpinLock> lock{mutex_};
     CHECK_GT(num_pending_reads_, 0);
 
     if (--num_pending_reads_ == 0) {
@@ -124,7 +124,7 @@ inline bool ThreadedVar::CompleteWriteDependency(Dispatcher dispatcher) {
   VersionedVarBlock *old_pending_write, *end_of_read_chain;
   OprBlock* trigger_write = nullptr;
   {
-    std::lock_guard<std::mutex> lock{mutex_};
+    std::lock_guard<VarSpinLock> lock{mutex_};
     // invariants
     assert(head_->next == nullptr);
     assert(pending_write_ != nullptr);
@@ -190,17 +190,17 @@ inline bool ThreadedVar::CompleteWriteDependency(Dispatcher dispatcher) {
 }
 
 inline void ThreadedVar::SetToDelete() {
-  std::lock_guard<std::mutex> lock{mutex_};
+  std::lock_guard<VarSpinLock> lock{mutex_};
   to_delete_ = true;
 }
 
 inline bool ThreadedVar::ready_to_read() {
-  std::lock_guard<std::mutex> lock{mutex_};
+  std::lock_guard<VarSpinLock> lock{mutex_};
   return this->is_ready_to_read();
 }
 
 inline size_t ThreadedVar::version() {
-  std::lock_guard<std::mutex> lock{mutex_};
+  std::lock_guard<VarSpinLock> lock{mutex_};
   return this->version_;
 }
 
@@ -288,6 +288,10 @@ void ThreadedEngine::DeleteOperator(OprHandle op) {
 void ThreadedEngine::Push(OprHandle op, Context exec_ctx, int priority, bool profiling) {
   BulkFlush();
   ThreadedOpr* threaded_opr = ThreadedOpr::CastFromBase(op);
+  if (profiling && profiler_->IsSampling()) {
+    // decided here so that the start and the stop of the operator agree
+    profiling = profiler_->SampleNext();
+  }
   if (profiling) {
     threaded_opr->opr_name =
         profiler::CustomOpProfiler::Get()->GenerateDisplayName(threaded_opr->opr_name);
@@ -113,6 +113,38 @@ struct VersionedVarBlock
   DEFINE_ENGINE_DEBUG_INFO(VersionedVarBlock);
 };  // struct VersionedVarBlock
 
+/*!
+ * \brief Lock guarding the dependency queue of a ThreadedVar.
+ *  The critical sections it protects are a handful of pointer updates, so
+ *  waiting threads spin on a relaxed load (test-and-test-and-set) instead of
+ *  going through the kernel, and only yield after spinning for a while.
+ */
+class VarSpinLock {
+ public:
+  inline void lock() noexcept {
+    int spin = 0;
+    while (locked_.exchange(true, std::memory_order_acquire)) {
+      while (locked_.load(std::memory_order_relaxed)) {
+        if (++spin > kSpinCount) {
+          std::this_thread::yield();
+        }
+      }
+    }
+  }
+  inline bool try_lock() noexcept {
+    return !locked_.load(std::memory_order_relaxed) &&
+           !locked_.exchange(true, std::memory_order_acquire);
+  }
+  inline void unlock() noexcept {
+    locked_.store(false, std::memory_order_release);
+  }
+
+ private:
+  /*! \brief number of busy-wait iterations before yielding the thread */
+  static constexpr int kSpinCount = 1024;
+  std::atomic<bool> locked_{false};
+};  // class VarSpinLock
+
 /*!
  * \brief Variable implementation.
  *  Each ThreadedVar is a linked list(queue) of operations to be performed.
@@ -189,10 +221,9 @@ class ThreadedVar final
   ExceptionRef var_exception;
 
  private:
-  // TODO(hotpxl) change this to spinlock for faster runtime
   // TODO(hotpxl) consider rename head
-  /*! \brief internal mutex of the ThreadedVar */
-  std::mutex mutex_;
+  /*! \brief internal lock of the ThreadedVar */
+  VarSpinLock mutex_;
   /*!
    * \brief number of pending reads operation in the variable.
    *  will be marked as -1 when there is a already triggered pending write.
@@ -376,6 +407,9 @@ class ThreadedEngine : public Engine {
           LOG(INFO) << "ExecuteOprFn ";
         }
         try {
+          // allocations made while the operator runs are attributed to it
+          profiler::MemoryScope memory_scope(opr_block->profiling ? threaded_opr->opr_name
+                                                                  : nullptr);
           if ((!(threaded_opr->opr_exception && *threaded_opr->opr_exception) ||
               threaded_opr->prop == FnProperty::kNoSkip) || threaded_opr->wait) {
             threaded_opr->fn(run_ctx, callback);
@@ -28,9 +28,16 @@
 #include <dmlc/parameter.h>
 #include <dmlc/concurrency.h>
 #include <dmlc/thread_group.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "../initialize.h"
 #include "./threaded_engine.h"
 #include "./thread_pool.h"
+#include "./work_stealing_queue.h"
 #include "../common/lazy_alloc_array.h"
 #include "../common/utils.h"
 
@@ -43,6 +50,8 @@ namespace engine {
  *  - Use fixed amount of threads for each device.
  *  - Use special threads for copy operations.
  *  - Each stream is allocated and bound to each of the thread.
+ *  - Optionally, normal CPU tasks are scheduled by work stealing: each CPU
+ *    worker owns a lock-free deque and idle workers steal from busy ones.
  */
 class ThreadedEnginePerDevice : public ThreadedEngine {
  public:
@@ -52,7 +61,12 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
   static auto constexpr kPriorityQueue = kPriority;
   static auto constexpr kWorkerQueue = kFIFO;
 
-  ThreadedEnginePerDevice() noexcept(false) {
+  /*!
+   * \brief Constructor.
+   * \param work_stealing whether normal CPU tasks use the work-stealing workers.
+   */
+  explicit ThreadedEnginePerDevice(bool work_stealing = false) noexcept(false)
+      : work_stealing_(work_stealing) {
     this->Start();
   }
   ~ThreadedEnginePerDevice() noexcept(false) {
@@ -65,6 +79,7 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
     gpu_priority_workers_.Clear();
     gpu_copy_workers_.Clear();
     cpu_normal_workers_.Clear();
+    cpu_stealing_workers_.Clear();
     cpu_priority_worker_.reset(nullptr);
   }
 
@@ -107,6 +122,21 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
         // CPU execution.
         if (opr_block->opr->prop == FnProperty::kCPUPrioritized) {
           cpu_priority_worker_->task_queue.Push(opr_block, opr_block->priority);
+        } else if (work_stealing_) {
+          int dev_id = ctx.dev_id;
+          int nthread = cpu_worker_nthreads_;
+          auto ptr =
+          cpu_stealing_workers_.Get(dev_id, [this, ctx, nthread]() {
+              auto blk = new StealingWorkerBlock(nthread);
+              blk->pool.reset(new ThreadPool(nthread,
+                  [this, ctx, blk](std::shared_ptr<dmlc::ManualEvent> ready_event) {
+                    this->CPUStealingWorker(ctx, blk, ready_event);
+                  }, true));
+            return blk;
+          });
+          if (ptr) {
+            ptr->Push(opr_block);
+          }
         } else {
           int dev_id = ctx.dev_id;
           int nthread = cpu_worker_nthreads_;
@@ -214,8 +244,93 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
     ~ThreadWorkerBlock() noexcept(false) {}
   };
 
+  // working unit of the work-stealing CPU workers.
+  struct StealingWorkerBlock {
+    // one deque per worker thread, pushed to and popped from by its owner only
+    std::vector<std::unique_ptr<WorkStealingQueue<OprBlock*> > > queues;
+    // tasks pushed from threads that are not workers of this block
+    std::deque<OprBlock*> inject_queue;
+    // protects inject_queue and the sleep/wake protocol
+    std::mutex mutex;
+    std::condition_variable cv;
+    // number of tasks pushed but not yet taken by a worker
+    std::atomic<int64_t> num_pending{0};
+    // number of workers waiting on cv
+    std::atomic<int> num_sleeping{0};
+    // next worker index to hand out
+    std::atomic<int> num_started{0};
+    bool exit_now = false;
+    // thread pool that works on this task
+    std::unique_ptr<ThreadPool> pool;
+
+    explicit StealingWorkerBlock(size_t nthread) {
+      for (size_t i = 0; i < nthread; ++i) {
+        queues.emplace_back(new WorkStealingQueue<OprBlock*>());
+      }
+    }
+    ~StealingWorkerBlock() noexcept(false) {}
+
+    /*! \brief push a task, lock-free when called from one of the workers */
+    void Push(OprBlock* opr_block) {
+      num_pending.fetch_add(1);
+      if (stealing_block_ == this) {
+        queues[stealing_index_]->Push(opr_block);
+      } else {
+        std::lock_guard<std::mutex> lock(mutex);
+        inject_queue.push_back(opr_block);
+      }
+      if (num_sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        cv.notify_one();
+      }
+    }
+    /*! \brief find a task for worker index, return false if nothing is found */
+    bool TryPop(int index, OprBlock** opr_block) {
+      if (queues[index]->Pop(opr_block)) return true;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!inject_queue.empty()) {
+          *opr_block = inject_queue.front();
+          inject_queue.pop_front();
+          return true;
+        }
+      }
+      const int nqueue = static_cast<int>(queues.size());
+      for (int i = 1; i < nqueue; ++i) {
+        if (queues[(index + i) % nqueue]->Steal(opr_block)) return true;
+      }
+      return false;
+    }
+    /*! \brief block until a task is taken, return false when signaled for kill */
+    bool Pop(int index, OprBlock** opr_block) {
+      while (true) {
+        if (TryPop(index, opr_block)) {
+          num_pending.fetch_sub(1);
+          return true;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        if (exit_now) return false;
+        num_sleeping.fetch_add(1);
+        cv.wait(lock, [this] { return exit_now || num_pending.load() > 0; });
+        num_sleeping.fetch_sub(1);
+        if (exit_now) return false;
+      }
+    }
+    void SignalForKill() {
+      std::lock_guard<std::mutex> lock(mutex);
+      exit_now = true;
+      cv.notify_all();
+    }
+  };
+
   /*! \brief whether this is a worker thread. */
   static MX_THREAD_LOCAL bool is_worker_;
+  /*! \brief work-stealing block of this thread, nullptr if not a stealing worker. */
+  static MX_THREAD_LOCAL StealingWorkerBlock* stealing_block_;
+  /*! \brief index of this thread's deque in stealing_block_. */
+  static MX_THREAD_LOCAL int stealing_index_;
+  /*! \brief whether normal CPU tasks use the work-stealing workers */
+  const bool work_stealing_;
   /*! \brief number of concurrent thread cpu worker uses */
   size_t cpu_worker_nthreads_;
   /*! \brief number of concurrent thread each gpu worker uses */
@@ -224,6 +339,8 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
   size_t gpu_copy_nthreads_;
   // cpu worker
   common::LazyAllocArray<ThreadWorkerBlock<kWorkerQueue> > cpu_normal_workers_;
+  // cpu work-stealing workers, used instead of cpu_normal_workers_ if work_stealing_
+  common::LazyAllocArray<StealingWorkerBlock> cpu_stealing_workers_;
   // cpu priority worker
   std::unique_ptr<ThreadWorkerBlock<kPriorityQueue> > cpu_priority_worker_;
   // workers doing normal works on GPU
@@ -303,6 +420,32 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
     }
   }
 
+  /*!
+   * \brief Work-stealing CPU worker that performs operations on CPU.
+   * \param block The work-stealing block of the worker.
+   */
+  inline void CPUStealingWorker(Context ctx,
+                                StealingWorkerBlock *block,
+                                const std::shared_ptr<dmlc::ManualEvent>& ready_event) {
+    this->is_worker_ = true;
+    stealing_block_ = block;
+    stealing_index_ = block->num_started.fetch_add(1);
+    CHECK_LT(stealing_index_, static_cast<int>(block->queues.size()));
+    RunContext run_ctx{ctx, nullptr, nullptr, false};
+
+    // execute task
+    OprBlock* opr_block;
+    ready_event->signal();
+
+    // Set default number of threads for OMP parallel regions initiated by this thread
+    OpenMP::Get()->on_start_worker_thread(true);
+
+    while (block->Pop(stealing_index_, &opr_block)) {
+      this->ExecuteOprBlock(run_ctx, opr_block);
+    }
+    stealing_block_ = nullptr;
+  }
+
   /*!
    * \brief Get number of cores this engine should reserve for its own use
    * \param using_gpu Whether there is GPU usage
@@ -338,6 +481,9 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
     SignalQueueForKill(&gpu_normal_workers_);
     SignalQueueForKill(&gpu_copy_workers_);
     SignalQueueForKill(&cpu_normal_workers_);
+    cpu_stealing_workers_.ForEach([](size_t i, StealingWorkerBlock *block) {
+      block->SignalForKill();
+    });
     if (cpu_priority_worker_) {
       cpu_priority_worker_->task_queue.SignalForKill();
     }
@@ -348,7 +494,14 @@ Engine *CreateThreadedEnginePerDevice() {
   return new ThreadedEnginePerDevice();
 }
 
+Engine *CreateThreadedEnginePerDeviceWorkStealing() {
+  return new ThreadedEnginePerDevice(true);
+}
+
 MX_THREAD_LOCAL bool ThreadedEnginePerDevice::is_worker_ = false;
+MX_THREAD_LOCAL ThreadedEnginePerDevice::StealingWorkerBlock*
+    ThreadedEnginePerDevice::stealing_block_ = nullptr;
+MX_THREAD_LOCAL int ThreadedEnginePerDevice::stealing_index_ = 0;
 
 }  // namespace engine
 }  // namespace mxnet
@@ -0,0 +1,166 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2019 by Contributors
+ * \file work_stealing_queue.h
+ * \brief Lock-free single-owner deque used by the work-stealing CPU workers.
+ */
+#ifndef MXNET_ENGINE_WORK_STEALING_QUEUE_H_
+#define MXNET_ENGINE_WORK_STEALING_QUEUE_H_
+
+#include <dmlc/base.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "mxnet/base.h"
+
+namespace mxnet {
+namespace engine {
+
+/*!
+ * \brief Chase-Lev work-stealing deque.
+ *
+ *  Push and Pop may only be called by the thread owning the queue and work on
+ *  the bottom end (LIFO). Steal may be called by any thread and takes from the
+ *  top end (FIFO). The ring buffer grows on demand, retired buffers are kept
+ *  alive until the queue is destroyed since a thief may still read from them.
+ *
+ * \tparam T trivially copyable item type, usually a pointer.
+ */
+template<typename T>
+class WorkStealingQueue {
+ public:
+  /*!
+   * \brief Constructor.
+   * \param log_capacity log2 of the initial capacity.
+   */
+  explicit WorkStealingQueue(size_t log_capacity = 10)
+      : top_(0), bottom_(0), array_(new Array(log_capacity)) {}
+  ~WorkStealingQueue() {
+    delete array_.load(std::memory_order_relaxed);
+  }
+  /*!
+   * \brief Push an item to the bottom of the queue, owner thread only.
+   * \param item the item to push.
+   */
+  void Push(T item) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    Array* a = array_.load(std::memory_order_relaxed);
+    if (b - t > static_cast<int64_t>(a->capacity()) - 1) {
+      garbage_.emplace_back(a);
+      a = a->Grow(b, t);
+      array_.store(a, std::memory_order_release);
+    }
+    a->Put(b, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+  /*!
+   * \brief Pop an item from the bottom of the queue, owner thread only.
+   * \param item pointer to store the popped item.
+   * \return whether an item was popped.
+   */
+  bool Pop(T* item) {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    Array* a = array_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      // empty
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+    *item = a->Get(b);
+    if (t == b) {
+      // last item, race against thieves
+      bool won = top_.compare_exchange_strong(t, t + 1,
+                                              std::memory_order_seq_cst,
+                                              std::memory_order_relaxed);
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return won;
+    }
+    return true;
+  }
+  /*!
+   * \brief Steal an item from the top of the queue, any thread.
+   * \param item pointer to store the stolen item.
+   * \return whether an item was stolen.
+   */
+  bool Steal(T* item) {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) return false;
+    Array* a = array_.load(std::memory_order_acquire);
+    T x = a->Get(t);
+    if (!top_.compare_exchange_strong(t, t + 1,
+                                      std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return false;
+    }
+    *item = x;
+    return true;
+  }
+  /*! \return whether the queue looks empty, only a hint for other threads */
+  bool Empty() const {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    return b <= t;
+  }
+
+ private:
+  /*! \brief circular buffer of atomic slots */
+  struct Array {
+    explicit Array(size_t log_size)
+        : log_size(log_size), items(new std::atomic<T>[size_t(1) << log_size]) {}
+    size_t capacity() const {
+      return size_t(1) << log_size;
+    }
+    T Get(int64_t i) const {
+      return items[i & (capacity() - 1)].load(std::memory_order_relaxed);
+    }
+    void Put(int64_t i, T x) {
+      items[i & (capacity() - 1)].store(x, std::memory_order_relaxed);
+    }
+    Array* Grow(int64_t bottom, int64_t top) const {
+      Array* ret = new Array(log_size + 1);
+      for (int64_t i = top; i != bottom; ++i) {
+        ret->Put(i, Get(i));
+      }
+      return ret;
+    }
+    size_t log_size;
+    std::unique_ptr<std::atomic<T>[]> items;
+  };
+  // pad the indices to different cache lines, top_ is written by thieves
+  alignas(64) std::atomic<int64_t> top_;
+  alignas(64) std::atomic<int64_t> bottom_;
+  std::atomic<Array*> array_;
+  // retired buffers, only touched by the owner
+  std::vector<std::unique_ptr<Array>> garbage_;
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingQueue);
+};
+
+}  // namespace engine
+}  // namespace mxnet
+#endif  // MXNET_ENGINE_WORK_STEALING_QUEUE_H_
@@ -31,6 +31,7 @@
 #include <mxnet/graph_attr_types.h>
 #include <nnvm/graph.h>
 #include <nnvm/graph_attr_types.h>
+#include <functional>
 #include <vector>
 #include <memory>
 #include <string>
@@ -170,6 +171,17 @@ void AttachOpResources(const Graph& g,
  */
 Graph DetectInplaceAddTo(Graph g);
 
+/*!
+ * \brief Choose the forward nodes to recompute in backward, so that the memory planned
+ *  for the forward graph, plus the data it keeps for backward, fits a budget.
+ *  The nodes that save the most bytes per estimated recomputation cost go first.
+ *
+ * \param g forward graph with the "shape" and "dtype" attributes.
+ * \param budget memory budget in bytes.
+ * \return mirror function to pass to the gradient pass, 1 for the nodes to recompute.
+ */
+std::function<int(const nnvm::Node&)> PlanMirror(const Graph& g, size_t budget);
+
 /*!
  * \brief Infer shapes in the graph given the information.
  * \param graph The input graph.
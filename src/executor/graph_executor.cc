@@ -169,6 +169,10 @@ void GraphExecutor::Print(std::ostream &os) const {  // NOLINT(*)
   // message to be backward compatible with the memonger
   size_t total_bytes = graph_.GetAttr<size_t>("storage_allocated_bytes");
   os << "Total " << (total_bytes >> 20UL) <<" MB allocated\n";
+  if (graph_.attrs.count("storage_planned_bytes") != 0) {
+    size_t planned_bytes = graph_.GetAttr<size_t>("storage_planned_bytes");
+    os << "Total " << (planned_bytes >> 20UL) << " MB planned by live interval packing\n";
+  }
   os << "Total " << 11 << " TempSpace resource requested\n";
 }
 
@@ -321,7 +325,9 @@ inline ValueType get_node_attr(
  * This is triggered by both simple_bind and bind flows.
  */
 nnvm::Graph GraphExecutor::InitFullGraph(nnvm::Symbol symbol,
-                                         const std::vector<OpReqType>& grad_req_types) {
+                                         const std::vector<OpReqType>& grad_req_types,
+                                         const mxnet::ShapeVector& arg_shapes,
+                                         const nnvm::DTypeVector& arg_dtypes) {
   using nnvm::NodePtr;
   using nnvm::NodeEntry;
   // initial information
@@ -363,6 +369,23 @@ nnvm::Graph GraphExecutor::InitFullGraph(nnvm::Symbol symbol,
     if (type == "CuDNNBatchNorm") return false;
     return true;
   };
+  std::function<int(const nnvm::Node&)> mirror_fun = need_mirror;
+  const size_t mirror_budget =
+      dmlc::GetEnv("MXNET_BACKWARD_MIRROR_BUDGET_MB", size_t(0)) << 20;
+  if (mirror_budget != 0) {
+    nnvm::Graph fwd;
+    fwd.outputs = symbol.outputs;
+    fwd = InferShape(std::move(fwd), mxnet::ShapeVector(arg_shapes), "__shape__");
+    fwd = InferType(std::move(fwd), nnvm::DTypeVector(arg_dtypes), "__dtype__");
+    if (fwd.GetAttr<size_t>("shape_num_unknown_nodes") == 0U &&
+        fwd.GetAttr<size_t>("dtype_num_unknown_nodes") == 0U) {
+      mirror_fun = PlanMirror(fwd, mirror_budget);
+    } else {
+      LOG(WARNING) << "Cannot plan mirroring for MXNET_BACKWARD_MIRROR_BUDGET_MB without "
+                   << "the shapes and types of all inputs, falling back to "
+                   << "MXNET_BACKWARD_DO_MIRROR";
+    }
+  }
 
   std::vector<const nnvm::Op*> zero_ops;
   zero_ops.push_back(nnvm::Op::Get("zeros_like"));
@@ -371,7 +394,7 @@ nnvm::Graph GraphExecutor::InitFullGraph(nnvm::Symbol symbol,
   // take gradient
   nnvm::Graph g_grad = nnvm::pass::MXGradient(
       g, symbol.outputs, xs, head_grad_entry_,
-      AggregateGradient, need_mirror, nullptr,
+      AggregateGradient, mirror_fun, nullptr,
       zero_ops, "_copy");
   CHECK_EQ(g_grad.outputs.size(), xs.size());
   for (const auto &e : g_grad.outputs) {
@@ -407,8 +430,25 @@ void GraphExecutor::Init(nnvm::Symbol symbol,
   std::vector<Context> aux_state_ctxes(aux_states.size());
   std::transform(aux_states.begin(), aux_states.end(), aux_state_ctxes.begin(), get_ctx1);
 
+  // shapes and types of the forward inputs, in the order of ListInputs(kAll)
+  mxnet::ShapeVector fwd_shapes;
+  nnvm::DTypeVector fwd_dtypes;
+  {
+    std::unordered_set<const nnvm::Node*> aux_nodes;
+    for (const auto& n : symbol.ListInputs(nnvm::Symbol::kAuxiliaryStates)) {
+      aux_nodes.insert(n.get());
+    }
+    size_t in_top = 0, st_top = 0;
+    for (const auto& n : symbol.ListInputs(nnvm::Symbol::kAll)) {
+      const NDArray& arr = aux_nodes.count(n.get()) ? aux_states.at(st_top++)
+                                                    : in_args.at(in_top++);
+      fwd_shapes.push_back(arr.shape());
+      fwd_dtypes.push_back(arr.dtype());
+    }
+  }
   nnvm::Graph g = InitGraph(symbol, default_ctx, ctx_map, in_arg_ctxes,
-                            arg_grad_ctxes, aux_state_ctxes, grad_req_types);
+                            arg_grad_ctxes, aux_state_ctxes, grad_req_types,
+                            fwd_shapes, fwd_dtypes);
 
   // create arg_shapes and arg_dtypes for shape and type inferences
   const auto& idx = g.indexed_graph();
@@ -724,6 +764,13 @@ void GraphExecutor::FinishInitGraph(nnvm::Symbol symbol,
       if (vstorage_type[i] != kDefaultStorage) arg_storage_id[i] = kDynamicStorageID;
     }
     g.attrs["storage"] = std::make_shared<dmlc::any>(std::move(arg_storage_id));
+#if MXNET_USE_MKLDNN != 1
+    // MKLDNN keeps one memory layout per chunk, it cannot share an arena among arrays
+    static bool memory_arena = dmlc::GetEnv("MXNET_EXEC_MEMORY_ARENA", false);
+    if (memory_arena) {
+      g.attrs["memory_arena"] = std::make_shared<dmlc::any>(true);
+    }
+#endif
     g = nnvm::ApplyPass(g, "MXPlanMemory");
   }
   g = DetectInplaceAddTo(g);
@@ -794,8 +841,17 @@ void GraphExecutor::Init(nnvm::Symbol symbol,
                          std::unordered_map<std::string, NDArray>* shared_buffer,
                          Executor* shared_exec,
                          const nnvm::NodeEntryMap<NDArray>& feed_dict) {
+  // shapes and types of the forward inputs, in the order of ListInputs(kAll)
+  mxnet::ShapeVector fwd_shapes;
+  nnvm::DTypeVector fwd_dtypes;
+  for (const auto& n : symbol.ListInputs(nnvm::Symbol::kAll)) {
+    auto it1 = arg_shape_map.find(n->attrs.name);
+    fwd_shapes.push_back(it1 != arg_shape_map.end() ? it1->second : mxnet::TShape());
+    auto it2 = arg_dtype_map.find(n->attrs.name);
+    fwd_dtypes.push_back(it2 != arg_dtype_map.end() ? it2->second : -1);
+  }
   nnvm::Graph g = InitGraph(symbol, default_ctx, ctx_map, in_arg_ctxes, arg_grad_ctxes,
-                            aux_state_ctxes, grad_req_types);
+                            aux_state_ctxes, grad_req_types, fwd_shapes, fwd_dtypes);
   // The following code of shape and dtype inferences and argument
   // initialization is for simple_bind only. Regular bind operation
   // should do this differently.
@@ -989,9 +1045,11 @@ Graph GraphExecutor::InitGraph(nnvm::Symbol symbol,
                                const std::vector<Context>& in_arg_ctxes,
                                const std::vector<Context>& arg_grad_ctxes,
                                const std::vector<Context>& aux_state_ctxes,
-                               const std::vector<OpReqType>& grad_req_types) {
+                               const std::vector<OpReqType>& grad_req_types,
+                               const mxnet::ShapeVector& arg_shapes,
+                               const nnvm::DTypeVector& arg_dtypes) {
   // setup gradient
-  nnvm::Graph g = InitFullGraph(symbol, grad_req_types);
+  nnvm::Graph g = InitFullGraph(symbol, grad_req_types, arg_shapes, arg_dtypes);
 
   // create "device" and "context" attrs for the graph
   g = AssignContext(g, default_ctx, ctx_map,
@@ -1107,41 +1165,60 @@ void GraphExecutor::InitDataEntryMemory(std::vector<NDArray>* shared_pool) {
   data_pool_.clear();
   data_pool_.resize(pool_info.size());
 
-  // sort the pool info the descending order before allocating memory
-  std::vector<size_t> sorted_pool_index;
-  for (size_t i = 0; i < pool_info.size(); i++) {
-    sorted_pool_index.push_back(i);
-  }
-  auto pool_comparator = [&pool_info](size_t lhs, size_t rhs){
-    return pool_info[lhs].bytes > pool_info[rhs].bytes;
-  };
-  std::sort(sorted_pool_index.begin(), sorted_pool_index.end(), pool_comparator);
-
-  for (size_t i : sorted_pool_index) {
-    const Context& ctx = pool_info[i].ctx;
-    size_t bytes = pool_info[i].bytes;
-    bool allocated = false;
+  // take an array of at least bytes from the re-use pool, or allocate it
+  auto alloc_pool = [&free_pool, shared_pool](const Context& ctx, size_t bytes) -> NDArray {
     for (auto it = free_pool.lower_bound(bytes); it != free_pool.end(); ++it) {
       if (it->second.ctx() == ctx && it->first >= bytes) {
-        data_pool_[i] = it->second;
+        NDArray nd = it->second;
         free_pool.erase(it);
-        allocated = true;
-        break;
+        return nd;
       }
     }
-    if (!allocated) {
-      size_t nword = (bytes + 3) / 4;
-      CHECK_LE(nword, std::numeric_limits<nnvm::dim_t>::max());
-      // allocate float arrays
-      mxnet::TShape shape{static_cast<nnvm::dim_t>(nword)};
-      // TODO(junwu): adding delay_alloc=true to create nd
-      // is a temporary solution.
-      NDArray nd(shape, ctx, true);
-      data_pool_[i] = nd;
-      // put the new allocated arrays to shared pool
-      if (shared_pool != nullptr)  {
-        shared_pool->push_back(nd);
-      }
+    size_t nword = (bytes + 3) / 4;
+    CHECK_LE(nword, std::numeric_limits<nnvm::dim_t>::max());
+    // allocate float arrays
+    mxnet::TShape shape{static_cast<nnvm::dim_t>(nword)};
+    // TODO(junwu): adding delay_alloc=true to create nd
+    // is a temporary solution.
+    NDArray nd(shape, ctx, true);
+    // put the new allocated arrays to shared pool
+    if (shared_pool != nullptr)  {
+      shared_pool->push_back(nd);
+    }
+    return nd;
+  };
+
+  if (graph_.attrs.count("storage_offset") != 0) {
+    // the planner packed the pool into one arena per context, carve the arrays out of it
+    const auto& voffset = graph_.GetAttr<std::vector<size_t> >("storage_offset");
+    std::map<Context, size_t> arena_bytes;
+    for (size_t i = 0; i < pool_info.size(); ++i) {
+      if (pool_info[i].stype == kUndefinedStorage) continue;
+      size_t& bytes = arena_bytes[pool_info[i].ctx];
+      bytes = std::max(bytes, voffset.at(i) + (pool_info[i].bytes + 3) / 4 * 4);
+    }
+    std::map<Context, NDArray> arenas;
+    for (const auto& kv : arena_bytes) {
+      arenas[kv.first] = alloc_pool(kv.first, kv.second);
+    }
+    for (size_t i = 0; i < pool_info.size(); ++i) {
+      if (pool_info[i].stype == kUndefinedStorage) continue;
+      mxnet::TShape shape{static_cast<nnvm::dim_t>((pool_info[i].bytes + 3) / 4)};
+      data_pool_[i] = arenas[pool_info[i].ctx].AsArray(shape, mshadow::kFloat32, voffset[i]);
+    }
+  } else {
+    // sort the pool info the descending order before allocating memory
+    std::vector<size_t> sorted_pool_index;
+    for (size_t i = 0; i < pool_info.size(); i++) {
+      sorted_pool_index.push_back(i);
+    }
+    auto pool_comparator = [&pool_info](size_t lhs, size_t rhs){
+      return pool_info[lhs].bytes > pool_info[rhs].bytes;
+    };
+    std::sort(sorted_pool_index.begin(), sorted_pool_index.end(), pool_comparator);
+
+    for (size_t i : sorted_pool_index) {
+      data_pool_[i] = alloc_pool(pool_info[i].ctx, pool_info[i].bytes);
     }
   }
   CHECK_EQ(data_pool_.size(), pool_info.size());
@@ -0,0 +1,241 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2019 by Contributors
+ * \file mirror_plan_pass.cc
+ * \brief Choose the forward nodes to recompute in backward to fit a memory budget.
+ */
+#include <mxnet/base.h>
+#include <mxnet/operator.h>
+#include <mxnet/op_attr_types.h>
+#include <nnvm/graph_attr_types.h>
+#include <nnvm/pass.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "./exec_pass.h"
+
+namespace mxnet {
+namespace exec {
+
+namespace {
+
+/*! \brief value of the boolean attribute key of node, -1 if it is not set */
+int GetBoolAttr(const nnvm::Node& node, const std::string& key) {
+  auto it = node.attrs.dict.find(key);
+  if (it == node.attrs.dict.end()) return -1;
+  bool ret;
+  dmlc::parameter::FieldEntry<bool> e;
+  e.Init(key, &ret, ret);
+  e.Set(&ret, it->second);
+  return ret;
+}
+
+/*! \brief whether recomputing the node gives the same outputs without side effects */
+bool CanMirror(const nnvm::Node& node) {
+  static auto& fmutate = nnvm::Op::GetAttr<nnvm::FMutateInputs>("FMutateInputs");
+  static auto& fstate = nnvm::Op::GetAttr<FCreateOpState>("FCreateOpState");
+  static auto& fresource = nnvm::Op::GetAttr<FResourceRequest>("FResourceRequest");
+  if (node.is_variable()) return false;
+  if (GetBoolAttr(node, "__force_mirroring__") == 0) return false;
+  const nnvm::Op* op = node.op();
+  if (op->name == "Dropout") return false;
+  if (fmutate.count(op) || fstate.count(op)) return false;
+  if (fresource.count(op)) {
+    for (const auto& req : fresource[op](node.attrs)) {
+      if (req.type == ResourceRequest::kRandom ||
+          req.type == ResourceRequest::kParallelRandom) return false;
+    }
+  }
+  return true;
+}
+
+/*!
+ * \brief Rough cost of recomputing a node: multiply-adds of the compute bound
+ *  operators, elements read and written by the others
+ */
+double EstimateCost(const nnvm::IndexedGraph& idx, uint32_t nid,
+                    const mxnet::ShapeVector& shapes) {
+  const auto& inode = idx[nid];
+  auto size = [&](const nnvm::IndexedGraph::NodeEntry& e) -> double {
+    const mxnet::TShape& s = shapes[idx.entry_id(e)];
+    return mxnet::shape_is_known(s) ? static_cast<double>(s.Size()) : 0.0;
+  };
+  double out = 0;
+  for (uint32_t i = 0; i < inode.source->num_outputs(); ++i) {
+    const mxnet::TShape& s = shapes[idx.entry_id(nid, i)];
+    if (mxnet::shape_is_known(s)) out += s.Size();
+  }
+  const std::string& name = inode.source->op()->name;
+  if ((name == "Convolution" || name == "Deconvolution" || name == "FullyConnected") &&
+      inode.inputs.size() > 1) {
+    // every output element takes one multiply-add per weight of a filter
+    const mxnet::TShape& w = shapes[idx.entry_id(inode.inputs[1])];
+    if (mxnet::shape_is_known(w) && w[0] > 0) return out * (w.Size() / w[0]) + 1;
+  }
+  if ((name == "dot" || name == "batch_dot") && inode.inputs.size() == 2) {
+    // (m, k) x (k, n) -> (m, n) takes m * k * n = sqrt(mk * kn * mn)
+    return std::sqrt(size(inode.inputs[0]) * size(inode.inputs[1]) * out) + 1;
+  }
+  double in = 0;
+  for (const auto& e : inode.inputs) in += size(e);
+  return in + out + 1;
+}
+
+}  // namespace
+
+std::function<int(const nnvm::Node&)> PlanMirror(const Graph& g, size_t budget) {
+  const auto& idx = g.indexed_graph();
+  const auto& shapes = g.GetAttr<mxnet::ShapeVector>("shape");
+  const auto& dtypes = g.GetAttr<nnvm::DTypeVector>("dtype");
+  const uint32_t num_nodes = idx.num_nodes();
+  const size_t num_entries = idx.num_node_entries();
+
+  std::vector<size_t> bytes(num_entries, 0);
+  for (size_t eid = 0; eid < num_entries; ++eid) {
+    if (mxnet::shape_is_known(shapes[eid]) && dtypes[eid] != -1) {
+      bytes[eid] = shapes[eid].Size() * mshadow::mshadow_sizeof(dtypes[eid]);
+    }
+  }
+  std::vector<uint32_t> producer(num_entries, 0);
+  std::vector<std::vector<uint32_t> > consumers(num_entries);
+  std::vector<uint32_t> fwd_ref_count(num_entries, 0);
+  std::vector<bool> can_mirror(num_nodes, false), mirror(num_nodes, false);
+  std::vector<double> cost(num_nodes, 0);
+  for (uint32_t nid = 0; nid < num_nodes; ++nid) {
+    const auto& inode = idx[nid];
+    for (uint32_t i = 0; i < inode.source->num_outputs(); ++i) {
+      producer[idx.entry_id(nid, i)] = nid;
+    }
+    if (inode.source->is_variable()) continue;
+    for (const auto& e : inode.inputs) {
+      consumers[idx.entry_id(e)].push_back(nid);
+      ++fwd_ref_count[idx.entry_id(e)];
+    }
+    can_mirror[nid] = CanMirror(*inode.source);
+    mirror[nid] = can_mirror[nid] && GetBoolAttr(*inode.source, "__force_mirroring__") == 1;
+    cost[nid] = EstimateCost(idx, nid, shapes);
+  }
+  std::vector<bool> is_output(num_entries, false);
+  for (const auto& e : idx.outputs()) {
+    is_output[idx.entry_id(e)] = true;
+    ++fwd_ref_count[idx.entry_id(e)];
+  }
+  // Backward may read the inputs and outputs of every node it does not recompute, so
+  // an output is only dropped after forward if its producer and all of its consumers
+  // are recomputed in backward.
+  auto kept = [&](size_t eid) {
+    const uint32_t nid = producer[eid];
+    if (idx[nid].source->is_variable() || is_output[eid]) return false;
+    if (!mirror[nid]) return true;
+    for (uint32_t c : consumers[eid]) {
+      if (!mirror[c]) return true;
+    }
+    return false;
+  };
+  auto kept_bytes = [&]() {
+    size_t total = 0;
+    for (size_t eid = 0; eid < num_entries; ++eid) {
+      if (kept(eid)) total += bytes[eid];
+    }
+    return total;
+  };
+  // Memory planned for the forward graph, with the kept outputs held until its end
+  auto planned_bytes = [&]() {
+    std::vector<uint32_t> ref_count(fwd_ref_count);
+    for (size_t eid = 0; eid < num_entries; ++eid) {
+      if (kept(eid)) ++ref_count[eid];
+    }
+    Graph plan;
+    plan.outputs = g.outputs;
+    plan.attrs["shape"] = g.attrs.at("shape");
+    plan.attrs["dtype"] = g.attrs.at("dtype");
+    plan.attrs["ref_count"] = std::make_shared<dmlc::any>(std::move(ref_count));
+    plan = nnvm::ApplyPass(std::move(plan), "MXPlanMemory");
+    return plan.GetAttr<size_t>("storage_allocated_bytes");
+  };
+
+  // Free the kept outputs that give back the most bytes per recomputed multiply-add,
+  // until the plan fits. The plan is only redone once the kept bytes alone shrank by
+  // its excess, which the transient memory of the forward graph seldom disturbs.
+  size_t planned = planned_bytes();
+  for (int round = 0; round < 8 && planned > budget; ++round) {
+    size_t current = kept_bytes();
+    const size_t excess = planned - budget;
+    const size_t target = current > excess ? current - excess : 0;
+    while (current > target) {
+      size_t best = num_entries;
+      double best_ratio = 0;
+      for (size_t eid = 0; eid < num_entries; ++eid) {
+        if (bytes[eid] == 0 || !kept(eid)) continue;
+        const uint32_t nid = producer[eid];
+        if (!can_mirror[nid]) continue;
+        double extra = mirror[nid] ? 0 : cost[nid];
+        bool feasible = true;
+        for (uint32_t c : consumers[eid]) {
+          if (!can_mirror[c]) feasible = false;
+          if (!mirror[c]) extra += cost[c];
+        }
+        if (!feasible) continue;
+        const double ratio = bytes[eid] / extra;
+        if (best == num_entries || ratio > best_ratio) {
+          best = eid;
+          best_ratio = ratio;
+        }
+      }
+      if (best == num_entries) break;
+      mirror[producer[best]] = true;
+      for (uint32_t c : consumers[best]) mirror[c] = true;
+      current = kept_bytes();
+    }
+    const size_t replanned = planned_bytes();
+    if (replanned >= planned) {
+      planned = replanned;
+      break;
+    }
+    planned = replanned;
+  }
+
+  auto nodes = std::make_shared<std::unordered_set<const nnvm::Node*> >();
+  for (uint32_t nid = 0; nid < num_nodes; ++nid) {
+    if (mirror[nid]) nodes->insert(idx[nid].source);
+  }
+  if (dmlc::GetEnv("MXNET_MEM_PLAN_VERBOSE_LOGGING", false)) {
+    LOG(INFO) << "Recomputing " << nodes->size() << " of " << num_nodes
+              << " forward nodes in backward, " << (planned >> 20) << " MB planned for a "
+              << (budget >> 20) << " MB budget";
+  }
+  if (planned > budget) {
+    LOG(WARNING) << "The graph does not fit the mirroring budget of " << (budget >> 20)
+                 << " MB, the remaining data are needed by operators that cannot be "
+                 << "recomputed";
+  }
+  return [nodes](const nnvm::Node& node) -> int {
+    return nodes->count(&node);
+  };
+}
+
+}  // namespace exec
+}  // namespace mxnet
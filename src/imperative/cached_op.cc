@@ -98,7 +98,6 @@ CachedOp::CachedOp(
     const std::vector<std::pair<std::string, std::string> >& flags) {
   using namespace nnvm;
   using namespace imperative;
-  static const std::vector<const Op*> zero_ops{Op::Get("zeros_like"), Op::Get("_zeros")};
   static const auto _copy_op = Op::Get("_copy");
   config_.Init(flags);
   this->dynamic_shape_checked_ = false;
@@ -160,11 +159,17 @@ CachedOp::CachedOp(
   }
 
   // construct backward graph
-  {
-    ograd_entries_.reserve(fwd_graph_.outputs.size());
-    for (size_t i = 0; i < fwd_graph_.outputs.size(); ++i)
-      ograd_entries_.emplace_back(Node::Create());
+  ograd_entries_.reserve(fwd_graph_.outputs.size());
+  for (size_t i = 0; i < fwd_graph_.outputs.size(); ++i)
+    ograd_entries_.emplace_back(Node::Create());
+  InitBackwardGraph(nullptr);
+}
 
+void CachedOp::InitBackwardGraph(const std::function<int(const nnvm::Node&)>& mirror_fun) {
+  using namespace nnvm;
+  static const std::vector<const Op*> zero_ops{Op::Get("zeros_like"), Op::Get("_zeros")};
+  // construct backward graph
+  {
     std::vector<NodeEntry> xs;
     const IndexedGraph& indexed_graph = fwd_graph_.indexed_graph();
     for (size_t i = 0; i < indexed_graph.input_nodes().size(); ++i) {
@@ -180,7 +185,7 @@ CachedOp::CachedOp(
 
     grad_graph_ = pass::MXGradient(
         fwd_graph_, fwd_graph_.outputs, xs, ograd_entries_,
-        exec::AggregateGradient, nullptr, nullptr,
+        exec::AggregateGradient, mirror_fun, nullptr,
         zero_ops, "_copy");
   }
 
@@ -189,6 +194,7 @@ CachedOp::CachedOp(
     size_t num_forward_nodes = fwd_graph_.indexed_graph().num_nodes();
     size_t num_forward_entries = fwd_graph_.indexed_graph().num_node_entries();
 
+    full_graph_ = nnvm::Graph();
     full_graph_.outputs = fwd_graph_.outputs;
     bwd_output_reqs_ = std::vector<OpReqType>(grad_graph_.outputs.size(), kWriteTo);
     for (const auto& i : grad_graph_.outputs) full_graph_.outputs.emplace_back(i);
@@ -208,6 +214,11 @@ CachedOp::CachedOp(
 
     size_t num_forward_inputs = num_inputs();
     size_t num_forward_outputs = num_outputs();
+    bwd_ograd_dep_.clear();
+    bwd_in_dep_.clear();
+    bwd_out_dep_.clear();
+    save_inputs_.clear();
+    save_outputs_.clear();
     for (uint32_t i = 0; i < ograd_entries_.size(); ++i) {
       if (!idx.exist(ograd_entries_[i].node.get())) continue;
       bwd_ograd_dep_.push_back(i);
@@ -228,6 +239,34 @@ CachedOp::CachedOp(
 CachedOp::~CachedOp() {
 }
 
+void CachedOp::PlanBackwardMirror(const std::vector<NDArray*>& inputs) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (mirror_planned_) return;
+  mirror_planned_ = true;
+  // the states copy the graphs, so the gradient can only be redone before the first one
+  for (const auto& kv : cached_op_states_) {
+    if (!kv.second.empty()) return;
+  }
+  nnvm::Graph g;
+  g.outputs = fwd_graph_.outputs;
+  mxnet::ShapeVector shapes;
+  nnvm::DTypeVector dtypes;
+  for (const NDArray* input : inputs) {
+    shapes.push_back(input->shape());
+    dtypes.push_back(input->dtype());
+  }
+  g = exec::InferShape(std::move(g), std::move(shapes));
+  g = exec::InferType(std::move(g), std::move(dtypes));
+  if (g.GetAttr<size_t>("shape_num_unknown_nodes") != 0U ||
+      g.GetAttr<size_t>("dtype_num_unknown_nodes") != 0U) {
+    LOG(WARNING) << "Cannot plan mirroring for backward_mirror_budget_mb, the shapes "
+                 << "of the graph cannot be inferred from the inputs";
+    return;
+  }
+  const size_t budget = static_cast<size_t>(config_.backward_mirror_budget_mb) << 20;
+  InitBackwardGraph(exec::PlanMirror(g, budget));
+}
+
 std::vector<nnvm::NodeEntry> CachedOp::Gradient(
     const nnvm::NodePtr& node,
     const std::vector<nnvm::NodeEntry>& ograds) const {
@@ -921,6 +960,8 @@ OpStatePtr CachedOp::Forward(
         << " is on " << inputs[i]->ctx();
   }
 
+  if (config_.backward_mirror_budget_mb != 0 && !inlining_) PlanBackwardMirror(inputs);
+
   int prev_bulk_size = Engine::Get()->set_bulk_size(config_.forward_bulk_size);
 
   OpStatePtr op_state;
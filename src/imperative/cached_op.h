@@ -23,6 +23,7 @@
 #include <mxnet/imperative.h>
 #include <vector>
 #include <atomic>
+#include <functional>
 #include <utility>
 #include <string>
 #include <unordered_map>
@@ -39,6 +40,7 @@ struct CachedOpConfig : public dmlc::Parameter<CachedOpConfig> {
   mxnet::Tuple<uint32_t> data_indices;
   mxnet::Tuple<uint32_t> param_indices;
   std::string subgraph;
+  uint32_t backward_mirror_budget_mb;
   DMLC_DECLARE_PARAMETER(CachedOpConfig) {
     DMLC_DECLARE_FIELD(static_alloc)
     .set_default(false)
@@ -70,6 +72,10 @@ struct CachedOpConfig : public dmlc::Parameter<CachedOpConfig> {
     DMLC_DECLARE_FIELD(is_dynamic)
     .set_default(false)
     .describe("Whether the graph contains dynamic shape operators.");
+    DMLC_DECLARE_FIELD(backward_mirror_budget_mb)
+    .set_default(0)
+    .describe("Memory budget in MB of the forward pass, including the data kept for "
+              "backward. Operators are recomputed in backward to fit it. 0 to disable.");
   }
 };
 
@@ -134,6 +140,13 @@ class CachedOp {
     sym.outputs = fwd_graph_.outputs;
     return sym;
   }
+  // the backward graph is rebuilt when mirroring is planned, at the first call
+  nnvm::Symbol GetFullSym() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    nnvm::Symbol sym;
+    sym.outputs = full_graph_.outputs;
+    return sym;
+  }
 
  private:
   struct GraphInfo;
@@ -141,6 +154,8 @@ class CachedOp {
   struct CachedOpState;
 
   OpStatePtr GetCachedOpState(const Context& ctx);
+  void InitBackwardGraph(const std::function<int(const nnvm::Node&)>& mirror_fun);
+  void PlanBackwardMirror(const std::vector<NDArray*>& inputs);
   bool SetForwardGraph(
       GraphInfo* info,
       const bool recording,
@@ -197,6 +212,7 @@ class CachedOp {
   nnvm::Graph full_graph_;
   bool inlining_;
   bool dynamic_shape_checked_;
+  bool mirror_planned_ = false;
   std::vector<nnvm::NodeEntry> ograd_entries_;
   std::vector<uint32_t> bwd_in_dep_, bwd_out_dep_, bwd_ograd_dep_;
   std::unordered_map<uint32_t, uint32_t> fwd_input_to_grad_output_;
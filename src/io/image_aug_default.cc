@@ -243,20 +243,104 @@ class DefaultImageAugmenter : public ImageAugmenter {
       return inter_method;
     }
   }
+  bool PlanDecode(int width, int height, DecodeHint *hint,
+                  common::RANDOM_ENGINE *prnd) override {
+    using mshadow::index_t;
+    float max_aspect_ratio, min_aspect_ratio;
+    GetAspectRatioRange(&min_aspect_ratio, &max_aspect_ratio);
+    planned_roi_ = false;
+    hint->roi = cv::Rect();
+    if (param_.resize != -1) {
+      // everything after the resize works on the resized image, so only the
+      // shorter edge has to survive, with room for the largest random scale
+      const int edge = std::ceil(param_.resize * std::max(1.0f, param_.max_random_scale));
+      hint->min_width = edge;
+      hint->min_height = edge;
+      return true;
+    }
+    // sizes are absolute past this point, only crops can be moved into the decoder
+    if (NeedAffine(min_aspect_ratio, max_aspect_ratio) || param_.pad > 0) return false;
+    const int out_width = param_.data_shape[2];
+    const int out_height = param_.data_shape[1];
+    if (param_.random_resized_crop) {
+      if (param_.min_random_scale != 1.0f || param_.max_random_scale != 1.0f ||
+          param_.min_crop_size != -1 || param_.max_crop_size != -1 || param_.rand_crop ||
+          min_aspect_ratio <= 0.0f || param_.min_random_area > param_.max_random_area ||
+          min_aspect_ratio > max_aspect_ratio) {
+        // leave the error to Process
+        return false;
+      }
+      if (param_.max_random_area != 1.0f || param_.min_random_area != 1.0f
+          || max_aspect_ratio != 1.0f || min_aspect_ratio != 1.0f) {
+        // same draws as the random resized crop in Process
+        std::uniform_real_distribution<float> rand_uniform_area(param_.min_random_area,
+                                                                param_.max_random_area);
+        std::uniform_real_distribution<float> rand_uniform_ratio(min_aspect_ratio,
+                                                                 max_aspect_ratio);
+        std::uniform_real_distribution<float> rand_uniform(0, 1);
+        float area = static_cast<float>(width) * height;
+        for (int i = 0; i < 10; ++i) {
+          float target_area = area * rand_uniform_area(*prnd);
+          float ratio = rand_uniform_ratio(*prnd);
+          int y_area = std::round(std::sqrt(target_area / ratio));
+          int x_area = std::round(std::sqrt(target_area * ratio));
+          if (rand_uniform(*prnd) > 0.5) std::swap(x_area, y_area);
+          if (y_area <= height && x_area <= width) {
+            index_t y = std::uniform_int_distribution<index_t>(0, height - y_area)(*prnd);
+            index_t x = std::uniform_int_distribution<index_t>(0, width - x_area)(*prnd);
+            hint->roi = cv::Rect(x, y, x_area, y_area);
+            hint->min_width = out_width;
+            hint->min_height = out_height;
+            planned_roi_ = true;
+            return true;
+          }
+        }
+        return false;
+      }
+    } else if (param_.max_crop_size != -1 || param_.min_crop_size != -1) {
+      if (width < param_.max_crop_size || height < param_.max_crop_size ||
+          param_.max_crop_size < param_.min_crop_size) {
+        return false;
+      }
+      index_t crop_size = std::uniform_int_distribution<index_t>(param_.min_crop_size,
+                                                                 param_.max_crop_size)(*prnd);
+      index_t y = height - crop_size;
+      index_t x = width - crop_size;
+      if (param_.rand_crop != 0) {
+        y = std::uniform_int_distribution<index_t>(0, y)(*prnd);
+        x = std::uniform_int_distribution<index_t>(0, x)(*prnd);
+      } else {
+        y /= 2; x /= 2;
+      }
+      hint->roi = cv::Rect(x, y, crop_size, crop_size);
+      hint->min_width = out_width;
+      hint->min_height = out_height;
+      planned_roi_ = true;
+      return true;
+    }
+    // the center (or random) crop of the output shape; Process gets exactly
+    // that shape back and its own crop becomes a no-op
+    if (width < out_width || height < out_height) return false;
+    index_t y = height - out_height;
+    index_t x = width - out_width;
+    if (param_.rand_crop != 0) {
+      y = std::uniform_int_distribution<index_t>(0, y)(*prnd);
+      x = std::uniform_int_distribution<index_t>(0, x)(*prnd);
+    } else {
+      y /= 2; x /= 2;
+    }
+    hint->roi = cv::Rect(x, y, out_width, out_height);
+    hint->min_width = out_width;
+    hint->min_height = out_height;
+    return true;
+  }
   cv::Mat Process(const cv::Mat &src, std::vector<float> *label,
                   common::RANDOM_ENGINE *prnd) override {
     using mshadow::index_t;
     bool is_cropped = false;
 
-    float max_aspect_ratio = 1.0f;
-    float min_aspect_ratio = 1.0f;
-    if (param_.min_aspect_ratio.has_value()) {
-      max_aspect_ratio = param_.max_aspect_ratio;
-      min_aspect_ratio = param_.min_aspect_ratio.value();
-    } else {
-      max_aspect_ratio = 1 + param_.max_aspect_ratio;
-      min_aspect_ratio = 1 - param_.max_aspect_ratio;
-    }
+    float max_aspect_ratio, min_aspect_ratio;
+    GetAspectRatioRange(&min_aspect_ratio, &max_aspect_ratio);
 
     cv::Mat res;
     if (param_.resize != -1) {
@@ -280,11 +364,7 @@ class DefaultImageAugmenter : public ImageAugmenter {
     }
 
     // normal augmentation by affine transformation.
-    if (param_.max_rotate_angle > 0 || param_.max_shear_ratio > 0.0f
-        || param_.rotate > 0 || rotate_list_.size() > 0
-        || param_.max_random_scale != 1.0f || param_.min_random_scale != 1.0
-        || (!param_.random_resized_crop && (min_aspect_ratio != 1.0f || max_aspect_ratio != 1.0f))
-        || param_.max_img_size != 1e10f || param_.min_img_size != 0.0f) {
+    if (NeedAffine(min_aspect_ratio, max_aspect_ratio)) {
       std::uniform_real_distribution<float> rand_uniform(0, 1);
       // shear
       float s = rand_uniform(*prnd) * param_.max_shear_ratio * 2 - param_.max_shear_ratio;
@@ -344,7 +424,16 @@ class DefaultImageAugmenter : public ImageAugmenter {
                          cv::Scalar(param_.fill_value, param_.fill_value, param_.fill_value));
     }
 
-    if (param_.random_resized_crop) {
+    if (planned_roi_) {
+      // the decoder already cut out the crop chosen in PlanDecode
+      planned_roi_ = false;
+      int interpolation_method = GetInterMethod(param_.inter_method, res.cols, res.rows,
+                                                param_.data_shape[2],
+                                                param_.data_shape[1], prnd);
+      cv::resize(res, res, cv::Size(param_.data_shape[2], param_.data_shape[1]),
+                 0, 0, interpolation_method);
+      is_cropped = true;
+    } else if (param_.random_resized_crop) {
       // random resize crop
       CHECK(param_.min_random_scale == 1.0f &&
         param_.max_random_scale == 1.0f &&
@@ -538,8 +627,28 @@ class DefaultImageAugmenter : public ImageAugmenter {
 
 
  private:
+  // aspect ratio range the affine transform or random resized crop draws from
+  void GetAspectRatioRange(float *min_aspect_ratio, float *max_aspect_ratio) const {
+    if (param_.min_aspect_ratio.has_value()) {
+      *max_aspect_ratio = param_.max_aspect_ratio;
+      *min_aspect_ratio = param_.min_aspect_ratio.value();
+    } else {
+      *max_aspect_ratio = 1 + param_.max_aspect_ratio;
+      *min_aspect_ratio = 1 - param_.max_aspect_ratio;
+    }
+  }
+  // whether Process applies the affine transformation
+  bool NeedAffine(float min_aspect_ratio, float max_aspect_ratio) const {
+    return param_.max_rotate_angle > 0 || param_.max_shear_ratio > 0.0f
+        || param_.rotate > 0 || rotate_list_.size() > 0
+        || param_.max_random_scale != 1.0f || param_.min_random_scale != 1.0
+        || (!param_.random_resized_crop && (min_aspect_ratio != 1.0f || max_aspect_ratio != 1.0f))
+        || param_.max_img_size != 1e10f || param_.min_img_size != 0.0f;
+  }
   // temporal space
   cv::Mat temp_;
+  // whether the image given to Process is the crop chosen by PlanDecode
+  bool planned_roi_ = false;
   // eigval and eigvec for adding pca noise
   // store eigval * eigvec as eigvec
   float eigvec[3][3] = { { 55.46f * -0.5675f, 4.794f * 0.7192f,  1.148f * 0.4009f },
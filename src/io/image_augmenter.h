@@ -43,6 +43,14 @@ namespace io {
  */
 class ImageAugmenter {
  public:
+  /*! \brief what the decoder is asked to produce for an encoded image */
+  struct DecodeHint {
+    /*! \brief region of the source image to decode, empty for the whole image */
+    cv::Rect roi;
+    /*! \brief the decoded region may be downscaled as long as it stays this large */
+    int min_width = 0;
+    int min_height = 0;
+  };
   /*!
    *  \brief Initialize the Operator by setting the parameters
    *  This function need to be called before all other functions.
@@ -59,6 +67,22 @@ class ImageAugmenter {
    */
   virtual cv::Mat Process(const cv::Mat &src, std::vector<float> *label,
                           common::RANDOM_ENGINE *prnd) = 0;
+  /*!
+   * \brief plan how an image is decoded before Process sees it.
+   *   Called on the same thread and with the same prnd as the Process call
+   *   that follows. When it returns true the decoder hands Process exactly
+   *   hint->roi (or the whole image), possibly downscaled but never below
+   *   the minimum size in the hint.
+   * \param width width of the encoded image
+   * \param height height of the encoded image
+   * \param hint the requested region and minimum size
+   * \param prnd pointer to random number generator.
+   * \return false if the image has to be decoded in full
+   */
+  virtual bool PlanDecode(int width, int height, DecodeHint *hint,
+                          common::RANDOM_ENGINE *prnd) {
+    return false;
+  }
   // virtual destructor
   virtual ~ImageAugmenter() {}
   /*!
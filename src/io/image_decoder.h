@@ -0,0 +1,197 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2019 by Contributors
+ * \file image_decoder.h
+ * \brief image decoding with optional downscaling and region of interest
+ */
+#ifndef MXNET_IO_IMAGE_DECODER_H_
+#define MXNET_IO_IMAGE_DECODER_H_
+
+#if MXNET_USE_OPENCV
+#include <opencv2/opencv.hpp>
+#if MXNET_USE_LIBJPEG_TURBO
+#include <turbojpeg.h>
+#endif
+#include <cstdint>
+#include <cstring>
+#include "./image_augmenter.h"
+
+namespace mxnet {
+namespace io {
+/*!
+ * \brief read the dimensions from the frame header of a JPEG stream
+ * \return false if buf is not a JPEG or the header could not be found
+ */
+inline bool JPEGImageSize(const uint8_t *buf, size_t size, int *width, int *height) {
+  if (size < 4 || buf[0] != 0xFF || buf[1] != 0xD8) return false;
+  size_t pos = 2;
+  while (pos + 4 <= size) {
+    if (buf[pos] != 0xFF) return false;
+    const uint8_t marker = buf[pos + 1];
+    if (marker == 0xFF) {
+      // fill byte
+      ++pos;
+      continue;
+    }
+    pos += 2;
+    // markers without a segment
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) continue;
+    // end of image or start of scan before any frame header
+    if (marker == 0xD9 || marker == 0xDA) return false;
+    // SOF0-SOF15, except DHT, JPG and DAC which share the range
+    if (marker >= 0xC0 && marker <= 0xCF &&
+        marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+      if (pos + 7 > size) return false;
+      *height = (buf[pos + 3] << 8) | buf[pos + 4];
+      *width = (buf[pos + 5] << 8) | buf[pos + 6];
+      return *width > 0 && *height > 0;
+    }
+    pos += (buf[pos] << 8) | buf[pos + 1];
+  }
+  return false;
+}
+
+/*!
+ * \brief largest of the 1/2, 1/4 and 1/8 DCT downscales that keeps a
+ *  width x height region at least min_width x min_height
+ */
+inline int DecodeScaleDenom(int width, int height, int min_width, int min_height) {
+  int denom = 1;
+  while (denom < 8 && width / (denom * 2) >= min_width &&
+         height / (denom * 2) >= min_height) {
+    denom *= 2;
+  }
+  return denom;
+}
+
+/*! \brief cut roi out of an image that was decoded at 1/denom scale */
+inline cv::Mat CropScaled(const cv::Mat &img, const cv::Rect &roi, int denom) {
+  cv::Rect scaled(roi.x / denom, roi.y / denom, roi.width / denom, roi.height / denom);
+  return img(scaled & cv::Rect(0, 0, img.cols, img.rows));
+}
+
+#if MXNET_USE_LIBJPEG_TURBO
+/*! \brief a cropped region smaller than this fraction of the image is
+ *  losslessly cut out of the JPEG before decoding; larger ones are decoded in
+ *  full, since the transform pays for entropy decoding the whole image anyway */
+const float kROITransformMaxArea = 0.5f;
+
+/*!
+ * \brief decode a JPEG with libjpeg-turbo
+ * \param image the encoded image
+ * \param color 1 for BGR, 0 for grayscale
+ * \param roi region to decode, in source coordinates
+ * \param denom downscale factor, one of 1, 2, 4 and 8
+ * \return the decoded region, empty on failure
+ */
+inline cv::Mat TJDecodeRegion(cv::Mat image, int color, cv::Rect roi, int denom) {
+  unsigned char *jpeg = image.ptr();
+  unsigned long jpeg_size = image.total();  // NOLINT(*)
+  cv::Mat ret;
+  tjhandle handle = tjInitDecompress();
+  if (handle == nullptr) return ret;
+  int w, h, subsamp;
+  if (tjDecompressHeader2(handle, jpeg, jpeg_size, &w, &h, &subsamp) == 0) {
+    unsigned char *cropped = nullptr;
+    if (roi.area() < kROITransformMaxArea * w * h && subsamp >= 0 && subsamp < TJ_NUMSAMP) {
+      // the crop has to start on an MCU boundary, the rest is cut after decoding
+      tjtransform xform;
+      memset(&xform, 0, sizeof(xform));
+      xform.r.x = roi.x / tjMCUWidth[subsamp] * tjMCUWidth[subsamp];
+      xform.r.y = roi.y / tjMCUHeight[subsamp] * tjMCUHeight[subsamp];
+      xform.r.w = roi.x + roi.width - xform.r.x;
+      xform.r.h = roi.y + roi.height - xform.r.y;
+      xform.op = TJXOP_NONE;
+      xform.options = TJXOPT_CROP;
+      unsigned long cropped_size = 0;  // NOLINT(*)
+      tjhandle transform = tjInitTransform();
+      if (transform != nullptr &&
+          tjTransform(transform, jpeg, jpeg_size, 1, &cropped, &cropped_size, &xform, 0) == 0) {
+        jpeg = cropped;
+        jpeg_size = cropped_size;
+        w = xform.r.w;
+        h = xform.r.h;
+        roi.x -= xform.r.x;
+        roi.y -= xform.r.y;
+      }
+      if (transform != nullptr) tjDestroy(transform);
+    }
+    const int sw = (w + denom - 1) / denom;
+    const int sh = (h + denom - 1) / denom;
+    cv::Mat full(sh, sw, color ? CV_8UC3 : CV_8UC1);
+    if (tjDecompress2(handle, jpeg, jpeg_size, full.ptr(), sw, 0, sh,
+                      color ? TJPF_BGR : TJPF_GRAY, 0) == 0) {
+      ret = CropScaled(full, roi, denom);
+    }
+    if (cropped != nullptr) tjFree(cropped);
+  }
+  tjDestroy(handle);
+  return ret;
+}
+#endif  // MXNET_USE_LIBJPEG_TURBO
+
+/*!
+ * \brief decode an image, honouring a hint from ImageAugmenter::PlanDecode
+ * \param image the encoded image
+ * \param color 1 for BGR, 0 for grayscale, -1 to keep the encoded channels
+ * \param hint the plan, or nullptr to decode the whole image at full size
+ * \return the decoded image; when hint is given, exactly its region, at
+ *  least as large as its minimum size
+ */
+inline cv::Mat DecodeImage(cv::Mat image, int color,
+                           const ImageAugmenter::DecodeHint *hint) {
+  int width = 0, height = 0;
+  const bool is_jpeg = JPEGImageSize(image.ptr(), image.total(), &width, &height);
+  cv::Rect roi(0, 0, width, height);
+  int denom = 1;
+  if (hint != nullptr && is_jpeg && color != -1) {
+    if (hint->roi.area() > 0) roi &= hint->roi;
+    denom = DecodeScaleDenom(roi.width, roi.height, hint->min_width, hint->min_height);
+  }
+#if MXNET_USE_LIBJPEG_TURBO
+  if (is_jpeg && color != -1) {
+    cv::Mat ret = TJDecodeRegion(image, color, roi, denom);
+    if (!ret.empty()) return ret;
+    // malformed for libjpeg-turbo, let OpenCV have a go at full size
+    denom = 1;
+  }
+#else
+#if !defined(CV_VERSION_EPOCH) && \
+    (CV_VERSION_MAJOR > 3 || (CV_VERSION_MAJOR == 3 && CV_VERSION_MINOR >= 2))
+  if (denom > 1) {
+    // IMREAD_REDUCED_{GRAYSCALE,COLOR}_{2,4,8} use the same DCT downscaling
+    const int reduced = (denom == 2 ? cv::IMREAD_REDUCED_GRAYSCALE_2 :
+                         denom == 4 ? cv::IMREAD_REDUCED_GRAYSCALE_4 :
+                                      cv::IMREAD_REDUCED_GRAYSCALE_8) + color;
+    cv::Mat ret = cv::imdecode(image, reduced);
+    if (!ret.empty()) return CropScaled(ret, roi, denom);
+  }
+#endif
+  denom = 1;
+#endif  // MXNET_USE_LIBJPEG_TURBO
+  cv::Mat ret = cv::imdecode(image, color);
+  if (hint == nullptr || !is_jpeg || color == -1 || ret.empty()) return ret;
+  return CropScaled(ret, roi, denom);
+}
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_USE_OPENCV
+#endif  // MXNET_IO_IMAGE_DECODER_H_
@@ -135,6 +135,10 @@ struct ImageRecParserParam : public dmlc::Parameter<ImageRecParserParam> {
   int shuffle_chunk_seed;
   /*! \brief random seed for augmentations */
   dmlc::optional<int> seed_aug;
+  /*! \brief whether to memory map the record file */
+  bool use_mmap;
+  /*! \brief whether to let the augmenter shrink or crop the image during decoding */
+  bool fast_decode;
 
   // declare parameters
   DMLC_DECLARE_PARAMETER(ImageRecParserParam) {
@@ -176,6 +180,16 @@ struct ImageRecParserParam : public dmlc::Parameter<ImageRecParserParam> {
         .describe("The random seed for shuffling");
     DMLC_DECLARE_FIELD(seed_aug).set_default(dmlc::optional<int>())
         .describe("Random seed for augmentations.");
+    DMLC_DECLARE_FIELD(use_mmap).set_default(false)
+        .describe("Memory map a local .rec file and decode the records in place "\
+                  "instead of copying them into chunk buffers. If path_imgidx is "\
+                  "given it is used for random access shuffling. "\
+                  "shuffle_chunk_size is ignored.");
+    DMLC_DECLARE_FIELD(fast_decode).set_default(false)
+        .describe("Let the augmenter pick a 1/2, 1/4 or 1/8 downscale and a crop region "\
+                  "that the JPEG decoder applies directly, from resize, rand_crop, "\
+                  "random_resized_crop, max_random_scale and the crop sizes. Results "\
+                  "differ from a full decode by interpolation only.");
   }
 };
 
@@ -356,6 +370,15 @@ struct PrefetcherParam : public dmlc::Parameter<PrefetcherParam> {
   /*! \brief data type */
   dmlc::optional<int> dtype;
 
+  /*! \brief number of batches the load stage may run ahead of the copy stage */
+  size_t load_buffer;
+
+  /*! \brief number of threads copying a batch into the output arrays */
+  int copy_threads;
+
+  /*! \brief whether the output arrays live in page-locked memory */
+  bool pin_memory;
+
   // declare parameters
   DMLC_DECLARE_PARAMETER(PrefetcherParam) {
     DMLC_DECLARE_FIELD(prefetch_buffer).set_default(4)
@@ -374,6 +397,15 @@ struct PrefetcherParam : public dmlc::Parameter<PrefetcherParam> {
       .add_enum("int8", mshadow::kInt8)
       .set_default(dmlc::optional<int>())
       .describe("Output data type. ``None`` means no change.");
+    DMLC_DECLARE_FIELD(load_buffer).set_default(0)
+        .describe("If positive, load batches on a separate stage that may run this many "
+                  "batches ahead of the copy into the output arrays. "
+                  "0 loads and copies on the same thread.");
+    DMLC_DECLARE_FIELD(copy_threads).set_default(1).set_lower_bound(1)
+        .describe("Number of threads copying a batch into the output arrays.");
+    DMLC_DECLARE_FIELD(pin_memory).set_default(false)
+        .describe("Allocate the output arrays in page-locked memory, "
+                  "for faster copies to the GPU.");
   }
 };
 
@@ -215,6 +215,8 @@ class TBlobContainer : public TBlob {
         auto tensor_container =
           (mshadow::TensorContainer<mshadow::cpu, 1, DType>*) tensor_container_;
         tensor_container->Resize(mshadow::Shape1(shape_.Size()));
+        // growing reallocates the storage
+        dptr_ = tensor_container->dptr_;
     });
   }
   void release() {
@@ -34,13 +34,12 @@
 #include <dmlc/common.h>
 #include <dmlc/timer.h>
 #include <type_traits>
-#if MXNET_USE_LIBJPEG_TURBO
-#include <turbojpeg.h>
-#endif
 #include "./image_recordio.h"
 #include "./image_augmenter.h"
+#include "./image_decoder.h"
 #include "./image_iter_common.h"
 #include "./inst_vector.h"
+#include "./mmap_recordio.h"
 #include "../common/utils.h"
 
 namespace mxnet {
@@ -57,7 +56,7 @@ class ImageRecordIOParser2 {
   inline void BeforeFirst(void) {
     if (batch_param_.round_batch == 0 || !overflow) {
       n_parsed_ = 0;
-      return source_->BeforeFirst();
+      return SourceBeforeFirst();
     } else {
       overflow = false;
     }
@@ -72,12 +71,16 @@ class ImageRecordIOParser2 {
   void ProcessImage(const cv::Mat& res,
     mshadow::Tensor<cpu, 3, DType>* data_ptr, const bool is_mirrored, const float contrast_scaled,
     const float illumination_scaled);
-#if MXNET_USE_LIBJPEG_TURBO
-  cv::Mat TJimdecode(cv::Mat buf, int color);
-#endif
 #endif
+  // fetch the next batch of records from whichever source is in use
+  inline bool NextSourceBatch(dmlc::InputSplit::Blob * chunk);
+  // rewind whichever source is in use
+  inline void SourceBeforeFirst(void);
   inline size_t ParseChunk(DType* data_dptr, real_t* label_dptr, const size_t current_size,
     dmlc::InputSplit::Blob * chunk);
+  template<typename Reader>
+  inline size_t ParseRecords(DType* data_dptr, real_t* label_dptr, const size_t current_size,
+    Reader * reader);
   inline void CreateMeanImg(void);
 
   // magic number to seed prng
@@ -98,6 +101,10 @@ class ImageRecordIOParser2 {
   common::RANDOM_ENGINE rnd_;
   /*! \brief data source */
   std::unique_ptr<dmlc::InputSplit> source_;
+  /*! \brief memory mapped data source, used instead of source_ if use_mmap is set */
+  std::unique_ptr<MMapRecordIOSplit> mmap_source_;
+  /*! \brief records of the current batch, pointing into mmap_source_ */
+  std::vector<dmlc::InputSplit::Blob> records_;
   /*! \brief label information, if any */
   std::unique_ptr<ImageLabelMap> label_map_;
   /*! \brief temporary results */
@@ -179,7 +186,15 @@ inline void ImageRecordIOParser2<DType>::Init(
               << ", use " << threadget << " threads for decoding..";
   }
   legacy_shuffle_ = false;
-  if (param_.path_imgidx.length() != 0) {
+  if (param_.use_mmap) {
+    mmap_source_.reset(new MMapRecordIOSplit(
+        param_.path_imgrec, param_.path_imgidx,
+        param_.part_index, param_.num_parts,
+        record_param_.shuffle, record_param_.seed));
+    // without an index, shuffle within each batch like the chunked reader does
+    if (record_param_.shuffle && param_.path_imgidx.length() == 0)
+      legacy_shuffle_ = true;
+  } else if (param_.path_imgidx.length() != 0) {
     source_.reset(dmlc::InputSplit::Create(
         param_.path_imgrec.c_str(),
         param_.path_imgidx.c_str(),
@@ -266,7 +281,7 @@ inline bool ImageRecordIOParser2<DType>::ParseNext(DataBatch *out) {
   if (overflow) {
     return false;
   }
-  CHECK(source_ != nullptr);
+  CHECK(source_ != nullptr || mmap_source_ != nullptr);
   dmlc::InputSplit::Blob chunk;
   size_t current_size = 0;
   out->index.resize(batch_param_.batch_size);
@@ -308,7 +323,7 @@ inline bool ImageRecordIOParser2<DType>::ParseNext(DataBatch *out) {
     // int n_to_copy;
     size_t n_to_out = 0;
     if (n_parsed_ == 0) {
-      if (source_->NextBatch(&chunk, batch_param_.batch_size)) {
+      if (NextSourceBatch(&chunk)) {
         inst_order_.clear();
         inst_index_ = 0;
         DType* data_dptr = static_cast<DType*>(out->data[0].data().dptr_);
@@ -331,7 +346,7 @@ inline bool ImageRecordIOParser2<DType>::ParseNext(DataBatch *out) {
         CHECK(!overflow) << "number of input images must be bigger than the batch size";
         if (batch_param_.round_batch != 0) {
           overflow = true;
-          source_->BeforeFirst();
+          SourceBeforeFirst();
         } else {
           current_size = batch_param_.batch_size;
         }
@@ -460,64 +475,45 @@ void ImageRecordIOParser2<DType>::ProcessImage(const cv::Mat& res,
   }
 }
 
-#if MXNET_USE_LIBJPEG_TURBO
+#endif
 
-bool is_jpeg(unsigned char * file) {
-  if ((file[0] == 255) && (file[1] == 216)) {
-    return true;
-  } else {
-    return false;
+template<typename DType>
+inline bool ImageRecordIOParser2<DType>::NextSourceBatch(dmlc::InputSplit::Blob * chunk) {
+  if (mmap_source_ != nullptr) {
+    return mmap_source_->NextBatch(batch_param_.batch_size, &records_);
   }
+  return source_->NextBatch(chunk, batch_param_.batch_size);
 }
 
 template<typename DType>
-cv::Mat ImageRecordIOParser2<DType>::TJimdecode(cv::Mat image, int color) {
-  unsigned char* jpeg = image.ptr();
-  size_t jpeg_size = image.rows * image.cols;
-
-  if (!is_jpeg(jpeg)) {
-    // If it is not JPEG then fall back to OpenCV
-    return cv::imdecode(image, color);
-  }
-
-  tjhandle handle = tjInitDecompress();
-  int h, w, subsamp;
-  int err = tjDecompressHeader2(handle,
-                                jpeg,
-                                jpeg_size,
-                                &w, &h, &subsamp);
-  if (err != 0) {
-    // If it is a malformed JPEG then fall back to OpenCV
-    return cv::imdecode(image, color);
-  }
-  cv::Mat ret = cv::Mat(h, w, color ? CV_8UC3 : CV_8UC1);
-  err = tjDecompress2(handle,
-                      jpeg,
-                      jpeg_size,
-                      ret.ptr(),
-                      w,
-                      0,
-                      h,
-                      color ? TJPF_BGR : TJPF_GRAY,
-                      0);
-  if (err != 0) {
-    // If it is a malformed JPEG then fall back to OpenCV
-    return cv::imdecode(image, color);
+inline void ImageRecordIOParser2<DType>::SourceBeforeFirst(void) {
+  if (mmap_source_ != nullptr) {
+    mmap_source_->BeforeFirst();
+  } else {
+    source_->BeforeFirst();
   }
-  tjDestroy(handle);
-  return ret;
 }
-#endif
-#endif
 
 // Returns the number of images that are put into output
 template<typename DType>
 inline size_t ImageRecordIOParser2<DType>::ParseChunk(DType* data_dptr, real_t* label_dptr,
   const size_t current_size, dmlc::InputSplit::Blob * chunk) {
+  if (mmap_source_ != nullptr) {
+    // records already point into the mapping, decode them where they lie
+    MMapRecordIOSplit::BatchReader reader(records_);
+    return ParseRecords(data_dptr, label_dptr, current_size, &reader);
+  }
+  dmlc::RecordIOChunkReader reader(*chunk, 0, 1);
+  return ParseRecords(data_dptr, label_dptr, current_size, &reader);
+}
+
+template<typename DType>
+template<typename Reader>
+inline size_t ImageRecordIOParser2<DType>::ParseRecords(DType* data_dptr, real_t* label_dptr,
+  const size_t current_size, Reader * reader) {
   temp_.resize(param_.preprocess_threads);
 #if MXNET_USE_OPENCV
   // save opencv out
-  dmlc::RecordIOChunkReader reader(*chunk, 0, 1);
   size_t gl_idx = current_size;
   #pragma omp parallel num_threads(param_.preprocess_threads)
   {
@@ -535,7 +531,7 @@ inline size_t ImageRecordIOParser2<DType>::ParseChunk(DType* data_dptr, real_t*
       size_t idx;
       #pragma omp critical
       {
-        reader_has_data = reader.NextRecord(&blob);
+        reader_has_data = reader->NextRecord(&blob);
         if (reader_has_data) {
           idx = gl_idx++;
           if (idx >= batch_param_.batch_size) {
@@ -555,20 +551,21 @@ inline size_t ImageRecordIOParser2<DType>::ParseChunk(DType* data_dptr, real_t*
         prnds_[tid]->seed(idx + param_.seed_aug.value() + kRandMagic);
       }
 
+      // let the first augmenter move its resize and crop into the decoder
+      ImageAugmenter::DecodeHint hint;
+      bool planned = false;
+      int width, height;
+      if (param_.fast_decode && param_.data_shape[0] != 4 && !augmenters_[tid].empty() &&
+          JPEGImageSize(rec.content, rec.content_size, &width, &height)) {
+        planned = augmenters_[tid][0]->PlanDecode(width, height, &hint, prnds_[tid].get());
+      }
+
       switch (param_.data_shape[0]) {
        case 1:
-#if MXNET_USE_LIBJPEG_TURBO
-        res = TJimdecode(buf, 0);
-#else
-        res = cv::imdecode(buf, 0);
-#endif
+        res = DecodeImage(buf, 0, planned ? &hint : nullptr);
         break;
        case 3:
-#if MXNET_USE_LIBJPEG_TURBO
-        res = TJimdecode(buf, 1);
-#else
-        res = cv::imdecode(buf, 1);
-#endif
+        res = DecodeImage(buf, 1, planned ? &hint : nullptr);
         break;
        case 4:
         // -1 to keep the number of channel of the encoded image, and not force gray or color.
@@ -666,7 +663,9 @@ inline void ImageRecordIOParser2<DType>::CreateMeanImg(void) {
     double start = dmlc::GetTime();
     dmlc::InputSplit::Blob chunk;
     size_t imcnt = 0;  // NOLINT(*)
-    while (source_->NextChunk(&chunk)) {
+    while (mmap_source_ != nullptr ?
+           mmap_source_->NextBatch(batch_param_.batch_size, &records_) :
+           source_->NextChunk(&chunk)) {
       inst_order_.clear();
       // Parse chunk w/o putting anything in out
       ParseChunk(nullptr, nullptr, batch_param_.batch_size, &chunk);
@@ -26,8 +26,11 @@
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
 #include <dmlc/data.h>
+#include <dmlc/common.h>
 #include "./iter_sparse_prefetcher.h"
 #include "./iter_sparse_batchloader.h"
+#include "./text_chunk_reader.h"
+#include "../engine/openmp.h"
 
 namespace mxnet {
 namespace io {
@@ -45,6 +48,8 @@ struct LibSVMIterParam : public dmlc::Parameter<LibSVMIterParam> {
   int num_parts;
   /*! \brief the index of the part will read*/
   int part_index;
+  /*! \brief number of threads parsing straight into batches */
+  int parse_threads;
   // declare parameters
   DMLC_DECLARE_PARAMETER(LibSVMIterParam) {
     DMLC_DECLARE_FIELD(data_libsvm)
@@ -61,6 +66,11 @@ struct LibSVMIterParam : public dmlc::Parameter<LibSVMIterParam> {
         .describe("partition the data into multiple parts");
     DMLC_DECLARE_FIELD(part_index).set_default(0)
         .describe("the index of the part will read");
+    DMLC_DECLARE_FIELD(parse_threads).set_default(0).set_lower_bound(-1)
+        .describe("If positive, split every chunk of the files between this many threads "
+                  "that parse straight into the csr batch, keeping the row order. "
+                  "-1 uses the recommended number of OpenMP threads. "
+                  "0 reads row by row through dmlc::Parser.");
   }
 };
 
@@ -195,6 +205,288 @@ class LibSVMIter: public SparseIIterator<DataInst> {
 };
 
 
+/*!
+ * \brief batch loader that parses the LibSVM lines of a chunk in parallel,
+ *  writing the rows straight into the csr arrays of the batch
+ */
+class LibSVMParallelBatchLoader : public SparseIIterator<TBlobBatch> {
+ public:
+  virtual ~LibSVMParallelBatchLoader() {}
+
+  virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    param_.InitAllowUnknown(kwargs);
+    batch_param_.InitAllowUnknown(kwargs);
+    CHECK_EQ(param_.data_shape.ndim(), 1) << "dimension of data_shape is expected to be 1";
+    CHECK_GT(param_.num_parts, 0) << "number of parts should be positive";
+    CHECK_GE(param_.part_index, 0) << "part index should be non-negative";
+    CHECK_NE(batch_param_.round_batch, 0)
+      << "round_batch = False is not supported for sparse data iterator";
+    nthread_ = param_.parse_threads > 0 ? param_.parse_threads :
+               engine::OpenMP::Get()->GetRecommendedOMPThreadCount();
+    // '#' starts a comment, as in dmlc::Parser
+    data_reader_.reset(new TextLineReader(param_.data_libsvm, param_.part_index,
+                                          param_.num_parts, nthread_, '#'));
+    if (param_.label_libsvm != "NULL") {
+      label_reader_.reset(new TextLineReader(param_.label_libsvm, param_.part_index,
+                                             param_.num_parts, nthread_, '#'));
+      CHECK_GT(param_.label_shape.Size(), 1)
+        << "label_shape is not expected to be (1,) when param_.label_libsvm is set.";
+    } else {
+      CHECK_EQ(param_.label_shape.Size(), 1)
+        << "label_shape is expected to be (1,) when param_.label_libsvm is NULL";
+    }
+    const size_t batch_size = batch_param_.batch_size;
+    data_.Init(batch_size);
+    if (label_reader_ != nullptr) {
+      label_.Init(batch_size);
+    } else {
+      dense_label_.resize(mshadow::Shape1(batch_size), mshadow::kFloat32);
+    }
+    out_.inst_index = new unsigned[batch_size];
+    out_.batch_size = batch_size;
+  }
+
+  virtual void BeforeFirst() {
+    // same round_batch contract as SparseBatchLoader
+    if (num_overflow_ == 0) {
+      data_reader_->BeforeFirst();
+      if (label_reader_ != nullptr) label_reader_->BeforeFirst();
+      inst_counter_ = 0;
+    } else {
+      num_overflow_ = 0;
+    }
+  }
+
+  virtual bool Next() {
+    out_.num_batch_padd = 0;
+    out_.batch_size = batch_param_.batch_size;
+    if (num_overflow_ != 0) return false;
+    size_t top = Fill(0);
+    if (top == 0) return false;
+    if (top < batch_param_.batch_size) {
+      data_reader_->BeforeFirst();
+      if (label_reader_ != nullptr) label_reader_->BeforeFirst();
+      inst_counter_ = 0;
+      const size_t filled = Fill(top);
+      CHECK_EQ(filled, batch_param_.batch_size)
+          << "number of input must be bigger than batch size";
+      num_overflow_ = filled - top;
+      out_.num_batch_padd = num_overflow_;
+    }
+    SetOutput();
+    return true;
+  }
+
+  virtual const TBlobBatch &Value(void) const {
+    return out_;
+  }
+
+  virtual const NDArrayStorageType GetStorageType(bool is_data) const {
+    if (is_data) return kCSRStorage;
+    return param_.label_shape.Size() > 1 ? kCSRStorage : kDefaultStorage;
+  }
+
+  virtual const mxnet::TShape GetShape(bool is_data) const {
+    const mxnet::TShape& inst_shape = is_data ? param_.data_shape : param_.label_shape;
+    std::vector<index_t> shape_vec;
+    shape_vec.push_back(batch_param_.batch_size);
+    for (index_t dim = 0; dim < inst_shape.ndim(); ++dim) {
+      shape_vec.push_back(inst_shape[dim]);
+    }
+    return mxnet::TShape(shape_vec.begin(), shape_vec.end());
+  }
+
+ private:
+  /*! \brief values, indices and indptr of a csr batch */
+  struct CSRBuffer {
+    TBlobContainer values, indices, indptr;
+    inline void Init(size_t batch_size) {
+      indptr.resize(mshadow::Shape1(batch_size + 1), mshadow::kInt64);
+      indptr.dptr<int64_t>()[0] = 0;
+      values.resize(mshadow::Shape1(batch_size), mshadow::kFloat32);
+      indices.resize(mshadow::Shape1(batch_size), mshadow::kInt64);
+    }
+    /*! \brief make room for nnz elements, keeping the first size */
+    inline void Reserve(size_t size, size_t nnz) {
+      if (values.Size() >= nnz) return;
+      const size_t capacity = std::max(nnz, values.Size() * 2 + 1);
+      Grow(&values, size, capacity);
+      Grow(&indices, size, capacity);
+    }
+    inline static void Grow(TBlobContainer *buf, size_t size, size_t capacity) {
+      MSHADOW_TYPE_SWITCH(buf->type_flag_, DType, {
+        std::vector<DType> temp(buf->dptr<DType>(), buf->dptr<DType>() + size);
+        buf->resize(mshadow::Shape1(capacity), buf->type_flag_);
+        std::copy(temp.begin(), temp.end(), buf->dptr<DType>());
+      });
+    }
+  };
+
+  /*! \brief fill batch rows from top on, returns the index after the last row filled */
+  inline size_t Fill(size_t top) {
+    const size_t batch_size = batch_param_.batch_size;
+    while (top < batch_size) {
+      const TextLine *lines;
+      const size_t n = data_reader_->Take(batch_size - top, &lines);
+      if (n == 0) break;
+      ParseRows(lines, n, top, &data_,
+                label_reader_ == nullptr ? dense_label_.dptr<real_t>() : nullptr);
+      for (size_t done = 0; label_reader_ != nullptr && done < n;) {
+        const TextLine *label_lines;
+        const size_t m = label_reader_->Take(n - done, &label_lines);
+        CHECK_NE(m, 0) << "Data LibSVM's row is smaller than the number of rows in label_libsvm";
+        ParseRows(label_lines, m, top + done, &label_, nullptr);
+        done += m;
+      }
+      for (size_t i = 0; i < n; ++i) {
+        out_.inst_index[top + i] = inst_counter_++;
+      }
+      top += n;
+    }
+    return top;
+  }
+  /*!
+   * \brief parse n lines into rows top, top + 1, ... of a csr batch
+   *  The rows are sized in a first parallel pass, so the second pass can
+   *  write every row at its final offset.
+   */
+  inline void ParseRows(const TextLine *lines, size_t n, size_t top,
+                        CSRBuffer *csr, real_t *label) {
+    int64_t *indptr = csr->indptr.dptr<int64_t>();
+    #pragma omp parallel for num_threads(nthread_) schedule(static)
+    for (int64_t i = 0; i < static_cast<int64_t>(n); ++i) {
+      // one element per blank separated token after the label and qid
+      const char *end = lines[i].second;
+      int64_t count = 0;
+      bool in_token = false;
+      for (const char *p = SkipLabel(lines[i].first, end); p != end; ++p) {
+        const bool blank = *p == ' ' || *p == '\t';
+        count += !in_token && !blank;
+        in_token = !blank;
+      }
+      indptr[top + i + 1] = count;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      indptr[top + i + 1] += indptr[top + i];
+    }
+    csr->Reserve(indptr[top], indptr[top + n]);
+    real_t *values = csr->values.dptr<real_t>();
+    int64_t *indices = csr->indices.dptr<int64_t>();
+    #pragma omp parallel for num_threads(nthread_) schedule(static)
+    for (int64_t i = 0; i < static_cast<int64_t>(n); ++i) {
+      omp_exc_.Run([&] {
+        const char *end = lines[i].second;
+        const char *p = SkipBlank(lines[i].first, end);
+        real_t v = 0;
+        // the label, possibly followed by a :weight that is ignored
+        ParseNumber(p, end, &v);
+        if (label != nullptr) label[top + i] = v;
+        p = SkipLabel(p, end);
+        for (int64_t j = indptr[top + i]; j < indptr[top + i + 1]; ++j) {
+          p = SkipBlank(p, end);
+          const char *q = ParseNumber(p, end, &indices[j]);
+          CHECK(q != p) << "Invalid LibSVM feature "
+                        << std::string(p, std::find(p, end, ' '));
+          values[j] = 1.0f;
+          if (q != end && *q == ':') q = ParseNumber(q + 1, end, &values[j]);
+          p = q;
+          while (p != end && *p != ' ' && *p != '\t') ++p;
+        }
+      });
+    }
+    omp_exc_.Rethrow();
+  }
+  /*!
+   * \brief skip the label of a line and the qid:<id> token that may follow it,
+   *  the query id of ranking data is ignored like by LibSVMIter
+   * \return the position after them
+   */
+  inline static const char* SkipLabel(const char *p, const char *end) {
+    p = SkipBlank(p, end);
+    while (p != end && *p != ' ' && *p != '\t') ++p;
+    p = SkipBlank(p, end);
+    if (end - p >= 4 && std::strncmp(p, "qid:", 4) == 0) {
+      while (p != end && *p != ' ' && *p != '\t') ++p;
+    }
+    return p;
+  }
+  /*! \brief point the output blobs at the buffers, sized to this batch */
+  inline void SetOutput() {
+    const size_t batch_size = batch_param_.batch_size;
+    out_.data.clear();
+    for (CSRBuffer *csr : {&data_, &label_}) {
+      if (csr == &label_ && label_reader_ == nullptr) {
+        out_.data.push_back(TBlob(dense_label_.dptr_, mshadow::Shape1(batch_size),
+                                  cpu::kDevMask, mshadow::kFloat32));
+        continue;
+      }
+      const int64_t nnz = csr->indptr.dptr<int64_t>()[batch_size];
+      out_.data.push_back(TBlob(csr->values.dptr_, mshadow::Shape1(nnz),
+                                cpu::kDevMask, mshadow::kFloat32));
+      out_.data.push_back(TBlob(csr->indices.dptr_, mshadow::Shape1(nnz),
+                                cpu::kDevMask, mshadow::kInt64));
+      out_.data.push_back(TBlob(csr->indptr.dptr_, mshadow::Shape1(batch_size + 1),
+                                cpu::kDevMask, mshadow::kInt64));
+    }
+  }
+
+  LibSVMIterParam param_;
+  BatchParam batch_param_;
+  /*! \brief number of parsing threads */
+  int nthread_;
+  std::unique_ptr<TextLineReader> data_reader_;
+  std::unique_ptr<TextLineReader> label_reader_;
+  /*! \brief csr batch buffers the rows are parsed into */
+  CSRBuffer data_, label_;
+  /*! \brief label buffer when the labels come from data_libsvm */
+  TBlobContainer dense_label_;
+  TBlobBatch out_;
+  // internal instance counter
+  unsigned inst_counter_{0};
+  /*! \brief number of overflow instances that readed in round_batch mode */
+  size_t num_overflow_{0};
+  /*! \brief OMPException obj to store and rethrow exceptions from omp blocks*/
+  dmlc::OMPException omp_exc_;
+};
+
+/*! \brief picks the parallel loader or SparseBatchLoader over LibSVMIter from the parameters */
+class LibSVMBatchIter : public SparseIIterator<TBlobBatch> {
+ public:
+  virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    LibSVMIterParam param;
+    param.InitAllowUnknown(kwargs);
+    if (param.parse_threads == 0) {
+      loader_.reset(new SparseBatchLoader(new LibSVMIter()));
+    } else {
+      loader_.reset(new LibSVMParallelBatchLoader());
+    }
+    loader_->Init(kwargs);
+  }
+
+  virtual void BeforeFirst() {
+    loader_->BeforeFirst();
+  }
+
+  virtual bool Next() {
+    return loader_->Next();
+  }
+
+  virtual const TBlobBatch &Value(void) const {
+    return loader_->Value();
+  }
+
+  virtual const NDArrayStorageType GetStorageType(bool is_data) const {
+    return loader_->GetStorageType(is_data);
+  }
+
+  virtual const mxnet::TShape GetShape(bool is_data) const {
+    return loader_->GetShape(is_data);
+  }
+
+ private:
+  std::unique_ptr<SparseIIterator<TBlobBatch> > loader_;
+};
+
 DMLC_REGISTER_PARAMETER(LibSVMIterParam);
 
 MXNET_REGISTER_IO_ITER(LibSVMIter)
@@ -224,6 +516,10 @@ When `num_parts` and `part_index` are provided, the data is split into `num_part
 and the iterator only reads the `part_index`-th partition. However, the partitions are not
 guaranteed to be even.
 
+Setting `parse_threads` splits every chunk of the input between several threads that
+parse straight into the csr batch, which is much faster for large files. The row order
+is the same as with the default reader.
+
 ``reset()`` is expected to be called only after a complete pass of data.
 
 Example::
@@ -301,8 +597,7 @@ Example::
 .add_arguments(PrefetcherParam::__FIELDS__())
 .set_body([]() {
     return new SparsePrefetcherIter(
-        new SparseBatchLoader(
-            new LibSVMIter()));
+        new LibSVMBatchIter());
   });
 
 }  // namespace io
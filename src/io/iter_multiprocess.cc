@@ -0,0 +1,526 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*!
+ * Copyright (c) 2019 by Contributors
+ * \file iter_multiprocess.cc
+ * \brief iterator running other iterators in forked worker processes
+*/
+#if !defined(_WIN32)
+#include <mxnet/io.h>
+#include <mxnet/base.h>
+#include <mxnet/ndarray.h>
+#include <mxnet/storage.h>
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace mxnet {
+namespace io {
+// Define multi process iterator parameters
+struct MultiProcessIterParam : public dmlc::Parameter<MultiProcessIterParam> {
+  /*! \brief name of the iterator run by the workers */
+  std::string worker_iter;
+  /*! \brief number of worker processes */
+  int num_workers;
+  /*! \brief number of shared memory batches per worker */
+  int ring_size;
+  // declare parameters
+  DMLC_DECLARE_PARAMETER(MultiProcessIterParam) {
+    DMLC_DECLARE_FIELD(worker_iter)
+        .describe("Name of the registered iterator every worker runs, e.g. ImageRecordIter. "
+                  "It has to accept num_parts and part_index.");
+    DMLC_DECLARE_FIELD(num_workers).set_default(4).set_lower_bound(1)
+        .describe("Number of worker processes, each reading one shard of the data.");
+    DMLC_DECLARE_FIELD(ring_size).set_default(4).set_lower_bound(3)
+        .describe("Number of batches in the shared memory ring of every worker.");
+  }
+};
+
+/*! \brief kind of a message between the iterator and a worker */
+enum MPMessageType {
+  // worker to iterator
+  kMPBatch, kMPEnd, kMPResetDone, kMPError,
+  // iterator to worker
+  kMPRelease, kMPReset, kMPStop
+};
+
+/*! \brief fixed size start of every message */
+struct MPHeader {
+  int32_t type;
+  /*! \brief ring slot of a batch or a release */
+  int32_t slot;
+  int32_t num_arrays;
+  int32_t num_batch_padd;
+  /*! \brief bytes following the header */
+  int64_t payload_size;
+};
+
+/*! \brief description of one array of a batch */
+struct MPArrayMeta {
+  static const int kMaxDim = 8;
+  int32_t shared_pid;
+  /*! \brief shared memory id; on linux the file descriptor travels with the message */
+  int32_t shared_id;
+  int32_t dtype;
+  int32_t ndim;
+  /*! \brief whether the array is new to the iterator and has to be attached */
+  int32_t is_new;
+  int32_t reserved;
+  int64_t shape[kMaxDim];
+};
+
+/*! \brief largest number of file descriptors sent with one message */
+const int kMPMaxFds = 64;
+
+/*!
+ * \brief write a message, passing fds with its first byte
+ * \return false if the peer is gone
+ */
+inline bool SendMessage(int sock, MPHeader header, const std::string &payload,
+                        const std::vector<int> &fds = std::vector<int>()) {
+  CHECK_LE(fds.size(), kMPMaxFds);
+  header.payload_size = payload.size();
+  std::string buf(reinterpret_cast<const char*>(&header), sizeof(header));
+  buf += payload;
+  size_t sent = 0;
+  while (sent < buf.size()) {
+    ssize_t ret;
+    if (sent == 0 && !fds.empty()) {
+      char control[CMSG_SPACE(sizeof(int) * kMPMaxFds)];
+      std::memset(control, 0, sizeof(control));
+      iovec iov = {&buf[0], buf.size()};
+      msghdr msg;
+      std::memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+      cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_RIGHTS;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+      std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+      ret = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } else {
+      ret = send(sock, &buf[sent], buf.size() - sent, MSG_NOSIGNAL);
+    }
+    if (ret < 0 && errno == EINTR) continue;
+    if (ret <= 0) return false;
+    sent += ret;
+  }
+  return true;
+}
+
+/*! \brief read exactly size bytes, returns false if the peer is gone */
+inline bool RecvAll(int sock, char *buf, size_t size) {
+  while (size != 0) {
+    ssize_t ret = recv(sock, buf, size, 0);
+    if (ret < 0 && errno == EINTR) continue;
+    if (ret <= 0) return false;
+    buf += ret;
+    size -= ret;
+  }
+  return true;
+}
+
+/*!
+ * \brief read a message and the fds sent with it
+ * \return false if the peer is gone
+ */
+inline bool RecvMessage(int sock, MPHeader *header, std::string *payload,
+                        std::vector<int> *fds) {
+  char control[CMSG_SPACE(sizeof(int) * kMPMaxFds)];
+  iovec iov = {header, sizeof(*header)};
+  msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ssize_t ret;
+  do {
+    ret = recvmsg(sock, &msg, 0);
+  } while (ret < 0 && errno == EINTR);
+  if (ret <= 0) return false;
+  fds->clear();
+  for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      const size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      const int *data = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+      fds->insert(fds->end(), data, data + n);
+    }
+  }
+  if (!RecvAll(sock, reinterpret_cast<char*>(header) + ret, sizeof(*header) - ret)) {
+    return false;
+  }
+  payload->resize(header->payload_size);
+  return RecvAll(sock, &(*payload)[0], payload->size());
+}
+
+/*!
+ * \brief body of a worker process: runs an iterator and copies its batches
+ *  into a ring of shared memory arrays the parent reads in place
+ */
+class MultiProcessWorker {
+ public:
+  MultiProcessWorker(int sock, int ring_size)
+      : sock_(sock), slots_(ring_size), free_(ring_size, true) {}
+
+  void Run(const std::string &iter_name,
+           const std::vector<std::pair<std::string, std::string> > &kwargs) {
+    try {
+      DataIteratorReg *reg = dmlc::Registry<DataIteratorReg>::Find(iter_name);
+      CHECK(reg != nullptr) << "Unknown iterator " << iter_name;
+      std::unique_ptr<IIterator<DataBatch> > iter(reg->body());
+      iter->Init(kwargs);
+      Loop(iter.get());
+    } catch (const std::exception &e) {
+      MPHeader header = {kMPError, 0, 0, 0, 0};
+      SendMessage(sock_, header, e.what());
+    }
+  }
+
+ private:
+  inline void Loop(IIterator<DataBatch> *iter) {
+    bool at_end = false;
+    while (true) {
+      const bool can_produce =
+          !at_end && std::find(free_.begin(), free_.end(), true) != free_.end();
+      pollfd pfd = {sock_, POLLIN, 0};
+      const int ready = poll(&pfd, 1, can_produce ? 0 : -1);
+      if (ready < 0 && errno == EINTR) continue;
+      if (ready != 0) {
+        MPHeader cmd;
+        std::string payload;
+        std::vector<int> fds;
+        if (!RecvMessage(sock_, &cmd, &payload, &fds) || cmd.type == kMPStop) return;
+        if (cmd.type == kMPRelease) {
+          free_[cmd.slot] = true;
+        } else if (cmd.type == kMPReset) {
+          // the parent dropped every batch it held
+          std::fill(free_.begin(), free_.end(), true);
+          iter->BeforeFirst();
+          at_end = false;
+          MPHeader done = {kMPResetDone, 0, 0, 0, 0};
+          if (!SendMessage(sock_, done, std::string())) return;
+        }
+        continue;
+      }
+      if (!iter->Next()) {
+        at_end = true;
+        MPHeader end = {kMPEnd, 0, 0, 0, 0};
+        if (!SendMessage(sock_, end, std::string())) return;
+        continue;
+      }
+      const int slot = std::find(free_.begin(), free_.end(), true) - free_.begin();
+      free_[slot] = false;
+      if (!Publish(slot, iter->Value())) return;
+    }
+  }
+
+  /*! \brief copy batch into a ring slot and tell the parent */
+  inline bool Publish(int slot, const DataBatch &batch) {
+    std::vector<NDArray> &arrays = slots_[slot];
+    arrays.resize(batch.data.size());
+    std::vector<MPArrayMeta> metas(batch.data.size());
+    for (size_t i = 0; i < batch.data.size(); ++i) {
+      const NDArray &src = batch.data[i];
+      CHECK_EQ(src.storage_type(), kDefaultStorage)
+          << "MultiProcessIter only supports dense batches";
+      CHECK_LE(src.shape().ndim(), MPArrayMeta::kMaxDim);
+      std::memset(&metas[i], 0, sizeof(MPArrayMeta));
+      if (arrays[i].is_none() || arrays[i].shape() != src.shape() ||
+          arrays[i].dtype() != src.dtype()) {
+        arrays[i] = NDArray(src.shape(), Context::CPUShared(0), false, src.dtype());
+        metas[i].is_new = 1;
+      }
+      CopyFromTo(src, arrays[i]);
+    }
+    std::vector<int> fds;
+    for (size_t i = 0; i < arrays.size(); ++i) {
+      arrays[i].WaitToRead();
+      const Storage::Handle handle = arrays[i].storage_handle();
+      MPArrayMeta &meta = metas[i];
+      meta.shared_pid = handle.shared_pid;
+      meta.shared_id = handle.shared_id;
+      meta.dtype = arrays[i].dtype();
+      meta.ndim = arrays[i].shape().ndim();
+      for (int d = 0; d < meta.ndim; ++d) meta.shape[d] = arrays[i].shape()[d];
+      if (meta.is_new) {
+        // owned by the parent's attachment from now on as well
+        Storage::Get()->SharedIncrementRefCount(handle);
+#if defined(__linux__)
+        fds.push_back(handle.shared_id);
+#endif
+      }
+    }
+    std::string payload(reinterpret_cast<const char*>(metas.data()),
+                        metas.size() * sizeof(MPArrayMeta));
+    payload.append(reinterpret_cast<const char*>(batch.index.data()),
+                   batch.index.size() * sizeof(uint64_t));
+    MPHeader header = {kMPBatch, slot, static_cast<int32_t>(arrays.size()),
+                       batch.num_batch_padd, 0};
+    return SendMessage(sock_, header, payload, fds);
+  }
+
+  /*! \brief socket to the parent */
+  int sock_;
+  /*! \brief shared memory arrays of every ring slot */
+  std::vector<std::vector<NDArray> > slots_;
+  /*! \brief whether the parent is done with a slot */
+  std::vector<bool> free_;
+};
+
+/*!
+ * \brief iterator forking worker processes that each run an iterator over a
+ *  shard of the data; batches come out of shared memory without a copy, in
+ *  round robin order over the workers
+ */
+class MultiProcessIter : public IIterator<DataBatch> {
+ public:
+  MultiProcessIter() : next_worker_(0), out_slot_(-1, -1) {}
+
+  virtual ~MultiProcessIter() {
+    for (Worker &w : workers_) {
+      MPHeader stop = {kMPStop, 0, 0, 0, 0};
+      SendMessage(w.sock, stop, std::string());
+      close(w.sock);
+    }
+    for (Worker &w : workers_) {
+      waitpid(w.pid, nullptr, 0);
+    }
+  }
+
+  virtual void Init(const std::vector<std::pair<std::string, std::string> > &kwargs) {
+    param_.InitAllowUnknown(kwargs);
+    // every part of a distributed run is split again between the workers
+    int num_parts = 1, part_index = 0;
+    std::vector<std::pair<std::string, std::string> > worker_kwargs;
+    for (const auto &kv : kwargs) {
+      if (kv.first == "num_parts") {
+        num_parts = std::stoi(kv.second);
+      } else if (kv.first == "part_index") {
+        part_index = std::stoi(kv.second);
+      } else {
+        worker_kwargs.push_back(kv);
+      }
+    }
+    worker_kwargs.emplace_back("num_parts", std::to_string(num_parts * param_.num_workers));
+    worker_kwargs.emplace_back("part_index", "");
+    for (int i = 0; i < param_.num_workers; ++i) {
+      worker_kwargs.back().second = std::to_string(part_index * param_.num_workers + i);
+      int socks[2];
+      CHECK_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, socks), 0)
+          << "socketpair failed: " << strerror(errno);
+      const pid_t pid = fork();
+      CHECK_GE(pid, 0) << "fork failed: " << strerror(errno);
+      if (pid == 0) {
+        close(socks[0]);
+        for (const Worker &w : workers_) close(w.sock);
+#if defined(__linux__)
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+        MultiProcessWorker(socks[1], param_.ring_size).Run(param_.worker_iter, worker_kwargs);
+        _exit(0);
+      }
+      close(socks[1]);
+      Worker w;
+      w.pid = pid;
+      w.sock = socks[0];
+      w.active = true;
+      w.slots.resize(param_.ring_size);
+      workers_.push_back(std::move(w));
+    }
+  }
+
+  virtual void BeforeFirst() {
+    if (out_slot_.first >= 0) held_.push_back(out_slot_);
+    out_slot_ = std::make_pair(-1, -1);
+    // the workers overwrite every slot after a reset
+    for (const auto &slot : held_) {
+      for (NDArray &arr : workers_[slot.first].slots[slot.second]) arr.WaitToWrite();
+    }
+    held_.clear();
+    out_.data.clear();
+    for (Worker &w : workers_) {
+      MPHeader reset = {kMPReset, 0, 0, 0, 0};
+      CHECK(SendMessage(w.sock, reset, std::string())) << "MultiProcessIter worker exited";
+    }
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      // drop what the worker produced before it saw the reset
+      while (Receive(i) != kMPResetDone) {}
+      workers_[i].active = true;
+    }
+    out_slot_ = std::make_pair(-1, -1);
+    out_.data.clear();
+    next_worker_ = 0;
+  }
+
+  virtual bool Next() {
+    if (out_slot_.first >= 0) {
+      // keep one earlier batch per worker, so readers of a batch get the time
+      // the next one is in use before its slot is reused
+      auto older = std::find_if(held_.begin(), held_.end(),
+                                [this](const std::pair<int, int> &slot) {
+                                  return slot.first == out_slot_.first;
+                                });
+      if (older != held_.end()) {
+        const auto slot = *older;
+        held_.erase(older);
+        for (NDArray &arr : workers_[slot.first].slots[slot.second]) arr.WaitToWrite();
+        MPHeader release = {kMPRelease, slot.second, 0, 0, 0};
+        CHECK(SendMessage(workers_[slot.first].sock, release, std::string()))
+            << "MultiProcessIter worker exited";
+      }
+      held_.push_back(out_slot_);
+    }
+    out_slot_ = std::make_pair(-1, -1);
+    for (size_t tried = 0; tried < workers_.size();) {
+      const size_t i = next_worker_;
+      next_worker_ = (next_worker_ + 1) % workers_.size();
+      if (!workers_[i].active) {
+        ++tried;
+        continue;
+      }
+      if (Receive(i) == kMPEnd) {
+        workers_[i].active = false;
+        ++tried;
+        continue;
+      }
+      return true;
+    }
+    return false;
+  }
+
+  virtual const DataBatch &Value() const {
+    return out_;
+  }
+
+ private:
+  struct Worker {
+    pid_t pid;
+    /*! \brief socket to the worker */
+    int sock;
+    /*! \brief whether the worker has batches left in this epoch */
+    bool active;
+    /*! \brief arrays of every ring slot, attached to the worker's shared memory */
+    std::vector<std::vector<NDArray> > slots;
+  };
+
+  /*! \brief read the next message of worker i; a batch becomes the output */
+  inline int Receive(size_t i) {
+    Worker &w = workers_[i];
+    MPHeader header;
+    std::string payload;
+    std::vector<int> fds;
+    CHECK(RecvMessage(w.sock, &header, &payload, &fds))
+        << "MultiProcessIter worker " << i << " exited";
+    if (header.type == kMPError) {
+      LOG(FATAL) << "MultiProcessIter worker " << i << " failed: " << payload;
+    }
+    if (header.type != kMPBatch) return header.type;
+    const MPArrayMeta *metas = reinterpret_cast<const MPArrayMeta*>(payload.data());
+    std::vector<NDArray> &arrays = w.slots[header.slot];
+    arrays.resize(header.num_arrays);
+    size_t next_fd = 0;
+    for (int k = 0; k < header.num_arrays; ++k) {
+      // attach new arrays even when the batch is dropped, the worker reuses them
+      if (!metas[k].is_new) continue;
+      int shared_id = metas[k].shared_id;
+#if defined(__linux__)
+      CHECK_LT(next_fd, fds.size());
+      shared_id = fds[next_fd++];
+#endif
+      arrays[k] = NDArray(metas[k].shared_pid, shared_id,
+                          mxnet::TShape(metas[k].shape, metas[k].shape + metas[k].ndim),
+                          metas[k].dtype);
+    }
+    const uint64_t *index = reinterpret_cast<const uint64_t*>(
+        payload.data() + header.num_arrays * sizeof(MPArrayMeta));
+    const size_t index_size =
+        (payload.size() - header.num_arrays * sizeof(MPArrayMeta)) / sizeof(uint64_t);
+    out_.data = arrays;
+    out_.index.assign(index, index + index_size);
+    out_.num_batch_padd = header.num_batch_padd;
+    out_slot_ = std::make_pair(static_cast<int>(i), header.slot);
+    return header.type;
+  }
+
+  MultiProcessIterParam param_;
+  std::vector<Worker> workers_;
+  /*! \brief worker the next batch is taken from */
+  size_t next_worker_;
+  /*! \brief (worker, slot) of the current output */
+  std::pair<int, int> out_slot_;
+  /*! \brief (worker, slot) of the latest earlier output of every worker, not yet given back */
+  std::deque<std::pair<int, int> > held_;
+  DataBatch out_;
+};
+
+DMLC_REGISTER_PARAMETER(MultiProcessIterParam);
+
+MXNET_REGISTER_IO_ITER(MultiProcessIter)
+.describe(R"code(Runs another iterator in several worker processes.
+
+Every worker is forked from the calling process and runs `worker_iter` over one
+shard of the data, selected through its `num_parts` and `part_index` arguments.
+All other arguments are passed to `worker_iter` unchanged. Workers copy their batches
+into a ring of shared memory arrays, which are returned without another copy, taking
+batches from the workers in turn. This scales decoding past the threads of a single
+process, without the global interpreter lock.
+
+The arrays of a batch are reused once two more batches of the same worker were taken.
+
+Only dense batches are supported, and not on Windows.
+
+Example::
+
+  data_iter = mx.io.MultiProcessIter(worker_iter='ImageRecordIter', num_workers=8,
+                                     path_imgrec='data/train.rec', data_shape=(3, 224, 224),
+                                     batch_size=64, preprocess_threads=4)
+
+)code" ADD_FILELINE)
+.add_arguments(MultiProcessIterParam::__FIELDS__())
+.set_body([]() {
+    return new MultiProcessIter();
+  });
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // !defined(_WIN32)
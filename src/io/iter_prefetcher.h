@@ -33,6 +33,8 @@
 #include <dmlc/optional.h>
 #include <mshadow/tensor.h>
 #include <climits>
+#include <cstring>
+#include <memory>
 #include <utility>
 #include <string>
 #include <vector>
@@ -40,10 +42,74 @@
 #include <algorithm>
 #include "./inst_vector.h"
 #include "./image_iter_common.h"
+#include "../profiler/profiler.h"
 
 namespace mxnet {
 namespace io {
-// iterator on image recordio
+/*! \brief host copy of a loaded batch, handed from the load stage to the copy stage */
+struct StagedBatch {
+  /*! \brief the batch, pointing into buffers */
+  TBlobBatch batch;
+  /*! \brief storage of batch.data, reused from batch to batch */
+  std::vector<std::unique_ptr<TBlobContainer> > buffers;
+  /*! \brief copy src, growing the buffers only when it is larger than any batch before */
+  inline void CopyFrom(const TBlobBatch& src) {
+    while (buffers.size() < src.data.size()) {
+      buffers.emplace_back(new TBlobContainer());
+    }
+    batch.data.resize(src.data.size());
+    for (size_t i = 0; i < src.data.size(); ++i) {
+      buffers[i]->resize(src.data[i].shape_, src.data[i].type_flag_);
+      std::memcpy(buffers[i]->dptr_, src.data[i].dptr_,
+                  src.data[i].Size() * mshadow::mshadow_sizeof(src.data[i].type_flag_));
+      batch.data[i] = *buffers[i];
+    }
+    if (src.inst_index != nullptr) {
+      if (batch.inst_index == nullptr || batch.batch_size != src.batch_size) {
+        delete[] batch.inst_index;
+        batch.inst_index = new unsigned[src.batch_size];
+      }
+      std::copy(src.inst_index, src.inst_index + src.batch_size, batch.inst_index);
+    } else {
+      delete[] batch.inst_index;
+      batch.inst_index = nullptr;
+    }
+    batch.batch_size = src.batch_size;
+    batch.num_batch_padd = src.num_batch_padd;
+    batch.extra_data = src.extra_data;
+  }
+};
+
+/*!
+ * \brief adds the microseconds it lives to a profiler counter, if the profiler is
+ *  running when it is created; every update queues a stat until the profile is dumped
+ */
+class StageTimer {
+ public:
+  explicit StageTimer(profiler::ProfileCounter *counter)
+      : counter_(profiler::Profiler::Get()->GetState() == profiler::Profiler::kRunning ?
+                 counter : nullptr),
+        start_(counter_ != nullptr ? profiler::ProfileStat::NowInMicrosec() : 0) {}
+  ~StageTimer() {
+    if (counter_ == nullptr) return;
+    *counter_ += static_cast<int64_t>(profiler::ProfileStat::NowInMicrosec() - start_);
+  }
+
+ private:
+  profiler::ProfileCounter *counter_;
+  uint64_t start_;
+};
+
+/*!
+ * \brief iterator keeping k batches fetched
+ *
+ *  Batches go through up to two stages, each on its own thread with a bounded
+ *  queue: the load stage runs the batch loader (reading, decoding and
+ *  augmenting with the loader's own threads) and, when load_buffer is set,
+ *  copies the batch aside; the copy stage fills recycled output arrays with
+ *  copy_threads threads. The time every stage spends working or waiting is
+ *  reported through profiler counters of the PrefetcherIter domain.
+ */
 class PrefetcherIter : public IIterator<DataBatch> {
  public:
   explicit PrefetcherIter(IIterator<TBlobBatch>* base)
@@ -56,7 +122,9 @@ class PrefetcherIter : public IIterator<DataBatch> {
       delete batch;
     }
     delete out_;
+    // the copy stage reads from the load stage, stop it first
     iter.Destroy();
+    load_iter_.Destroy();
   }
 
   void InitParams(const std::vector<std::pair<std::string, std::string> >& kwargs) {
@@ -67,48 +135,51 @@ class PrefetcherIter : public IIterator<DataBatch> {
     const int kMaxPrefetchBuffer = 16;
     // init thread iter
     iter.set_max_capacity(kMaxPrefetchBuffer);
+    load_busy_.reset(new profiler::ProfileCounter("Load stage busy (us)", &domain_));
+    copy_starved_.reset(new profiler::ProfileCounter("Copy stage starved (us)", &domain_));
+    copy_busy_.reset(new profiler::ProfileCounter("Copy stage busy (us)", &domain_));
+    consumer_starved_.reset(new profiler::ProfileCounter("Consumer starved (us)", &domain_));
+    recycle_wait_.reset(new profiler::ProfileCounter("Recycle wait (us)", &domain_));
   }
 
   virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
     InitParams(kwargs);
     // use the kwarg to init batch loader
     loader_->Init(kwargs);
-    iter.Init([this](DataBatch **dptr) {
-        if (!loader_->Next()) return false;
-        const TBlobBatch& batch = loader_->Value();
-        if (*dptr == nullptr) {
-          // allocate databatch
-          *dptr = new DataBatch();
-          (*dptr)->num_batch_padd = batch.num_batch_padd;
-          (*dptr)->data.resize(batch.data.size());
-          (*dptr)->index.resize(batch.batch_size);
-          for (size_t i = 0; i < batch.data.size(); ++i) {
-            auto dtype = param_.dtype
-                             ? param_.dtype.value()
-                             : batch.data[i].type_flag_;
-            (*dptr)->data.at(i) = NDArray(batch.data[i].shape_,
-                                          Context::CPU(), false,
-                                          dtype);
+    if (param_.load_buffer == 0) {
+      iter.Init([this](DataBatch **dptr) {
+          {
+            StageTimer timer(load_busy_.get());
+            if (!loader_->Next()) return false;
           }
-        }
-        CHECK(batch.data.size() == (*dptr)->data.size());
-        // copy data over
-        for (size_t i = 0; i < batch.data.size(); ++i) {
-          CHECK_EQ((*dptr)->data.at(i).shape(), batch.data[i].shape_);
-          MSHADOW_TYPE_SWITCH(batch.data[i].type_flag_, DType, {
-              mshadow::Copy(((*dptr)->data)[i].data().FlatTo2D<cpu, DType>(),
-                        batch.data[i].FlatTo2D<cpu, DType>());
-          });
-          (*dptr)->num_batch_padd = batch.num_batch_padd;
-        }
-        if (batch.inst_index) {
-          std::copy(batch.inst_index,
-                    batch.inst_index + batch.batch_size,
-                    (*dptr)->index.begin());
-        }
-       return true;
+          StageTimer timer(copy_busy_.get());
+          CopyBatch(loader_->Value(), dptr);
+          return true;
+        },
+        [this]() { loader_->BeforeFirst(); });
+      return;
+    }
+    load_iter_.set_max_capacity(param_.load_buffer);
+    load_iter_.Init([this](StagedBatch **dptr) {
+        StageTimer timer(load_busy_.get());
+        if (!loader_->Next()) return false;
+        if (*dptr == nullptr) *dptr = new StagedBatch();
+        (*dptr)->CopyFrom(loader_->Value());
+        return true;
       },
       [this]() { loader_->BeforeFirst(); });
+    iter.Init([this](DataBatch **dptr) {
+        StagedBatch *staged = nullptr;
+        {
+          StageTimer timer(copy_starved_.get());
+          if (!load_iter_.Next(&staged)) return false;
+        }
+        StageTimer timer(copy_busy_.get());
+        CopyBatch(staged->batch, dptr);
+        load_iter_.Recycle(&staged);
+        return true;
+      },
+      [this]() { load_iter_.BeforeFirst(); });
   }
 
   virtual void BeforeFirst(void) {
@@ -123,12 +194,16 @@ class PrefetcherIter : public IIterator<DataBatch> {
     if (recycle_queue_.size() == param_.prefetch_buffer) {
       DataBatch *old_batch =  recycle_queue_.front();
       // can be more efficient on engine
-      for (NDArray& arr : old_batch->data) {
-        arr.WaitToWrite();
+      {
+        StageTimer timer(recycle_wait_.get());
+        for (NDArray& arr : old_batch->data) {
+          arr.WaitToWrite();
+        }
       }
       recycle_queue_.pop();
       iter.Recycle(&old_batch);
     }
+    StageTimer timer(consumer_starved_.get());
     return iter.Next(&out_);
   }
   virtual const DataBatch &Value(void) const {
@@ -136,6 +211,53 @@ class PrefetcherIter : public IIterator<DataBatch> {
   }
 
  protected:
+  /*! \brief copy a batch into the output arrays of *dptr, allocating them on first use */
+  inline void CopyBatch(const TBlobBatch& batch, DataBatch **dptr) {
+    if (*dptr == nullptr) {
+      // allocate databatch
+      *dptr = new DataBatch();
+      (*dptr)->num_batch_padd = batch.num_batch_padd;
+      (*dptr)->data.resize(batch.data.size());
+      (*dptr)->index.resize(batch.batch_size);
+      const Context ctx = param_.pin_memory ? Context::CPUPinned(0) : Context::CPU();
+      for (size_t i = 0; i < batch.data.size(); ++i) {
+        auto dtype = param_.dtype
+                         ? param_.dtype.value()
+                         : batch.data[i].type_flag_;
+        (*dptr)->data.at(i) = NDArray(batch.data[i].shape_, ctx, false, dtype);
+      }
+    }
+    CHECK(batch.data.size() == (*dptr)->data.size());
+    // copy data over
+    for (size_t i = 0; i < batch.data.size(); ++i) {
+      CHECK_EQ((*dptr)->data.at(i).shape(), batch.data[i].shape_);
+      MSHADOW_TYPE_SWITCH(batch.data[i].type_flag_, DType, {
+          CopyParallel(((*dptr)->data)[i].data().FlatTo1D<cpu, DType>(),
+                       batch.data[i].FlatTo1D<cpu, DType>());
+      });
+      (*dptr)->num_batch_padd = batch.num_batch_padd;
+    }
+    if (batch.inst_index) {
+      std::copy(batch.inst_index,
+                batch.inst_index + batch.batch_size,
+                (*dptr)->index.begin());
+    }
+  }
+
+  /*! \brief copy src to dst, split between copy_threads threads */
+  template<typename DType>
+  inline void CopyParallel(mshadow::Tensor<cpu, 1, DType> dst,
+                           mshadow::Tensor<cpu, 1, DType> src) {
+    const int nthread = param_.copy_threads;
+    const index_t step = (src.size(0) + nthread - 1) / nthread;
+    #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+    for (int tid = 0; tid < nthread; ++tid) {
+      const index_t begin = std::min<index_t>(src.size(0), step * tid);
+      const index_t end = std::min<index_t>(src.size(0), begin + step);
+      if (begin < end) mshadow::Copy(dst.Slice(begin, end), src.Slice(begin, end));
+    }
+  }
+
   /*! \brief prefetcher parameters */
   PrefetcherParam param_;
   /*! \brief backend thread */
@@ -148,6 +270,20 @@ class PrefetcherIter : public IIterator<DataBatch> {
   DataBatch *out_;
   /*! \brief queue to be recycled */
   std::queue<DataBatch*> recycle_queue_;
+  /*! \brief load stage thread, used when load_buffer is set */
+  dmlc::ThreadedIter<StagedBatch> load_iter_;
+  /*! \brief profiler domain of the stall counters */
+  profiler::ProfileDomain domain_{"PrefetcherIter"};
+  /*! \brief time the load stage spends in the batch loader */
+  std::unique_ptr<profiler::ProfileCounter> load_busy_;
+  /*! \brief time the copy stage waits for the load stage */
+  std::unique_ptr<profiler::ProfileCounter> copy_starved_;
+  /*! \brief time the copy stage spends copying into the output arrays */
+  std::unique_ptr<profiler::ProfileCounter> copy_busy_;
+  /*! \brief time Next waits for the copy stage */
+  std::unique_ptr<profiler::ProfileCounter> consumer_starved_;
+  /*! \brief time Next waits for readers of a batch before it can be reused */
+  std::unique_ptr<profiler::ProfileCounter> recycle_wait_;
 };
 }  // namespace io
 }  // namespace mxnet
@@ -0,0 +1,305 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2019 by Contributors
+ * \file mmap_recordio.h
+ * \brief memory mapped RecordIO source that hands out records in place
+ */
+#ifndef MXNET_IO_MMAP_RECORDIO_H_
+#define MXNET_IO_MMAP_RECORDIO_H_
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif  // _WIN32
+
+#include <dmlc/base.h>
+#include <dmlc/io.h>
+#include <dmlc/logging.h>
+#include <dmlc/recordio.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mxnet {
+namespace io {
+/*!
+ * \brief RecordIO source backed by a read-only mapping of a local .rec file.
+ *
+ *  Unlike dmlc::InputSplit, which copies records into chunk buffers, every
+ *  record returned by NextBatch points straight into the mapping, so the
+ *  encoded image can be handed to the decoder without an intermediate copy.
+ *  Only records that were split by the writer (because their payload
+ *  contains the RecordIO magic) are reassembled into a private buffer.
+ *
+ *  When an index file is given records are visited in index order, or in a
+ *  per-epoch random order if shuffle is set. Otherwise the partition is
+ *  scanned sequentially. In both cases the pages of the next batch are
+ *  prefetched with madvise(MADV_WILLNEED) while the current batch decodes.
+ */
+class MMapRecordIOSplit {
+ public:
+  /*! \brief sequential reader over the records of one batch */
+  class BatchReader {
+   public:
+    explicit BatchReader(const std::vector<dmlc::InputSplit::Blob>& records)
+        : records_(records), pos_(0) {}
+    /*! \brief same contract as dmlc::RecordIOChunkReader::NextRecord */
+    inline bool NextRecord(dmlc::InputSplit::Blob *out) {
+      if (pos_ == records_.size()) return false;
+      *out = records_[pos_++];
+      return true;
+    }
+
+   private:
+    const std::vector<dmlc::InputSplit::Blob>& records_;
+    size_t pos_;
+  };
+  /*!
+   * \brief map a RecordIO file
+   * \param path_rec path to the local .rec file
+   * \param path_idx path to the .idx file, empty for sequential access
+   * \param part_index index of the partition to read
+   * \param num_parts number of partitions
+   * \param shuffle whether to shuffle the index order every epoch
+   * \param seed seed of the shuffle
+   */
+  MMapRecordIOSplit(const std::string& path_rec, const std::string& path_idx,
+                    unsigned part_index, unsigned num_parts,
+                    bool shuffle, int seed)
+      : shuffle_(shuffle), rnd_(seed) {
+    CHECK_LT(part_index, num_parts) << "invalid part_index " << part_index;
+#ifndef _WIN32
+    int fd = open(path_rec.c_str(), O_RDONLY);
+    CHECK_NE(fd, -1) << "Failed to open " << path_rec << ": " << strerror(errno);
+    struct stat st;
+    CHECK_EQ(fstat(fd, &st), 0) << "Failed to stat " << path_rec << ": " << strerror(errno);
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ != 0) {
+      void *ptr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      CHECK_NE(ptr, MAP_FAILED)
+          << "Failed to map " << path_rec << ": " << strerror(errno);
+      data_ = static_cast<char*>(ptr);
+    }
+    close(fd);
+    page_size_ = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+    LOG(FATAL) << "Memory mapped RecordIO is not supported on Windows";
+#endif  // _WIN32
+    if (path_idx.length() != 0) {
+      LoadIndex(path_idx, part_index, num_parts);
+      Advise(0, size_, shuffle_ ? kAdviseRandom : kAdviseSequential);
+    } else {
+      size_t nstep = (size_ + num_parts - 1) / num_parts;
+      nstep = (nstep + 3UL) & ~3UL;
+      begin_ = FindRecordHead(std::min(nstep * part_index, size_));
+      end_ = FindRecordHead(std::min(nstep * (part_index + 1), size_));
+      Advise(begin_, end_, kAdviseSequential);
+    }
+    this->BeforeFirst();
+  }
+
+  ~MMapRecordIOSplit() {
+#ifndef _WIN32
+    if (data_ != nullptr) munmap(data_, size_);
+#endif  // _WIN32
+  }
+  /*! \brief rewind to the start of the partition, reshuffling if needed */
+  inline void BeforeFirst() {
+    const size_t readahead = kInitialReadahead;
+    if (!index_.empty()) {
+      if (shuffle_) std::shuffle(order_.begin(), order_.end(), rnd_);
+      cursor_ = 0;
+      readahead_end_ = std::min(order_.size(), readahead);
+      PrefetchIndex(cursor_, readahead_end_);
+    } else {
+      cursor_ = begin_;
+      readahead_end_ = std::min(end_, begin_ + readahead * page_size_);
+      Advise(cursor_, readahead_end_, kAdviseWillNeed);
+    }
+  }
+  /*!
+   * \brief fetch up to n records
+   *  The returned blobs remain valid until the next call to NextBatch.
+   * \param n maximum number of records to return
+   * \param out the records
+   * \return false if the partition is exhausted
+   */
+  inline bool NextBatch(size_t n, std::vector<dmlc::InputSplit::Blob> *out) {
+    out->clear();
+    spill_.clear();
+    dmlc::InputSplit::Blob blob;
+    if (!index_.empty()) {
+      const size_t stop = std::min(order_.size(), cursor_ + n);
+      for (; cursor_ < stop; ++cursor_) {
+        ReadRecord(index_[order_[cursor_]].first, &blob);
+        out->push_back(blob);
+      }
+      // prefetch the batch after this one while the caller decodes
+      const size_t next = std::min(order_.size(), cursor_ + n);
+      PrefetchIndex(std::max(cursor_, readahead_end_), next);
+      readahead_end_ = std::max(readahead_end_, next);
+    } else {
+      const size_t start = cursor_;
+      while (out->size() < n && cursor_ < end_) {
+        cursor_ = ReadRecord(cursor_, &blob);
+        out->push_back(blob);
+      }
+      const size_t next = std::min(end_, cursor_ + (cursor_ - start));
+      Advise(std::max(cursor_, readahead_end_), next, kAdviseWillNeed);
+      readahead_end_ = std::max(readahead_end_, next);
+    }
+    return !out->empty();
+  }
+  /*! \return number of bytes in the mapped file */
+  inline size_t GetTotalSize() const {
+    return size_;
+  }
+
+ private:
+  /*! \brief advice passed to Advise, mirrors the madvise flags */
+  enum AdviseType {kAdviseWillNeed, kAdviseSequential, kAdviseRandom};
+  /*! \brief how far ahead BeforeFirst prefetches, in records or pages */
+  static const size_t kInitialReadahead = 256;
+  /*! \brief magic number of the RecordIO format */
+  static const uint32_t kMagic = dmlc::RecordIOWriter::kMagic;
+
+  /*! \brief read the .idx file and keep this partition's (offset, size) pairs */
+  inline void LoadIndex(const std::string& path_idx, unsigned part_index, unsigned num_parts) {
+    std::ifstream fi(path_idx.c_str());
+    CHECK(fi.good()) << "Failed to open " << path_idx;
+    std::vector<size_t> offsets;
+    size_t key, offset;
+    while (fi >> key >> offset) {
+      CHECK_LT(offset, size_) << "index " << path_idx << " points past the end of the file";
+      offsets.push_back(offset);
+    }
+    std::sort(offsets.begin(), offsets.end());
+    const size_t nstep = (offsets.size() + num_parts - 1) / num_parts;
+    const size_t begin = std::min(nstep * part_index, offsets.size());
+    const size_t end = std::min(nstep * (part_index + 1), offsets.size());
+    for (size_t i = begin; i < end; ++i) {
+      const size_t next = i + 1 < offsets.size() ? offsets[i + 1] : size_;
+      index_.emplace_back(offsets[i], next - offsets[i]);
+    }
+    order_.resize(index_.size());
+    for (size_t i = 0; i < order_.size(); ++i) order_[i] = i;
+  }
+  /*! \brief first record head at or after pos, size_ if there is none */
+  inline size_t FindRecordHead(size_t pos) const {
+    pos = (pos + 3UL) & ~3UL;
+    for (; pos + 2 * sizeof(uint32_t) <= size_; pos += sizeof(uint32_t)) {
+      const uint32_t *head = reinterpret_cast<const uint32_t*>(data_ + pos);
+      const uint32_t cflag = dmlc::RecordIOWriter::DecodeFlag(head[1]);
+      if (head[0] == kMagic && (cflag == 0U || cflag == 1U)) return pos;
+    }
+    return size_;
+  }
+  /*!
+   * \brief decode the record starting at pos
+   * \return offset of the record that follows it
+   */
+  inline size_t ReadRecord(size_t pos, dmlc::InputSplit::Blob *out) {
+    std::string *buf = nullptr;
+    while (true) {
+      CHECK_LE(pos + 2 * sizeof(uint32_t), size_) << "truncated RecordIO file";
+      const uint32_t *head = reinterpret_cast<const uint32_t*>(data_ + pos);
+      CHECK_EQ(head[0], kMagic) << "invalid RecordIO record at offset " << pos;
+      const uint32_t cflag = dmlc::RecordIOWriter::DecodeFlag(head[1]);
+      const uint32_t len = dmlc::RecordIOWriter::DecodeLength(head[1]);
+      char *payload = data_ + pos + 2 * sizeof(uint32_t);
+      CHECK_LE(pos + 2 * sizeof(uint32_t) + len, size_) << "truncated RecordIO file";
+      pos += 2 * sizeof(uint32_t) + ((len + 3U) & ~3U);
+      if (cflag == 0U) {
+        // the common case: the payload is used where it lies
+        out->dptr = payload;
+        out->size = len;
+        return pos;
+      }
+      // the writer split this record at embedded magic numbers, stitch it back
+      if (buf == nullptr) {
+        CHECK_EQ(cflag, 1U) << "invalid RecordIO record at offset " << pos;
+        spill_.emplace_back();
+        buf = &spill_.back();
+      } else {
+        const uint32_t magic = kMagic;
+        buf->append(reinterpret_cast<const char*>(&magic), sizeof(magic));
+      }
+      buf->append(payload, len);
+      if (cflag == 3U) {
+        out->dptr = dmlc::BeginPtr(*buf);
+        out->size = buf->length();
+        return pos;
+      }
+    }
+  }
+  /*! \brief madvise the byte range [begin, end) */
+  inline void Advise(size_t begin, size_t end, AdviseType type) {
+#ifndef _WIN32
+    if (data_ == nullptr || begin >= end) return;
+    const size_t aligned = begin / page_size_ * page_size_;
+    const int advice = type == kAdviseWillNeed ? MADV_WILLNEED :
+                       type == kAdviseSequential ? MADV_SEQUENTIAL : MADV_RANDOM;
+    // advice is only a hint, a failure here is not worth surfacing
+    madvise(data_ + aligned, end - aligned, advice);
+#endif  // _WIN32
+  }
+  /*! \brief prefetch the records at positions [begin, end) of the visiting order */
+  inline void PrefetchIndex(size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const std::pair<size_t, size_t>& rec = index_[order_[i]];
+      Advise(rec.first, rec.first + rec.second, kAdviseWillNeed);
+    }
+  }
+
+  /*! \brief start of the mapping */
+  char *data_ = nullptr;
+  /*! \brief size of the mapping in bytes */
+  size_t size_ = 0;
+  /*! \brief system page size */
+  size_t page_size_ = 4096;
+  /*! \brief byte range of this partition when reading sequentially */
+  size_t begin_ = 0, end_ = 0;
+  /*! \brief (offset, size) of the records of this partition, empty without .idx */
+  std::vector<std::pair<size_t, size_t> > index_;
+  /*! \brief visiting order of index_ */
+  std::vector<size_t> order_;
+  /*! \brief next position in order_, or next byte offset when sequential */
+  size_t cursor_ = 0;
+  /*! \brief end of the range already prefetched, same unit as cursor_ */
+  size_t readahead_end_ = 0;
+  /*! \brief whether to shuffle order_ every epoch */
+  bool shuffle_;
+  /*! \brief random engine for the shuffle */
+  std::mt19937 rnd_;
+  /*! \brief reassembled multi-part records of the current batch */
+  std::deque<std::string> spill_;
+};
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_MMAP_RECORDIO_H_
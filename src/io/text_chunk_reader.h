@@ -0,0 +1,248 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2019 by Contributors
+ * \file text_chunk_reader.h
+ * \brief chunked line reader and number parsing shared by the text iterators
+ */
+#ifndef MXNET_IO_TEXT_CHUNK_READER_H_
+#define MXNET_IO_TEXT_CHUNK_READER_H_
+
+#include <dmlc/io.h>
+#include <dmlc/logging.h>
+#include <dmlc/omp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mxnet {
+namespace io {
+/*! \brief a line of text, [first, second) without the line break */
+typedef std::pair<const char*, const char*> TextLine;
+
+/*!
+ * \brief reads a text file in chunks and splits every chunk into lines
+ *  using several threads. Lines come out in file order, empty lines are
+ *  skipped, and so are comments if a comment character is given.
+ */
+class TextLineReader {
+ public:
+  /*!
+   * \param path file or directory to read
+   * \param part_index index of the partition to read
+   * \param num_parts number of partitions
+   * \param nthread number of threads used to find the lines of a chunk
+   * \param comment character starting a comment up to the end of the line, 0 for none
+   */
+  TextLineReader(const std::string& path, unsigned part_index, unsigned num_parts,
+                 int nthread, char comment = '\0')
+      : source_(dmlc::InputSplit::Create(path.c_str(), part_index, num_parts, "text")),
+        nthread_(std::max(nthread, 1)), comment_(comment), thread_lines_(nthread_),
+        pos_(0) {}
+  /*! \brief rewind to the start of the partition */
+  inline void BeforeFirst() {
+    source_->BeforeFirst();
+    lines_.clear();
+    pos_ = 0;
+  }
+  /*!
+   * \brief take up to n lines from the current chunk, reading the next chunk
+   *  if the current one is used up
+   * \param n maximum number of lines
+   * \param lines set to the first line taken; the lines stay valid until the
+   *  next call
+   * \return number of lines taken, 0 at the end of the partition
+   */
+  inline size_t Take(size_t n, const TextLine **lines) {
+    while (pos_ == lines_.size()) {
+      dmlc::InputSplit::Blob chunk;
+      if (!source_->NextChunk(&chunk)) return 0;
+      const char *begin = static_cast<const char*>(chunk.dptr);
+      IndexChunk(begin, begin + chunk.size);
+    }
+    const size_t m = std::min(n, lines_.size() - pos_);
+    *lines = lines_.data() + pos_;
+    pos_ += m;
+    return m;
+  }
+
+ private:
+  /*! \brief find the lines of [begin, end), each thread scanning one byte range */
+  inline void IndexChunk(const char *begin, const char *end) {
+    const size_t step = (end - begin + nthread_ - 1) / nthread_;
+    #pragma omp parallel for num_threads(nthread_)
+    for (int tid = 0; tid < nthread_; ++tid) {
+      std::vector<TextLine>& out = thread_lines_[tid];
+      out.clear();
+      // this thread owns the lines that start inside [lo, hi)
+      const char *lo = begin + std::min(step * tid, static_cast<size_t>(end - begin));
+      const char *hi = begin + std::min(step * (tid + 1), static_cast<size_t>(end - begin));
+      const char *p = lo;
+      if (p != begin && p[-1] != '\n') {
+        p = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        p = p == nullptr ? end : p + 1;
+      }
+      while (p < hi) {
+        const char *q = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (q == nullptr) q = end;
+        const char *e = q;
+        if (comment_ != '\0') {
+          const char *c = static_cast<const char*>(std::memchr(p, comment_, q - p));
+          if (c != nullptr) e = c;
+        }
+        while (e != p && (e[-1] == '\r' || e[-1] == ' ' || e[-1] == '\t')) --e;
+        if (e != p) out.emplace_back(p, e);
+        p = q + 1;
+      }
+    }
+    lines_.clear();
+    for (const auto& out : thread_lines_) {
+      lines_.insert(lines_.end(), out.begin(), out.end());
+    }
+    pos_ = 0;
+  }
+
+  /*! \brief the underlying byte source */
+  std::unique_ptr<dmlc::InputSplit> source_;
+  /*! \brief number of threads */
+  int nthread_;
+  /*! \brief comment character, 0 for none */
+  char comment_;
+  /*! \brief lines found by every thread in the current chunk */
+  std::vector<std::vector<TextLine> > thread_lines_;
+  /*! \brief lines of the current chunk */
+  std::vector<TextLine> lines_;
+  /*! \brief next line to take */
+  size_t pos_;
+};
+
+/*! \brief skip blanks, returns the first other character or end */
+inline const char* SkipBlank(const char *p, const char *end) {
+  while (p != end && (*p == ' ' || *p == '\t')) ++p;
+  return p;
+}
+
+/*! \brief strtod on a copy of [p, end), for the spellings ParseNumber does not handle */
+inline const char* ParseNumberSlow(const char *p, const char *end, double *out) {
+  char buf[64];
+  const size_t len = std::min(static_cast<size_t>(end - p), sizeof(buf) - 1);
+  std::memcpy(buf, p, len);
+  buf[len] = '\0';
+  char *stop = nullptr;
+  *out = std::strtod(buf, &stop);
+  return p + (stop - buf);
+}
+
+/*!
+ * \brief parse a decimal number starting at p
+ *  The common spellings (sign, digits, fraction, exponent) are parsed
+ *  without locale lookups or NUL termination; the rest goes through strtod.
+ * \return the position after the number, p if there is none
+ */
+template<typename DType>
+inline const char* ParseNumber(const char *p, const char *end, DType *out) {
+  static const double kPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  // mantissas up to 2^53 and powers up to 1e22 are exact doubles, so one
+  // multiplication or division rounds correctly
+  const uint64_t kMaxExactMantissa = uint64_t(1) << 53;
+  const char *start = p;
+  bool neg = false;
+  if (p != end && (*p == '-' || *p == '+')) {
+    neg = *p == '-';
+    ++p;
+  }
+  uint64_t mant = 0;
+  int ndigit = 0, exp10 = 0;
+  bool any = false;
+  for (; p != end && *p >= '0' && *p <= '9'; ++p) {
+    any = true;
+    if (ndigit < 19) {
+      mant = mant * 10 + (*p - '0');
+      ndigit += mant != 0;
+    } else {
+      ++exp10;
+    }
+  }
+  bool integral = true;
+  if (p != end && *p == '.') {
+    integral = false;
+    for (++p; p != end && *p >= '0' && *p <= '9'; ++p) {
+      any = true;
+      if (ndigit < 19) {
+        mant = mant * 10 + (*p - '0');
+        ndigit += mant != 0;
+        --exp10;
+      }
+    }
+  }
+  if (!any || (p != end && (*p == 'x' || *p == 'X'))) {
+    // inf, nan and hex floats
+    double v;
+    const char *stop = ParseNumberSlow(start, end, &v);
+    if (stop != start) *out = static_cast<DType>(v);
+    return stop;
+  }
+  if (p != end && (*p == 'e' || *p == 'E')) {
+    const char *q = p + 1;
+    bool eneg = false;
+    if (q != end && (*q == '-' || *q == '+')) {
+      eneg = *q == '-';
+      ++q;
+    }
+    if (q != end && *q >= '0' && *q <= '9') {
+      int e = 0;
+      for (; q != end && *q >= '0' && *q <= '9'; ++q) {
+        if (e < 100000) e = e * 10 + (*q - '0');
+      }
+      exp10 += eneg ? -e : e;
+      integral = false;
+      p = q;
+    }
+  }
+  if (std::is_integral<DType>::value && integral && exp10 == 0) {
+    *out = static_cast<DType>(neg ? -static_cast<int64_t>(mant) : static_cast<int64_t>(mant));
+    return p;
+  }
+  double v = static_cast<double>(mant);
+  if (mant > kMaxExactMantissa || exp10 > 22 || exp10 < -22) {
+    // rare, leave the rounding to strtod
+    ParseNumberSlow(start, end, &v);
+    neg = false;
+  } else if (exp10 > 0) {
+    v *= kPow10[exp10];
+  } else if (exp10 < 0) {
+    v /= kPow10[-exp10];
+  }
+  *out = static_cast<DType>(neg ? -v : v);
+  return p;
+}
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_TEXT_CHUNK_READER_H_
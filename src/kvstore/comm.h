@@ -35,6 +35,8 @@
 #include "../ndarray/ndarray_function.h"
 #include "../operator/tensor/sparse_retain-inl.h"
 #include "./kvstore_utils.h"
+#include "./reduce_sum_cpu-inl.h"
+#include "./reduce_sum_rsp_cpu-inl.h"
 namespace mxnet {
 namespace kvstore {
 /**
@@ -105,6 +107,8 @@ class CommCPU : public Comm {
   CommCPU() {
     nthread_reduction_ = dmlc::GetEnv("MXNET_KVSTORE_REDUCTION_NTHREADS", 4);
     bigarray_bound_ = dmlc::GetEnv("MXNET_KVSTORE_BIGARRAY_BOUND", 1000 * 1000);
+    stream_bound_ = dmlc::GetEnv("MXNET_KVSTORE_REDUCTION_STREAM_BOUND",
+                                 static_cast<size_t>(8 * 1000 * 1000));
     // TODO(junwu) delete the following data member, now for benchmark only
     is_serial_push_ = dmlc::GetEnv("MXNET_KVSTORE_SERIAL_PUSH", 0);
   }
@@ -190,16 +194,14 @@ class CommCPU : public Comm {
         reduce[i] = buf.copy_buf[i];
         const_vars[i] = reduce[i].var();
       }
-      Resource rsc = ResourceManager::Get()->Request(buf_merged.ctx(),
-          ResourceRequest(ResourceRequest::kTempSpace));
       Engine::Get()->PushAsync(
-        [reduce, buf_merged, rsc, this](RunContext rctx, Engine::CallbackOnComplete on_complete) {
+        [reduce, buf_merged, this](RunContext rctx, Engine::CallbackOnComplete on_complete) {
           NDArray out = buf_merged;
           is_serial_push_?
             ReduceSumCPUExSerial(reduce, &out)
-            : mxnet::ndarray::ElementwiseSum(rctx.get_stream<cpu>(), rsc, reduce, &out);
+            : ReduceSumCPUExParallel(reduce, &out);
           on_complete();
-        }, Context::CPU(), const_vars, {buf_merged.var(), rsc.var},
+        }, Context::CPU(), const_vars, {buf_merged.var()},
         FnProperty::kCPUPrioritized, priority, "KVStoreReduce");
     }
 
@@ -354,57 +356,81 @@ class CommCPU : public Comm {
     });
   }
 
-  template<typename DType>
-  inline static void ReduceSumCPU(
-      const std::vector<DType*> &dptr, size_t offset, index_t size) {
-    using namespace mshadow;  // NOLINT(*)
-    Tensor<cpu, 1, DType> in_0(dptr[0] + offset, Shape1(size));
-    for (size_t i = 1; i < dptr.size(); i+=4) {
-      switch (dptr.size() - i) {
-        case 1: {
-          Tensor<cpu, 1, DType> in_1(dptr[i] + offset, Shape1(size));
-          in_0 += in_1;
-          break;
+  // parallel implementation of reduce sum for row sparse NDArray. The row indices
+  // of every input are already sorted, so the row id space is split into ranges
+  // which are k-way merged independently: once to count the unique rows of each
+  // range, and once more, after the output is allocated, to write them.
+  inline void ReduceSumCPUExParallel(const std::vector<NDArray> &in, NDArray *out) {
+    using namespace rowsparse;
+    using namespace mshadow;
+    auto stype = out->storage_type();
+    CHECK_EQ(stype, kRowSparseStorage) << "Unexpected storage type " << stype;
+    const size_t row_length = out->shape().ProdShape(1, out->shape().ndim());
+    MSHADOW_TYPE_SWITCH(out->dtype(), DType, {
+      MSHADOW_IDX_TYPE_SWITCH(out->aux_type(kIdx), IType, {
+        std::vector<const IType*> in_idx;
+        std::vector<const DType*> in_val;
+        std::vector<size_t> num_rows;
+        size_t total_num_rows = 0;
+        for (const auto& nd : in) {
+          // skip the ones with empty indices and values
+          if (!nd.storage_initialized()) continue;
+          CHECK_EQ(nd.aux_type(kIdx), out->aux_type(kIdx));
+          in_idx.push_back(nd.aux_data(kIdx).dptr<IType>());
+          in_val.push_back(nd.data().dptr<DType>());
+          num_rows.push_back(nd.aux_shape(kIdx).Size());
+          total_num_rows += num_rows.back();
         }
-        case 2: {
-          Tensor<cpu, 1, DType> in_1(dptr[i] + offset, Shape1(size));
-          Tensor<cpu, 1, DType> in_2(dptr[i+1] + offset, Shape1(size));
-          in_0 += in_1 + in_2;
-          break;
+        // a few ranges per thread to even out skewed row ids
+        const size_t nparts = (total_num_rows * row_length < bigarray_bound_ ||
+                               nthread_reduction_ <= 1) ? 1 : nthread_reduction_ * 4;
+        std::vector<size_t> bounds;
+        PartitionRowSparse(in_idx, num_rows, nparts, &bounds);
+        std::vector<size_t> offsets(nparts + 1, 0);
+        #pragma omp parallel for schedule(dynamic) num_threads(nthread_reduction_) if (nparts > 1)
+        for (long p = 0; p < static_cast<long>(nparts); ++p) { // NOLINT(*)
+          offsets[p + 1] = MergeRowSparseRange<DType, IType>(in_idx, in_val, bounds, p,
+                                                             row_length, nullptr, nullptr);
         }
-        case 3: {
-          Tensor<cpu, 1, DType> in_1(dptr[i] + offset, Shape1(size));
-          Tensor<cpu, 1, DType> in_2(dptr[i+1] + offset, Shape1(size));
-          Tensor<cpu, 1, DType> in_3(dptr[i+2] + offset, Shape1(size));
-          in_0 += in_1 + in_2 + in_3;
-          break;
+        for (size_t p = 0; p < nparts; ++p) {
+          offsets[p + 1] += offsets[p];
         }
-        default: {
-          Tensor<cpu, 1, DType> in_1(dptr[i] + offset, Shape1(size));
-          Tensor<cpu, 1, DType> in_2(dptr[i+1] + offset, Shape1(size));
-          Tensor<cpu, 1, DType> in_3(dptr[i+2] + offset, Shape1(size));
-          Tensor<cpu, 1, DType> in_4(dptr[i+3] + offset, Shape1(size));
-          in_0 += in_1 + in_2 + in_3 + in_4;
-          break;
+        // allocate memory for output
+        out->CheckAndAlloc({Shape1(offsets[nparts])});
+        IType* out_idx = out->aux_data(kIdx).dptr<IType>();
+        DType* out_val = out->data().dptr<DType>();
+        #pragma omp parallel for schedule(dynamic) num_threads(nthread_reduction_) if (nparts > 1)
+        for (long p = 0; p < static_cast<long>(nparts); ++p) { // NOLINT(*)
+          MergeRowSparseRange<DType, IType>(in_idx, in_val, bounds, p, row_length,
+                                            out_idx + offsets[p],
+                                            out_val + offsets[p] * row_length);
         }
-      }
-    }
+      });
+    });
   }
 
   template<typename DType>
   inline void ReduceSumCPUImpl(std::vector<DType*> dptr, size_t total) {
-    const size_t step = std::min(bigarray_bound_, static_cast<size_t>(4 << 10));
-    long ntask = (total + step - 1) / step; // NOLINT(*)
+    // results of arrays much larger than the cache are not read back soon,
+    // write them around the cache
+    const bool streaming = total >= stream_bound_;
     if (total < bigarray_bound_ || nthread_reduction_ <= 1) {
-      ReduceSumCPU(dptr, 0, total);
+      ReduceSumRange(dptr, 0, total, streaming);
     } else {
-      #pragma omp parallel for schedule(static) num_threads(nthread_reduction_)
-      for (long j = 0; j < ntask; ++j) { // NOLINT(*)
+      // one contiguous range per thread, aligned to 4K elements, so that
+      // threads do not share pages or cache lines of the output
+      const size_t align = 4 << 10;
+      const long nthread = nthread_reduction_; // NOLINT(*)
+      size_t step = (total + nthread - 1) / nthread;
+      step = (step + align - 1) / align * align;
+      #pragma omp parallel for schedule(static, 1) num_threads(nthread_reduction_)
+      for (long j = 0; j < nthread; ++j) { // NOLINT(*)
         size_t k = static_cast<size_t>(j);
         size_t begin = std::min(k * step, total);
         size_t end = std::min((k + 1) * step, total);
-        if (j == ntask - 1) CHECK_EQ(end, total);
-        ReduceSumCPU(dptr, begin, static_cast<index_t>(end - begin));
+        if (begin < end) {
+          ReduceSumRange(dptr, begin, end, streaming);
+        }
       }
     }
   }
@@ -436,6 +462,7 @@ class CommCPU : public Comm {
   };
   std::unordered_map<int, BufferEntry> merge_buf_;
   size_t bigarray_bound_;
+  size_t stream_bound_;
   int nthread_reduction_;
   bool is_serial_push_;
 };
@@ -25,17 +25,58 @@
 #ifndef MXNET_KVSTORE_GRADIENT_COMPRESSION_INL_H_
 #define MXNET_KVSTORE_GRADIENT_COMPRESSION_INL_H_
 
+#include <algorithm>
+#include <cmath>
 #include <vector>
+#include "./gradient_compression.h"
 #include "../operator/mxnet_op.h"
 
 namespace mxnet {
 namespace kvstore {
 
 // these gpu functions are defined in gradient_compression.cu
-void Quantize2BitImpl(mshadow::Stream<mshadow::gpu> *s, const std::vector<mxnet::TBlob> &inputs,
-                      const float threshold);
-void Dequantize2BitImpl(mshadow::Stream<mshadow::gpu> *s, const std::vector<mxnet::TBlob> &inputs,
-                        const float threshold);
+void QuantizeImpl(mshadow::Stream<mshadow::gpu> *s, const std::vector<mxnet::TBlob> &inputs,
+                  const CompressionType type, const float threshold, const int block_size);
+void DequantizeImpl(mshadow::Stream<mshadow::gpu> *s, const std::vector<mxnet::TBlob> &inputs,
+                    const CompressionType type, const float threshold, const int block_size);
+
+/*! \brief number of gradient values sharing one scale in 1bit compression */
+const int kOneBitBlock = 256;
+/*! \brief floats per 1bit block, one for the scale and one per 32 signs */
+const int kOneBitComprBlock = 1 + kOneBitBlock / 32;
+/*! \brief number of (index, value) pairs sent per block in topk compression */
+const int kTopKPairs = 8;
+
+/*!
+ * \brief returns the number of gradient values among which topk compression picks
+ * kTopKPairs values, so that about `ratio` of all values are sent
+ */
+inline int TopKBlockSize(const float ratio) {
+  return std::max(2 * kTopKPairs, static_cast<int>(std::round(kTopKPairs / ratio)));
+}
+
+/*! \brief bit pattern of a float, used to store integers and bf16 in float buffers */
+union FloatBits {
+  float f;
+  uint32_t u;
+};
+
+/*! \brief rounds a float to the upper 16 bits of its bit pattern, to nearest even */
+MSHADOW_XINLINE uint16_t FloatToBFloat16(const float v) {
+  FloatBits bits;
+  bits.f = v;
+  if ((bits.u & 0x7fffffff) > 0x7f800000) {
+    // keep NaN a quiet NaN after truncation
+    return static_cast<uint16_t>((bits.u >> 16) | 0x40);
+  }
+  return static_cast<uint16_t>((bits.u + 0x7fff + ((bits.u >> 16) & 1)) >> 16);
+}
+
+MSHADOW_XINLINE float BFloat16ToFloat(const uint16_t v) {
+  FloatBits bits;
+  bits.u = static_cast<uint32_t>(v) << 16;
+  return bits.f;
+}
 
 struct quantize_2bit {
   MSHADOW_XINLINE static void Map(int out_block_id,
@@ -138,16 +179,236 @@ void Dequantize2BitKernelLaunch(mshadow::Stream<xpu> *s, const std::vector<mxnet
           threshold);               // positive threshold
 }
 
-inline void Quantize2BitImpl(mshadow::Stream<mshadow::cpu> *s,
-                             const std::vector<mxnet::TBlob> &inputs,
-                             const float threshold) {
-  Quantize2BitKernelLaunch(s, inputs, threshold);
+struct quantize_1bit {
+  MSHADOW_XINLINE static void Map(int out_block_id,
+                                  int original_size,
+                                  float *out,
+                                  float *grad,
+                                  float *residual) {
+    // start and end are indices in original grad array
+    const int start = out_block_id * kOneBitBlock;
+    const int end = (start + kOneBitBlock <= original_size) ? start + kOneBitBlock
+                                                             : original_size;
+    // first float is the scale of the block, the others hold one sign bit per value
+    float *compr_block = out + out_block_id * kOneBitComprBlock;
+    uint32_t *sign_words = reinterpret_cast<uint32_t *>(compr_block + 1);
+    float abs_sum = 0;
+    for (int i = start; i < end; i++) {
+      residual[i] += grad[i];
+      abs_sum += residual[i] < 0 ? -residual[i] : residual[i];
+    }
+    // the mean magnitude keeps the l1 norm of the block, the rest stays in residual
+    const float scale = abs_sum / (end - start);
+    compr_block[0] = scale;
+    for (int w = 0; w < kOneBitComprBlock - 1; w++) {
+      sign_words[w] = 0;
+    }
+    for (int i = start; i < end; i++) {
+      if (residual[i] >= 0) {
+        sign_words[(i - start) >> 5] |= 1u << ((i - start) & 31);
+        residual[i] -= scale;
+      } else {
+        residual[i] += scale;
+      }
+    }
+  }
+};
+
+struct dequantize_1bit {
+  MSHADOW_XINLINE static void Map(int i,
+                                  float *out,
+                                  float *in) {
+    const float *compr_block = in + (i / kOneBitBlock) * kOneBitComprBlock;
+    const uint32_t *sign_words = reinterpret_cast<const uint32_t *>(compr_block + 1);
+    const int j = i % kOneBitBlock;
+    out[i] = ((sign_words[j >> 5] >> (j & 31)) & 1) ? compr_block[0] : -compr_block[0];
+  }
+};
+
+struct quantize_topk {
+  MSHADOW_XINLINE static void Map(int out_block_id,
+                                  int original_size,
+                                  int block_size,
+                                  float *out,
+                                  float *grad,
+                                  float *residual) {
+    const int start = out_block_id * block_size;
+    const int end = (start + block_size <= original_size) ? start + block_size : original_size;
+    // pairs of (index in block, value)
+    float *compr_block = out + out_block_id * 2 * kTopKPairs;
+    for (int i = start; i < end; i++) {
+      residual[i] += grad[i];
+    }
+    // kTopKPairs passes over the block are cheaper than sorting it, and run on gpu as well.
+    // A value is removed from residual once sent, so that the next pass skips it.
+    for (int p = 0; p < kTopKPairs; p++) {
+      int best = start;
+      float best_abs = -1;
+      for (int i = start; i < end; i++) {
+        const float a = residual[i] < 0 ? -residual[i] : residual[i];
+        if (a > best_abs) {
+          best = i;
+          best_abs = a;
+        }
+      }
+      FloatBits index;
+      index.u = static_cast<uint32_t>(best - start);
+      compr_block[2 * p] = index.f;
+      compr_block[2 * p + 1] = residual[best];
+      residual[best] = 0;
+    }
+  }
+};
+
+struct dequantize_topk {
+  MSHADOW_XINLINE static void Map(int out_block_id,
+                                  int original_size,
+                                  int block_size,
+                                  float *out,
+                                  float *in) {
+    const int start = out_block_id * block_size;
+    const int end = (start + block_size <= original_size) ? start + block_size : original_size;
+    const float *compr_block = in + out_block_id * 2 * kTopKPairs;
+    for (int i = start; i < end; i++) {
+      out[i] = 0;
+    }
+    for (int p = 0; p < kTopKPairs; p++) {
+      FloatBits index;
+      index.f = compr_block[2 * p];
+      // blocks with less than kTopKPairs values repeat an index with a zero value
+      if (index.u < static_cast<uint32_t>(end - start)) {
+        out[start + index.u] += compr_block[2 * p + 1];
+      }
+    }
+  }
+};
+
+struct quantize_fp16 {
+  MSHADOW_XINLINE static void Map(int i,
+                                  float *out,
+                                  float *grad,
+                                  float *residual) {
+    // two half precision values are packed in each float of out,
+    // the rounding error is sent with the next gradient
+    const float val = grad[i] + residual[i];
+    const mshadow::half::half_t h = mshadow::half::half_t(val);
+    reinterpret_cast<mshadow::half::half_t *>(out)[i] = h;
+    residual[i] = val - static_cast<float>(h);
+  }
+};
+
+struct dequantize_fp16 {
+  MSHADOW_XINLINE static void Map(int i,
+                                  float *out,
+                                  float *in) {
+    out[i] = static_cast<float>(reinterpret_cast<mshadow::half::half_t *>(in)[i]);
+  }
+};
+
+struct quantize_bf16 {
+  MSHADOW_XINLINE static void Map(int i,
+                                  float *out,
+                                  float *grad,
+                                  float *residual) {
+    const float val = grad[i] + residual[i];
+    const uint16_t h = FloatToBFloat16(val);
+    reinterpret_cast<uint16_t *>(out)[i] = h;
+    residual[i] = val - BFloat16ToFloat(h);
+  }
+};
+
+struct dequantize_bf16 {
+  MSHADOW_XINLINE static void Map(int i,
+                                  float *out,
+                                  float *in) {
+    out[i] = BFloat16ToFloat(reinterpret_cast<uint16_t *>(in)[i]);
+  }
+};
+
+/*!
+ * \brief launches the quantize kernel of `type`
+ * \param inputs original array, residual array and compressed array
+ * \param block_size number of values compressed together, used by topk
+ */
+template<typename xpu>
+void QuantizeKernelLaunch(mshadow::Stream<xpu> *s, const std::vector<mxnet::TBlob> &inputs,
+                          const CompressionType type, const float threshold,
+                          const int block_size) {
+  using mxnet::op::mxnet_op::Kernel;
+  const int original_size = inputs[0].Size();
+  float *out = inputs[2].dptr<float>();
+  float *grad = inputs[0].dptr<float>();
+  float *residual = inputs[1].dptr<float>();
+  switch (type) {
+    case CompressionType::kTwoBit:
+      Quantize2BitKernelLaunch(s, inputs, threshold);
+      break;
+    case CompressionType::kOneBit:
+      Kernel<quantize_1bit, xpu>::Launch(s, (original_size + kOneBitBlock - 1) / kOneBitBlock,
+                                         original_size, out, grad, residual);
+      break;
+    case CompressionType::kTopK:
+      Kernel<quantize_topk, xpu>::Launch(s, (original_size + block_size - 1) / block_size,
+                                         original_size, block_size, out, grad, residual);
+      break;
+    case CompressionType::kFloat16:
+      Kernel<quantize_fp16, xpu>::Launch(s, original_size, out, grad, residual);
+      break;
+    case CompressionType::kBFloat16:
+      Kernel<quantize_bf16, xpu>::Launch(s, original_size, out, grad, residual);
+      break;
+    default:
+      LOG(FATAL) << "Unsupported quantization of type " << static_cast<int>(type);
+  }
+}
+
+/*!
+ * \brief launches the dequantize kernel of `type`
+ * \param inputs compressed array and output array
+ * \param block_size number of values compressed together, used by topk
+ */
+template<typename xpu>
+void DequantizeKernelLaunch(mshadow::Stream<xpu> *s, const std::vector<mxnet::TBlob> &inputs,
+                            const CompressionType type, const float threshold,
+                            const int block_size) {
+  using mxnet::op::mxnet_op::Kernel;
+  const int original_size = inputs[1].Size();
+  float *out = inputs[1].dptr<float>();
+  float *in = inputs[0].dptr<float>();
+  switch (type) {
+    case CompressionType::kTwoBit:
+      Dequantize2BitKernelLaunch(s, inputs, threshold);
+      break;
+    case CompressionType::kOneBit:
+      Kernel<dequantize_1bit, xpu>::Launch(s, original_size, out, in);
+      break;
+    case CompressionType::kTopK:
+      Kernel<dequantize_topk, xpu>::Launch(s, (original_size + block_size - 1) / block_size,
+                                           original_size, block_size, out, in);
+      break;
+    case CompressionType::kFloat16:
+      Kernel<dequantize_fp16, xpu>::Launch(s, original_size, out, in);
+      break;
+    case CompressionType::kBFloat16:
+      Kernel<dequantize_bf16, xpu>::Launch(s, original_size, out, in);
+      break;
+    default:
+      LOG(FATAL) << "Unsupported dequantization of type " << static_cast<int>(type);
+  }
+}
+
+inline void QuantizeImpl(mshadow::Stream<mshadow::cpu> *s,
+                         const std::vector<mxnet::TBlob> &inputs,
+                         const CompressionType type, const float threshold,
+                         const int block_size) {
+  QuantizeKernelLaunch(s, inputs, type, threshold, block_size);
 }
 
-inline void Dequantize2BitImpl(mshadow::Stream<mshadow::cpu> *s,
-                               const std::vector<mxnet::TBlob> &inputs,
-                               const float threshold) {
-  Dequantize2BitKernelLaunch(s, inputs, threshold);
+inline void DequantizeImpl(mshadow::Stream<mshadow::cpu> *s,
+                           const std::vector<mxnet::TBlob> &inputs,
+                           const CompressionType type, const float threshold,
+                           const int block_size) {
+  DequantizeKernelLaunch(s, inputs, type, threshold, block_size);
 }
 }  // namespace kvstore
 }  // namespace mxnet
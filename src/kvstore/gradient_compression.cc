@@ -44,6 +44,15 @@ void GradientCompression::SetParams(const std::vector<std::pair<std::string, std
   CHECK_GT(params.threshold, 0) << "threshold must be greater than 0";
   if (params.type == "2bit") {
     SetTwoBitCompression(params.threshold);
+  } else if (params.type == "1bit") {
+    SetCompression(CompressionType::kOneBit, params.ratio);
+  } else if (params.type == "topk") {
+    CHECK(params.ratio > 0 && params.ratio <= 0.5) << "ratio must be in (0, 0.5]";
+    SetCompression(CompressionType::kTopK, params.ratio);
+  } else if (params.type == "fp16") {
+    SetCompression(CompressionType::kFloat16, params.ratio);
+  } else if (params.type == "bf16") {
+    SetCompression(CompressionType::kBFloat16, params.ratio);
   } else {
     LOG(FATAL) << "Unknown type for gradient compression " << params.type;
   }
@@ -62,11 +71,21 @@ void GradientCompression::SetTwoBitCompression(const float threshold) {
   threshold_ = threshold;
 }
 
+void GradientCompression::SetCompression(const CompressionType type, const float ratio) {
+  CHECK(type != CompressionType::kNone && type != CompressionType::kTwoBit)
+    << "Use SetTwoBitCompression for 2bit compression";
+  type_ = type;
+  ratio_ = ratio;
+}
+
 std::string GradientCompression::EncodeParams() {
   using namespace std;  // to reduce length of next line
   string rval = get_type_str();
   if (type_ == CompressionType::kTwoBit) {
     rval += "," + to_string(threshold_);
+  } else if (type_ == CompressionType::kTopK) {
+    // threshold is left empty, see DecodeParams
+    rval += ",," + to_string(ratio_);
   }
   return rval;
 }
@@ -80,22 +99,52 @@ void GradientCompression::DecodeParams(const std::string &s) {
       threshold_ = stof(elems[1]);
     }
   }
+  if (elems.size() > 2) {
+    if (!elems[2].empty()) {
+      ratio_ = stof(elems[2]);
+    }
+  }
 }
 
-int GradientCompression::GetCompressionFactor() {
-  if (type_ == CompressionType::kTwoBit) {
-    return 16;
-  } else {
-    LOG(FATAL) << "Unsupported compression type: " << get_type_str();
-    return 0;
+int GradientCompression::GetOriginalBlockSize() {
+  switch (type_) {
+    case CompressionType::kTwoBit:
+      return 16;
+    case CompressionType::kOneBit:
+      return kOneBitBlock;
+    case CompressionType::kTopK:
+      return TopKBlockSize(ratio_);
+    case CompressionType::kFloat16:
+    case CompressionType::kBFloat16:
+      return 2;
+    default:
+      LOG(FATAL) << "Unsupported compression type: " << get_type_str();
+      return 0;
+  }
+}
+
+int GradientCompression::GetCompressedBlockSize() {
+  switch (type_) {
+    case CompressionType::kTwoBit:
+    case CompressionType::kFloat16:
+    case CompressionType::kBFloat16:
+      return 1;
+    case CompressionType::kOneBit:
+      return kOneBitComprBlock;
+    case CompressionType::kTopK:
+      return 2 * kTopKPairs;
+    default:
+      LOG(FATAL) << "Unsupported compression type: " << get_type_str();
+      return 0;
   }
 }
 
 int64_t GradientCompression::GetCompressedSize(const int64_t original_size) {
-  const int bits = GetCompressionFactor();
-  return ((original_size % bits == 0) ?
-          original_size / bits :
-          original_size / bits + 1);
+  const int64_t block = GetOriginalBlockSize();
+  const int64_t num_blocks = (original_size % block == 0) ?
+                             original_size / block :
+                             original_size / block + 1;
+  return num_blocks * GetCompressedBlockSize();
 }
 
 void GradientCompression::Quantize(const mxnet::NDArray &from, mxnet::NDArray *to,
@@ -106,19 +155,23 @@ void GradientCompression::Quantize(const mxnet::NDArray &from, mxnet::NDArray *t
   const int a = from.ctx().dev_mask();
   const int b = to->ctx().dev_mask();
   const float threshold = threshold_;
-  if (type_ == CompressionType::kTwoBit) {
+  const CompressionType type = type_;
+  if (type_ != CompressionType::kNone) {
+    const int block_size = GetOriginalBlockSize();
     if (a == mshadow::cpu::kDevMask && b == mshadow::cpu::kDevMask) {
-      mxnet::Engine::Get()->PushSync([from, to, residual, threshold](mxnet::RunContext ctx) {
+      mxnet::Engine::Get()->PushSync([from, to, residual, type, threshold, block_size]
+                                     (mxnet::RunContext ctx) {
         std::vector<mxnet::TBlob> inputs = {from.data(), residual->data(), to->data()};
-        Quantize2BitImpl(ctx.get_stream<mshadow::cpu>(), inputs, threshold);
+        QuantizeImpl(ctx.get_stream<mshadow::cpu>(), inputs, type, threshold, block_size);
       }, from.ctx(), {from.var()}, {to->var(), residual->var()},
       mxnet::FnProperty::kNormal, priority, "QuantizeCPU");
     } else {
 #if MXNET_USE_CUDA
       if (a == mshadow::gpu::kDevMask && b == mshadow::gpu::kDevMask) {
-        mxnet::Engine::Get()->PushSync([from, to, residual, threshold](mxnet::RunContext ctx) {
+        mxnet::Engine::Get()->PushSync([from, to, residual, type, threshold, block_size]
+                                       (mxnet::RunContext ctx) {
           std::vector<mxnet::TBlob> inputs = {from.data(), residual->data(), to->data()};
-          Quantize2BitImpl(ctx.get_stream<mshadow::gpu>(), inputs, threshold);
+          QuantizeImpl(ctx.get_stream<mshadow::gpu>(), inputs, type, threshold, block_size);
           // Wait GPU kernel to complete
           ctx.get_stream<mshadow::gpu>()->Wait();
         }, from.ctx(), {from.var()}, {to->var(), residual->var()},
@@ -142,19 +195,23 @@ void GradientCompression::Dequantize(const mxnet::NDArray &from, mxnet::NDArray
   const int a = from.ctx().dev_mask();
   const int b = to->ctx().dev_mask();
   const float threshold = threshold_;
-  if (type_ == CompressionType::kTwoBit) {
+  const CompressionType type = type_;
+  if (type_ != CompressionType::kNone) {
+    const int block_size = GetOriginalBlockSize();
     if (a == mshadow::cpu::kDevMask && b == mshadow::cpu::kDevMask) {
-      mxnet::Engine::Get()->PushSync([from, to, threshold](mxnet::RunContext ctx) {
+      mxnet::Engine::Get()->PushSync([from, to, type, threshold, block_size]
+                                     (mxnet::RunContext ctx) {
         std::vector<mxnet::TBlob> inputs = {from.data(), to->data()};
-        Dequantize2BitImpl(ctx.get_stream<mshadow::cpu>(), inputs, threshold);
+        DequantizeImpl(ctx.get_stream<mshadow::cpu>(), inputs, type, threshold, block_size);
       }, from.ctx(), {from.var()}, {to->var()},
       mxnet::FnProperty::kNormal, priority, "DequantizeCPU");
     } else {
 #if MXNET_USE_CUDA
       if (a == mshadow::gpu::kDevMask && b == mshadow::gpu::kDevMask) {
-        mxnet::Engine::Get()->PushSync([from, to, threshold](mxnet::RunContext ctx) {
+        mxnet::Engine::Get()->PushSync([from, to, type, threshold, block_size]
+                                       (mxnet::RunContext ctx) {
           std::vector<mxnet::TBlob> inputs = {from.data(), to->data()};
-          Dequantize2BitImpl(ctx.get_stream<mshadow::gpu>(), inputs, threshold);
+          DequantizeImpl(ctx.get_stream<mshadow::gpu>(), inputs, type, threshold, block_size);
           // Wait GPU kernel to complete
           ctx.get_stream<mshadow::gpu>()->Wait();
         }, from.ctx(), {from.var()}, {to->var()},
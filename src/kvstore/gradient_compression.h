@@ -35,17 +35,21 @@ namespace mxnet {
 namespace kvstore {
 
 enum class CompressionType {
-  kNone, kTwoBit
+  kNone, kTwoBit, kOneBit, kTopK, kFloat16, kBFloat16
 };
 
 struct GradientCompressionParam : public dmlc::Parameter<GradientCompressionParam> {
   std::string type;
   float threshold;
+  float ratio;
   DMLC_DECLARE_PARAMETER(GradientCompressionParam) {
     DMLC_DECLARE_FIELD(type)
-      .describe("Type of gradient compression to use, like `2bit` for example");
+      .describe("Type of gradient compression to use, one of `2bit`, `1bit`, "
+                "`topk`, `fp16` and `bf16`");
     DMLC_DECLARE_FIELD(threshold).set_default(0.5)
       .describe("Threshold to use for 2bit gradient compression");
+    DMLC_DECLARE_FIELD(ratio).set_default(0.01)
+      .describe("Approximate fraction of gradient values sent by topk gradient compression");
   }
 };
 
@@ -78,6 +82,13 @@ class GradientCompression {
    */
   void SetTwoBitCompression(const float threshold);
 
+  /*!
+   * \brief sets compression of any type which does not take a threshold
+   * \param type one of kOneBit, kTopK, kFloat16 and kBFloat16
+   * \param ratio fraction of values kept by kTopK, ignored by the others
+   */
+  void SetCompression(const CompressionType type, const float ratio);
+
   /*!
    * \brief encodes parameters of gc into a string
    */
@@ -89,10 +100,16 @@ class GradientCompression {
   void DecodeParams(const std::string &s);
 
   /*!
-   * \brief returns compression factor, which is the factor by which size of gradient
-   * reduces when using a particular type of compression
+   * \brief returns the number of gradient values which are compressed together.
+   * Compressed data can only be split between servers at block boundaries.
    */
-  int GetCompressionFactor();
+  int GetOriginalBlockSize();
+
+  /*!
+   * \brief returns the number of floats a block of GetOriginalBlockSize() gradient values
+   * is compressed into
+   */
+  int GetCompressedBlockSize();
 
   /*!
    * \brief returns the size of compressed gradients given an original sized gradient array
@@ -132,6 +149,11 @@ class GradientCompression {
    * all negative gradients will be thresholded to -1*`threshold_`
    */
   float threshold_ = 0;
+
+  /*!
+   * \brief denotes approximate fraction of values kept by top-k compression
+   */
+  float ratio_ = 0;
 };
 }  // namespace kvstore
 }  // namespace mxnet
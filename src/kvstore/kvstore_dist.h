@@ -27,6 +27,8 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <cstring>
+#include <map>
 #include <utility>
 #include "./kvstore_local.h"
 #include "mxnet/engine.h"
@@ -56,6 +58,7 @@ class KVStoreDist : public KVStoreLocal {
       }
     }
     bigarray_bound_ = dmlc::GetEnv("MXNET_KVSTORE_BIGARRAY_BOUND", 1000 * 1000);
+    fusion_bucket_size_ = dmlc::GetEnv("MXNET_KVSTORE_FUSION_BUCKET_SIZE", 0);
     log_verbose_ = dmlc::GetEnv("MXNET_KVSTORE_DIST_ROW_SPARSE_VERBOSE", false);
   }
 
@@ -84,6 +87,15 @@ class KVStoreDist : public KVStoreLocal {
     }
   }
 
+  void set_thread_safe_updater(const Updater& updater) override {
+    CHECK(updater) << "invalid updater";
+    if (IsServerNode()) {
+      CHECK_NOTNULL(server_)->set_updater(updater, true);
+    } else {
+      updater_ = updater;
+    }
+  }
+
   void SetGradientCompression(const std::vector<std::pair<std::string, std::string> >
                               & kwargs) override {
     KVStoreLocal::SetGradientCompression(kwargs);
@@ -188,6 +200,7 @@ class KVStoreDist : public KVStoreLocal {
   void InitImpl(const std::vector<int>& keys,
                 const std::vector<NDArray>& values) override {
     CheckUnique(keys);
+    AssignServers(keys, values);
     for (size_t i = 0; i < keys.size(); ++i) {
       comm_->Init(keys[i], values[i].storage_type(), values[i].shape(), values[i].dtype());
     }
@@ -220,6 +233,8 @@ class KVStoreDist : public KVStoreLocal {
     GroupKVPairsPull(okeys, outputs, &uniq_okeys, &grouped_outs, true);
     CHECK_EQ(uniq_vkeys.size(), uniq_okeys.size())
              << "List of push and pull keys are different";
+    // keys of a fusion bucket pushpulled together are sent in one message
+    std::map<int, std::vector<size_t>> fused;
 
     for (size_t i = 0; i < uniq_vkeys.size(); ++i) {
       CHECK_EQ(uniq_vkeys[i], uniq_okeys[i])
@@ -253,6 +268,11 @@ class KVStoreDist : public KVStoreLocal {
 
       CHECK(gradient_compression_->get_type() == CompressionType::kNone)
                << "Compression not supported with PushPull";
+      const int bucket = FusionBucketOf(key);
+      if (bucket >= 0) {
+        fused[bucket].push_back(i);
+        continue;
+      }
       auto pushpull = [this, key, comm_buf](
           RunContext rctx, Engine::CallbackOnComplete cb) {
         size_t size = comm_buf.shape().Size();
@@ -279,6 +299,18 @@ class KVStoreDist : public KVStoreLocal {
 
       comm_->Broadcast(key, comm_buf, outs, priority);
     }
+    for (const auto& bucket : fused) {
+      std::vector<int> fused_keys;
+      std::vector<NDArray> bufs;
+      for (const size_t i : bucket.second) {
+        fused_keys.push_back(uniq_vkeys[i]);
+        bufs.push_back(comm_buf_[uniq_vkeys[i]]);
+      }
+      PushPullFused(fused_keys, bufs, priority);
+      for (const size_t i : bucket.second) {
+        comm_->Broadcast(uniq_vkeys[i], comm_buf_[uniq_vkeys[i]], grouped_outs[i], priority);
+      }
+    }
   }
 
   void PushImpl(const std::vector<int>& keys,
@@ -294,6 +326,8 @@ class KVStoreDist : public KVStoreLocal {
     std::vector<int> uniq_keys;
     std::vector<std::vector<NDArray*> > grouped_vals;
     GroupKVPairsPull(keys, values, &uniq_keys, &grouped_vals, true);
+    // keys of a fusion bucket pulled together are pulled in one message
+    std::map<int, std::vector<size_t>> fused;
 
     for (size_t i = 0; i < uniq_keys.size(); ++i) {
       int key = uniq_keys[i];
@@ -308,6 +342,11 @@ class KVStoreDist : public KVStoreLocal {
         recv_buf = NDArray(grouped_vals[i][0]->shape(), pinned_ctx_,
                            true, grouped_vals[i][0]->dtype());
       }
+      const int bucket = FusionBucketOf(key);
+      if (bucket >= 0) {
+        fused[bucket].push_back(i);
+        continue;
+      }
       auto pull_from_servers = [this, key, recv_buf](
           RunContext rctx, Engine::CallbackOnComplete cb) {
         // convert to ps keys
@@ -339,6 +378,18 @@ class KVStoreDist : public KVStoreLocal {
 
       comm_->Broadcast(key, recv_buf, grouped_vals[i], priority);
     }
+    for (const auto& bucket : fused) {
+      std::vector<int> fused_keys;
+      std::vector<NDArray> recv_bufs;
+      for (const size_t i : bucket.second) {
+        fused_keys.push_back(uniq_keys[i]);
+        recv_bufs.push_back(comm_buf_[uniq_keys[i]]);
+      }
+      PullFused(fused_keys, recv_bufs, priority);
+      for (const size_t i : bucket.second) {
+        comm_->Broadcast(uniq_keys[i], comm_buf_[uniq_keys[i]], grouped_vals[i], priority);
+      }
+    }
   }
 
   void PullRowSparseImpl(const std::vector<int>& keys,
@@ -389,6 +440,8 @@ class KVStoreDist : public KVStoreLocal {
     std::vector<int> uniq_keys;
     std::vector<std::vector<NDArray> > grouped_vals;
     GroupKVPairsPush(keys, values, &uniq_keys, &grouped_vals, false);
+    // keys of a fusion bucket pushed together are pushed in one message
+    std::map<int, std::vector<int>> fused;
 
     for (size_t i = 0; i < uniq_keys.size(); ++i) {
       // merge over devices
@@ -419,6 +472,11 @@ class KVStoreDist : public KVStoreLocal {
       // push to servers
       if (storage_type == kDefaultStorage) {
         if (gradient_compression_->get_type() == CompressionType::kNone) {
+          const int bucket = FusionBucketOf(key);
+          if (bucket >= 0) {
+            fused[bucket].push_back(key);
+            continue;
+          }
           PSKV& pskv = EncodeDefaultKey(key, comm_buf.shape().Size(), num_bytes);
           PushDefault(key, comm_buf, pskv, priority);
         } else {
@@ -446,6 +504,222 @@ class KVStoreDist : public KVStoreLocal {
         LOG(FATAL) << "unknown storage type";
       }
     }
+    for (const auto& bucket : fused) {
+      std::vector<NDArray> send_bufs;
+      for (const int key : bucket.second) {
+        send_bufs.push_back(comm_buf_[key]);
+      }
+      PushFused(bucket.second, send_bufs, priority);
+    }
+  }
+
+  /**
+   * \brief places small dense keys on the server with the fewest bytes so far, and
+   * groups them into fusion buckets of at most MXNET_KVSTORE_FUSION_BUCKET_SIZE bytes.
+   * Every worker initializes keys in the same order, so all agree on the placement.
+   */
+  void AssignServers(const std::vector<int>& keys, const std::vector<NDArray>& values) {
+    if (fusion_bucket_size_ == 0) return;
+    const size_t num_servers = ps::Postoffice::Get()->GetServerKeyRanges().size();
+    std::lock_guard<std::mutex> lk(mu_);
+    if (server_bytes_.empty()) {
+      server_bytes_.resize(num_servers, 0);
+      for (size_t i = 0; i < num_servers; ++i) {
+        std::string name = "Server " + std::to_string(i) + " bytes";
+        server_bytes_counters_.emplace_back(std::make_shared<profiler::ProfileCounter>(
+            name.c_str(), &fusion_domain_));
+        name = "Server " + std::to_string(i) + " keys";
+        server_keys_counters_.emplace_back(std::make_shared<profiler::ProfileCounter>(
+            name.c_str(), &fusion_domain_));
+      }
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+      const int key = keys[i];
+      const NDArray& value = values[i];
+      const size_t num_elems = value.shape().Size();
+      const size_t bytes = num_elems * mshadow::mshadow_sizeof(value.dtype());
+      if (value.storage_type() != kDefaultStorage || num_elems >= bigarray_bound_) {
+        // big arrays are partitioned to all servers, row sparse ones are counted alike
+        for (size_t s = 0; s < num_servers; ++s) {
+          server_bytes_[s] += bytes / num_servers;
+          *server_bytes_counters_[s] += bytes / num_servers;
+          ++(*server_keys_counters_[s]);
+        }
+        continue;
+      }
+      const int server = std::min_element(server_bytes_.begin(), server_bytes_.end()) -
+                         server_bytes_.begin();
+      key_server_[key] = server;
+      server_bytes_[server] += bytes;
+      *server_bytes_counters_[server] += bytes;
+      ++(*server_keys_counters_[server]);
+      if (bytes >= fusion_bucket_size_) continue;
+      // fill the open bucket of this server and dtype, or open a new one
+      const auto open_key = std::make_pair(server, value.dtype());
+      auto it = open_bucket_.find(open_key);
+      if (it == open_bucket_.end() ||
+          fusion_buckets_[it->second].bytes + bytes > fusion_bucket_size_) {
+        open_bucket_[open_key] = fusion_buckets_.size();
+        fusion_buckets_.emplace_back();
+        it = open_bucket_.find(open_key);
+      }
+      fusion_buckets_[it->second].bytes += bytes;
+      key_bucket_[key] = it->second;
+    }
+  }
+
+  /**
+   * \brief returns the fusion bucket of key, or -1 if key is not fused
+   */
+  int FusionBucketOf(const int key) {
+    // compressed pushes are sent key by key
+    if (fusion_bucket_size_ == 0 ||
+        gradient_compression_->get_type() != CompressionType::kNone) return -1;
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = key_bucket_.find(key);
+    return it == key_bucket_.end() ? -1 : it->second;
+  }
+
+  /**
+   * \brief ps keys and lens for several keys of one bucket, sorted by key as ps-lite needs
+   */
+  PSKV EncodeFusedKeys(const std::vector<int>& keys, const std::vector<NDArray>& bufs,
+                       std::vector<size_t>* order) {
+    order->resize(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) (*order)[i] = i;
+    std::sort(order->begin(), order->end(),
+              [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+    auto krs = ps::Postoffice::Get()->GetServerKeyRanges();
+    PSKV pskv;
+    pskv.size = 0;
+    for (const size_t i : *order) {
+      const int server = ServerOfKey(keys[i], krs.size());
+      ps::Key ps_key = krs[server].begin() + keys[i];
+      CHECK_LT(ps_key, krs[server].end());
+      const int bytes = bufs[i].shape().Size() * mshadow::mshadow_sizeof(bufs[i].dtype());
+      pskv.keys.push_back(ps_key);
+      pskv.lens.push_back(bytes);
+      pskv.size += bytes;
+    }
+    return pskv;
+  }
+
+  void PushFused(const std::vector<int>& keys, const std::vector<NDArray>& send_bufs,
+                 int priority) {
+    auto push_to_servers =
+        [this, keys, send_bufs](RunContext rctx, Engine::CallbackOnComplete cb) {
+          std::vector<size_t> order;
+          PSKV pskv = EncodeFusedKeys(keys, send_bufs, &order);
+          // concatenate the values in key order
+          ps::SArray<char> vals(pskv.size);
+          size_t offset = 0;
+          for (size_t j = 0; j < order.size(); ++j) {
+            std::memcpy(vals.data() + offset, send_bufs[order[j]].data().dptr_, pskv.lens[j]);
+            offset += pskv.lens[j];
+          }
+          int cmd = GetCommandType(RequestType::kFusedPushPull, send_bufs[0].dtype());
+          CHECK_NOTNULL(ps_worker_)->ZPush(
+              pskv.keys, vals, pskv.lens,
+              cmd, [cb]() { cb(); });
+        };
+    std::vector<Engine::VarHandle> const_vars;
+    for (const auto& buf : send_bufs) const_vars.push_back(buf.var());
+    Engine::Get()->PushAsync(
+        push_to_servers,
+        pinned_ctx_,
+        const_vars,
+        {},
+        FnProperty::kNormal,
+        priority,
+        "KVStoreDistFusedPush");
+  }
+
+  void PullFused(const std::vector<int>& keys, const std::vector<NDArray>& recv_bufs,
+                 int priority) {
+    auto pull_from_servers =
+        [this, keys, recv_bufs](RunContext rctx, Engine::CallbackOnComplete cb) {
+          std::vector<size_t> order;
+          PSKV pskv = EncodeFusedKeys(keys, recv_bufs, &order);
+          auto vals = new ps::SArray<char>(pskv.size);
+          auto lens = new ps::SArray<int>(pskv.lens);
+          int cmd = GetCommandType(RequestType::kFusedPushPull, recv_bufs[0].dtype());
+          CHECK_NOTNULL(ps_worker_)->ZPull(
+              pskv.keys, vals, lens, cmd, [vals, lens, order, recv_bufs, cb]() {
+                // scatter the values, which come back in key order
+                size_t offset = 0;
+                for (size_t j = 0; j < order.size(); ++j) {
+                  std::memcpy(recv_bufs[order[j]].data().dptr_, vals->data() + offset,
+                              (*lens)[j]);
+                  offset += (*lens)[j];
+                }
+                delete vals;
+                delete lens;
+                cb();
+              });
+        };
+    std::vector<Engine::VarHandle> mutable_vars;
+    for (const auto& buf : recv_bufs) mutable_vars.push_back(buf.var());
+    CHECK_NOTNULL(Engine::Get())->PushAsync(
+        pull_from_servers,
+        pinned_ctx_,
+        {},
+        mutable_vars,
+        FnProperty::kNormal,
+        priority,
+        "KVStoreDistFusedPull");
+  }
+
+  void PushPullFused(const std::vector<int>& keys, const std::vector<NDArray>& bufs,
+                     int priority) {
+    auto pushpull =
+        [this, keys, bufs](RunContext rctx, Engine::CallbackOnComplete cb) {
+          std::vector<size_t> order;
+          PSKV pskv = EncodeFusedKeys(keys, bufs, &order);
+          // concatenate the values in key order, they come back in the same order
+          ps::SArray<char> vals(pskv.size);
+          size_t offset = 0;
+          for (size_t j = 0; j < order.size(); ++j) {
+            std::memcpy(vals.data() + offset, bufs[order[j]].data().dptr_, pskv.lens[j]);
+            offset += pskv.lens[j];
+          }
+          auto outs = new ps::SArray<char>(pskv.size);
+          auto lens = new ps::SArray<int>(pskv.lens);
+          int cmd = GetCommandType(RequestType::kFusedPushPull, bufs[0].dtype());
+          CHECK_NOTNULL(ps_worker_)->ZPushPull(
+              pskv.keys, vals, outs, lens, cmd, [outs, lens, order, bufs, cb]() {
+                size_t offset = 0;
+                for (size_t j = 0; j < order.size(); ++j) {
+                  std::memcpy(bufs[order[j]].data().dptr_, outs->data() + offset, (*lens)[j]);
+                  offset += (*lens)[j];
+                }
+                delete outs;
+                delete lens;
+                cb();
+              });
+        };
+    std::vector<Engine::VarHandle> mutable_vars;
+    for (const auto& buf : bufs) mutable_vars.push_back(buf.var());
+    CHECK_NOTNULL(Engine::Get())->PushAsync(
+        pushpull,
+        pinned_ctx_,
+        {},
+        mutable_vars,
+        FnProperty::kNormal,
+        priority,
+        "KVStoreDistFusedPushPull");
+  }
+
+  /**
+   * \brief the server holding a key smaller than bigarray_bound_
+   */
+  int ServerOfKey(const int key, const int num_servers) {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      auto it = key_server_.find(key);
+      if (it != key_server_.end()) return it->second;
+    }
+    // a simple heuristic for load balance, a random picked server
+    return (key * 9973) % num_servers;
   }
 
   void PushCompressed(int key, const NDArray& comm_buf, const PSKV& pskv, int priority) {
@@ -617,10 +891,9 @@ class KVStoreDist : public KVStoreLocal {
       const int num_servers = krs.size();
       CHECK_GT(num_servers, 0);
 
-      // a simple heuristic for load balance
       if (num_arr_elems < bigarray_bound_) {
-        // send it to a single random picked server
-        int server = (key * 9973) % num_servers;
+        // send it to a single server
+        int server = ServerOfKey(key, num_servers);
         ps::Key ps_key = krs[server].begin() + key;
         CHECK_LT(ps_key, krs[server].end());
         pskv.keys.push_back(ps_key);
@@ -683,9 +956,8 @@ class KVStoreDist : public KVStoreLocal {
       mu_.unlock();
 
       if (original_num_elem < bigarray_bound_) {
-        // a simple heuristic for load balancing
-        // send it to a single random picked server
-        const int server = (key * 9973) % num_servers;
+        // send it to a single server
+        const int server = ServerOfKey(key, num_servers);
         ps::Key ps_key = krs[server].begin() + key;
         CHECK_LT(ps_key, krs[server].end());
         // meta info
@@ -701,9 +973,13 @@ class KVStoreDist : public KVStoreLocal {
         push_pskv.size = compr_size;
         pull_pskv.size = original_size;
       } else {
-        // partition it to all servers
+        // partition it to all servers, at compression block boundaries so that
+        // each server can decode its part on its own
         push_pskv.size = 0;
         pull_pskv.size = 0;
+        const size_t compr_block = gradient_compression_->GetCompressedBlockSize();
+        const size_t orig_block = gradient_compression_->GetOriginalBlockSize();
+        const size_t num_blocks = compr_num_elem / compr_block;
 
         for (int i = 0; i < num_servers; ++i) {
           size_t part_compr, part_orig;
@@ -711,10 +987,11 @@ class KVStoreDist : public KVStoreLocal {
             part_compr = compr_num_elem - push_pskv.size;
             part_orig = original_num_elem - pull_pskv.size;
           } else {
-            part_compr =
-              static_cast<size_t> (round(static_cast<double>(compr_num_elem)/num_servers*(i+1))) -
-              static_cast<size_t> (round(static_cast<double>(compr_num_elem)/num_servers*(i)));
-            part_orig = part_compr * gradient_compression_->GetCompressionFactor();
+            const size_t part_blocks =
+              static_cast<size_t> (round(static_cast<double>(num_blocks)/num_servers*(i+1))) -
+              static_cast<size_t> (round(static_cast<double>(num_blocks)/num_servers*(i)));
+            part_compr = part_blocks * compr_block;
+            part_orig = part_blocks * orig_block;
           }
 
           // meta info
@@ -818,6 +1095,33 @@ class KVStoreDist : public KVStoreLocal {
    * \brief threshold for partition
    */
   size_t bigarray_bound_;
+  /**
+   * \brief maximum bytes of a fusion bucket, 0 to send each key on its own
+   */
+  size_t fusion_bucket_size_;
+  /**
+   * \brief bytes a fusion bucket holds, its keys are kept in key_bucket_
+   */
+  struct FusionBucket {
+    size_t bytes = 0;
+  };
+  std::vector<FusionBucket> fusion_buckets_;
+  /**
+   * \brief bucket still accepting keys for each (server, dtype)
+   */
+  std::map<std::pair<int, int>, size_t> open_bucket_;
+  /**
+   * \brief fusion bucket and server assigned to each small key at init
+   */
+  std::unordered_map<int, int> key_bucket_;
+  std::unordered_map<int, int> key_server_;
+  /**
+   * \brief bytes and keys assigned to each server, also reported to the profiler
+   */
+  std::vector<size_t> server_bytes_;
+  profiler::ProfileDomain fusion_domain_{"KVStoreDist"};
+  std::vector<std::shared_ptr<profiler::ProfileCounter>> server_bytes_counters_;
+  std::vector<std::shared_ptr<profiler::ProfileCounter>> server_keys_counters_;
   /**
    * \brief buffer for non-compressed data.
    * When gradient compression is active, this is used
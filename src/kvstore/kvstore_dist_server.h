@@ -34,6 +34,9 @@
 #include <memory>
 #include <functional>
 #include <future>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include "../profiler/profiler.h"
 #include "../operator/tensor/elemwise_binary_op-inl.h"
@@ -49,7 +52,7 @@ enum class CommandType {
 };
 
 enum class RequestType {
-  kDefaultPushPull, kRowSparsePushPull, kCompressedPushPull
+  kDefaultPushPull, kRowSparsePushPull, kCompressedPushPull, kFusedPushPull
 };
 
 struct DataHandleType {
@@ -103,13 +106,15 @@ class Executor {
       cond_.wait(lk, [this]{return !queue_.empty();});
       Block blk = std::move(queue_.front());
       queue_.pop();
+      PublishDepth();
       lk.unlock();
 
       if (blk.f) {
         blk.f();
-        blk.p->set_value();
+        if (blk.p) blk.p->set_value();
       } else {
-        blk.p->set_value(); break;
+        if (blk.p) blk.p->set_value();
+        break;
       }
       lk.lock();
     }
@@ -126,14 +131,19 @@ class Executor {
   void Exec(const Func& func) {
     Block blk(func);
     auto fut = blk.p->get_future();
-    {
-      std::lock_guard<std::mutex> lk(mu_);
-      queue_.push(std::move(blk));
-      cond_.notify_one();
-    }
+    Push(std::move(blk));
     fut.wait();
   }
 
+  /**
+   * \brief same as \ref Exec, but returns without waiting for func to run. threadsafe
+   */
+  void ExecAsync(const Func& func) {
+    Block blk(func);
+    blk.p.reset();
+    Push(std::move(blk));
+  }
+
   /**
    * \brief stop the thread, threadsafe
    */
@@ -141,21 +151,67 @@ class Executor {
     Exec(Func());
   }
 
+  /**
+   * \brief report the number of functions waiting in the queue to counter, while
+   * the profiler runs
+   */
+  void set_depth_counter(profiler::ProfileCounter* counter) {
+    depth_counter_ = counter;
+  }
+
  private:
   struct Block {
   explicit Block(const Func& func) : f(func), p(std::make_shared<std::promise<void>>()) { }
     Func f;
     std::shared_ptr<std::promise<void>> p;
   };
+  void Push(Block&& blk) {
+    std::lock_guard<std::mutex> lk(mu_);
+    queue_.push(std::move(blk));
+    PublishDepth();
+    cond_.notify_one();
+  }
+  // every counter update queues a stat until the profile is dumped, so only
+  // update it while profiling. called with mu_ held
+  void PublishDepth() {
+    if (depth_counter_ != nullptr &&
+        profiler::Profiler::Get()->GetState() == profiler::Profiler::kRunning) {
+      *depth_counter_ = queue_.size();
+    }
+  }
   std::queue<Block> queue_;
   std::mutex mu_;
   std::condition_variable cond_;
+  profiler::ProfileCounter* depth_counter_ = nullptr;
+};
+
+/**
+ * \brief map from key to V whose lookups are threadsafe. As for std::unordered_map,
+ * references to the values stay valid when other keys are inserted, so only
+ * the lookup is locked and each value is left to the thread owning its key.
+ */
+template<typename V>
+class KeyMap {
+ public:
+  V& operator[](const int key) {
+    std::lock_guard<std::mutex> lk(mu_);
+    return map_[key];
+  }
+  // iterating is not threadsafe, only for commands sent before any push
+  typename std::unordered_map<int, V>::iterator begin() { return map_.begin(); }
+  typename std::unordered_map<int, V>::iterator end() { return map_.end(); }
+
+ private:
+  std::unordered_map<int, V> map_;
+  std::mutex mu_;
 };
 
 class KVStoreDistServer {
  public:
   KVStoreDistServer() {
     using namespace std::placeholders;
+    // shards have to be running before the first request arrives
+    StartApplyShards(dmlc::GetEnv("MXNET_KVSTORE_SERVER_APPLY_THREADS", 0));
     ps_server_ = new ps::KVServer<char>(0);
     static_cast<ps::SimpleApp*>(ps_server_)->set_request_handle(
         std::bind(&KVStoreDistServer::CommandHandle, this, _1, _2));
@@ -167,6 +223,7 @@ class KVStoreDistServer {
   }
 
   ~KVStoreDistServer() {
+    StopApplyShards();
     profiler::Profiler::Get()->SetState(profiler::Profiler::ProfilerState(0));
     delete ps_server_;
   }
@@ -176,9 +233,15 @@ class KVStoreDistServer {
     controller_ = controller;
   }
 
-  void set_updater(const KVStore::Updater& updater)  {
+  /**
+   * \brief set the updater, which runs on the main thread unless it is thread safe
+   * \param thread_safe whether updater may run for different keys at once on any
+   * thread, so that the apply shards run it in parallel
+   */
+  void set_updater(const KVStore::Updater& updater, bool thread_safe = false)  {
     CHECK(updater);
     updater_ = updater;
+    updater_thread_safe_ = thread_safe;
   }
 
   /**
@@ -189,8 +252,25 @@ class KVStoreDistServer {
   }
 
  private:
+  /**
+   * \brief a push, pull or pushpull of several small keys in one message, which
+   * is answered once each of its keys has been handled
+   */
+  struct FusedRequest {
+    ps::KVMeta meta;
+    DataHandleType type;
+    // for a pull, the values of all keys in key order, filled in key by key
+    ps::KVPairs<char> response;
+    // index of each key in response, and the byte offset of its value
+    std::unordered_map<int, size_t> index;
+    std::vector<size_t> offsets;
+    std::atomic<int> pending;
+  };
+
   struct UpdateBuf {
     std::vector<ps::KVMeta> request;
+    // fused pushes waiting for this key, counted together with request
+    std::vector<std::shared_ptr<FusedRequest>> fused_request;
     NDArray merged;
     // temp_array is used to cast received values as float32 for computation if required
     NDArray temp_array;
@@ -200,6 +280,7 @@ class KVStoreDistServer {
     CommandType recved_type = static_cast<CommandType>(recved.head);
     switch (recved_type) {
       case CommandType::kStopServer:
+        StopApplyShards();
         exec_.Stop();
         break;
       case CommandType::kSyncMode:
@@ -322,9 +403,93 @@ class KVStoreDistServer {
     }
   }
 
+  /**
+   * \brief starts num_shards apply threads, or none to handle requests on the
+   * ps-lite thread and run updates on the main thread
+   */
+  void StartApplyShards(const int num_shards) {
+    for (int i = 0; i < num_shards; ++i) {
+      const std::string name = "Apply shard " + std::to_string(i) + " queue depth";
+      apply_depth_counters_.emplace_back(std::make_shared<profiler::ProfileCounter>(
+          name.c_str(), &apply_domain_));
+      apply_shards_.emplace_back(new Executor());
+      apply_shards_.back()->set_depth_counter(apply_depth_counters_.back().get());
+    }
+    for (int i = 0; i < num_shards; ++i) {
+      Executor* shard = apply_shards_[i].get();
+      apply_threads_.emplace_back([shard]() { shard->Start(); });
+    }
+  }
+
+  /**
+   * \brief lets the apply threads finish their queued requests and joins them
+   */
+  void StopApplyShards() {
+    for (auto& shard : apply_shards_) {
+      shard->ExecAsync(Executor::Func());
+    }
+    for (auto& thread : apply_threads_) {
+      if (thread.joinable()) thread.join();
+    }
+  }
+
+  /**
+   * \brief runs f on the apply shard of key, or right away if requests are not sharded
+   */
+  void RunOnShard(const int key, const Executor::Func& f) {
+    if (apply_shards_.empty()) {
+      f();
+    } else {
+      apply_shards_[key % apply_shards_.size()]->ExecAsync(f);
+    }
+  }
+
+  /**
+   * \brief the key a request works on, which decides its apply shard
+   */
+  int RequestKey(const DataHandleType type, const ps::KVMeta& req_meta,
+                 const ps::KVPairs<char>& req_data) {
+    // a compressed push starts with a dummy key holding the original size
+    if (type.requestType == RequestType::kCompressedPushPull && req_meta.push) {
+      return DecodeKey(req_data.keys[1]);
+    }
+    return DecodeKey(req_data.keys[0]);
+  }
+
+  /**
+   * \brief runs a thread safe updater on the calling thread, which is the apply
+   * shard of key if there are shards. Other updaters, such as the ones of python,
+   * run on the main thread one at a time, the shards waiting for them.
+   */
+  void RunUpdater(const int key, const NDArray& update, NDArray* stored) {
+    if (updater_thread_safe_) {
+      updater_(key, update, stored);
+      return;
+    }
+    exec_.Exec([this, key, &update, stored]() {
+      updater_(key, update, stored);
+    });
+  }
+
   void DataHandleEx(const ps::KVMeta& req_meta,
                     const ps::KVPairs<char>& req_data,
                     ps::KVServer<char>* server) {
+    const DataHandleType type = DepairDataHandleType(req_meta.cmd);
+    if (apply_shards_.empty() || type.requestType == RequestType::kFusedPushPull) {
+      // a fused request is split into its keys by DataHandleFused
+      DataHandle(req_meta, req_data, server);
+      return;
+    }
+    // requests of one key go to one shard, which keeps their order, while
+    // requests of different keys are merged in parallel
+    RunOnShard(RequestKey(type, req_meta, req_data), [this, req_meta, req_data, server]() {
+      DataHandle(req_meta, req_data, server);
+    });
+  }
+
+  void DataHandle(const ps::KVMeta& req_meta,
+                  const ps::KVPairs<char>& req_data,
+                  ps::KVServer<char>* server) {
     DataHandleType type = DepairDataHandleType(req_meta.cmd);
     switch (type.requestType) {
       case RequestType::kRowSparsePushPull:
@@ -336,6 +501,9 @@ class KVStoreDistServer {
       case RequestType::kDefaultPushPull:
         DataHandleDefault(type, req_meta, req_data, server);
         break;
+      case RequestType::kFusedPushPull:
+        DataHandleFused(type, req_meta, req_data, server);
+        break;
     }
   }
 
@@ -346,15 +514,13 @@ class KVStoreDistServer {
   inline void ApplyUpdates(const DataHandleType type, const int key,
                            const ps::KVPairs<char>& req_data, UpdateBuf *update_buf,
                            ps::KVServer<char>* server) {
-    if (!sync_mode_ || update_buf->request.size() == (size_t) ps::NumWorkers()) {
+    const size_t num_requests = update_buf->request.size() + update_buf->fused_request.size();
+    if (!sync_mode_ || num_requests == (size_t) ps::NumWorkers()) {
       // let the main thread to execute updater_, which is necessary for python
       auto& stored = has_multi_precision_copy(type) ? store_realt_[key] : store_[key];
       auto& update =  sync_mode_ ? update_buf->merged : update_buf->temp_array;
       if (updater_) {
-        exec_.Exec([this, key, &update, &stored](){
-          CHECK(updater_);
-          updater_(key, update, &stored);
-        });
+        RunUpdater(key, update, &stored);
       } else {
         CHECK(sync_mode_) << "Updater needs to be set for async mode";
         // if no updater, just copy
@@ -376,7 +542,11 @@ class KVStoreDistServer {
           server->Response(req);
         }
       }
+      for (const auto& fused : update_buf->fused_request) {
+        RespondFused(fused, key, server);
+      }
       update_buf->request.clear();
+      update_buf->fused_request.clear();
       if (has_multi_precision_copy(type)) CopyFromTo(stored, store_[key]);
       stored.WaitToRead();
     } else {
@@ -630,6 +800,12 @@ class KVStoreDistServer {
       auto& stored = store_[key];
 
       size_t ds[] = {(size_t)req_data.lens[1] / mshadow::mshadow_sizeof(type.dtype)};
+      // every compression type decodes its blocks independently, the worker splits
+      // data between servers at block boundaries, so a part decodes on its own
+      CHECK_EQ(static_cast<int64_t>(ds[0]),
+               gradient_compression_->GetCompressedSize(original_size))
+        << "Compressed data of key " << key << " does not match compression type "
+        << gradient_compression_->get_type_str();
       mxnet::TShape dshape(ds, ds + 1);
       TBlob recv_blob(reinterpret_cast<real_t*>(req_data.vals.data()), dshape, cpu::kDevMask);
       NDArray recved = NDArray(recv_blob, 0);
@@ -663,10 +839,8 @@ class KVStoreDistServer {
       } else {
         // async push
         gradient_compression_->Dequantize(recved, &decomp_buf, 0);
-        exec_.Exec([this, key, &decomp_buf, &stored]() {
-          CHECK(updater_);
-          updater_(key, decomp_buf, &stored);
-        });
+        CHECK(updater_);
+        RunUpdater(key, decomp_buf, &stored);
         server->Response(req_meta);
         stored.WaitToRead();
       }
@@ -688,65 +862,181 @@ class KVStoreDistServer {
       CHECK_EQ(req_data.vals.size(), (size_t)req_data.lens[0]);
     }
     int key = DecodeKey(req_data.keys[0]);
+    if (req_meta.push) {
+      NDArray recved = RecvDefault(type, req_data.vals.data(), req_data.lens[0]);
+      DefaultStoragePush(type, key, recved, req_meta, req_data, nullptr, server);
+    } else {
+      DefaultStorageResponse(type, key, req_meta, req_data, server);
+    }
+  }
+
+  /**
+   * \brief wraps len bytes of received data into an NDArray, without copying
+   */
+  NDArray RecvDefault(const DataHandleType type, char* data, const int len) {
+    size_t ds[] = {(size_t) len / mshadow::mshadow_sizeof(type.dtype)};
+    mxnet::TShape dshape(ds, ds + 1);
+    TBlob recv_blob;
+    MSHADOW_REAL_TYPE_SWITCH(type.dtype, DType, {
+      recv_blob = TBlob(reinterpret_cast<DType*>(data), dshape, cpu::kDevMask);
+    })
+    return NDArray(recv_blob, 0);
+  }
+
+  /**
+   * \brief answers req_meta, or counts key down if the push is part of a fused request
+   */
+  void RespondPush(const ps::KVMeta& req_meta, const int key,
+                   const std::shared_ptr<FusedRequest>& fused,
+                   ps::KVServer<char>* server) {
+    if (fused) {
+      RespondFused(fused, key, server);
+    } else {
+      server->Response(req_meta);
+    }
+  }
+
+  /**
+   * \brief counts key of a fused request down, copying its value if the request
+   * pulls, and answers the request after its last key. Runs on the shard of key.
+   */
+  void RespondFused(const std::shared_ptr<FusedRequest>& fused, const int key,
+                    ps::KVServer<char>* server) {
+    if (fused->meta.pull) {
+      const NDArray& stored = store_[key];
+      CHECK(!stored.is_none()) << "init " << key << " first";
+      stored.WaitToRead();
+      const size_t i = fused->index.at(key);
+      const size_t len = fused->response.lens[i];
+      CHECK_EQ(stored.shape().Size() * mshadow::mshadow_sizeof(stored.dtype()), len);
+      fused->response.vals.segment(fused->offsets[i], fused->offsets[i] + len)
+          .CopyFrom(static_cast<const char*>(stored.data().dptr_), len);
+    }
+    if (--fused->pending == 0) {
+      if (fused->meta.pull) {
+        server->Response(fused->meta, fused->response);
+      } else {
+        server->Response(fused->meta);
+      }
+    }
+  }
+
+  /**
+   * \brief initializes, merges or applies the pushed value of key
+   * \param fused the fused push recved is part of, or null
+   */
+  void DefaultStoragePush(const DataHandleType type, const int key, const NDArray& recved,
+                          const ps::KVMeta& req_meta, const ps::KVPairs<char> &req_data,
+                          const std::shared_ptr<FusedRequest>& fused,
+                          ps::KVServer<char>* server) {
     auto& stored = has_multi_precision_copy(type) ? store_realt_[key] : store_[key];
+    const mxnet::TShape& dshape = recved.shape();
     // there used several WaitToRead, this is because \a recved's memory
     // could be deallocated when this function returns. so we need to make sure
     // the operators with \a NDArray are actually finished
-    if (req_meta.push) {
-      size_t ds[] = {(size_t) req_data.lens[0] / mshadow::mshadow_sizeof(type.dtype)};
-      mxnet::TShape dshape(ds, ds + 1);
-      TBlob recv_blob;
-      MSHADOW_REAL_TYPE_SWITCH(type.dtype, DType, {
-        recv_blob = TBlob(reinterpret_cast<DType*>(req_data.vals.data()), dshape, cpu::kDevMask);
-      })
-      NDArray recved = NDArray(recv_blob, 0);
-      if (stored.is_none()) {
-        // initialization
-        stored = NDArray(dshape, Context(), false,
-                         has_multi_precision_copy(type) ? mshadow::kFloat32 : type.dtype);
-        CopyFromTo(recved, &stored, 0);
-        server->Response(req_meta);
-        if (has_multi_precision_copy(type)) {
-          auto& stored_dtype = store_[key];
-          stored_dtype = NDArray(dshape, Context(), false, type.dtype);
-          CopyFromTo(stored, stored_dtype);
-          stored_dtype.WaitToRead();
-        }
-        stored.WaitToRead();
-      } else {
-        auto &updates = update_buf_[key];
-        if (sync_mode_ && updates.merged.is_none()) {
-          updates.merged = NDArray(dshape, Context(), false,
-                                   has_multi_precision_copy(type) ? mshadow::kFloat32 : type.dtype);
-        }
-        if (has_multi_precision_copy(type) && updates.temp_array.is_none()) {
-          updates.temp_array = NDArray(dshape, Context(), false, mshadow::kFloat32);
-        }
-        if (updates.request.empty()) {
-          if (sync_mode_) {
-            CopyFromTo(recved, updates.merged);
-          } else {
-            if (has_multi_precision_copy(type)) {
-              CopyFromTo(recved, updates.temp_array);
-            } else {
-              updates.temp_array = recved;
-            }
-          }
+    if (stored.is_none()) {
+      // initialization
+      stored = NDArray(dshape, Context(), false,
+                       has_multi_precision_copy(type) ? mshadow::kFloat32 : type.dtype);
+      CopyFromTo(recved, &stored, 0);
+      RespondPush(req_meta, key, fused, server);
+      if (has_multi_precision_copy(type)) {
+        auto& stored_dtype = store_[key];
+        stored_dtype = NDArray(dshape, Context(), false, type.dtype);
+        CopyFromTo(stored, stored_dtype);
+        stored_dtype.WaitToRead();
+      }
+      stored.WaitToRead();
+    } else {
+      auto &updates = update_buf_[key];
+      if (sync_mode_ && updates.merged.is_none()) {
+        updates.merged = NDArray(dshape, Context(), false,
+                                 has_multi_precision_copy(type) ? mshadow::kFloat32 : type.dtype);
+      }
+      if (has_multi_precision_copy(type) && updates.temp_array.is_none()) {
+        updates.temp_array = NDArray(dshape, Context(), false, mshadow::kFloat32);
+      }
+      if (updates.request.empty() && updates.fused_request.empty()) {
+        if (sync_mode_) {
+          CopyFromTo(recved, updates.merged);
         } else {
-          CHECK(sync_mode_);
           if (has_multi_precision_copy(type)) {
             CopyFromTo(recved, updates.temp_array);
-            updates.merged += updates.temp_array;
           } else {
-            updates.merged += recved;
+            updates.temp_array = recved;
           }
         }
+      } else {
+        CHECK(sync_mode_);
+        if (has_multi_precision_copy(type)) {
+          CopyFromTo(recved, updates.temp_array);
+          updates.merged += updates.temp_array;
+        } else {
+          updates.merged += recved;
+        }
+      }
+      if (fused) {
+        updates.fused_request.push_back(fused);
+      } else {
         updates.request.push_back(req_meta);
-        ApplyUpdates(type, key, req_data, &updates, server);
       }
-    } else {
-      DefaultStorageResponse(type, key, req_meta, req_data, server);
+      ApplyUpdates(type, key, req_data, &updates, server);
+    }
+  }
+
+  /**
+   * \brief handles a push, pull or pushpull of several small dense keys in one
+   * message. Each key is handled on its own shard, as if sent alone, and the
+   * answer goes out once all keys are done.
+   */
+  void DataHandleFused(const DataHandleType type, const ps::KVMeta& req_meta,
+                       const ps::KVPairs<char> &req_data,
+                       ps::KVServer<char>* server) {
+    const size_t num_keys = req_data.keys.size();
+    if (req_meta.push) CHECK_EQ(req_data.lens.size(), num_keys);
+    auto fused = std::make_shared<FusedRequest>();
+    fused->meta = req_meta;
+    fused->type = type;
+    fused->pending = num_keys;
+    if (req_meta.pull) {
+      // values of all keys are concatenated in the order of the keys
+      std::vector<int> lens(num_keys);
+      size_t total = 0;
+      for (size_t i = 0; i < num_keys; ++i) {
+        const int key = DecodeKey(req_data.keys[i]);
+        if (req_meta.push) {
+          lens[i] = req_data.lens[i];
+        } else {
+          const NDArray& stored = store_[key];
+          CHECK(!stored.is_none()) << "init " << key << " first";
+          lens[i] = stored.shape().Size() * mshadow::mshadow_sizeof(stored.dtype());
+        }
+        fused->index[key] = i;
+        fused->offsets.push_back(total);
+        total += lens[i];
+      }
+      fused->response.keys = req_data.keys;
+      fused->response.lens.CopyFrom(lens.begin(), lens.end());
+      fused->response.vals.resize(total);
     }
+    size_t offset = 0;
+    for (size_t i = 0; i < num_keys; ++i) {
+      const int key = DecodeKey(req_data.keys[i]);
+      if (req_meta.push) {
+        char* data = req_data.vals.data() + offset;
+        const int len = req_data.lens[i];
+        offset += len;
+        RunOnShard(key, [this, type, key, data, len, req_meta, req_data, fused, server]() {
+          DefaultStoragePush(type, key, RecvDefault(type, data, len), req_meta, req_data,
+                             fused, server);
+        });
+      } else {
+        RunOnShard(key, [this, key, fused, server]() {
+          RespondFused(fused, key, server);
+        });
+      }
+    }
+    if (req_meta.push) CHECK_EQ(offset, req_data.vals.size());
   }
 
   int DecodeKey(ps::Key key) {
@@ -761,27 +1051,39 @@ class KVStoreDistServer {
   bool sync_mode_;
   KVStore::Controller controller_;
   KVStore::Updater updater_;
+  /** \brief whether updater_ may run on the apply shards, see set_updater */
+  bool updater_thread_safe_ = false;
 
   /**
    * \brief store_ contains the value at kvstore for each key
    */
-  std::unordered_map<int, NDArray> store_;
-  std::unordered_map<int, NDArray> store_realt_;
+  KeyMap<NDArray> store_;
+  KeyMap<NDArray> store_realt_;
 
   /**
    * \brief merge_buf_ is a buffer used if sync_mode is true. It represents
    * values from different workers being merged. The store will be updated
    * to this value when values from all workers are pushed into this buffer.
    */
-  std::unordered_map<int, UpdateBuf> update_buf_;
+  KeyMap<UpdateBuf> update_buf_;
 
   /**
    * \brief decomp_buf_ is a buffer into which compressed values are
    * decompressed before merging to the store. used when compress_!='none'
    */
-  std::unordered_map<int, NDArray> decomp_buf_;
+  KeyMap<NDArray> decomp_buf_;
 
   Executor exec_;
+
+  /**
+   * \brief apply shards, requests are sent to shard key % apply_shards_.size().
+   * Empty unless MXNET_KVSTORE_SERVER_APPLY_THREADS is set.
+   */
+  std::vector<std::unique_ptr<Executor>> apply_shards_;
+  std::vector<std::thread> apply_threads_;
+  profiler::ProfileDomain apply_domain_{"KVStoreServer"};
+  std::vector<std::shared_ptr<profiler::ProfileCounter>> apply_depth_counters_;
+
   ps::KVServer<char>* ps_server_;
 
   // whether to LOG verbose information
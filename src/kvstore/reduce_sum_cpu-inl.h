@@ -0,0 +1,146 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2019 by Contributors
+ * \file reduce_sum_cpu-inl.h
+ * \brief vectorized kernels summing several dense CPU arrays into the first one
+ */
+#ifndef MXNET_KVSTORE_REDUCE_SUM_CPU_INL_H_
+#define MXNET_KVSTORE_REDUCE_SUM_CPU_INL_H_
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MXNET_KVSTORE_REDUCE_USE_SSE 1
+#else
+#define MXNET_KVSTORE_REDUCE_USE_SSE 0
+#endif
+#include <mshadow/base.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace mxnet {
+namespace kvstore {
+
+/*! \brief number of elements summed per block by the scalar kernels */
+static constexpr size_t kReduceBlock = 256;
+
+/*!
+ * \brief dptr[0][i] += dptr[1][i] + ... + dptr[n-1][i] for i in [begin, end)
+ *  Generic version, processes blocks source by source so that the compiler
+ *  can vectorize the inner loop.
+ * \param streaming ignored, non-temporal stores are only used for float
+ */
+template<typename DType>
+inline void ReduceSumRange(const std::vector<DType*>& dptr, size_t begin, size_t end,
+                           bool streaming) {
+  DType* out = dptr[0];
+  for (size_t b = begin; b < end; b += kReduceBlock) {
+    const size_t n = std::min(kReduceBlock, end - b);
+    for (size_t k = 1; k < dptr.size(); ++k) {
+      const DType* in = dptr[k] + b;
+      DType* o = out + b;
+      for (size_t j = 0; j < n; ++j) {
+        o[j] += in[j];
+      }
+    }
+  }
+}
+
+/*!
+ * \brief float32 version, all sources are added in registers and the result is
+ *  written once, with non-temporal stores if streaming is set.
+ */
+inline void ReduceSumRange(const std::vector<float*>& dptr, size_t begin, size_t end,
+                           bool streaming) {
+  float* out = dptr[0];
+  const size_t nsrc = dptr.size();
+  size_t i = begin;
+#if MXNET_KVSTORE_REDUCE_USE_SSE
+  // peel until the output is 16-byte aligned
+  for (; i < end && (reinterpret_cast<uintptr_t>(out + i) & 15) != 0; ++i) {
+    float sum = out[i];
+    for (size_t k = 1; k < nsrc; ++k) sum += dptr[k][i];
+    out[i] = sum;
+  }
+  for (; i + 16 <= end; i += 16) {
+    __m128 acc0 = _mm_load_ps(out + i);
+    __m128 acc1 = _mm_load_ps(out + i + 4);
+    __m128 acc2 = _mm_load_ps(out + i + 8);
+    __m128 acc3 = _mm_load_ps(out + i + 12);
+    for (size_t k = 1; k < nsrc; ++k) {
+      const float* in = dptr[k] + i;
+      acc0 = _mm_add_ps(acc0, _mm_loadu_ps(in));
+      acc1 = _mm_add_ps(acc1, _mm_loadu_ps(in + 4));
+      acc2 = _mm_add_ps(acc2, _mm_loadu_ps(in + 8));
+      acc3 = _mm_add_ps(acc3, _mm_loadu_ps(in + 12));
+    }
+    if (streaming) {
+      _mm_stream_ps(out + i, acc0);
+      _mm_stream_ps(out + i + 4, acc1);
+      _mm_stream_ps(out + i + 8, acc2);
+      _mm_stream_ps(out + i + 12, acc3);
+    } else {
+      _mm_store_ps(out + i, acc0);
+      _mm_store_ps(out + i + 4, acc1);
+      _mm_store_ps(out + i + 8, acc2);
+      _mm_store_ps(out + i + 12, acc3);
+    }
+  }
+  if (streaming) {
+    // make the non-temporal stores visible before the engine completes the reduce
+    _mm_sfence();
+  }
+#endif  // MXNET_KVSTORE_REDUCE_USE_SSE
+  for (; i < end; ++i) {
+    float sum = out[i];
+    for (size_t k = 1; k < nsrc; ++k) sum += dptr[k][i];
+    out[i] = sum;
+  }
+}
+
+/*!
+ * \brief float16 version, accumulates in float32 and rounds once per element
+ *  instead of once per addition.
+ */
+inline void ReduceSumRange(const std::vector<mshadow::half::half_t*>& dptr,
+                           size_t begin, size_t end, bool streaming) {
+  using mshadow::half::half_t;
+  float acc[kReduceBlock];
+  half_t* out = dptr[0];
+  for (size_t b = begin; b < end; b += kReduceBlock) {
+    const size_t n = std::min(kReduceBlock, end - b);
+    for (size_t j = 0; j < n; ++j) {
+      acc[j] = static_cast<float>(out[b + j]);
+    }
+    for (size_t k = 1; k < dptr.size(); ++k) {
+      const half_t* in = dptr[k] + b;
+      for (size_t j = 0; j < n; ++j) {
+        acc[j] += static_cast<float>(in[j]);
+      }
+    }
+    for (size_t j = 0; j < n; ++j) {
+      out[b + j] = half_t(acc[j]);
+    }
+  }
+}
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_REDUCE_SUM_CPU_INL_H_
@@ -0,0 +1,132 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2019 by Contributors
+ * \file reduce_sum_rsp_cpu-inl.h
+ * \brief kernels summing several row sparse CPU arrays by merging their sorted row indices
+ */
+#ifndef MXNET_KVSTORE_REDUCE_SUM_RSP_CPU_INL_H_
+#define MXNET_KVSTORE_REDUCE_SUM_RSP_CPU_INL_H_
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace mxnet {
+namespace kvstore {
+
+/*!
+ * \brief split the row id space of k sorted row index arrays into nparts ranges
+ *  of roughly equal number of input rows. Rows with the same id always end up
+ *  in the same range, so the ranges can be merged independently.
+ * \param idx row indices of each input, sorted and unique within an input
+ * \param num_rows number of rows of each input
+ * \param nparts number of ranges
+ * \param bounds output, (nparts + 1) x k positions, range p of input i is
+ *  [bounds[p * k + i], bounds[(p + 1) * k + i])
+ */
+template<typename IType>
+inline void PartitionRowSparse(const std::vector<const IType*>& idx,
+                               const std::vector<size_t>& num_rows,
+                               size_t nparts, std::vector<size_t>* bounds) {
+  const size_t k = idx.size();
+  bounds->assign((nparts + 1) * k, 0);
+  for (size_t i = 0; i < k; ++i) {
+    (*bounds)[nparts * k + i] = num_rows[i];
+  }
+  if (nparts <= 1) return;
+  size_t total = 0;
+  for (size_t i = 0; i < k; ++i) total += num_rows[i];
+  // sample each input with the same stride, so that larger inputs weigh more
+  const size_t stride = std::max<size_t>(1, total / (nparts * 8));
+  std::vector<IType> samples;
+  samples.reserve(total / stride + k);
+  for (size_t i = 0; i < k; ++i) {
+    for (size_t j = stride / 2; j < num_rows[i]; j += stride) {
+      samples.push_back(idx[i][j]);
+    }
+  }
+  if (samples.empty()) return;
+  std::sort(samples.begin(), samples.end());
+  for (size_t p = 1; p < nparts; ++p) {
+    const IType splitter = samples[p * samples.size() / nparts];
+    for (size_t i = 0; i < k; ++i) {
+      (*bounds)[p * k + i] = std::lower_bound(idx[i], idx[i] + num_rows[i], splitter) - idx[i];
+    }
+  }
+}
+
+/*!
+ * \brief k-way merge of range p of the inputs.
+ *  Writes the unique row ids and the summed rows to out_idx and out_val when
+ *  out_idx is not null, otherwise only counts them.
+ * \return number of unique rows in the range
+ */
+template<typename DType, typename IType>
+inline size_t MergeRowSparseRange(const std::vector<const IType*>& idx,
+                                  const std::vector<const DType*>& val,
+                                  const std::vector<size_t>& bounds,
+                                  size_t p, size_t row_length,
+                                  IType* out_idx, DType* out_val) {
+  const size_t k = idx.size();
+  std::vector<size_t> cur(bounds.begin() + p * k, bounds.begin() + (p + 1) * k);
+  const size_t* end = bounds.data() + (p + 1) * k;
+  size_t n = 0;
+  while (true) {
+    // the number of inputs is the number of devices, a linear scan beats a heap
+    bool found = false;
+    IType row = 0;
+    for (size_t i = 0; i < k; ++i) {
+      if (cur[i] < end[i] && (!found || idx[i][cur[i]] < row)) {
+        row = idx[i][cur[i]];
+        found = true;
+      }
+    }
+    if (!found) break;
+    if (out_idx != nullptr) {
+      out_idx[n] = row;
+      DType* out = out_val + n * row_length;
+      bool first = true;
+      for (size_t i = 0; i < k; ++i) {
+        if (cur[i] < end[i] && idx[i][cur[i]] == row) {
+          const DType* in = val[i] + cur[i] * row_length;
+          if (first) {
+            std::memcpy(out, in, row_length * sizeof(DType));
+            first = false;
+          } else {
+            for (size_t j = 0; j < row_length; ++j) {
+              out[j] += in[j];
+            }
+          }
+          ++cur[i];
+        }
+      }
+    } else {
+      for (size_t i = 0; i < k; ++i) {
+        if (cur[i] < end[i] && idx[i][cur[i]] == row) ++cur[i];
+      }
+    }
+    ++n;
+  }
+  return n;
+}
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_REDUCE_SUM_RSP_CPU_INL_H_
@@ -35,6 +35,7 @@
 #include <mkldnn.hpp>
 #endif
 #include "./ndarray_function.h"
+#include "./ndarray_checkpoint.h"
 #include "../common/utils.h"
 #include "../operator/tensor/matrix_op-inl.h"
 #include "../operator/tensor/init_op.h"
@@ -1838,12 +1839,117 @@ void NDArray::Save(dmlc::Stream* fo,
   fo->Write(names);
 }
 
+/*! \brief a copy of nd in default layout on cpu, ready to be written out */
+static NDArray SaveableCPUCopy(const NDArray &nd) {
+  NDArray nd_cpu;
+  if (nd.ctx().dev_mask() != cpu::kDevMask) {
+    nd_cpu = nd.Copy(Context::CPU());
+    nd_cpu.WaitToRead();
+  } else {
+    nd.WaitToRead();
+    nd_cpu = nd;
+#if MXNET_USE_MKLDNN == 1
+    if (nd_cpu.IsMKLDNNData())
+      nd_cpu = nd_cpu.Reorder2Default();
+#endif
+  }
+  return nd_cpu;
+}
+
+/*! \brief move a loaded cpu array to the context it was saved from, as NDArray::Load does */
+static NDArray ToSavedContext(NDArray &&temp, const Context &ctx) {
+#if MXNET_USE_CUDA
+  if (ctx.dev_mask() != cpu::kDevMask) return temp.Copy(ctx);
+#endif
+  return std::move(temp);
+}
+
+/*!
+ * \brief read the index of a chunked file
+ * \return the flags, or -1 if the index is malformed
+ */
+static int64_t LoadChunkedIndex(dmlc::Stream *fi, uint64_t *index_size, uint64_t *checksum_offset,
+                                std::vector<ndarray::ChunkEntry> *entries) {
+  uint64_t flags, count;
+  if (!fi->Read(&flags) || !fi->Read(index_size) || !fi->Read(checksum_offset) ||
+      !fi->Read(&count)) {
+    return -1;
+  }
+  entries->resize(count);
+  for (auto &entry : *entries) {
+    if (!entry.Load(fi)) return -1;
+  }
+  return flags;
+}
+
+/*! \brief read a chunked file from a stream, after its magic */
+static void LoadChunked(dmlc::Stream *fi, std::vector<NDArray> *data,
+                        std::vector<std::string> *keys) {
+  using namespace ndarray;
+  uint64_t index_size, checksum_offset;
+  std::vector<ChunkEntry> entries;
+  const int64_t flags = LoadChunkedIndex(fi, &index_size, &checksum_offset, &entries);
+  CHECK_GE(flags, 0) << "Invalid NDArray file format";
+  // position in the file, the header is four uint64
+  uint64_t pos = 4 * sizeof(uint64_t) + index_size;
+  std::string skipped;
+  auto skip_to = [&](uint64_t offset) {
+    CHECK_GE(offset, pos) << "Invalid NDArray file format";
+    skipped.resize(offset - pos);
+    CHECK_EQ(fi->Read(&skipped[0], skipped.size()), skipped.size())
+        << "Invalid NDArray file format";
+    pos = offset;
+  };
+  std::vector<uint64_t> checksums(entries.size());
+  data->resize(entries.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const ChunkEntry &entry = entries[i];
+    skip_to(entry.offset);
+    if (entry.kind == kChunkRaw) {
+      NDArray temp(entry.shape, Context::CPU(), false, entry.dtype);
+      CHECK_EQ(temp.shape().Size() * mshadow::mshadow_sizeof(entry.dtype), entry.nbytes)
+          << "Invalid NDArray file format";
+      void *dptr = temp.data().dptr_;
+      CHECK_EQ(fi->Read(dptr, entry.nbytes), entry.nbytes) << "Invalid NDArray file format";
+      if (flags & kChunkHasChecksum) checksums[i] = Checksum64(dptr, entry.nbytes);
+      (*data)[i] = ToSavedContext(std::move(temp),
+                                  Context::Create(static_cast<Context::DeviceType>(entry.dev_type),
+                                                  entry.dev_id));
+    } else {
+      std::string buf(entry.nbytes, '\0');
+      CHECK_EQ(fi->Read(&buf[0], buf.size()), buf.size()) << "Invalid NDArray file format";
+      if (flags & kChunkHasChecksum) checksums[i] = Checksum64(buf.data(), buf.size());
+      dmlc::MemoryStringStream strm(&buf);
+      CHECK((*data)[i].Load(&strm)) << "Invalid NDArray file format";
+    }
+    pos += entry.nbytes;
+  }
+  if (flags & kChunkHasChecksum) {
+    skip_to(checksum_offset);
+    std::vector<uint64_t> expected(entries.size());
+    CHECK_EQ(fi->Read(expected.data(), expected.size() * sizeof(uint64_t)),
+             expected.size() * sizeof(uint64_t)) << "Invalid NDArray file format";
+    for (size_t i = 0; i < entries.size(); ++i) {
+      CHECK_EQ(checksums[i], expected[i]) << "Checksum mismatch of array " << i
+                                          << " " << entries[i].name;
+    }
+  }
+  keys->clear();
+  if (flags & kChunkHasNames) {
+    for (const auto &entry : entries) keys->push_back(entry.name);
+  }
+}
+
 void NDArray::Load(dmlc::Stream* fi,
                    std::vector<NDArray>* data,
                    std::vector<std::string>* keys) {
   uint64_t header, reserved;
   CHECK(fi->Read(&header))
       << "Invalid NDArray file format";
+  if (header == ndarray::kChunkedMagic) {
+    LoadChunked(fi, data, keys);
+    return;
+  }
   CHECK(fi->Read(&reserved))
       << "Invalid NDArray file format";
   CHECK(header == kMXAPINDArrayListMagic)
@@ -1856,6 +1962,185 @@ void NDArray::Load(dmlc::Stream* fi,
       << "Invalid NDArray file format";
 }
 
+void NDArray::SaveChunked(dmlc::Stream* fo,
+                          const std::vector<NDArray>& data,
+                          const std::vector<std::string>& names,
+                          bool checksum) {
+  using namespace ndarray;
+  CHECK(names.size() == 0 || names.size() == data.size())
+      << "number of names does not match number of arrays";
+  std::vector<ChunkEntry> entries(data.size());
+  std::vector<std::string> serialized(data.size());
+  for (size_t i = 0; i < data.size(); ++i) {
+    const NDArray &nd = data[i];
+    ChunkEntry &entry = entries[i];
+    if (names.size() != 0) entry.name = names[i];
+    entry.offset = 0;
+    if (!nd.is_none() && nd.storage_type() == kDefaultStorage && shape_is_known(nd.shape())) {
+      entry.kind = kChunkRaw;
+      entry.dtype = nd.dtype();
+      entry.dev_type = nd.ctx().dev_type;
+      entry.dev_id = nd.ctx().dev_id;
+      entry.shape = nd.shape();
+      entry.nbytes = nd.shape().Size() * mshadow::mshadow_sizeof(nd.dtype());
+    } else {
+      // sparse and empty arrays keep their usual serialization
+      dmlc::MemoryStringStream strm(&serialized[i]);
+      nd.Save(&strm);
+      entry.kind = kChunkSerialized;
+      entry.dtype = entry.dev_type = entry.dev_id = 0;
+      entry.nbytes = serialized[i].size();
+    }
+  }
+  // the entries are fixed width, so the index can be sized before the offsets are known
+  std::string index;
+  auto write_index = [&]() {
+    index.clear();
+    dmlc::MemoryStringStream strm(&index);
+    uint64_t count = entries.size();
+    strm.Write(count);
+    for (const auto &entry : entries) entry.Save(&strm);
+  };
+  write_index();
+  uint64_t pos = 4 * sizeof(uint64_t) + index.size();
+  for (auto &entry : entries) {
+    entry.offset = ChunkAlignUp(pos);
+    pos = entry.offset + entry.nbytes;
+  }
+  const uint64_t checksum_offset = ChunkAlignUp(pos);
+  write_index();
+
+  const uint64_t flags = (checksum ? kChunkHasChecksum : 0) |
+                         (names.size() != 0 ? kChunkHasNames : 0);
+  const uint64_t index_size = index.size();
+  fo->Write(kChunkedMagic);
+  fo->Write(flags);
+  fo->Write(index_size);
+  fo->Write(checksum_offset);
+  fo->Write(index.data(), index.size());
+  pos = 4 * sizeof(uint64_t) + index.size();
+  const char zeros[kChunkAlign] = {0};
+  auto pad_to = [&](uint64_t offset) {
+    fo->Write(zeros, offset - pos);
+    pos = offset;
+  };
+  std::vector<uint64_t> checksums(data.size());
+  for (size_t i = 0; i < data.size(); ++i) {
+    pad_to(entries[i].offset);
+    if (entries[i].kind == kChunkRaw) {
+      // one array at a time on cpu, like Save
+      NDArray nd_cpu = SaveableCPUCopy(data[i]);
+      TBlob save_data = nd_cpu.data();
+      CHECK(save_data.CheckContiguous());
+      fo->Write(save_data.dptr_, entries[i].nbytes);
+      if (checksum) checksums[i] = Checksum64(save_data.dptr_, entries[i].nbytes);
+    } else {
+      fo->Write(serialized[i].data(), serialized[i].size());
+      if (checksum) checksums[i] = Checksum64(serialized[i].data(), serialized[i].size());
+    }
+    pos += entries[i].nbytes;
+  }
+  if (checksum) {
+    pad_to(checksum_offset);
+    fo->Write(checksums.data(), checksums.size() * sizeof(uint64_t));
+  }
+}
+
+void NDArray::LoadFile(const std::string& fname,
+                       const std::vector<Context>& ctxs,
+                       bool verify,
+                       std::vector<NDArray>* data,
+                       std::vector<std::string>* keys) {
+  using namespace ndarray;
+  std::vector<NDArray> loaded;
+  bool mapped = false;
+#if !defined(_WIN32)
+  std::string path = fname;
+  if (path.compare(0, 7, "file://") == 0) path = path.substr(7);
+  uint64_t magic = 0;
+  if (path.find("://") == std::string::npos) {
+    std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(path.c_str(), "r"));
+    mapped = fi->Read(&magic) && magic == kChunkedMagic;
+  }
+  if (mapped) {
+    auto file = std::make_shared<MappedFile>(path);
+    dmlc::MemoryFixedSizeStream strm(file->data(), file->size());
+    uint64_t index_size, checksum_offset;
+    std::vector<ChunkEntry> entries;
+    CHECK(strm.Read(&magic));
+    const int64_t flags = LoadChunkedIndex(&strm, &index_size, &checksum_offset, &entries);
+    CHECK_GE(flags, 0) << "Invalid NDArray file format";
+    for (const auto &entry : entries) {
+      CHECK_LE(entry.offset + entry.nbytes, file->size()) << "Invalid NDArray file format";
+    }
+    // arrays used in place on the CPU are faulted in row by row as they are read,
+    // so a table larger than memory is left to the page cache; everything else
+    // is about to be read in full, let the kernel fetch ahead
+    const bool copied = std::any_of(ctxs.begin(), ctxs.end(), [](const Context &ctx) {
+      return ctx != Context::CPU();
+    });
+    if (copied || verify) file->WillNeed();
+    if (verify && (flags & kChunkHasChecksum)) {
+      CHECK_LE(checksum_offset + entries.size() * sizeof(uint64_t), file->size())
+          << "Invalid NDArray file format";
+      const uint64_t *expected = reinterpret_cast<const uint64_t*>(file->data() + checksum_offset);
+      std::vector<uint8_t> ok(entries.size());
+      #pragma omp parallel for schedule(dynamic)
+      for (int64_t i = 0; i < static_cast<int64_t>(entries.size()); ++i) {
+        ok[i] = Checksum64(file->data() + entries[i].offset, entries[i].nbytes) == expected[i];
+      }
+      for (size_t i = 0; i < entries.size(); ++i) {
+        CHECK(ok[i]) << "Checksum mismatch of array " << i << " " << entries[i].name;
+      }
+    }
+    loaded.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+      const ChunkEntry &entry = entries[i];
+      if (entry.kind == kChunkRaw) {
+        CHECK_EQ(entry.shape.Size() * mshadow::mshadow_sizeof(entry.dtype), entry.nbytes)
+            << "Invalid NDArray file format";
+        // the array keeps the mapping alive
+        TBlob blob(static_cast<void*>(file->data() + entry.offset), entry.shape,
+                   cpu::kDevMask, entry.dtype, 0);
+        NDArray temp(blob, 0, [file]() {});
+        loaded[i] = ctxs.empty() ?
+            ToSavedContext(std::move(temp),
+                           Context::Create(static_cast<Context::DeviceType>(entry.dev_type),
+                                           entry.dev_id)) :
+            temp;
+      } else {
+        dmlc::MemoryFixedSizeStream array_strm(file->data() + entry.offset, entry.nbytes);
+        CHECK(loaded[i].Load(&array_strm)) << "Invalid NDArray file format";
+      }
+    }
+    keys->clear();
+    if (flags & kChunkHasNames) {
+      for (const auto &entry : entries) keys->push_back(entry.name);
+    }
+  }
+#endif  // !defined(_WIN32)
+  if (!mapped) {
+    std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(fname.c_str(), "r"));
+    Load(fi.get(), &loaded, keys);
+  }
+  if (ctxs.empty()) {
+    *data = std::move(loaded);
+    return;
+  }
+  // the copies are pushed to the engine, which runs them for all devices at once
+  data->clear();
+  data->reserve(ctxs.size() * loaded.size());
+  for (const Context &ctx : ctxs) {
+    for (const NDArray &nd : loaded) {
+      if (nd.is_none() || nd.ctx() == ctx) {
+        data->push_back(nd);
+      } else {
+        data->push_back(nd.Copy(ctx));
+      }
+    }
+  }
+}
+
 NDArray NDArray::Copy(Context ctx) const {
   NDArray ret;
   if (kDefaultStorage == storage_type()) {
@@ -1871,6 +2156,18 @@ NDArray NDArray::Copy(Context ctx) const {
   return ret;
 }
 
+void NDArray::SetStaticDataPtr(void *data) const {
+  CHECK(!is_none() && ptr_->static_data)
+      << "SetStaticDataPtr is only supported on NDArrays created from a TBlob";
+  CHECK_EQ(storage_type(), kDefaultStorage);
+  CHECK_EQ(byte_offset_, 0U);
+  this->WaitToWrite();
+  ptr_->shandle.dptr = data;
+#if MXNET_USE_MKLDNN == 1
+  ptr_->mkl_mem_ = nullptr;
+#endif
+}
+
 void NDArray::SyncCopyFromCPU(const void *data, size_t size) const {
   mxnet::TShape dshape = this->shape();
   CHECK_EQ(dshape.Size(), size)
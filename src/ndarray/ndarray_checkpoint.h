@@ -0,0 +1,214 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2019 by Contributors
+ * \file ndarray_checkpoint.h
+ * \brief layout of the chunked NDArray list format and helpers to read it
+ *
+ * A chunked file is
+ *   uint64 magic, uint64 flags, uint64 index size, uint64 checksum table offset,
+ *   the index: uint64 count followed by one ChunkEntry per array,
+ *   the payloads, each starting at a multiple of kChunkAlign from the file start,
+ *   and, with kChunkHasChecksum, one uint64 Checksum64 per payload at an aligned offset.
+ * Payloads of dense arrays are their raw bytes, so they can be used in place
+ * from a memory mapped file; other arrays are stored the way NDArray::Save writes them.
+ */
+#ifndef MXNET_NDARRAY_NDARRAY_CHECKPOINT_H_
+#define MXNET_NDARRAY_NDARRAY_CHECKPOINT_H_
+
+#include <dmlc/io.h>
+#include <dmlc/logging.h>
+#include <mxnet/tuple.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../common/mapped_region.h"
+
+namespace mxnet {
+namespace ndarray {
+/*! \brief magic of the chunked format, following the 0x112 of the NDArray list format */
+const uint64_t kChunkedMagic = 0x113;
+/*! \brief alignment of payloads from the file start */
+const uint64_t kChunkAlign = 64;
+/*! \brief file flags */
+enum ChunkFlag {
+  kChunkHasChecksum = 1,
+  kChunkHasNames = 2
+};
+/*! \brief how a payload is stored */
+enum ChunkKind {
+  /*! \brief raw bytes of a dense array */
+  kChunkRaw = 0,
+  /*! \brief bytes written by NDArray::Save */
+  kChunkSerialized = 1
+};
+
+/*! \brief index entry of one array */
+struct ChunkEntry {
+  std::string name;
+  int32_t kind;
+  int32_t dtype;
+  int32_t dev_type;
+  int32_t dev_id;
+  mxnet::TShape shape;
+  /*! \brief payload offset from the file start */
+  uint64_t offset;
+  uint64_t nbytes;
+
+  inline void Save(dmlc::Stream *strm) const {
+    strm->Write(name);
+    strm->Write(&kind, sizeof(kind));
+    strm->Write(&dtype, sizeof(dtype));
+    strm->Write(&dev_type, sizeof(dev_type));
+    strm->Write(&dev_id, sizeof(dev_id));
+    // fixed width, so the index size does not depend on the offsets
+    int32_t ndim = shape.ndim();
+    strm->Write(&ndim, sizeof(ndim));
+    for (int i = 0; i < ndim; ++i) {
+      int64_t dim = shape[i];
+      strm->Write(&dim, sizeof(dim));
+    }
+    strm->Write(&offset, sizeof(offset));
+    strm->Write(&nbytes, sizeof(nbytes));
+  }
+
+  inline bool Load(dmlc::Stream *strm) {
+    int32_t ndim;
+    if (!strm->Read(&name) ||
+        strm->Read(&kind, sizeof(kind)) != sizeof(kind) ||
+        strm->Read(&dtype, sizeof(dtype)) != sizeof(dtype) ||
+        strm->Read(&dev_type, sizeof(dev_type)) != sizeof(dev_type) ||
+        strm->Read(&dev_id, sizeof(dev_id)) != sizeof(dev_id) ||
+        strm->Read(&ndim, sizeof(ndim)) != sizeof(ndim)) {
+      return false;
+    }
+    if (ndim < 0) return false;
+    std::vector<int64_t> dims(ndim);
+    if (strm->Read(dims.data(), ndim * sizeof(int64_t)) != ndim * sizeof(int64_t)) return false;
+    shape = mxnet::TShape(dims.begin(), dims.end());
+    return strm->Read(&offset, sizeof(offset)) == sizeof(offset) &&
+           strm->Read(&nbytes, sizeof(nbytes)) == sizeof(nbytes);
+  }
+};
+
+/*! \brief round x up to the payload alignment */
+inline uint64_t ChunkAlignUp(uint64_t x) {
+  return (x + kChunkAlign - 1) / kChunkAlign * kChunkAlign;
+}
+
+inline uint64_t ChecksumRotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t ChecksumRound(uint64_t acc, uint64_t v) {
+  acc += v * 14029467366897019727ULL;
+  return ChecksumRotl(acc, 31) * 11400714785074694791ULL;
+}
+
+/*!
+ * \brief 64 bit checksum of a payload, reading four independent 8 byte lanes
+ *  so it runs near memory bandwidth
+ */
+inline uint64_t Checksum64(const void *data, size_t size) {
+  const uint64_t kPrime1 = 11400714785074694791ULL;
+  const uint64_t kPrime2 = 14029467366897019727ULL;
+  const uint64_t kPrime3 = 1609587929392839161ULL;
+  const char *p = static_cast<const char*>(data);
+  const char *end = p + size;
+  uint64_t lanes[4] = {kPrime1 + kPrime2, kPrime2, 0, 0 - kPrime1};
+  for (; end - p >= 32; p += 32) {
+    for (int k = 0; k < 4; ++k) {
+      uint64_t v;
+      std::memcpy(&v, p + 8 * k, sizeof(v));
+      lanes[k] = ChecksumRound(lanes[k], v);
+    }
+  }
+  uint64_t h = size;
+  for (int k = 0; k < 4; ++k) {
+    h = (h ^ ChecksumRound(0, lanes[k])) * kPrime1 + kPrime3;
+  }
+  for (; end - p >= 8; p += 8) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    h = ChecksumRotl(h ^ ChecksumRound(0, v), 27) * kPrime1 + kPrime3;
+  }
+  for (; p != end; ++p) {
+    h = ChecksumRotl(h ^ (static_cast<uint8_t>(*p) * kPrime3), 11) * kPrime1;
+  }
+  h ^= h >> 33;
+  h *= kPrime2;
+  h ^= h >> 29;
+  h *= kPrime3;
+  h ^= h >> 32;
+  return h;
+}
+
+#if !defined(_WIN32)
+/*!
+ * \brief private, writable mapping of a whole file; writes to the mapping
+ *  stay in memory
+ */
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string &path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    CHECK_NE(fd, -1) << "Failed to open " << path << ": " << strerror(errno);
+    struct stat st;
+    CHECK_EQ(fstat(fd, &st), 0) << "Failed to stat " << path << ": " << strerror(errno);
+    size_ = st.st_size;
+    if (size_ != 0) {
+      data_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+      CHECK(data_ != MAP_FAILED) << "Failed to map " << path << ": " << strerror(errno);
+      common::MappedRegistry::Get()->Add(data(), size_);
+    }
+    close(fd);
+  }
+  ~MappedFile() {
+    if (data_ == nullptr) return;
+    common::MappedRegistry::Get()->Remove(data());
+    munmap(data_, size_);
+  }
+  /*! \brief start reading the whole file in the background */
+  inline void WillNeed() {
+    if (data_ != nullptr) madvise(data_, size_, MADV_WILLNEED);
+  }
+  inline char *data() const {
+    return static_cast<char*>(data_);
+  }
+  inline size_t size() const {
+    return size_;
+  }
+
+ private:
+  void *data_{nullptr};
+  size_t size_{0};
+};
+#endif  // !defined(_WIN32)
+}  // namespace ndarray
+}  // namespace mxnet
+#endif  // MXNET_NDARRAY_NDARRAY_CHECKPOINT_H_
@@ -28,7 +28,12 @@
 #include <nnvm/op_attr_types.h>
 #include <nnvm/top/tensor.h>
 #include <mxnet/base.h>
+#include <algorithm>
+#include <limits>
+#include <map>
 #include <memory>
+#include <utility>
+#include <vector>
 #include "graph_algorithm.h"
 #include "../operator/operator_common.h"
 
@@ -77,40 +82,15 @@ class GraphAllocator {
   // request a free storage
   StorageID Request(int dev_id, int dtype, mxnet::TShape shape, uint32_t node_id) {
     if (!mxnet::shape_is_known(shape)) return kBadStorageID;
-    // search memory block in [size / match_range_, size * match_range_)
-    // TODO(tqchen) add size of the dtype, assume 4 bytes for now
-    size_t size = shape.Size() * 4;
-    if (match_range_ == 0) return this->Alloc(dev_id, size);
-    auto begin = free_.lower_bound(size / match_range_);
-    auto mid = free_.lower_bound(size);
-    auto end = free_.upper_bound(size * match_range_);
-    // search for memory blocks larger than requested
-    for (auto it = mid; it != end; ++it) {
-      StorageEntry *e = it->second;
-      if (e->device_id != dev_id) continue;
-      if (node_color_.size() != 0 &&
-          node_color_[e->released_by_node] != node_color_[node_id]) continue;
-      // Use exect matching strategy
-      e->max_bytes = std::max(size, e->max_bytes);
-      // find a exact match, erase from map and return
-      free_.erase(it);
-      return e->id;
-    }
-    // then search for memory blocks smaller than requested space
-    for (auto it = mid; it != begin;) {
-      --it;
-      StorageEntry *e = it->second;
-      if (e->device_id != dev_id) continue;
-      if (node_color_.size() != 0 &&
-          node_color_[e->released_by_node] != node_color_[node_id]) continue;
-      // Use exect matching strategy
-      e->max_bytes = std::max(size, e->max_bytes);
-      // erase from map and return
-      free_.erase(it);
-      return e->id;
-    }
-    // cannot find anything return a new one.
-    return this->Alloc(dev_id, size);
+    // exact size in bytes, assume 4 bytes per element when the dtype is unknown
+    size_t size = shape.Size() * (dtype < 0 ? 4 : GetDTypeSize(dtype));
+    StorageEntry *e = this->Match(dev_id, size, node_id);
+    if (e == nullptr) e = this->Alloc(dev_id, size);
+    e->max_bytes = std::max(size, e->max_bytes);
+    // the entry holds the new data until it is released
+    e->lease = leases_.size();
+    leases_.push_back(Lease{dev_id, size, node_id, std::numeric_limits<uint32_t>::max()});
+    return e->id;
   }
   // release a memory space.
   void Release(StorageID id, uint32_t node_id) {
@@ -118,6 +98,7 @@ class GraphAllocator {
     if (id == kExternalStorageID || id == kDynamicStorageID) return;
     StorageEntry *e = data_[id].get();
     e->released_by_node = node_id;
+    leases_[e->lease].end = node_id;
     free_.insert({e->max_bytes, e});
   }
 
@@ -130,6 +111,61 @@ class GraphAllocator {
     return total;
   }
 
+  /*!
+   * \brief Pack the data held over the graph into one arena per device, by offsets.
+   *  Greedy by size: the largest data first, each at the best fitting offset that no
+   *  data alive at the same time overlaps.
+   * \param offsets byte offset of every storage entry in the arena of its device, only
+   *  meaningful if no entry is reused, as an entry has a single offset
+   * \return total bytes of the arenas
+   */
+  size_t PackArena(std::vector<size_t> *offsets) const {
+    std::vector<size_t> lease_offset(leases_.size(), 0);
+    std::vector<size_t> order(leases_.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+      return leases_[a].bytes > leases_[b].bytes;
+    });
+    std::map<int, size_t> arena_bytes;
+    std::vector<size_t> placed;
+    std::vector<std::pair<size_t, size_t> > busy;
+    for (size_t i : order) {
+      const Lease &l = leases_[i];
+      const size_t bytes = AlignArena(l.bytes);
+      busy.clear();
+      for (size_t j : placed) {
+        const Lease &o = leases_[j];
+        if (o.dev_id == l.dev_id && o.start <= l.end && l.start <= o.end) {
+          busy.emplace_back(lease_offset[j], lease_offset[j] + AlignArena(o.bytes));
+        }
+      }
+      std::sort(busy.begin(), busy.end());
+      // smallest gap between live data that fits, else past all of them
+      size_t offset = 0, best = std::numeric_limits<size_t>::max();
+      size_t best_gap = std::numeric_limits<size_t>::max();
+      for (const auto &b : busy) {
+        if (b.first >= offset + bytes && b.first - offset < best_gap) {
+          best = offset;
+          best_gap = b.first - offset;
+        }
+        offset = std::max(offset, b.second);
+      }
+      if (best == std::numeric_limits<size_t>::max()) best = offset;
+      lease_offset[i] = best;
+      placed.push_back(i);
+      arena_bytes[l.dev_id] = std::max(arena_bytes[l.dev_id], best + bytes);
+    }
+    if (offsets != nullptr) {
+      offsets->resize(data_.size());
+      for (size_t sid = 0; sid < data_.size(); ++sid) {
+        (*offsets)[sid] = lease_offset[data_[sid]->lease];
+      }
+    }
+    size_t total = 0;
+    for (const auto &kv : arena_bytes) total += kv.second;
+    return total;
+  }
+
   // constructor
   explicit GraphAllocator(const IndexedGraph* idx, const size_t match_range) : idx_(idx) {
     this->Init(match_range, dmlc::GetEnv("NNVM_EXEC_NUM_TEMP", 1));
@@ -151,15 +187,6 @@ class GraphAllocator {
     }
   }
 
-  StorageID Alloc(int dev_id, size_t size) {
-    StorageID id = static_cast<StorageID>(data_.size());
-    std::unique_ptr<StorageEntry> ptr(new StorageEntry());
-    ptr->id = id;
-    ptr->device_id = dev_id;
-    ptr->max_bytes = size;
-    data_.emplace_back(std::move(ptr));
-    return id;
-  }
   // internal storage entry
   struct StorageEntry {
     // the id of the entry.
@@ -170,7 +197,62 @@ class GraphAllocator {
     size_t max_bytes{0};
     // node index that released it last time
     uint32_t released_by_node{0};
+    // the lease of its current data
+    size_t lease{0};
+  };
+  // alignment of the data in an arena, in bytes
+  static const size_t kArenaAlignment = 64;
+  // data held by a storage entry from the node requesting it to the node releasing it
+  struct Lease {
+    int dev_id;
+    size_t bytes;
+    uint32_t start;
+    uint32_t end;
   };
+  // find a released storage entry to reuse, nullptr if there is none
+  StorageEntry *Match(int dev_id, size_t size, uint32_t node_id) {
+    // search memory block in [size / match_range_, size * match_range_)
+    if (match_range_ == 0) return nullptr;
+    auto begin = free_.lower_bound(size / match_range_);
+    auto mid = free_.lower_bound(size);
+    auto end = free_.upper_bound(size * match_range_);
+    // search for memory blocks larger than requested
+    for (auto it = mid; it != end; ++it) {
+      StorageEntry *e = it->second;
+      if (e->device_id != dev_id) continue;
+      if (node_color_.size() != 0 &&
+          node_color_[e->released_by_node] != node_color_[node_id]) continue;
+      // find a exact match, erase from map and return
+      free_.erase(it);
+      return e;
+    }
+    // then search for memory blocks smaller than requested space
+    for (auto it = mid; it != begin;) {
+      --it;
+      StorageEntry *e = it->second;
+      if (e->device_id != dev_id) continue;
+      if (node_color_.size() != 0 &&
+          node_color_[e->released_by_node] != node_color_[node_id]) continue;
+      // erase from map and return
+      free_.erase(it);
+      return e;
+    }
+    return nullptr;
+  }
+
+  StorageEntry *Alloc(int dev_id, size_t size) {
+    StorageID id = static_cast<StorageID>(data_.size());
+    std::unique_ptr<StorageEntry> ptr(new StorageEntry());
+    ptr->id = id;
+    ptr->device_id = dev_id;
+    ptr->max_bytes = size;
+    data_.emplace_back(std::move(ptr));
+    return data_.back().get();
+  }
+  // size of data in the arena, rounded up so that every offset is aligned
+  static size_t AlignArena(size_t bytes) {
+    return (bytes + kArenaAlignment - 1) / kArenaAlignment * kArenaAlignment;
+  }
   // scale used for rough match
   size_t match_range_;
   // whether use color based match algorithm
@@ -181,6 +263,8 @@ class GraphAllocator {
   std::multimap<size_t, StorageEntry*> free_;
   // all the storage resources available
   std::vector<std::unique_ptr<StorageEntry> > data_;
+  // every request of storage, in order
+  std::vector<Lease> leases_;
   // color of nodes in the graph, used for auxiliary policy making.
   std::vector<uint32_t> node_color_;
   // internal indexed graph
@@ -369,24 +453,27 @@ Graph PlanMemory(Graph ret) {
     storage.resize(idx.num_node_entries(), -1);
   }
 
+  // With an arena, data share memory through offsets rather than storage ids
+  const bool arena = ret.attrs.count("memory_arena") != 0;
   // Search the best NNVM_EXEC_MATCH_RANGE parameter. This is turned off by default
   size_t min_allocated_bytes = -1;
-  size_t max_match_range = dmlc::GetEnv("NNVM_EXEC_MATCH_RANGE", 16);
-  size_t min_match_range =
+  size_t max_match_range = arena ? 0 : dmlc::GetEnv("NNVM_EXEC_MATCH_RANGE", 16);
+  size_t min_match_range = !arena &&
          dmlc::GetEnv("NNVM_AUTO_SEARCH_MATCH_RANGE", false) ? 1 : max_match_range;
+  std::unique_ptr<GraphAllocator> best_allocator;
   for (size_t match_range = min_match_range; match_range <= max_match_range; match_range *= 2) {
     // Make a copy of related fields
     StorageVector storage_vec(storage);
     std::vector<int> storage_inplace_index(idx.num_node_entries(), -1);
 
     // the allocator
-    GraphAllocator allocator(&idx, match_range);
+    std::unique_ptr<GraphAllocator> allocator(new GraphAllocator(&idx, match_range));
 
     // number of entries that are not statically allocated.
     size_t storage_num_not_allocated =
       AllocMemory(ret, idx, node_range, &storage_vec, &storage_inplace_index,
-                  ref_count, &allocator);
-    size_t storage_allocated_bytes = allocator.TotalAllocBytes();
+                  ref_count, allocator.get());
+    size_t storage_allocated_bytes = allocator->TotalAllocBytes();
 
     // Choose the plan which leads to minimal memory usage
     if (min_allocated_bytes > storage_allocated_bytes) {
@@ -395,12 +482,28 @@ Graph PlanMemory(Graph ret) {
       ret.attrs["storage_allocated_bytes"] = std::make_shared<any>(storage_allocated_bytes);
       ret.attrs["storage_num_not_allocated"] = std::make_shared<any>(storage_num_not_allocated);
       min_allocated_bytes = storage_allocated_bytes;
+      best_allocator = std::move(allocator);
     }
 
     if (max_match_range == 0) {
       break;
     }
   }
+  // Packing is quadratic in the number of data, so the chosen plan is only packed for an
+  // arena, or to report what the same data take once packed when the plan is logged.
+  if (best_allocator != nullptr &&
+      (arena || dmlc::GetEnv("MXNET_MEM_PLAN_VERBOSE_LOGGING", false))) {
+    std::vector<size_t> storage_offset;
+    size_t storage_planned_bytes =
+        best_allocator->PackArena(arena ? &storage_offset : nullptr);
+    ret.attrs["storage_planned_bytes"] = std::make_shared<any>(storage_planned_bytes);
+    if (arena) {
+      ret.attrs["storage_offset"] = std::make_shared<any>(std::move(storage_offset));
+    }
+  } else {
+    ret.attrs.erase("storage_planned_bytes");
+    ret.attrs.erase("storage_offset");
+  }
   return ret;
 }
 
@@ -411,7 +514,8 @@ NNVM_REGISTER_PASS(MXPlanMemory)
 .depend_graph_attr("dtype")
 .depend_graph_attr("shape")
 .provide_graph_attr("storage_id")
-.provide_graph_attr("storage_inplace_index");
+.provide_graph_attr("storage_inplace_index")
+.provide_graph_attr("storage_planned_bytes");
 
 }  // namespace
 }  // namespace pass
@@ -0,0 +1,248 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2019 by Contributors
+ * \file embedding_update.cc
+ * \brief Embedding backward fused with sparse optimizer updates of the weight
+ */
+#include <vector>
+#include "../optimizer_op-inl.h"
+#include "../tensor/indexing_op.h"
+
+namespace mxnet {
+namespace op {
+
+namespace embedding_update {
+enum EmbeddingUpdateInputs {kWeight, kData, kGrad, kHistory};
+}  // namespace embedding_update
+
+/*!
+ * \brief Shape inference of the fused updates: weight is (input_dim, output_dim),
+ *  grad is data.shape + (output_dim,) and history, if any, is shaped like weight
+ */
+inline bool EmbeddingUpdateShape(const nnvm::NodeAttrs& attrs,
+                                 mxnet::ShapeVector *in_attrs,
+                                 mxnet::ShapeVector *out_attrs) {
+  using namespace embedding_update;
+  CHECK_EQ(out_attrs->size(), 1U);
+  SHAPE_ASSIGN_CHECK(*out_attrs, 0, in_attrs->at(kWeight));
+  SHAPE_ASSIGN_CHECK(*in_attrs, kWeight, out_attrs->at(0));
+  if (in_attrs->size() > kHistory) {
+    SHAPE_ASSIGN_CHECK(*in_attrs, kHistory, out_attrs->at(0));
+    SHAPE_ASSIGN_CHECK(*out_attrs, 0, in_attrs->at(kHistory));
+  }
+  const mxnet::TShape& wshape = out_attrs->at(0);
+  const mxnet::TShape& dshape = in_attrs->at(kData);
+  if (!shape_is_known(wshape) || !mxnet::ndim_is_known(dshape)) return false;
+  CHECK_EQ(wshape.ndim(), 2) << "weight must be 2D, (input_dim, output_dim)";
+  mxnet::TShape gshape(dshape.ndim() + 1, -1);
+  for (int i = 0; i < dshape.ndim(); ++i) gshape[i] = dshape[i];
+  gshape[dshape.ndim()] = wshape[1];
+  SHAPE_ASSIGN_CHECK(*in_attrs, kGrad, gshape);
+  return shape_is_known(in_attrs->at(kData));
+}
+
+inline bool EmbeddingUpdateType(const nnvm::NodeAttrs& attrs,
+                                std::vector<int> *in_attrs,
+                                std::vector<int> *out_attrs) {
+  using namespace embedding_update;
+  CHECK_EQ(out_attrs->size(), 1U);
+  // the weight, the gradient and the history share a type, the indices have their own
+  std::vector<int> shared{kWeight, kGrad};
+  if (in_attrs->size() > kHistory) shared.push_back(kHistory);
+  int dtype = out_attrs->at(0);
+  for (int i : shared) {
+    if (in_attrs->at(i) != -1) dtype = in_attrs->at(i);
+  }
+  if (dtype == -1) return false;
+  TYPE_ASSIGN_CHECK(*out_attrs, 0, dtype);
+  for (int i : shared) TYPE_ASSIGN_CHECK(*in_attrs, i, dtype);
+  return in_attrs->at(kData) != -1;
+}
+
+/*!
+ * \brief sum the gradient rows the indices in data hit and hand every sum to
+ *  update, in parallel over the rows. The row_sparse gradient is never built.
+ * \param update called as update(row, grad_row) for every distinct row
+ */
+template<typename DType, typename IType, typename Update>
+void ForEachEmbeddingGradRow(const TBlob& data, const TBlob& grad,
+                             const nnvm::dim_t num_rows, const nnvm::dim_t row_length,
+                             const Update& update) {
+  using nnvm::dim_t;
+  std::vector<dim_t> rows, offsets, positions;
+  CHECK(GroupIndicesByRow(data.dptr<IType>(), data.Size(), num_rows,
+                          &rows, &offsets, &positions))
+      << "Embedding input contains data out of bound";
+  const DType* ograd = grad.dptr<DType>();
+  const dim_t nnr = rows.size();
+  const int omp_threads = engine::OpenMP::Get()->GetRecommendedOMPThreadCount();
+  #pragma omp parallel num_threads(omp_threads)
+  {
+    std::vector<DType> sum(row_length);
+    #pragma omp for
+    for (dim_t r = 0; r < nnr; ++r) {
+      const DType* first = ograd + positions[offsets[r]] * row_length;
+      std::copy(first, first + row_length, sum.begin());
+      for (dim_t p = offsets[r] + 1; p < offsets[r + 1]; ++p) {
+        const DType* src = ograd + positions[p] * row_length;
+        for (dim_t j = 0; j < row_length; ++j) sum[j] += src[j];
+      }
+      update(rows[r], sum.data());
+    }
+  }
+}
+
+void EmbeddingSGDUpdate(const nnvm::NodeAttrs& attrs,
+                        const OpContext& ctx,
+                        const std::vector<TBlob>& inputs,
+                        const std::vector<OpReqType>& req,
+                        const std::vector<TBlob>& outputs) {
+  using namespace embedding_update;
+  using namespace mshadow_op;
+  using nnvm::dim_t;
+  const SGDParam& param = nnvm::get<SGDParam>(attrs.parsed);
+  if (req[0] == kNullOp) return;
+  CHECK_EQ(req[0], kWriteInplace) << "the weight is updated in place, out must be weight";
+  const TBlob& weight = inputs[kWeight];
+  const dim_t row_length = weight.shape_[1];
+  MSHADOW_SGL_DBL_TYPE_SWITCH(weight.type_flag_, DType, {
+    MSHADOW_TYPE_SWITCH(inputs[kData].type_flag_, IType, {
+      DType* out = outputs[0].dptr<DType>();
+      const DType lr = param.lr;
+      const DType decay = 1.f - param.lr * param.wd;
+      const DType rescale_grad = param.rescale_grad;
+      const DType clip_gradient = param.clip_gradient;
+      ForEachEmbeddingGradRow<DType, IType>(inputs[kData], inputs[kGrad], weight.shape_[0],
+                                            row_length, [&](dim_t row, const DType* grad) {
+        DType* w = out + row * row_length;
+        for (dim_t j = 0; j < row_length; ++j) {
+          DType g = rescale_grad * grad[j];
+          if (clip_gradient >= 0.0f) g = clip::Map(g, clip_gradient);
+          w[j] = decay * w[j] - lr * g;
+        }
+      });
+    });
+  });
+}
+
+void EmbeddingAdagradUpdate(const nnvm::NodeAttrs& attrs,
+                            const OpContext& ctx,
+                            const std::vector<TBlob>& inputs,
+                            const std::vector<OpReqType>& req,
+                            const std::vector<TBlob>& outputs) {
+  using namespace embedding_update;
+  using namespace mshadow_op;
+  using nnvm::dim_t;
+  const AdagradParam& param = nnvm::get<AdagradParam>(attrs.parsed);
+  CHECK_EQ(param.wd, 0.0f)
+      << "sparse adagrad update does not support wd.";
+  if (req[0] == kNullOp) return;
+  CHECK_EQ(req[0], kWriteInplace) << "the weight is updated in place, out must be weight";
+  const TBlob& weight = inputs[kWeight];
+  const dim_t row_length = weight.shape_[1];
+  MSHADOW_SGL_DBL_TYPE_SWITCH(weight.type_flag_, DType, {
+    MSHADOW_TYPE_SWITCH(inputs[kData].type_flag_, IType, {
+      DType* out = outputs[0].dptr<DType>();
+      DType* history = inputs[kHistory].dptr<DType>();
+      const DType lr = param.lr;
+      const DType epsilon = param.epsilon;
+      const DType rescale_grad = param.rescale_grad;
+      const DType clip_gradient = param.clip_gradient;
+      ForEachEmbeddingGradRow<DType, IType>(inputs[kData], inputs[kGrad], weight.shape_[0],
+                                            row_length, [&](dim_t row, const DType* grad) {
+        DType* w = out + row * row_length;
+        DType* h = history + row * row_length;
+        for (dim_t j = 0; j < row_length; ++j) {
+          DType g = rescale_grad * grad[j];
+          if (clip_gradient >= 0.0f) g = clip::Map(g, clip_gradient);
+          h[j] += g * g;
+          w[j] -= lr * g / square_root::Map(h[j] + epsilon);
+        }
+      });
+    });
+  });
+}
+
+NNVM_REGISTER_OP(_contrib_embedding_sgd_update)
+.describe(R"code(Embedding backward fused with a lazy SGD update of the weight.
+
+Equivalent to an ``Embedding`` backward with ``sparse_grad=True`` followed by ``sgd_update``
+with ``lazy_update=True``, without building the row_sparse gradient::
+
+    for row in unique(data):
+        g = clip(rescale_grad * sum(grad[data == row]), clip_gradient)
+        weight[row] = (1 - lr * wd) * weight[row] - lr * g
+
+The weight is updated in place, so ``out`` must be ``weight``.
+
+)code" ADD_FILELINE)
+.set_num_inputs(3)
+.set_num_outputs(1)
+.set_attr_parser(ParamParser<SGDParam>)
+.set_attr<mxnet::FInferShape>("FInferShape", EmbeddingUpdateShape)
+.set_attr<nnvm::FInferType>("FInferType", EmbeddingUpdateType)
+.set_attr<nnvm::FInplaceOption>("FInplaceOption",
+  [](const NodeAttrs& attrs) {
+    return std::vector<std::pair<int, int> >{{0, 0}};
+  })
+.set_attr<FCompute>("FCompute<cpu>", EmbeddingSGDUpdate)
+.add_argument("weight", "NDArray-or-Symbol", "Weight, (input_dim, output_dim)")
+.add_argument("data", "NDArray-or-Symbol", "The indices the Embedding forward looked up")
+.add_argument("grad", "NDArray-or-Symbol", "Gradient of the Embedding output")
+.add_arguments(SGDParam::__FIELDS__());
+
+NNVM_REGISTER_OP(_contrib_embedding_adagrad_update)
+.describe(R"code(Embedding backward fused with a sparse AdaGrad update of the weight.
+
+Equivalent to an ``Embedding`` backward with ``sparse_grad=True`` followed by
+``_sparse_adagrad_update``, without building the row_sparse gradient::
+
+    for row in unique(data):
+        g = clip(rescale_grad * sum(grad[data == row]), clip_gradient)
+        history[row] += square(g)
+        weight[row] -= lr * g / sqrt(history[row] + epsilon)
+
+The weight is updated in place, so ``out`` must be ``weight``.
+Note that non-zero values for the weight decay option are not supported.
+
+)code" ADD_FILELINE)
+.set_num_inputs(4)
+.set_num_outputs(1)
+.set_attr_parser(ParamParser<AdagradParam>)
+.set_attr<mxnet::FInferShape>("FInferShape", EmbeddingUpdateShape)
+.set_attr<nnvm::FInferType>("FInferType", EmbeddingUpdateType)
+.set_attr<nnvm::FInplaceOption>("FInplaceOption",
+  [](const NodeAttrs& attrs) {
+    return std::vector<std::pair<int, int> >{{0, 0}};
+  })
+.set_attr<nnvm::FMutateInputs>("FMutateInputs",
+  [](const nnvm::NodeAttrs& attrs) {
+    return std::vector<uint32_t>{3};
+  })
+.set_attr<FCompute>("FCompute<cpu>", EmbeddingAdagradUpdate)
+.add_argument("weight", "NDArray-or-Symbol", "Weight, (input_dim, output_dim)")
+.add_argument("data", "NDArray-or-Symbol", "The indices the Embedding forward looked up")
+.add_argument("grad", "NDArray-or-Symbol", "Gradient of the Embedding output")
+.add_argument("history", "NDArray-or-Symbol", "History")
+.add_arguments(AdagradParam::__FIELDS__());
+
+}  // namespace op
+}  // namespace mxnet
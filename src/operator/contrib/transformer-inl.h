@@ -25,6 +25,7 @@
 #ifndef MXNET_OPERATOR_CONTRIB_TRANSFORMER_INL_H_
 #define MXNET_OPERATOR_CONTRIB_TRANSFORMER_INL_H_
 
+#include <dmlc/parameter.h>
 #include <mxnet/operator_util.h>
 #include <vector>
 #include "../mxnet_op.h"
@@ -34,6 +35,28 @@
 namespace mxnet {
 namespace op {
 
+namespace selfatt {
+enum SelfAttOutputs {kOut, kLogSumExp};
+}  // namespace selfatt
+
+struct MultiHeadSelfAttParam : public dmlc::Parameter<MultiHeadSelfAttParam> {
+  int heads;
+  bool use_mask;
+  bool use_valid_length;
+  DMLC_DECLARE_PARAMETER(MultiHeadSelfAttParam) {
+    DMLC_DECLARE_FIELD(heads)
+    .describe("Number of attention heads");
+    DMLC_DECLARE_FIELD(use_mask)
+    .set_default(false)
+    .describe("Whether a mask of shape (batch_size, seq_length, seq_length) is given, "
+              "keys where it is 0 are ignored by the query of its row");
+    DMLC_DECLARE_FIELD(use_valid_length)
+    .set_default(false)
+    .describe("Whether the number of valid keys of every batch element is given, "
+              "the keys after it are ignored");
+  }
+};
+
 template<typename xpu>
 static void DivSqrtDimForward_(const nnvm::NodeAttrs& attrs,
                   const OpContext& ctx,
@@ -23,12 +23,20 @@
  * \brief CPU implementation of the operators used in Transformer
  */
 #include <mxnet/base.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
 #include "./transformer-inl.h"
+#include "../linalg.h"
 #include "../tensor/elemwise_unary_op.h"
 
 namespace mxnet {
 namespace op {
 
+DMLC_REGISTER_PARAMETER(MultiHeadSelfAttParam);
+
 // relu
 MXNET_OPERATOR_REGISTER_UNARY(_contrib_div_sqrt_dim)
 .describe(R"code(Rescale the input by the square root of the channel dimension.
@@ -39,5 +47,359 @@ MXNET_OPERATOR_REGISTER_UNARY(_contrib_div_sqrt_dim)
 .set_attr<FCompute>("FCompute<cpu>", DivSqrtDimForward_<cpu>)
 .set_attr<nnvm::FGradient>("FGradient", ElemwiseGradUseNone{"_contrib_div_sqrt_dim"});
 
+namespace selfatt {
+/*! \brief queries and keys of a block, the scores of a block stay in cache */
+const index_t kBlockQ = 64;
+const index_t kBlockK = 128;
+}  // namespace selfatt
+
+/*! \brief C = alpha * op(A) * op(B) + beta * C on row major blocks of larger matrices */
+template<typename DType>
+inline void SelfAttGemm(const DType* A, index_t lda, const DType* B, index_t ldb,
+                        DType* C, index_t ldc, index_t m, index_t n, index_t k,
+                        DType alpha, DType beta, bool tA, bool tB) {
+  using mshadow::Shape2;
+  mshadow::Tensor<cpu, 2, DType> a(const_cast<DType*>(A), tA ? Shape2(k, m) : Shape2(m, k),
+                                   lda, nullptr);
+  mshadow::Tensor<cpu, 2, DType> b(const_cast<DType*>(B), tB ? Shape2(n, k) : Shape2(k, n),
+                                   ldb, nullptr);
+  mshadow::Tensor<cpu, 2, DType> c(C, Shape2(m, n), ldc, nullptr);
+  linalg_gemm(a, b, c, alpha, beta, tA, tB);
+}
+
+/*! \brief number of keys batch element b attends to */
+template<typename DType>
+inline index_t SelfAttNumKeys(const DType* valid_length, index_t b, index_t seq) {
+  if (valid_length == nullptr) return seq;
+  return std::max<index_t>(0, std::min<index_t>(seq, static_cast<index_t>(valid_length[b])));
+}
+
+/*! \brief set the scores of the masked keys of a block to -inf */
+template<typename DType>
+inline void SelfAttApplyMask(const DType* mask, index_t seq, index_t nq, index_t nk,
+                             DType* scores) {
+  for (index_t i = 0; i < nq; ++i) {
+    for (index_t j = 0; j < nk; ++j) {
+      if (mask[i * seq + j] == 0) scores[i * nk + j] = -std::numeric_limits<DType>::infinity();
+    }
+  }
+}
+
+/*!
+ * \brief Attention of every query over the keys, one block of queries against one
+ *  block of keys at a time. The softmax is computed online: a row keeps its running
+ *  maximum and sum, and rescales its partial output when the maximum grows, so the
+ *  full score matrix is never built.
+ */
+template<typename DType>
+void MultiHeadSelfAttForwardCPU(const DType* qkv, const DType* mask, const DType* valid_length,
+                                DType* out, DType* lse, OpReqType req,
+                                index_t seq, index_t batch, index_t heads, index_t dim) {
+  using namespace selfatt;
+  const DType inf = std::numeric_limits<DType>::infinity();
+  const DType scale = 1 / std::sqrt(static_cast<DType>(dim));
+  const index_t ld = batch * heads * 3 * dim, ld_out = batch * heads * dim;
+  const index_t num_qblocks = (seq + kBlockQ - 1) / kBlockQ;
+  const index_t num_tasks = batch * heads * num_qblocks;
+  const int omp_threads = engine::OpenMP::Get()->GetRecommendedOMPThreadCount();
+  #pragma omp parallel num_threads(omp_threads)
+  {
+    std::vector<DType> scores(kBlockQ * kBlockK), acc(kBlockQ * dim);
+    std::vector<DType> row_max(kBlockQ), row_sum(kBlockQ);
+    #pragma omp for
+    for (index_t task = 0; task < num_tasks; ++task) {
+      const index_t b = task / (heads * num_qblocks), h = task / num_qblocks % heads;
+      const index_t q0 = task % num_qblocks * kBlockQ, nq = std::min(kBlockQ, seq - q0);
+      const DType* query = qkv + (b * heads + h) * 3 * dim;
+      const DType* key = query + dim;
+      const DType* value = key + dim;
+      const index_t num_keys = SelfAttNumKeys(valid_length, b, seq);
+      std::fill(acc.begin(), acc.end(), DType(0));
+      std::fill(row_max.begin(), row_max.end(), -inf);
+      std::fill(row_sum.begin(), row_sum.end(), DType(0));
+      for (index_t k0 = 0; k0 < num_keys; k0 += kBlockK) {
+        const index_t nk = std::min(kBlockK, num_keys - k0);
+        SelfAttGemm(query + q0 * ld, ld, key + k0 * ld, ld, scores.data(), nk,
+                    nq, nk, dim, scale, DType(0), false, true);
+        if (mask != nullptr) {
+          SelfAttApplyMask(mask + (b * seq + q0) * seq + k0, seq, nq, nk, scores.data());
+        }
+        for (index_t i = 0; i < nq; ++i) {
+          DType* s = &scores[i * nk];
+          const DType m = std::max(row_max[i], *std::max_element(s, s + nk));
+          if (m == -inf) {
+            std::fill(s, s + nk, DType(0));
+            continue;
+          }
+          DType sum = 0;
+          for (index_t j = 0; j < nk; ++j) {
+            s[j] = std::exp(s[j] - m);
+            sum += s[j];
+          }
+          const DType correction = std::exp(row_max[i] - m);
+          if (correction != 1) {
+            for (index_t d = 0; d < dim; ++d) acc[i * dim + d] *= correction;
+          }
+          row_sum[i] = row_sum[i] * correction + sum;
+          row_max[i] = m;
+        }
+        SelfAttGemm(scores.data(), nk, value + k0 * ld, ld, acc.data(), dim,
+                    nq, dim, nk, DType(1), DType(1), false, false);
+      }
+      // queries without any key to attend to give 0
+      for (index_t i = 0; i < nq; ++i) {
+        DType* o = out + (q0 + i) * ld_out + (b * heads + h) * dim;
+        const DType norm = row_sum[i] > 0 ? 1 / row_sum[i] : DType(0);
+        for (index_t d = 0; d < dim; ++d) {
+          if (req == kAddTo) {
+            o[d] += acc[i * dim + d] * norm;
+          } else {
+            o[d] = acc[i * dim + d] * norm;
+          }
+        }
+        lse[(b * heads + h) * seq + q0 + i] =
+            row_sum[i] > 0 ? row_max[i] + std::log(row_sum[i]) : -inf;
+      }
+    }
+  }
+}
+
+/*!
+ * \brief Gradient of the attention, adding to grad. The probabilities are recomputed
+ *  a block at a time from the log-sum-exp of every query saved by the forward pass.
+ */
+template<typename DType>
+void MultiHeadSelfAttBackwardCPU(const DType* ograd, const DType* qkv, const DType* mask,
+                                 const DType* valid_length, const DType* out, const DType* lse,
+                                 DType* grad, index_t seq, index_t batch, index_t heads,
+                                 index_t dim) {
+  using namespace selfatt;
+  const DType inf = std::numeric_limits<DType>::infinity();
+  const DType scale = 1 / std::sqrt(static_cast<DType>(dim));
+  const index_t ld = batch * heads * 3 * dim, ld_out = batch * heads * dim;
+  const index_t num_tasks = batch * heads;
+  const int omp_threads = engine::OpenMP::Get()->GetRecommendedOMPThreadCount();
+  // every head of every batch element writes its own columns of grad
+  #pragma omp parallel num_threads(omp_threads)
+  {
+    std::vector<DType> probs(kBlockQ * kBlockK), dprobs(kBlockQ * kBlockK), delta(seq);
+    #pragma omp for
+    for (index_t task = 0; task < num_tasks; ++task) {
+      const index_t b = task / heads;
+      const DType* query = qkv + task * 3 * dim;
+      const DType* key = query + dim;
+      const DType* value = key + dim;
+      DType* dquery = grad + task * 3 * dim;
+      DType* dkey = dquery + dim;
+      DType* dvalue = dkey + dim;
+      const DType* dout = ograd + task * dim;
+      const DType* head_lse = lse + task * seq;
+      const index_t num_keys = SelfAttNumKeys(valid_length, b, seq);
+      for (index_t t = 0; t < seq; ++t) {
+        const DType* o = out + t * ld_out + task * dim;
+        DType sum = 0;
+        for (index_t d = 0; d < dim; ++d) sum += dout[t * ld_out + d] * o[d];
+        delta[t] = sum;
+      }
+      for (index_t q0 = 0; q0 < seq; q0 += kBlockQ) {
+        const index_t nq = std::min(kBlockQ, seq - q0);
+        for (index_t k0 = 0; k0 < num_keys; k0 += kBlockK) {
+          const index_t nk = std::min(kBlockK, num_keys - k0);
+          SelfAttGemm(query + q0 * ld, ld, key + k0 * ld, ld, probs.data(), nk,
+                      nq, nk, dim, scale, DType(0), false, true);
+          if (mask != nullptr) {
+            SelfAttApplyMask(mask + (b * seq + q0) * seq + k0, seq, nq, nk, probs.data());
+          }
+          for (index_t i = 0; i < nq; ++i) {
+            const DType l = head_lse[q0 + i];
+            for (index_t j = 0; j < nk; ++j) {
+              DType& p = probs[i * nk + j];
+              p = l == -inf ? DType(0) : std::exp(p - l);
+            }
+          }
+          // dvalue += probs^T dout
+          SelfAttGemm(probs.data(), nk, dout + q0 * ld_out, ld_out, dvalue + k0 * ld, ld,
+                      nk, dim, nq, DType(1), DType(1), true, false);
+          // dscores = probs * (dout value^T - delta)
+          SelfAttGemm(dout + q0 * ld_out, ld_out, value + k0 * ld, ld, dprobs.data(), nk,
+                      nq, nk, dim, DType(1), DType(0), false, true);
+          for (index_t i = 0; i < nq; ++i) {
+            for (index_t j = 0; j < nk; ++j) {
+              dprobs[i * nk + j] = probs[i * nk + j] * (dprobs[i * nk + j] - delta[q0 + i]);
+            }
+          }
+          // dquery += scale * dscores key, dkey += scale * dscores^T query
+          SelfAttGemm(dprobs.data(), nk, key + k0 * ld, ld, dquery + q0 * ld, ld,
+                      nq, dim, nk, scale, DType(1), false, false);
+          SelfAttGemm(dprobs.data(), nk, query + q0 * ld, ld, dkey + k0 * ld, ld,
+                      nk, dim, nq, scale, DType(1), true, false);
+        }
+      }
+    }
+  }
+}
+
+inline uint32_t MultiHeadSelfAttNumInputs(const NodeAttrs& attrs) {
+  const MultiHeadSelfAttParam& param = nnvm::get<MultiHeadSelfAttParam>(attrs.parsed);
+  return 1 + param.use_mask + param.use_valid_length;
+}
+
+static bool MultiHeadSelfAttShape(const nnvm::NodeAttrs& attrs,
+                                  mxnet::ShapeVector *in_attrs,
+                                  mxnet::ShapeVector *out_attrs) {
+  using namespace selfatt;
+  const MultiHeadSelfAttParam& param = nnvm::get<MultiHeadSelfAttParam>(attrs.parsed);
+  const mxnet::TShape& qkv = in_attrs->at(0);
+  if (!mxnet::ndim_is_known(qkv)) return false;
+  CHECK_EQ(qkv.ndim(), 3)
+      << "queries_keys_values must be (seq_length, batch_size, 3 * heads * head_dim)";
+  if (!mxnet::shape_is_known(qkv)) return false;
+  CHECK_GT(param.heads, 0);
+  CHECK_EQ(qkv[2] % (3 * param.heads), 0)
+      << "The last dimension of queries_keys_values, " << qkv[2]
+      << ", is not a multiple of 3 * heads";
+  const dim_t seq = qkv[0], batch = qkv[1];
+  int i = 1;
+  if (param.use_mask) SHAPE_ASSIGN_CHECK(*in_attrs, i++, mshadow::Shape3(batch, seq, seq));
+  if (param.use_valid_length) SHAPE_ASSIGN_CHECK(*in_attrs, i++, mshadow::Shape1(batch));
+  SHAPE_ASSIGN_CHECK(*out_attrs, kOut, mshadow::Shape3(seq, batch, qkv[2] / 3));
+  SHAPE_ASSIGN_CHECK(*out_attrs, kLogSumExp, mshadow::Shape3(batch, param.heads, seq));
+  return true;
+}
+
+static bool MultiHeadSelfAttType(const nnvm::NodeAttrs& attrs,
+                                 std::vector<int> *in_attrs,
+                                 std::vector<int> *out_attrs) {
+  int dtype = -1;
+  for (int t : *in_attrs) {
+    if (dtype == -1) dtype = t;
+  }
+  for (int t : *out_attrs) {
+    if (dtype == -1) dtype = t;
+  }
+  if (dtype == -1) return false;
+  for (size_t i = 0; i < in_attrs->size(); ++i) TYPE_ASSIGN_CHECK(*in_attrs, i, dtype);
+  for (size_t i = 0; i < out_attrs->size(); ++i) TYPE_ASSIGN_CHECK(*out_attrs, i, dtype);
+  return true;
+}
+
+static void MultiHeadSelfAttForward(const nnvm::NodeAttrs& attrs,
+                                    const OpContext& ctx,
+                                    const std::vector<TBlob>& inputs,
+                                    const std::vector<OpReqType>& req,
+                                    const std::vector<TBlob>& outputs) {
+  using namespace selfatt;
+  const MultiHeadSelfAttParam& param = nnvm::get<MultiHeadSelfAttParam>(attrs.parsed);
+  if (req[kOut] == kNullOp) return;
+  const TBlob& qkv = inputs[0];
+  const index_t dim = qkv.shape_[2] / (3 * param.heads);
+  MSHADOW_SGL_DBL_TYPE_SWITCH(qkv.type_flag_, DType, {
+    int i = 1;
+    const DType* mask = param.use_mask ? inputs[i++].dptr<DType>() : nullptr;
+    const DType* valid_length = param.use_valid_length ? inputs[i++].dptr<DType>() : nullptr;
+    MultiHeadSelfAttForwardCPU(qkv.dptr<DType>(), mask, valid_length,
+                               outputs[kOut].dptr<DType>(), outputs[kLogSumExp].dptr<DType>(),
+                               req[kOut], qkv.shape_[0], qkv.shape_[1], param.heads, dim);
+  });
+}
+
+static void MultiHeadSelfAttBackward(const nnvm::NodeAttrs& attrs,
+                                     const OpContext& ctx,
+                                     const std::vector<TBlob>& inputs,
+                                     const std::vector<OpReqType>& req,
+                                     const std::vector<TBlob>& outputs) {
+  const MultiHeadSelfAttParam& param = nnvm::get<MultiHeadSelfAttParam>(attrs.parsed);
+  // inputs are the output gradient, the forward inputs, the output and the log-sum-exp
+  const TBlob& qkv = inputs[1];
+  const index_t dim = qkv.shape_[2] / (3 * param.heads);
+  MSHADOW_SGL_DBL_TYPE_SWITCH(qkv.type_flag_, DType, {
+    // the mask and the valid lengths get no gradient
+    for (size_t i = 1; i < outputs.size(); ++i) {
+      if (req[i] == kWriteTo || req[i] == kWriteInplace) {
+        std::fill(outputs[i].dptr<DType>(), outputs[i].dptr<DType>() + outputs[i].Size(),
+                  DType(0));
+      }
+    }
+    if (req[0] == kNullOp) return;
+    const TBlob& grad = outputs[0];
+    if (req[0] != kAddTo) {
+      std::fill(grad.dptr<DType>(), grad.dptr<DType>() + grad.Size(), DType(0));
+    }
+    int i = 2;
+    const DType* mask = param.use_mask ? inputs[i++].dptr<DType>() : nullptr;
+    const DType* valid_length = param.use_valid_length ? inputs[i++].dptr<DType>() : nullptr;
+    MultiHeadSelfAttBackwardCPU(inputs[0].dptr<DType>(), qkv.dptr<DType>(), mask, valid_length,
+                                inputs[i].dptr<DType>(), inputs[i + 1].dptr<DType>(),
+                                grad.dptr<DType>(), qkv.shape_[0], qkv.shape_[1],
+                                param.heads, dim);
+  });
+}
+
+NNVM_REGISTER_OP(_contrib_multihead_selfatt)
+.describe(R"code(Multi-head self-attention over packed query, key and value projections.
+
+queries_keys_values is (seq_length, batch_size, heads * 3 * head_dim), and holds, for every
+head, its queries, keys and values one after the other on the last axis. For every head::
+
+    out = softmax(queries * keys^T / sqrt(head_dim)) * values
+
+and the heads are concatenated into an output of shape (seq_length, batch_size,
+heads * head_dim). With ``use_mask``, a mask of shape (batch_size, seq_length, seq_length)
+follows, and the keys where it is 0 are ignored. With ``use_valid_length``, the number of
+valid keys of every batch element follows, and the keys after it are ignored. A query
+that ignores all keys gets 0.
+
+The scores are computed a block at a time with a softmax that is updated online, so the
+(seq_length, seq_length) score matrix is never stored, in forward nor in backward.
+Dropout on the attention weights is not supported.
+
+)code" ADD_FILELINE)
+.set_num_inputs(MultiHeadSelfAttNumInputs)
+.set_num_outputs(2)
+.set_attr<nnvm::FNumVisibleOutputs>("FNumVisibleOutputs",
+  [](const NodeAttrs& attrs) {
+    return 1;
+  })
+.set_attr_parser(ParamParser<MultiHeadSelfAttParam>)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    const MultiHeadSelfAttParam& param = nnvm::get<MultiHeadSelfAttParam>(attrs.parsed);
+    std::vector<std::string> names{"queries_keys_values"};
+    if (param.use_mask) names.emplace_back("mask");
+    if (param.use_valid_length) names.emplace_back("valid_length");
+    return names;
+  })
+.set_attr<nnvm::FListOutputNames>("FListOutputNames",
+  [](const NodeAttrs& attrs) {
+    return std::vector<std::string>{"output", "lse"};
+  })
+.set_attr<mxnet::FInferShape>("FInferShape", MultiHeadSelfAttShape)
+.set_attr<nnvm::FInferType>("FInferType", MultiHeadSelfAttType)
+.set_attr<FCompute>("FCompute<cpu>", MultiHeadSelfAttForward)
+.set_attr<nnvm::FGradient>("FGradient",
+  [](const nnvm::NodePtr& n, const std::vector<nnvm::NodeEntry>& ograds) {
+    std::vector<nnvm::NodeEntry> heads{ograds[selfatt::kOut]};
+    heads.insert(heads.end(), n->inputs.begin(), n->inputs.end());
+    heads.emplace_back(n, selfatt::kOut, 0);
+    heads.emplace_back(n, selfatt::kLogSumExp, 0);
+    return MakeGradNode("_backward_contrib_multihead_selfatt", n, heads, n->attrs.dict);
+  })
+.add_argument("queries_keys_values", "NDArray-or-Symbol",
+              "Packed projections, (seq_length, batch_size, heads * 3 * head_dim)")
+.add_argument("mask", "NDArray-or-Symbol",
+              "Mask of the keys every query attends to, (batch_size, seq_length, seq_length)")
+.add_argument("valid_length", "NDArray-or-Symbol",
+              "Number of valid keys of every batch element, (batch_size,)")
+.add_arguments(MultiHeadSelfAttParam::__FIELDS__());
+
+NNVM_REGISTER_OP(_backward_contrib_multihead_selfatt)
+.set_num_inputs([](const NodeAttrs& attrs) {
+  return MultiHeadSelfAttNumInputs(attrs) + 3;
+})
+.set_num_outputs(MultiHeadSelfAttNumInputs)
+.set_attr_parser(ParamParser<MultiHeadSelfAttParam>)
+.set_attr<nnvm::TIsBackward>("TIsBackward", true)
+.set_attr<FCompute>("FCompute<cpu>", MultiHeadSelfAttBackward);
+
 }  // namespace op
 }  // namespace mxnet
@@ -23,6 +23,8 @@
  * \brief
  * \author Ziheng Jiang, Jun Wu
 */
+#include "./quantization_utils.h"
+#include "./quantized_gemm.h"
 #include "../nn/convolution-inl.h"
 #if MXNET_USE_MKLDNN == 1
 #include "../nn/mkldnn/mkldnn_ops-inl.h"
@@ -114,11 +116,10 @@ bool QuantizedConvStorageType(const nnvm::NodeAttrs& attrs,
                               std::vector<int> *in_attrs,
                               std::vector<int> *out_attrs) {
   *dispatch_mode = DispatchMode::kFCompute;
-#if MXNET_USE_MKLDNN == 1
+  // without MKLDNN, the CPU operator is stateful and reads the version of its weight array
   if (dev_mask == mshadow::cpu::kDevMask) {
     *dispatch_mode = DispatchMode::kFComputeEx;
   }
-#endif
 
   (*out_attrs)[0] = kDefaultStorage;
   (*out_attrs)[1] = kDefaultStorage;
@@ -126,6 +127,83 @@ bool QuantizedConvStorageType(const nnvm::NodeAttrs& attrs,
   return true;
 }
 
+#if MXNET_USE_MKLDNN != 1
+static OpStatePtr CreateQuantizedConvState(const nnvm::NodeAttrs &attrs,
+                                           Context ctx,
+                                           const mxnet::ShapeVector &in_shapes,
+                                           const std::vector<int> &in_types) {
+  return OpStatePtr::Create<QuantizedGemmState>(attrs);
+}
+
+/*!
+ * \brief Convolution of every image as one int8 GEMM, of its patches laid out as rows
+ *  by the packed filters
+ */
+template<typename SrcType>
+void QuantizedConvImageGemm(const ConvolutionParam &param, const OpContext &ctx,
+                            const TBlob &data, const PackedInt8Weight &weight,
+                            const int32_t *bias, const TBlob &out) {
+  const mxnet::TShape &dshape = data.shape_;
+  const mxnet::TShape &oshape = out.shape_;
+  const index_t channels = dshape[1], height = dshape[2], width = dshape[3];
+  const index_t out_w = oshape[3], spatial = oshape[2] * oshape[3];
+  const index_t kernel_h = param.kernel[0], kernel_w = param.kernel[1];
+  const index_t k = weight.num_inputs();
+  mshadow::Tensor<cpu, 1, SrcType> patches =
+      ctx.requested[0].get_space_typed<cpu, 1, SrcType>(mshadow::Shape1(spatial * k),
+                                                         ctx.get_stream<cpu>());
+  const int omp_threads = engine::OpenMP::Get()->GetRecommendedOMPThreadCount();
+  for (index_t n = 0; n < dshape[0]; ++n) {
+    const SrcType *image = data.dptr<SrcType>() + n * channels * height * width;
+    // row p of patches holds the inputs of output pixel p, zero in the padding
+    #pragma omp parallel for num_threads(omp_threads)
+    for (index_t p = 0; p < spatial; ++p) {
+      SrcType *row = patches.dptr_ + p * k;
+      const index_t y0 = p / out_w * param.stride[0] - param.pad[0];
+      const index_t x0 = p % out_w * param.stride[1] - param.pad[1];
+      for (index_t c = 0; c < channels; ++c) {
+        for (index_t y = y0; y < y0 + kernel_h; ++y) {
+          for (index_t x = x0; x < x0 + kernel_w; ++x) {
+            const bool inside = y >= 0 && y < height && x >= 0 && x < width;
+            *row++ = inside ? image[(c * height + y) * width + x] : SrcType(0);
+          }
+        }
+      }
+    }
+    QuantizedGemm(patches.dptr_, spatial, k, weight, bias,
+                  out.dptr<int32_t>() + n * weight.num_outputs() * spatial, 1, spatial);
+  }
+}
+
+void QuantizedConvForwardPackedCPU(const OpStatePtr &state_ptr,
+                                   const OpContext &ctx,
+                                   const std::vector<NDArray> &in_data,
+                                   const std::vector<OpReqType> &req,
+                                   const std::vector<NDArray> &out_data) {
+  QuantizedGemmState &state = state_ptr.get_state<QuantizedGemmState>();
+  const ConvolutionParam& param = nnvm::get<ConvolutionParam>(state.attrs.parsed);
+  std::vector<TBlob> in_blobs(in_data.size()), out_blobs(out_data.size());
+  for (size_t i = 0; i < in_data.size(); ++i) in_blobs[i] = in_data[i].data();
+  for (size_t i = 0; i < out_data.size(); ++i) out_blobs[i] = out_data[i].data();
+  const TBlob &data = in_blobs[conv::kData];
+  CHECK(data.type_flag_ == mshadow::kInt8 || data.type_flag_ == mshadow::kUint8)
+    << "quantized_conv only supports int8/uint8 data, while "
+    << type_string(data.type_flag_) << " is given.";
+  const mxnet::TShape &wshape = in_blobs[conv::kWeight].shape_;
+  state.PackWeight(in_data[conv::kWeight], wshape[0], wshape.ProdShape(1, wshape.ndim()));
+  std::vector<int32_t> bias;
+  QuantizedGemmOutputRange(in_blobs, param.no_bias, out_blobs, &bias);
+  const int32_t *bias_ptr = param.no_bias ? nullptr : bias.data();
+  if (data.type_flag_ == mshadow::kUint8) {
+    QuantizedConvImageGemm<uint8_t>(param, ctx, data, state.weight, bias_ptr,
+                                    out_blobs[conv::kOut]);
+  } else {
+    QuantizedConvImageGemm<int8_t>(param, ctx, data, state.weight, bias_ptr,
+                                   out_blobs[conv::kOut]);
+  }
+}
+#endif
+
 NNVM_REGISTER_OP(_contrib_quantized_conv)
 .describe(R"code(Convolution operator for input, weight and bias data type of int8,
 and accumulates in type int32 for the output. For each argument, two more arguments of type
@@ -168,6 +246,10 @@ and max thresholds representing the threholds for quantizing the float32 output
     return std::vector<ResourceRequest>(1, ResourceRequest::kTempSpace);
   })
 .set_attr<FNeedRequantize>("FNeedRequantize", [](const NodeAttrs& attrs) { return true; })
+#if MXNET_USE_MKLDNN != 1
+.set_attr<FCreateOpState>("FCreateOpState", CreateQuantizedConvState)
+.set_attr<FStatefulComputeEx>("FStatefulComputeEx<cpu>", QuantizedConvForwardPackedCPU)
+#endif
 .add_argument("data", "NDArray-or-Symbol", "Input data.")
 .add_argument("weight", "NDArray-or-Symbol", "weight.")
 .add_argument("bias", "NDArray-or-Symbol", "bias.")
@@ -25,6 +25,7 @@
 */
 #include "../nn/convolution-inl.h"
 #include "./quantization_utils.h"
+#include "./quantized_gemm.h"
 #include "../tensor/matrix_op-inl.h"
 
 namespace mxnet {
@@ -271,6 +272,8 @@ void QuantizedConvForwardGPU(const nnvm::NodeAttrs& attrs,
   const ConvolutionParam& param = nnvm::get<ConvolutionParam>(attrs.parsed);
   CHECK_EQ(param.kernel.ndim(), 2U)
     << "QuantizedConvForward<gpu> only supports 2D convolution for now";
+  CHECK_EQ(inputs[0].type_flag_, mshadow::kInt8)
+    << "QuantizedConvForward<gpu> only supports int8 data";
 #if MXNET_USE_CUDNN == 1 && CUDA_VERSION >= 8000
   typedef QuantizedCuDNNConvOp<int8_t, float, int32_t> QuantizedConvOpInt8;
 #if DMLC_CXX11_THREAD_LOCAL
@@ -286,7 +289,22 @@ void QuantizedConvForwardGPU(const nnvm::NodeAttrs& attrs,
 #endif  // MXNET_USE_CUDNN == 1 && CUDA_VERSION >= 8000
 }
 
+#if MXNET_USE_MKLDNN != 1
+// The CPU operator keeps its packed weights in a state, so every device runs stateful
+void QuantizedConvForwardStatefulGPU(const OpStatePtr& state_ptr,
+                                     const OpContext& ctx,
+                                     const std::vector<TBlob>& inputs,
+                                     const std::vector<OpReqType>& req,
+                                     const std::vector<TBlob>& outputs) {
+  QuantizedConvForwardGPU(state_ptr.get_state<QuantizedGemmState>().attrs,
+                          ctx, inputs, req, outputs);
+}
+#endif
+
 NNVM_REGISTER_OP(_contrib_quantized_conv)
+#if MXNET_USE_MKLDNN != 1
+.set_attr<FStatefulCompute>("FStatefulCompute<gpu>", QuantizedConvForwardStatefulGPU)
+#endif
 .set_attr<FCompute>("FCompute<gpu>", QuantizedConvForwardGPU);
 
 }  // namespace op
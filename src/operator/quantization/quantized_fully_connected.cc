@@ -25,6 +25,7 @@
 */
 #include <vector>
 #include "quantization_utils.h"
+#include "quantized_gemm.h"
 #include "../nn/fully_connected-inl.h"
 #if MXNET_USE_MKLDNN == 1
 #include "../nn/mkldnn/mkldnn_fully_connected-inl.h"
@@ -99,7 +100,9 @@ bool QuantizedFullyConnectedType(const nnvm::NodeAttrs& attrs,
       << "QuantizedFullyConnected only supports int8/uint8 input, while "
       << in_type->at(0) << " is given.";
 #else
-  TYPE_ASSIGN_CHECK(*in_type, 0, mshadow::kInt8);
+  if (in_type->at(0) != mshadow::kUint8) {
+    TYPE_ASSIGN_CHECK(*in_type, 0, mshadow::kInt8);
+  }
 #endif
   for (size_t i = 1; i < num_inputs; ++i) {
     TYPE_ASSIGN_CHECK(*in_type, i, mshadow::kInt8);
@@ -128,7 +131,9 @@ bool QuantizedFullyConnectedStorageType(const nnvm::NodeAttrs& attrs,
   return MKLDNNStorageType(attrs, dev_mask, true,
                            dispatch_mode, in_attrs, out_attrs);
 #else
-  *dispatch_mode = DispatchMode::kFCompute;
+  // the CPU operator is stateful and reads the version of its weight array
+  *dispatch_mode = dev_mask == mshadow::cpu::kDevMask ? DispatchMode::kFComputeEx
+                                                      : DispatchMode::kFCompute;
 
   for (auto &v : *out_attrs) {
     v = kDefaultStorage;
@@ -292,6 +297,47 @@ void QuantizedFullyConnectedForwardCPU(const nnvm::NodeAttrs& attrs,
 #endif
 }
 
+#if MXNET_USE_MKLDNN != 1
+static OpStatePtr CreateQuantizedFullyConnectedState(const nnvm::NodeAttrs &attrs,
+                                                     Context ctx,
+                                                     const mxnet::ShapeVector &in_shapes,
+                                                     const std::vector<int> &in_types) {
+  return OpStatePtr::Create<QuantizedGemmState>(attrs);
+}
+
+void QuantizedFullyConnectedForwardPackedCPU(const OpStatePtr &state_ptr,
+                                             const OpContext &ctx,
+                                             const std::vector<NDArray> &in_data,
+                                             const std::vector<OpReqType> &req,
+                                             const std::vector<NDArray> &out_data) {
+  QuantizedGemmState &state = state_ptr.get_state<QuantizedGemmState>();
+  const FullyConnectedParam& param = nnvm::get<FullyConnectedParam>(state.attrs.parsed);
+  std::vector<TBlob> in_blobs(in_data.size()), out_blobs(out_data.size());
+  for (size_t i = 0; i < in_data.size(); ++i) in_blobs[i] = in_data[i].data();
+  for (size_t i = 0; i < out_data.size(); ++i) out_blobs[i] = out_data[i].data();
+#if MSHADOW_USE_MKL == 1
+  // cblas_gemm_s8u8s32 covers int8 data with two dimensions
+  if (in_data[fullc::kData].dtype() == mshadow::kInt8 &&
+      (param.flatten || in_data[fullc::kData].shape().ndim() == 2)) {
+    QuantizedFullyConnectedForwardCPU(state.attrs, ctx, in_blobs, req, out_blobs);
+    return;
+  }
+#endif
+  const TBlob &data = in_blobs[fullc::kData];
+  const index_t n = param.num_hidden, k = in_blobs[fullc::kWeight].shape_[1];
+  state.PackWeight(in_data[fullc::kWeight], n, k);
+  std::vector<int32_t> bias;
+  QuantizedGemmOutputRange(in_blobs, param.no_bias, out_blobs, &bias);
+  const int32_t *bias_ptr = param.no_bias ? nullptr : bias.data();
+  int32_t *out = out_blobs[fullc::kOut].dptr<int32_t>();
+  if (data.type_flag_ == mshadow::kUint8) {
+    QuantizedGemm(data.dptr<uint8_t>(), data.Size() / k, k, state.weight, bias_ptr, out, n, 1);
+  } else {
+    QuantizedGemm(data.dptr<int8_t>(), data.Size() / k, k, state.weight, bias_ptr, out, n, 1);
+  }
+}
+#endif
+
 #if MXNET_USE_MKLDNN == 1
 void QuantizedFullyConnectedForwardExCPU(const nnvm::NodeAttrs &attrs,
                                          const OpContext &ctx,
@@ -344,6 +390,10 @@ and max thresholds representing the threholds for quantizing the float32 output
 #if MXNET_USE_MKLDNN == 1
 .set_attr<bool>("TIsMKLDNN", true)
 .set_attr<FComputeEx>("FComputeEx<cpu>", QuantizedFullyConnectedForwardExCPU)
+#else
+.set_attr<FCreateOpState>("FCreateOpState", CreateQuantizedFullyConnectedState)
+.set_attr<FStatefulComputeEx>("FStatefulComputeEx<cpu>",
+                              QuantizedFullyConnectedForwardPackedCPU)
 #endif
 .set_attr<FResourceRequest>("FResourceRequest",
   [](const NodeAttrs& attrs) {
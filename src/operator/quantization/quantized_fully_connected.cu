@@ -24,6 +24,7 @@
  * \author Ziheng Jiang, Jun Wu
 */
 #include "./quantization_utils.h"
+#include "./quantized_gemm.h"
 #include "../mxnet_op.h"
 #include "../nn/fully_connected-inl.h"
 
@@ -70,6 +71,8 @@ void QuantizedFullyConnectedForwardGPU(const nnvm::NodeAttrs& attrs,
   const TBlob& data   =  inputs[0];
   const TBlob& weight =  inputs[1];
   const TBlob& out    = outputs[0];
+  CHECK_EQ(data.type_flag_, mshadow::kInt8)
+    << "QuantizedFullyConnectedForwardGPU only supports int8 data";
   mxnet::TShape dshape = data.shape_;
   mxnet::TShape wshape = weight.shape_;
   mxnet::TShape oshape = out.shape_;
@@ -126,7 +129,22 @@ void QuantizedFullyConnectedForwardGPU(const nnvm::NodeAttrs& attrs,
 #endif  // CUDA_VERSION >= 8000
 }
 
+#if MXNET_USE_MKLDNN != 1
+// The CPU operator keeps its packed weights in a state, so every device runs stateful
+void QuantizedFullyConnectedForwardStatefulGPU(const OpStatePtr& state_ptr,
+                                               const OpContext &ctx,
+                                               const std::vector<TBlob> &inputs,
+                                               const std::vector<OpReqType> &req,
+                                               const std::vector<TBlob> &outputs) {
+  QuantizedFullyConnectedForwardGPU<int8_t, int32_t, int32_t>(
+      state_ptr.get_state<QuantizedGemmState>().attrs, ctx, inputs, req, outputs);
+}
+#endif
+
 NNVM_REGISTER_OP(_contrib_quantized_fully_connected)
+#if MXNET_USE_MKLDNN != 1
+.set_attr<FStatefulCompute>("FStatefulCompute<gpu>", QuantizedFullyConnectedForwardStatefulGPU)
+#endif
 .set_attr<FCompute>("FCompute<gpu>", QuantizedFullyConnectedForwardGPU<int8_t, int32_t, int32_t>);
 
 }  // namespace op
@@ -0,0 +1,286 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2019 by Contributors
+ * \file quantized_gemm.cc
+ * \brief int8 GEMM on packed weights, with AVX2 and AVX-512 VNNI kernels picked at runtime
+ */
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include "./quantized_gemm.h"
+#include "./quantization_utils.h"
+#include "../../engine/openmp.h"
+
+// The SIMD kernels are compiled for their instruction set with function attributes,
+// so that they are in every x86 build and only run on CPUs that have them.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MXNET_QUANTIZED_GEMM_AVX2 1
+#if (defined(__clang__) && __clang_major__ >= 8) || (!defined(__clang__) && __GNUC__ >= 9)
+#define MXNET_QUANTIZED_GEMM_VNNI 1
+#endif
+#endif
+
+namespace mxnet {
+namespace op {
+
+using quantized_gemm::kPanel;
+using quantized_gemm::kGroup;
+
+void PackedInt8Weight::Pack(const int8_t* weight, index_t n, index_t k) {
+  n_ = n;
+  k_ = k;
+  const index_t groups = (k + kGroup - 1) / kGroup;
+  panel_size_ = groups * kPanel * kGroup;
+  packed_.assign(num_panels() * panel_size_, 0);
+  sums_.assign(num_panels() * kPanel, 0);
+  for (index_t j = 0; j < n; ++j) {
+    int8_t* dst = &packed_[j / kPanel * panel_size_ + j % kPanel * kGroup];
+    for (index_t l = 0; l < k; ++l) {
+      dst[l / kGroup * kPanel * kGroup + l % kGroup] = weight[j * k + l];
+      sums_[j] += weight[j * k + l];
+    }
+  }
+}
+
+void QuantizedGemmOutputRange(const std::vector<TBlob>& in_data, bool no_bias,
+                              const std::vector<TBlob>& out_data, std::vector<int32_t>* bias) {
+  using mshadow::red::limits::MaxValue;
+  const size_t num_inputs = no_bias ? 2 : 3;
+  float* min_output = out_data[1].dptr<float>();
+  float* max_output = out_data[2].dptr<float>();
+  const float* min_data = in_data[num_inputs].dptr<float>();
+  const float* max_data = in_data[num_inputs + 1].dptr<float>();
+  const float* min_weight = in_data[num_inputs + 2].dptr<float>();
+  const float* max_weight = in_data[num_inputs + 3].dptr<float>();
+  if (in_data[0].type_flag_ == mshadow::kUint8) {
+    QuantizationRangeForS8U8MultiplicationStruct::Map(0, min_output, max_output,
+                                                     min_weight, max_weight, min_data, max_data);
+  } else {
+    QuantizationRangeForS8S8MultiplicationStruct::Map(0, min_output, max_output,
+                                                     min_data, max_data, min_weight, max_weight);
+  }
+  bias->clear();
+  if (no_bias) return;
+  // the int8 bias in units of the int32 output, as QuantizedSumInitKernelWithBias
+  const TBlob& qbias = in_data[2];
+  const float float_for_one_out_quant =
+      MaxAbs(*min_output, *max_output) / static_cast<double>(MaxValue<int32_t>());
+  const float float_for_one_bias_quant =
+      MaxAbs(*in_data[num_inputs + 4].dptr<float>(), *in_data[num_inputs + 5].dptr<float>()) /
+      static_cast<double>(MaxValue<int8_t>());
+  bias->resize(qbias.Size(), 0);
+  if (float_for_one_out_quant == 0) return;
+  for (size_t j = 0; j < bias->size(); ++j) {
+    (*bias)[j] = qbias.dptr<int8_t>()[j] * float_for_one_bias_quant / float_for_one_out_quant;
+  }
+}
+
+namespace {
+
+enum class Int8Isa {kScalar, kAVX2, kVNNI};
+
+Int8Isa DetectInt8Isa() {
+#if MXNET_QUANTIZED_GEMM_VNNI
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vnni")) {
+    return Int8Isa::kVNNI;
+  }
+#endif
+#if MXNET_QUANTIZED_GEMM_AVX2
+  if (__builtin_cpu_supports("avx2")) return Int8Isa::kAVX2;
+#endif
+  return Int8Isa::kScalar;
+}
+
+/*!
+ * \brief kernel used by QuantizedGemm, MXNET_QUANTIZED_GEMM_ISA may force a kernel no
+ *  stronger than the CPU supports, for testing and benchmarking.
+ */
+Int8Isa SelectInt8Isa() {
+  const Int8Isa detected = DetectInt8Isa();
+  const std::string forced = dmlc::GetEnv("MXNET_QUANTIZED_GEMM_ISA", std::string());
+  Int8Isa isa;
+  if (forced.empty()) {
+    return detected;
+  } else if (forced == "scalar") {
+    isa = Int8Isa::kScalar;
+  } else if (forced == "avx2") {
+    isa = Int8Isa::kAVX2;
+  } else if (forced == "vnni") {
+    isa = Int8Isa::kVNNI;
+  } else {
+    LOG(FATAL) << "MXNET_QUANTIZED_GEMM_ISA must be one of scalar, avx2 or vnni. "
+               << "Got: " << forced << ".";
+    return detected;
+  }
+  if (isa > detected) {
+    LOG(WARNING) << "MXNET_QUANTIZED_GEMM_ISA=" << forced << " is not supported by this CPU "
+                 << "or build, using a weaker kernel.";
+    return detected;
+  }
+  return isa;
+}
+
+/*! \brief elements l to l + 3 of a row as one word, zero past the end of the row */
+template<typename SrcType>
+inline int32_t LoadGroup(const SrcType* row, index_t l, index_t k) {
+  int32_t v = 0;
+  if (k - l >= kGroup) {
+    std::memcpy(&v, row + l, kGroup);
+  } else {
+    std::memcpy(&v, row + l, k - l);
+  }
+  return v;
+}
+
+/*! \brief acc(r, j) = sum_l rows[r][l] * panel(j, l) for the first mr rows */
+template<typename SrcType>
+void PanelScalar(const SrcType* const* rows, int mr, const int8_t* panel, index_t k,
+                 int32_t (*acc)[kPanel]) {
+  for (int r = 0; r < mr; ++r) {
+    std::fill(acc[r], acc[r] + kPanel, 0);
+    for (index_t l = 0; l < k; ++l) {
+      const int32_t d = rows[r][l];
+      const int8_t* w = panel + l / kGroup * kPanel * kGroup + l % kGroup;
+      for (index_t j = 0; j < kPanel; ++j) acc[r][j] += d * w[j * kGroup];
+    }
+  }
+}
+
+#if MXNET_QUANTIZED_GEMM_AVX2
+/*!
+ * \brief AVX2 kernel for two rows. Data and weights are widened to int16 so that the
+ *  products are exact; _mm256_maddubs_epi16 would saturate. Every 32-bit lane holds
+ *  the partial sum of one output over two of the four elements of a group.
+ */
+template<typename SrcType, int MR>
+__attribute__((target("avx2")))
+void PanelAVX2(const SrcType* const* rows, int mr, const int8_t* panel, index_t k,
+               int32_t (*acc)[kPanel]) {
+  __m256i c[MR][4];
+  for (int r = 0; r < MR; ++r) {
+    for (int i = 0; i < 4; ++i) c[r][i] = _mm256_setzero_si256();
+  }
+  for (index_t l = 0; l < k; l += kGroup, panel += kPanel * kGroup) {
+    __m256i w[4];
+    for (int i = 0; i < 4; ++i) {
+      w[i] = _mm256_cvtepi8_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(panel) + i));
+    }
+    for (int r = 0; r < MR; ++r) {
+      const __m128i d = _mm_cvtsi32_si128(LoadGroup(rows[r], l, k));
+      const __m256i d16 = _mm256_broadcastq_epi64(
+          std::is_signed<SrcType>::value ? _mm_cvtepi8_epi16(d) : _mm_cvtepu8_epi16(d));
+      for (int i = 0; i < 4; ++i) {
+        c[r][i] = _mm256_add_epi32(c[r][i], _mm256_madd_epi16(w[i], d16));
+      }
+    }
+  }
+  for (int r = 0; r < mr; ++r) {
+    for (int i = 0; i < 2; ++i) {
+      const __m256i sum = _mm256_permute4x64_epi64(
+          _mm256_hadd_epi32(c[r][2 * i], c[r][2 * i + 1]), _MM_SHUFFLE(3, 1, 2, 0));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc[r] + 8 * i), sum);
+    }
+  }
+}
+#endif  // MXNET_QUANTIZED_GEMM_AVX2
+
+#if MXNET_QUANTIZED_GEMM_VNNI
+/*!
+ * \brief AVX-512 VNNI kernel for four rows, one vpdpbusd per group of four elements.
+ *  It multiplies unsigned data by signed weights, so int8 data are shifted by 128 and
+ *  the caller subtracts 128 times the weight sums.
+ */
+template<typename SrcType, int MR>
+__attribute__((target("avx512f,avx512vnni")))
+void PanelVNNI(const SrcType* const* rows, int mr, const int8_t* panel, index_t k,
+               int32_t (*acc)[kPanel]) {
+  __m512i c[MR];
+  for (int r = 0; r < MR; ++r) c[r] = _mm512_setzero_si512();
+  const __m512i shift = _mm512_set1_epi32(
+      std::is_signed<SrcType>::value ? static_cast<int>(0x80808080u) : 0);
+  for (index_t l = 0; l < k; l += kGroup, panel += kPanel * kGroup) {
+    const __m512i w = _mm512_loadu_si512(panel);
+    for (int r = 0; r < MR; ++r) {
+      const __m512i d = _mm512_xor_si512(_mm512_set1_epi32(LoadGroup(rows[r], l, k)), shift);
+      c[r] = _mm512_dpbusd_epi32(c[r], d, w);
+    }
+  }
+  for (int r = 0; r < mr; ++r) _mm512_storeu_si512(acc[r], c[r]);
+}
+#endif  // MXNET_QUANTIZED_GEMM_VNNI
+
+}  // namespace
+
+template<typename SrcType>
+void QuantizedGemm(const SrcType* data, index_t m, index_t ld_data,
+                   const PackedInt8Weight& weight, const int32_t* bias,
+                   int32_t* out, index_t out_row_stride, index_t out_col_stride) {
+  static const Int8Isa isa = SelectInt8Isa();
+  const int mr = isa == Int8Isa::kAVX2 ? 2 : 4;
+  const bool shifted = isa == Int8Isa::kVNNI && std::is_signed<SrcType>::value;
+  const index_t n = weight.num_outputs(), k = weight.num_inputs();
+  const index_t panels = weight.num_panels(), row_blocks = (m + mr - 1) / mr;
+  const int omp_threads = engine::OpenMP::Get()->GetRecommendedOMPThreadCount();
+  #pragma omp parallel for num_threads(omp_threads)
+  for (index_t task = 0; task < row_blocks * panels; ++task) {
+    const index_t i0 = task / panels * mr, p = task % panels;
+    const int rows_left = static_cast<int>(std::min<index_t>(mr, m - i0));
+    // missing rows of the last block repeat its first row, their sums are not stored
+    const SrcType* rows[4];
+    for (int r = 0; r < 4; ++r) rows[r] = data + (i0 + (r < rows_left ? r : 0)) * ld_data;
+    int32_t acc[4][kPanel];
+    switch (isa) {
+#if MXNET_QUANTIZED_GEMM_VNNI
+      case Int8Isa::kVNNI:
+        PanelVNNI<SrcType, 4>(rows, rows_left, weight.panel(p), k, acc);
+        break;
+#endif
+#if MXNET_QUANTIZED_GEMM_AVX2
+      case Int8Isa::kAVX2:
+        PanelAVX2<SrcType, 2>(rows, rows_left, weight.panel(p), k, acc);
+        break;
+#endif
+      default:
+        PanelScalar<SrcType>(rows, rows_left, weight.panel(p), k, acc);
+    }
+    const index_t cols = std::min(kPanel, n - p * kPanel);
+    for (int r = 0; r < rows_left; ++r) {
+      int32_t* dst = out + (i0 + r) * out_row_stride + p * kPanel * out_col_stride;
+      for (index_t j = 0; j < cols; ++j) {
+        int32_t v = acc[r][j];
+        if (bias != nullptr) v += bias[p * kPanel + j];
+        if (shifted) v -= 128 * weight.sums()[p * kPanel + j];
+        dst[j * out_col_stride] = v;
+      }
+    }
+  }
+}
+
+template void QuantizedGemm<int8_t>(const int8_t*, index_t, index_t, const PackedInt8Weight&,
+                                    const int32_t*, int32_t*, index_t, index_t);
+template void QuantizedGemm<uint8_t>(const uint8_t*, index_t, index_t, const PackedInt8Weight&,
+                                     const int32_t*, int32_t*, index_t, index_t);
+
+}  // namespace op
+}  // namespace mxnet
@@ -0,0 +1,113 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2019 by Contributors
+ * \file quantized_gemm.h
+ * \brief int8 GEMM on packed weights for the quantized operators of builds without MKLDNN
+ */
+#ifndef MXNET_OPERATOR_QUANTIZATION_QUANTIZED_GEMM_H_
+#define MXNET_OPERATOR_QUANTIZATION_QUANTIZED_GEMM_H_
+
+#include <mxnet/base.h>
+#include <mxnet/ndarray.h>
+#include <nnvm/node.h>
+#include <cstdint>
+#include <vector>
+
+namespace mxnet {
+namespace op {
+
+namespace quantized_gemm {
+/*! \brief outputs of a panel of packed weights */
+const index_t kPanel = 16;
+/*! \brief consecutive reduction elements of an output stored together */
+const index_t kGroup = 4;
+}  // namespace quantized_gemm
+
+/*!
+ * \brief int8 weights of n outputs over k inputs, packed once so that the GEMM reads
+ *  them in order: panels of 16 outputs, and within a panel groups of 4 inputs of every
+ *  output, zero padded. Also keeps the sum of the weights of every output.
+ */
+class PackedInt8Weight {
+ public:
+  /*! \brief pack weight, (n, k) row major */
+  void Pack(const int8_t* weight, index_t n, index_t k);
+
+  index_t num_outputs() const { return n_; }
+  index_t num_inputs() const { return k_; }
+  index_t num_panels() const {
+    return (n_ + quantized_gemm::kPanel - 1) / quantized_gemm::kPanel;
+  }
+  const int8_t* panel(index_t p) const { return &packed_[p * panel_size_]; }
+  const int32_t* sums() const { return sums_.data(); }
+
+ private:
+  index_t n_ = 0, k_ = 0, panel_size_ = 0;
+  std::vector<int8_t> packed_;
+  std::vector<int32_t> sums_;
+};
+
+/*!
+ * \brief State of quantized_conv and quantized_fully_connected in builds without MKLDNN:
+ *  the weights packed on the CPU, packed again only when the weight array changes.
+ */
+struct QuantizedGemmState {
+  /*! \brief attributes of the operator, for the implementations of other devices */
+  nnvm::NodeAttrs attrs;
+  PackedInt8Weight weight;
+  Engine::VarHandle weight_var = nullptr;
+  size_t weight_version = 0;
+
+  explicit QuantizedGemmState(const nnvm::NodeAttrs& attrs) : attrs(attrs) {}
+
+  /*! \brief pack w as n outputs over k inputs, unless it already is */
+  void PackWeight(const NDArray& w, index_t n, index_t k) {
+    if (w.var() == weight_var && w.version() == weight_version) return;
+    weight.Pack(w.data().dptr<int8_t>(), n, k);
+    weight_var = w.var();
+    weight_version = w.version();
+  }
+};
+
+/*!
+ * \brief out(i, j) = sum_l data(i, l) * weight(j, l) + bias(j), in int32, for the m rows
+ *  of data. Row i of data starts at data + i * ld_data, and out(i, j) is written to
+ *  out[i * out_row_stride + j * out_col_stride]. bias may be null. Uses AVX-512 VNNI or
+ *  AVX2 when the CPU has them.
+ * \tparam SrcType int8_t or uint8_t
+ */
+template<typename SrcType>
+void QuantizedGemm(const SrcType* data, index_t m, index_t ld_data,
+                   const PackedInt8Weight& weight, const int32_t* bias,
+                   int32_t* out, index_t out_row_stride, index_t out_col_stride);
+
+/*!
+ * \brief Sets the range of the int32 output of a product of data and int8 weights, and
+ *  converts the int8 bias to the units of the output. in_data are the inputs of
+ *  quantized_conv or quantized_fully_connected, out_data their outputs.
+ */
+void QuantizedGemmOutputRange(const std::vector<TBlob>& in_data, bool no_bias,
+                              const std::vector<TBlob>& out_data, std::vector<int32_t>* bias);
+
+}  // namespace op
+}  // namespace mxnet
+
+#endif  // MXNET_OPERATOR_QUANTIZATION_QUANTIZED_GEMM_H_
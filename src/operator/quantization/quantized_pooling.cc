@@ -22,6 +22,7 @@
  * \file quantized_pooling.cc
 */
 #include <mxnet/op_attr_types.h>
+#include <algorithm>
 #include "../nn/pooling-inl.h"
 #if MXNET_USE_MKLDNN == 1
 #include "../nn/mkldnn/mkldnn_pooling-inl.h"
@@ -101,8 +102,10 @@ bool QuantizedPoolingType(const nnvm::NodeAttrs& attrs,
 #if MXNET_USE_MKLDNN  == 1
     TYPE_ASSIGN_CHECK(*out_type, 0, (*in_type)[0]);
 #else
-    TYPE_ASSIGN_CHECK(*in_type, 0, mshadow::kInt8);
-    TYPE_ASSIGN_CHECK(*out_type, 0, mshadow::kInt8);
+    if (in_type->at(0) != mshadow::kUint8) {
+      TYPE_ASSIGN_CHECK(*in_type, 0, mshadow::kInt8);
+    }
+    TYPE_ASSIGN_CHECK(*out_type, 0, (*in_type)[0]);
 #endif
   } else {
     LOG(FATAL) << "QuantizedPoolingOp only supports pool_type=max/avg for now";
@@ -135,6 +138,78 @@ inline static bool QuantizedPoolingStorageType(const nnvm::NodeAttrs &attrs,
   return true;
 }
 
+/*!
+ * \brief Max or average pooling of int8/uint8 data in NCHW layout, with the windows and
+ *  the divisor of the float operator. Averages are rounded to the nearest integer.
+ */
+template<typename DType>
+void QuantizedPoolingCPU(const PoolingParam &param, const TBlob &data, const TBlob &out) {
+  const mxnet::TShape &dshape = data.shape_;
+  const mxnet::TShape &oshape = out.shape_;
+  const int height = dshape[2], width = dshape[3];
+  const int out_h = oshape[2], out_w = oshape[3];
+  const bool global = param.global_pool;
+  const int kernel_h = global ? height : param.kernel[0];
+  const int kernel_w = global ? width : param.kernel[1];
+  const int pad_h = global ? 0 : param.pad[0], pad_w = global ? 0 : param.pad[1];
+  const int stride_h = global ? 1 : param.stride[0], stride_w = global ? 1 : param.stride[1];
+  const bool avg = param.pool_type == pool_enum::kAvgPooling;
+  const bool count_include_pad =
+      param.count_include_pad.has_value() ? param.count_include_pad.value() : true;
+  const index_t planes = dshape[0] * dshape[1];
+  const int omp_threads = engine::OpenMP::Get()->GetRecommendedOMPThreadCount();
+  #pragma omp parallel for num_threads(omp_threads)
+  for (index_t plane = 0; plane < planes; ++plane) {
+    const DType *in = data.dptr<DType>() + plane * height * width;
+    DType *dst = out.dptr<DType>() + plane * out_h * out_w;
+    for (int oy = 0; oy < out_h; ++oy) {
+      for (int ox = 0; ox < out_w; ++ox) {
+        int hstart = oy * stride_h - pad_h, wstart = ox * stride_w - pad_w;
+        int hend = std::min(hstart + kernel_h, height + pad_h);
+        int wend = std::min(wstart + kernel_w, width + pad_w);
+        int pool_size = (hend - hstart) * (wend - wstart);
+        hstart = std::max(hstart, 0);
+        wstart = std::max(wstart, 0);
+        hend = std::min(hend, height);
+        wend = std::min(wend, width);
+        if (!count_include_pad) pool_size = (hend - hstart) * (wend - wstart);
+        int32_t acc = avg ? 0 : mshadow::red::limits::MinValue<DType>();
+        for (int y = hstart; y < hend; ++y) {
+          for (int x = wstart; x < wend; ++x) {
+            acc = avg ? acc + in[y * width + x] : std::max<int32_t>(acc, in[y * width + x]);
+          }
+        }
+        if (avg) {
+          const int32_t half = pool_size / 2;
+          acc = pool_size <= 0 ? 0 :
+              (acc >= 0 ? (acc + half) / pool_size : -((half - acc) / pool_size));
+        }
+        dst[oy * out_w + ox] = static_cast<DType>(acc);
+      }
+    }
+  }
+}
+
+void QuantizedPoolingForwardCPU(const nnvm::NodeAttrs &attrs,
+                                const OpContext &ctx,
+                                const std::vector<TBlob> &in_data,
+                                const std::vector<OpReqType> &req,
+                                const std::vector<TBlob> &out_data) {
+  const PoolingParam &param = nnvm::get<PoolingParam>(attrs.parsed);
+  CHECK_EQ(param.kernel.ndim(), 2U)
+    << "QuantizedPoolingForwardCPU only supports 2D pooling for now";
+  if (in_data[0].type_flag_ == mshadow::kUint8) {
+    QuantizedPoolingCPU<uint8_t>(param, in_data[0], out_data[0]);
+  } else {
+    CHECK_EQ(in_data[0].type_flag_, mshadow::kInt8)
+      << "QuantizedPoolingForwardCPU only supports int8/uint8 data";
+    QuantizedPoolingCPU<int8_t>(param, in_data[0], out_data[0]);
+  }
+  // pooling keeps the range of its input
+  *out_data[1].dptr<float>() = *in_data[1].dptr<float>();
+  *out_data[2].dptr<float>() = *in_data[2].dptr<float>();
+}
+
 NNVM_REGISTER_OP(_contrib_quantized_pooling)
 .describe(R"code(Pooling operator for input and output data type of int8.
 The input and output data comes with min and max thresholds for quantizing
@@ -167,6 +242,7 @@ the float32 data into int8.
       << "QuantizedPoolingOp only supports pool_type=max/avg for now";
     return false;
   })
+.set_attr<FCompute>("FCompute<cpu>", QuantizedPoolingForwardCPU)
 .add_argument("data", "NDArray-or-Symbol", "Input data.")
 .add_argument("min_data", "NDArray-or-Symbol", "Minimum value of data.")
 .add_argument("max_data", "NDArray-or-Symbol", "Maximum value of data.")
@@ -597,6 +597,11 @@ void CreateSubgraphNode(nnvm::Graph* g,
         sn->outputs[n.get()].push_back(i);
       }
     }
+  } else {
+    // Reconnect the subgraph nodes to the entries CutGraphInputs replaced
+    for (size_t i = 0; i < input_entries.size(); ++i) {
+      *input_entries[i] = orig_input_entries[i];
+    }
   }
 #if DEBUG_SUBGRAPH
   if (n)
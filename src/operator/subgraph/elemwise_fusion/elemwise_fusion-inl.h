@@ -0,0 +1,305 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2019 by Contributors
+ * \file elemwise_fusion-inl.h
+ * \brief chains of elementwise, broadcast and scalar operators evaluated in one
+ *  pass over memory, by interpreting the chain on tiles that stay in cache
+ */
+#ifndef MXNET_OPERATOR_SUBGRAPH_ELEMWISE_FUSION_ELEMWISE_FUSION_INL_H_
+#define MXNET_OPERATOR_SUBGRAPH_ELEMWISE_FUSION_ELEMWISE_FUSION_INL_H_
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../../mshadow_op.h"
+#include "../../mxnet_op.h"
+#include "../../nn/activation-inl.h"
+#include "../../tensor/matrix_op-inl.h"
+
+namespace mxnet {
+namespace op {
+
+namespace elemwise_fusion {
+enum FusedOpCode {
+  kCopy, kNegative, kAbs, kExp, kLog, kSqrt, kSquare,
+  kReLU, kSigmoid, kTanh, kSoftReLU, kSoftSign, kClip,
+  kPlusScalar, kMinusScalar, kRMinusScalar, kMulScalar, kDivScalar, kRDivScalar,
+  kMaximumScalar, kMinimumScalar, kPowerScalar,
+  kAdd, kSub, kMul, kDiv, kMaximum, kMinimum
+};
+/*! \brief number of elements evaluated at once, all registers of a tile stay in L1 */
+const index_t kTile = 256;
+}  // namespace elemwise_fusion
+
+/*! \brief one operator of the chain */
+struct FusedStep {
+  elemwise_fusion::FusedOpCode code;
+  /*! \brief registers of the operands, rhs is only read by binary operators */
+  uint32_t lhs, rhs;
+  /*! \brief scalar operand, or the bounds of clip */
+  double alpha, beta;
+};
+
+/*!
+ * \brief The chain as a straight line program. The first num_inputs registers hold
+ *  the inputs, step i writes register num_inputs + i.
+ */
+struct FusedElemwiseProgram {
+  uint32_t num_inputs;
+  std::vector<FusedStep> steps;
+  /*! \brief register of every output */
+  std::vector<uint32_t> outputs;
+};
+
+/*!
+ * \brief whether node can be part of a fused chain
+ * \param step if not null, receives the operator code and scalar operands
+ */
+inline bool GetFusedStep(const nnvm::Node& node, FusedStep* step) {
+  using namespace elemwise_fusion;
+  static const std::unordered_map<std::string, FusedOpCode> codes{
+    {"_copy", kCopy}, {"negative", kNegative}, {"abs", kAbs}, {"exp", kExp},
+    {"log", kLog}, {"sqrt", kSqrt}, {"square", kSquare}, {"relu", kReLU},
+    {"sigmoid", kSigmoid}, {"tanh", kTanh}, {"softsign", kSoftSign},
+    {"_plus_scalar", kPlusScalar}, {"_minus_scalar", kMinusScalar},
+    {"_rminus_scalar", kRMinusScalar}, {"_mul_scalar", kMulScalar},
+    {"_div_scalar", kDivScalar}, {"_rdiv_scalar", kRDivScalar},
+    {"_maximum_scalar", kMaximumScalar}, {"_minimum_scalar", kMinimumScalar},
+    {"_power_scalar", kPowerScalar},
+    {"elemwise_add", kAdd}, {"elemwise_sub", kSub}, {"elemwise_mul", kMul},
+    {"elemwise_div", kDiv}, {"_maximum", kMaximum}, {"_minimum", kMinimum},
+    {"broadcast_add", kAdd}, {"broadcast_sub", kSub}, {"broadcast_mul", kMul},
+    {"broadcast_div", kDiv}, {"broadcast_maximum", kMaximum},
+    {"broadcast_minimum", kMinimum}
+  };
+  if (node.is_variable() || node.num_outputs() != 1) return false;
+  FusedStep ret{kCopy, 0, 0, 0.0, 0.0};
+  const std::string& name = node.op()->name;
+  auto it = codes.find(name);
+  if (it != codes.end()) {
+    ret.code = it->second;
+    if (ret.code >= kPlusScalar && ret.code <= kPowerScalar) {
+      ret.alpha = nnvm::get<double>(node.attrs.parsed);
+    }
+  } else if (name == "Activation") {
+    switch (nnvm::get<ActivationParam>(node.attrs.parsed).act_type) {
+      case activation::kReLU: ret.code = kReLU; break;
+      case activation::kSigmoid: ret.code = kSigmoid; break;
+      case activation::kTanh: ret.code = kTanh; break;
+      case activation::kSoftReLU: ret.code = kSoftReLU; break;
+      case activation::kSoftSign: ret.code = kSoftSign; break;
+      default: return false;
+    }
+  } else if (name == "clip") {
+    const ClipParam& param = nnvm::get<ClipParam>(node.attrs.parsed);
+    ret.code = kClip;
+    ret.alpha = param.a_min;
+    ret.beta = param.a_max;
+  } else {
+    return false;
+  }
+  if (node.inputs.size() != (ret.code >= kAdd ? 2U : 1U)) return false;
+  if (step != nullptr) *step = ret;
+  return true;
+}
+
+/*! \brief translate the subgraph of a fused node to a program */
+inline FusedElemwiseProgram CompileFusedElemwise(const nnvm::Symbol& sym) {
+  FusedElemwiseProgram prog;
+  std::unordered_map<const nnvm::Node*, uint32_t> regs;
+  const std::vector<nnvm::NodePtr> inputs = sym.ListInputs(nnvm::Symbol::kAll);
+  prog.num_inputs = inputs.size();
+  for (size_t i = 0; i < inputs.size(); ++i) regs[inputs[i].get()] = i;
+  nnvm::DFSVisit(sym.outputs, [&](const nnvm::NodePtr& node) {
+    if (node->is_variable()) return;
+    FusedStep step;
+    CHECK(GetFusedStep(*node, &step))
+        << "Operator " << node->op()->name << " cannot be fused";
+    step.lhs = regs.at(node->inputs[0].node.get());
+    step.rhs = node->inputs.size() > 1 ? regs.at(node->inputs[1].node.get()) : step.lhs;
+    regs[node.get()] = prog.num_inputs + prog.steps.size();
+    prog.steps.push_back(step);
+  });
+  for (const auto& e : sym.outputs) prog.outputs.push_back(regs.at(e.node.get()));
+  return prog;
+}
+
+/*! \brief type the chain is evaluated in */
+template<typename DType>
+struct FusedAccType {
+  typedef DType type;
+};
+template<>
+struct FusedAccType<mshadow::half::half_t> {
+  typedef float type;
+};
+
+/*! \brief evaluate one step on a tile of n elements */
+template<typename AType>
+inline void RunFusedStep(const FusedStep& step, const AType* lhs, const AType* rhs,
+                         AType* out, const index_t n) {
+  using namespace elemwise_fusion;
+  const AType alpha = static_cast<AType>(step.alpha);
+  const AType beta = static_cast<AType>(step.beta);
+#define FUSED_STEP_CASE(code, expr)                  \
+  case code:                                         \
+    for (index_t k = 0; k < n; ++k) out[k] = (expr); \
+    break
+  switch (step.code) {
+    FUSED_STEP_CASE(kCopy, lhs[k]);
+    FUSED_STEP_CASE(kNegative, -lhs[k]);
+    FUSED_STEP_CASE(kAbs, mshadow_op::abs::Map(lhs[k]));
+    FUSED_STEP_CASE(kExp, mshadow_op::exp::Map(lhs[k]));
+    FUSED_STEP_CASE(kLog, mshadow_op::log::Map(lhs[k]));
+    FUSED_STEP_CASE(kSqrt, mshadow_op::square_root::Map(lhs[k]));
+    FUSED_STEP_CASE(kSquare, lhs[k] * lhs[k]);
+    FUSED_STEP_CASE(kReLU, mshadow_op::relu::Map(lhs[k]));
+    FUSED_STEP_CASE(kSigmoid, mshadow_op::sigmoid::Map(lhs[k]));
+    FUSED_STEP_CASE(kTanh, mshadow_op::tanh::Map(lhs[k]));
+    FUSED_STEP_CASE(kSoftReLU, mshadow_op::softrelu::Map(lhs[k]));
+    FUSED_STEP_CASE(kSoftSign, mshadow_op::softsign::Map(lhs[k]));
+    FUSED_STEP_CASE(kClip, lhs[k] > beta ? beta : (lhs[k] < alpha ? alpha : lhs[k]));
+    FUSED_STEP_CASE(kPlusScalar, lhs[k] + alpha);
+    FUSED_STEP_CASE(kMinusScalar, lhs[k] - alpha);
+    FUSED_STEP_CASE(kRMinusScalar, alpha - lhs[k]);
+    FUSED_STEP_CASE(kMulScalar, lhs[k] * alpha);
+    FUSED_STEP_CASE(kDivScalar, lhs[k] / alpha);
+    FUSED_STEP_CASE(kRDivScalar, alpha / lhs[k]);
+    FUSED_STEP_CASE(kMaximumScalar, mshadow_op::maximum::Map(lhs[k], alpha));
+    FUSED_STEP_CASE(kMinimumScalar, mshadow_op::minimum::Map(lhs[k], alpha));
+    FUSED_STEP_CASE(kPowerScalar, mshadow_op::power::Map(lhs[k], alpha));
+    FUSED_STEP_CASE(kAdd, lhs[k] + rhs[k]);
+    FUSED_STEP_CASE(kSub, lhs[k] - rhs[k]);
+    FUSED_STEP_CASE(kMul, lhs[k] * rhs[k]);
+    FUSED_STEP_CASE(kDiv, lhs[k] / rhs[k]);
+    FUSED_STEP_CASE(kMaximum, mshadow_op::maximum::Map(lhs[k], rhs[k]));
+    FUSED_STEP_CASE(kMinimum, mshadow_op::minimum::Map(lhs[k], rhs[k]));
+    default:
+      LOG(FATAL) << "Unknown fused operator " << step.code;
+  }
+#undef FUSED_STEP_CASE
+}
+
+/*! \brief how an input is read at every element of the output */
+struct FusedInputView {
+  /*! \brief the input has as many elements as the output, or only one */
+  bool dense, scalar;
+  /*! \brief step of the input offset along every output dimension, 0 if broadcast */
+  std::vector<index_t> strides;
+
+  FusedInputView(const mxnet::TShape& ishape, const mxnet::TShape& oshape)
+      : dense(ishape.Size() == oshape.Size()), scalar(ishape.Size() == 1),
+        strides(oshape.ndim(), 0) {
+    // shapes are aligned on their last dimension, like the broadcast operators do
+    const int lead = oshape.ndim() - ishape.ndim();
+    CHECK_GE(lead, 0) << "Input of shape " << ishape << " does not broadcast to " << oshape;
+    index_t stride = 1;
+    for (int d = ishape.ndim() - 1; d >= 0; --d) {
+      CHECK(ishape[d] == oshape[d + lead] || ishape[d] == 1)
+          << "Input of shape " << ishape << " does not broadcast to " << oshape;
+      if (ishape[d] != 1) strides[d + lead] = stride;
+      stride *= ishape[d];
+    }
+  }
+
+  /*! \brief read the n elements from begin of the output index space */
+  template<typename DType, typename AType>
+  inline void Load(const DType* dptr, const mxnet::TShape& oshape,
+                   index_t begin, index_t n, AType* out) const {
+    if (dense) {
+      for (index_t k = 0; k < n; ++k) out[k] = static_cast<AType>(dptr[begin + k]);
+      return;
+    }
+    if (scalar) {
+      std::fill(out, out + n, static_cast<AType>(dptr[0]));
+      return;
+    }
+    // walk the output coordinates like an odometer, carrying the input offset along
+    const int ndim = oshape.ndim();
+    std::vector<index_t> coord(ndim);
+    index_t offset = 0, rest = begin;
+    for (int d = ndim - 1; d >= 0; --d) {
+      coord[d] = rest % oshape[d];
+      rest /= oshape[d];
+      offset += coord[d] * strides[d];
+    }
+    for (index_t k = 0; k < n; ++k) {
+      out[k] = static_cast<AType>(dptr[offset]);
+      for (int d = ndim - 1; d >= 0; --d) {
+        offset += strides[d];
+        if (++coord[d] < oshape[d]) break;
+        offset -= strides[d] * oshape[d];
+        coord[d] = 0;
+      }
+    }
+  }
+};
+
+/*! \brief evaluate prog over all elements of the outputs, tile by tile */
+template<typename DType, typename AType>
+void RunFusedElemwise(const FusedElemwiseProgram& prog,
+                      const std::vector<TBlob>& inputs,
+                      const std::vector<OpReqType>& req,
+                      const std::vector<TBlob>& outputs) {
+  using elemwise_fusion::kTile;
+  const mxnet::TShape& oshape = outputs[0].shape_;
+  const index_t size = oshape.Size();
+  std::vector<FusedInputView> views;
+  views.reserve(inputs.size());
+  for (const TBlob& input : inputs) views.emplace_back(input.shape_, oshape);
+  const index_t num_tiles = (size + kTile - 1) / kTile;
+  const size_t num_regs = prog.num_inputs + prog.steps.size();
+  const int omp_threads = std::max(1, static_cast<int>(std::min<index_t>(
+      engine::OpenMP::Get()->GetRecommendedOMPThreadCount(), num_tiles)));
+  #pragma omp parallel num_threads(omp_threads)
+  {
+    std::vector<AType> regs(num_regs * kTile);
+    #pragma omp for
+    for (index_t t = 0; t < num_tiles; ++t) {
+      const index_t begin = t * kTile;
+      const index_t n = std::min(kTile, size - begin);
+      for (uint32_t i = 0; i < prog.num_inputs; ++i) {
+        views[i].Load(inputs[i].dptr<DType>(), oshape, begin, n, &regs[i * kTile]);
+      }
+      for (size_t s = 0; s < prog.steps.size(); ++s) {
+        const FusedStep& step = prog.steps[s];
+        RunFusedStep(step, &regs[step.lhs * kTile], &regs[step.rhs * kTile],
+                     &regs[(prog.num_inputs + s) * kTile], n);
+      }
+      for (size_t o = 0; o < outputs.size(); ++o) {
+        if (req[o] == kNullOp) continue;
+        const AType* reg = &regs[prog.outputs[o] * kTile];
+        DType* out = outputs[o].dptr<DType>() + begin;
+        if (req[o] == kAddTo) {
+          for (index_t k = 0; k < n; ++k) out[k] += static_cast<DType>(reg[k]);
+        } else {
+          for (index_t k = 0; k < n; ++k) out[k] = static_cast<DType>(reg[k]);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace op
+}  // namespace mxnet
+
+#endif  // MXNET_OPERATOR_SUBGRAPH_ELEMWISE_FUSION_ELEMWISE_FUSION_INL_H_
@@ -0,0 +1,71 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2019 by Contributors
+ * \file elemwise_fusion.cc
+ * \brief fused elementwise operator and the ELEMWISE_FUSION subgraph backend
+ */
+#include <vector>
+#include "./elemwise_fusion-inl.h"
+#include "./elemwise_fusion_property.h"
+
+namespace mxnet {
+namespace op {
+
+static void SgElemwiseFusedParamParser(nnvm::NodeAttrs *attrs) {
+  CHECK_EQ(attrs->subgraphs.size(), 1U)
+      << "_sg_elemwise_fused needs the subgraph of the chain it evaluates";
+  attrs->parsed = CompileFusedElemwise(*attrs->subgraphs[0]);
+}
+
+static void SgElemwiseFusedForward(const nnvm::NodeAttrs& attrs,
+                                   const OpContext& ctx,
+                                   const std::vector<TBlob>& inputs,
+                                   const std::vector<OpReqType>& req,
+                                   const std::vector<TBlob>& outputs) {
+  const FusedElemwiseProgram& prog = nnvm::get<FusedElemwiseProgram>(attrs.parsed);
+  const mxnet::TShape& oshape = outputs[0].shape_;
+  for (const TBlob& out : outputs) {
+    CHECK_EQ(out.shape_, oshape) << "All outputs of a fused chain must have the same shape";
+  }
+  if (oshape.Size() == 0) return;
+  MSHADOW_REAL_TYPE_SWITCH(outputs[0].type_flag_, DType, {
+    RunFusedElemwise<DType, typename FusedAccType<DType>::type>(prog, inputs, req, outputs);
+  });
+}
+
+NNVM_REGISTER_OP(_sg_elemwise_fused)
+.describe(R"code(_sg_elemwise_fused)code" ADD_FILELINE)
+.set_num_inputs(DefaultSubgraphOpNumInputs)
+.set_num_outputs(DefaultSubgraphOpNumOutputs)
+.set_attr_parser(SgElemwiseFusedParamParser)
+.set_attr<nnvm::FListInputNames>("FListInputNames", DefaultSubgraphOpListInputs)
+.set_attr<nnvm::FListOutputNames>("FListOutputNames", DefaultSubgraphOpListOutputs)
+.set_attr<mxnet::FInferShape>("FInferShape", DefaultSubgraphOpShape)
+.set_attr<nnvm::FInferType>("FInferType", DefaultSubgraphOpType)
+.set_attr<FCompute>("FCompute<cpu>", SgElemwiseFusedForward);
+
+MXNET_REGISTER_SUBGRAPH_BACKEND(ELEMWISE_FUSION)
+.set_attr("context", Context::CPU());
+
+MXNET_REGISTER_SUBGRAPH_PROPERTY(ELEMWISE_FUSION, SgElemwiseFusionProperty);
+
+}  // namespace op
+}  // namespace mxnet
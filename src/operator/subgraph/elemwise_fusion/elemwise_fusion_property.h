@@ -0,0 +1,128 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2019 by Contributors
+ * \file elemwise_fusion_property.h
+ * \brief Partition graph property that fuses chains of elementwise operators
+ */
+#ifndef MXNET_OPERATOR_SUBGRAPH_ELEMWISE_FUSION_ELEMWISE_FUSION_PROPERTY_H_
+#define MXNET_OPERATOR_SUBGRAPH_ELEMWISE_FUSION_ELEMWISE_FUSION_PROPERTY_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "../common.h"
+#include "../subgraph_property.h"
+#include "./elemwise_fusion-inl.h"
+
+namespace mxnet {
+namespace op {
+
+/*
+ * Selects connected elementwise, broadcast and scalar operators, in both directions.
+ */
+class SgElemwiseFusionSelector : public SubgraphSelector {
+ public:
+  bool Select(const nnvm::Node &n) override {
+    return GetFusedStep(n, nullptr);
+  }
+
+  bool SelectInput(const nnvm::Node &n, const nnvm::Node &new_node) override {
+    return GetFusedStep(new_node, nullptr);
+  }
+
+  bool SelectOutput(const nnvm::Node &n, const nnvm::Node &new_node) override {
+    return GetFusedStep(new_node, nullptr);
+  }
+
+  std::vector<nnvm::Node *> Filter(const std::vector<nnvm::Node *> &candidates) override {
+    // a single operator already makes one pass over memory
+    if (candidates.size() < 2) return std::vector<nnvm::Node *>();
+    return candidates;
+  }
+};
+
+class SgElemwiseFusionProperty : public SubgraphProperty {
+ public:
+  static SubgraphPropertyPtr Create() {
+    static const std::string &name = "Elementwise fusion optimization pass";
+    auto property = std::make_shared<SgElemwiseFusionProperty>();
+    property->SetAttr<std::string>("property_name", name);
+    property->SetAttr<bool>("inference_only", true);
+    if (dmlc::GetEnv("MXNET_DISABLE_ELEMWISE_FUSION", 0)) {
+      property->SetAttr<bool>("disable", true);
+    }
+    return property;
+  }
+
+  nnvm::NodePtr CreateSubgraphNode(const nnvm::Symbol &sym,
+                                   const int subgraph_id = 0) const override {
+    if (!FitsOneLoop(sym)) return nullptr;
+    nnvm::NodePtr n = nnvm::Node::Create();
+    n->attrs.op = Op::Get("_sg_elemwise_fused");
+    n->attrs.name = "sg_elemwise_fused_" + std::to_string(subgraph_id);
+    n->attrs.subgraphs.emplace_back(std::make_shared<nnvm::Symbol>(sym));
+    n->op()->attr_parser(&(n->attrs));
+    return n;
+  }
+
+  SubgraphSelectorPtr CreateSubgraphSelector() const override {
+    return std::make_shared<SgElemwiseFusionSelector>();
+  }
+
+ private:
+  /*!
+   * \brief whether one loop over the elements can produce all outputs, which needs
+   *  them to have the same shape, and a floating point type to evaluate in.
+   *  Chains whose shapes or types were not inferred are left alone.
+   */
+  bool FitsOneLoop(const nnvm::Symbol &sym) const {
+    if (!HasAttr("graph")) return false;
+    const nnvm::Graph &g = GetAttr<nnvm::Graph>("graph");
+    if (!g.attrs.count("shape") || !g.attrs.count("dtype")) return false;
+    const auto &idx = g.indexed_graph();
+    const auto &shapes = g.GetAttr<mxnet::ShapeVector>("shape");
+    const auto &dtypes = g.GetAttr<nnvm::DTypeVector>("dtype");
+    bool fits = true;
+    nnvm::DFSVisit(sym.outputs, [&](const nnvm::NodePtr &node) {
+      if (node->is_variable()) return;
+      if (!idx.exist(node.get())) {
+        fits = false;
+        return;
+      }
+      const int dtype = dtypes[idx.entry_id(idx.node_id(node.get()), 0)];
+      if (dtype != mshadow::kFloat32 && dtype != mshadow::kFloat64 &&
+          dtype != mshadow::kFloat16) fits = false;
+    });
+    if (!fits) return false;
+    const mxnet::TShape &oshape =
+        shapes[idx.entry_id(idx.node_id(sym.outputs[0].node.get()), 0)];
+    if (!mxnet::shape_is_known(oshape)) return false;
+    for (const auto &e : sym.outputs) {
+      if (shapes[idx.entry_id(idx.node_id(e.node.get()), 0)] != oshape) return false;
+    }
+    return true;
+  }
+};
+
+}  // namespace op
+}  // namespace mxnet
+
+#endif  // MXNET_OPERATOR_SUBGRAPH_ELEMWISE_FUSION_ELEMWISE_FUSION_PROPERTY_H_
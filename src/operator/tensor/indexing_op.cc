@@ -25,6 +25,7 @@
 */
 
 #include "./indexing_op.h"
+#include "../../common/mapped_region.h"
 namespace mxnet {
 namespace op {
 
@@ -50,6 +51,35 @@ struct TakeCPU {
   }
 };
 
+/*!
+ * \brief when the rows of a take live in a memory mapped file, ask for all of
+ *  them before the gather, so that their page faults overlap instead of each
+ *  memcpy of TakeCPU stalling on its own
+ * \param idx the N indices, resolved as TakeCPU<clip> does
+ * \param in_data the (K, M) table
+ */
+template<bool clip, typename DType, typename IType>
+void PrefetchMappedRows(const IType* idx, size_t N, const DType* in_data,
+                        const size_t M, const int64_t K) {
+#if !defined(_WIN32)
+  std::shared_ptr<common::MappedRegion> region = common::MappedRegistry::Get()->Find(in_data);
+  if (region == nullptr || K == 0) return;
+  const size_t base = reinterpret_cast<const char*>(in_data) - region->begin();
+  std::vector<size_t> offsets(N);
+  for (size_t i = 0; i < N; ++i) {
+    int64_t j = static_cast<int64_t>(idx[i]);
+    if (clip) {
+      j = std::min(std::max(j, int64_t(0)), K - 1);
+    } else {
+      j = j % K;
+      j += (j < 0) ? K : 0;
+    }
+    offsets[i] = base + j * M * sizeof(DType);
+  }
+  region->WillNeed(&offsets, M * sizeof(DType));
+#endif  // !defined(_WIN32)
+}
+
 /*
  * \brief returns true if all indices are between [min, max]
  * \param data_ptr the indices to check
@@ -88,6 +118,8 @@ void EmbeddingOpForwardDnsImpl<cpu>(mshadow::Stream<cpu>* s,
       Tensor<cpu, 2, DType> wmat = weight.get<cpu, 2, DType>(s);
       Tensor<cpu, 2, DType> out = output.get_with_shape<cpu, 2, DType>(
         Shape2(oshape.ProdShape(0, oshape.ndim()-1), oshape[oshape.ndim()-1]), s);
+      PrefetchMappedRows<true>(idx.dptr_, idx.shape_.Size(), wmat.dptr_,
+                               wmat.shape_[1], wmat.shape_[0]);
       Kernel<TakeCPU<true>, cpu>::Launch(s, oshape.Size() / wmat.shape_[1], out.dptr_, wmat.dptr_,
                                          idx.dptr_, wmat.shape_[1], wmat.shape_[0]);
     });
@@ -304,12 +336,18 @@ void TakeOpForward<cpu>(const nnvm::NodeAttrs& attrs,
       }
       if (actual_axis == 0) {
         if (param.mode == take_::kClip) {
+          PrefetchMappedRows<true>(inputs[take_::kIdx].dptr<IType>(), idxshape.Size(),
+                                   inputs[take_::kArr].dptr<DType>(),
+                                   oshape.Size()/idxshape.Size(), arrshape[0]);
           Kernel<TakeCPU<true>, cpu>::Launch(s, idxshape.Size(),
                                              outputs[take_::kOut].dptr<DType>(),
                                              inputs[take_::kArr].dptr<DType>(),
                                              inputs[take_::kIdx].dptr<IType>(),
                                              oshape.Size()/idxshape.Size(), arrshape[0]);
         } else {
+          PrefetchMappedRows<false>(inputs[take_::kIdx].dptr<IType>(), idxshape.Size(),
+                                   inputs[take_::kArr].dptr<DType>(),
+                                   oshape.Size()/idxshape.Size(), arrshape[0]);
           Kernel<TakeCPU<false>, cpu>::Launch(s, idxshape.Size(),
                                               outputs[take_::kOut].dptr<DType>(),
                                               inputs[take_::kArr].dptr<DType>(),
@@ -349,6 +387,32 @@ void TakeOpForward<cpu>(const nnvm::NodeAttrs& attrs,
   });
 }
 
+/*!
+ * \brief CPU: sum the output gradient rows of every row group into a row of the
+ *  row_sparse gradient, in parallel over the groups
+ */
+template<typename DType, typename RType>
+void SumRowGroups(const std::vector<nnvm::dim_t>& rows,
+                  const std::vector<nnvm::dim_t>& offsets,
+                  const std::vector<nnvm::dim_t>& positions,
+                  const DType* ograd, const nnvm::dim_t row_length,
+                  RType* grad_idx, DType* grad_data) {
+  using nnvm::dim_t;
+  const dim_t nnr = rows.size();
+  const int omp_threads = engine::OpenMP::Get()->GetRecommendedOMPThreadCount();
+  #pragma omp parallel for num_threads(omp_threads)
+  for (dim_t r = 0; r < nnr; ++r) {
+    grad_idx[r] = static_cast<RType>(rows[r]);
+    DType* grad = grad_data + r * row_length;
+    const DType* first = ograd + positions[offsets[r]] * row_length;
+    std::copy(first, first + row_length, grad);
+    for (dim_t p = offsets[r] + 1; p < offsets[r + 1]; ++p) {
+      const DType* src = ograd + positions[p] * row_length;
+      for (dim_t j = 0; j < row_length; ++j) grad[j] += src[j];
+    }
+  }
+}
+
 template<>
 inline void SparseEmbeddingOpBackwardRspImpl<cpu>(const bool deterministic,
                                                   const OpContext& ctx,
@@ -365,17 +429,9 @@ inline void SparseEmbeddingOpBackwardRspImpl<cpu>(const bool deterministic,
   CHECK_EQ(req, kWriteTo) << "SparseEmbedding layer doesn't support "
                           << "weight gradient calculation with req != write";
 
-  // Request temporary storage for marking non-zero rows and prefix sum
   Stream<cpu> *s = ctx.get_stream<cpu>();
   dim_t num_rows = output.shape()[0];
   dim_t row_length = output.shape()[1];
-  size_t workspace_size = num_rows * sizeof(dim_t);
-  Tensor<cpu, 1, char> workspace =
-    ctx.requested[embedding::kTempSpace].get_space_typed<cpu, 1, char>(
-      Shape1(workspace_size), s);
-  dim_t* row_flg = reinterpret_cast<dim_t*>(workspace.dptr_);
-  // prefix sum array re-uses the row_flg array temp space
-  dim_t* prefix_sum = row_flg;
   dim_t data_size = static_cast<dim_t>(data.shape_.Size());
 
   MSHADOW_TYPE_SWITCH(data.type_flag_, IType, {
@@ -390,6 +446,29 @@ inline void SparseEmbeddingOpBackwardRspImpl<cpu>(const bool deterministic,
           bool is_valid = CheckIndexOutOfBound(data_ptr, data.shape_.Size(), min, max);
           CHECK(is_valid) << "Embedding input contains data out of bound";
         }
+        if (data_size < num_rows) {
+          // few indices into many rows: group the indices by row with a hash table
+          // instead of flagging and prefix summing all rows. The sums follow the
+          // input order, so this path is deterministic as well.
+          std::vector<dim_t> rows, offsets, positions;
+          GroupIndicesByRow(data.dptr<IType>(), data_size, num_rows, &rows, &offsets, &positions);
+          if (rows.empty()) {
+            FillZerosRspImpl(s, output);
+            return;
+          }
+          output.CheckAndAlloc({Shape1(rows.size())});
+          SumRowGroups(rows, offsets, positions, ograd.dptr<DType>(), row_length,
+                       output.aux_data(kIdx).dptr<RType>(), output.data().dptr<DType>());
+          return;
+        }
+        // Request temporary storage for marking non-zero rows and prefix sum
+        size_t workspace_size = num_rows * sizeof(dim_t);
+        Tensor<cpu, 1, char> workspace =
+          ctx.requested[embedding::kTempSpace].get_space_typed<cpu, 1, char>(
+            Shape1(workspace_size), s);
+        dim_t* row_flg = reinterpret_cast<dim_t*>(workspace.dptr_);
+        // prefix sum array re-uses the row_flg array temp space
+        dim_t* prefix_sum = row_flg;
         // mark row flags
         Fill<false>(s, TBlob(row_flg, Shape1(num_rows), cpu::kDevMask), kWriteTo, 0);
         Kernel<MarkRowFlgKernel, cpu>::Launch(s, data_size, row_flg, data.dptr<IType>());
@@ -588,6 +588,61 @@ struct AddTakeGradRspKernel {
   }
 };
 
+/*!
+ * \brief CPU: group the positions of an index array by the row they hit.
+ *  The distinct rows are found with a hash table, so the cost depends on the
+ *  number of indices rather than on the number of rows, and no full sort of
+ *  the indices is needed.
+ * \param idx the n indices
+ * \param num_rows indices must be in [0, num_rows)
+ * \param rows set to the distinct rows, in increasing order
+ * \param offsets set to the rows.size() + 1 bounds of the groups in positions
+ * \param positions set to the positions in idx hitting each row, in input order
+ * \return false if an index is out of bound
+ */
+template<typename IType>
+inline bool GroupIndicesByRow(const IType* idx, const nnvm::dim_t n,
+                              const nnvm::dim_t num_rows,
+                              std::vector<nnvm::dim_t>* rows,
+                              std::vector<nnvm::dim_t>* offsets,
+                              std::vector<nnvm::dim_t>* positions) {
+  using nnvm::dim_t;
+  int shift = 60;
+  while (shift > 0 && (dim_t(1) << (64 - shift)) < 2 * n) --shift;
+  const size_t mask = (size_t(1) << (64 - shift)) - 1;
+  std::vector<dim_t> keys(mask + 1, -1), slots(mask + 1);
+  std::vector<dim_t> group(n);
+  rows->clear();
+  for (dim_t i = 0; i < n; ++i) {
+    const dim_t row = static_cast<dim_t>(idx[i]);
+    if (row < 0 || row >= num_rows) return false;
+    // fibonacci hashing spreads the consecutive ids of frequency sorted vocabularies
+    size_t h = static_cast<size_t>((static_cast<uint64_t>(row) * 0x9E3779B97F4A7C15ULL) >> shift);
+    while (keys[h] != -1 && keys[h] != row) h = (h + 1) & mask;
+    if (keys[h] == -1) {
+      keys[h] = row;
+      slots[h] = rows->size();
+      rows->push_back(row);
+    }
+    group[i] = slots[h];
+  }
+  // number the groups by row
+  const dim_t num_groups = rows->size();
+  std::vector<dim_t> order(num_groups), rank(num_groups);
+  for (dim_t g = 0; g < num_groups; ++g) order[g] = g;
+  std::sort(order.begin(), order.end(),
+            [rows](dim_t a, dim_t b) { return (*rows)[a] < (*rows)[b]; });
+  for (dim_t r = 0; r < num_groups; ++r) rank[order[r]] = r;
+  std::sort(rows->begin(), rows->end());
+  offsets->assign(num_groups + 1, 0);
+  for (dim_t i = 0; i < n; ++i) ++(*offsets)[rank[group[i]] + 1];
+  for (dim_t r = 0; r < num_groups; ++r) (*offsets)[r + 1] += (*offsets)[r];
+  positions->resize(n);
+  std::vector<dim_t> cursor(offsets->begin(), offsets->end() - 1);
+  for (dim_t i = 0; i < n; ++i) (*positions)[cursor[rank[group[i]]]++] = i;
+  return true;
+}
+
 template<typename xpu>
 inline void SparseEmbeddingOpBackwardRspImpl(const bool deterministic,
                                              const OpContext& ctx,
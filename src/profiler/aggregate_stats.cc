@@ -27,9 +27,12 @@
 #include <mxnet/base.h>
 #include <fstream>
 #include <thread>
+#include <algorithm>
 #include <iomanip>
 #include <queue>
+#include <sstream>
 #include <utility>
+#include <vector>
 #include "./profiler.h"
 
 namespace mxnet {
@@ -93,6 +96,79 @@ void AggregateStats::OnProfileStat(const ProfileStat& stat) {
   }
 }
 
+void AggregateStats::OnDuration(const char *category, const char *name, uint64_t duration) {
+  std::unique_lock<std::mutex> lk(m_);
+  StatData& data = stats_[category][name];
+  data.type_ = StatData::kDuration;
+  ++data.total_count_;
+  data.total_aggregate_ += duration;
+  data.max_aggregate_ = std::max(data.max_aggregate_, duration);
+  data.min_aggregate_ = std::min(data.min_aggregate_, duration);
+}
+
+void AggregateStats::OnMemoryAlloc(const std::string& device, const std::string& op,
+                                   uint64_t bytes) {
+  std::unique_lock<std::mutex> lk(m_);
+  DeviceMemory& dev = memory_[device];
+  MemoryUse& use = dev.ops_[op];
+  use.live_ += bytes;
+  use.peak_ = std::max(use.peak_, use.live_);
+  ++use.alloc_count_;
+  use.alloc_bytes_ += bytes;
+  dev.live_ += bytes;
+  if (dev.live_ > dev.peak_) {
+    // remember who held the memory at the device peak
+    dev.peak_ = dev.live_;
+    for (auto& kv : dev.ops_) {
+      kv.second.at_device_peak_ = kv.second.live_;
+    }
+  }
+}
+
+void AggregateStats::OnMemoryFree(const std::string& device, const std::string& op,
+                                  uint64_t bytes) {
+  std::unique_lock<std::mutex> lk(m_);
+  DeviceMemory& dev = memory_[device];
+  MemoryUse& use = dev.ops_[op];
+  use.live_ -= std::min(use.live_, bytes);
+  dev.live_ -= std::min(dev.live_, bytes);
+}
+
+void AggregateStats::DumpMemoryTable(std::ostream& os) {
+  for (const auto& dev : memory_) {
+    os << "Top Memory Consumers: " << dev.first
+       << " (peak " << std::fixed << std::setprecision(4) << ByteToKilobyte(dev.second.peak_)
+       << " kB)" << std::endl << "=================" << std::endl;
+    os << std::setw(25) << std::left  << "Name"
+       << std::setw(16) << std::right << "Alloc Count" << " "
+       << std::setw(16) << std::right << "Alloc (kB)" << " "
+       << std::setw(16) << std::right << "Peak Use (kB)" << " "
+       << std::setw(16) << std::right << "At Dev Peak (kB)" << std::endl;
+    os << std::setw(25) << std::left  << "----"
+       << std::setw(16) << std::right << "-----------" << " "
+       << std::setw(16) << std::right << "----------" << " "
+       << std::setw(16) << std::right << "-------------" << " "
+       << std::setw(16) << std::right << "----------------" << std::endl;
+    std::vector<std::pair<uint64_t, std::string>> order;
+    for (const auto& op : dev.second.ops_) {
+      order.emplace_back(op.second.peak_, op.first);
+    }
+    std::sort(order.rbegin(), order.rend());
+    for (const auto& item : order) {
+      const MemoryUse& use = dev.second.ops_.at(item.second);
+      os << std::setw(25) << std::left << item.second
+         << std::setw(16) << std::right << use.alloc_count_ << " "
+         << std::fixed << std::setw(16) << std::setprecision(4) << std::right
+         << ByteToKilobyte(use.alloc_bytes_) << " "
+         << std::fixed << std::setw(16) << std::setprecision(4) << std::right
+         << ByteToKilobyte(use.peak_) << " "
+         << std::fixed << std::setw(16) << std::setprecision(4) << std::right
+         << ByteToKilobyte(use.at_device_peak_) << std::endl;
+    }
+    os << std::endl;
+  }
+}
+
 void AggregateStats::DumpTable(std::ostream& os, int sort_by, int ascending) {
   std::ios state(nullptr);
   state.copyfmt(os);
@@ -104,7 +180,8 @@ void AggregateStats::DumpTable(std::ostream& os, int sort_by, int ascending) {
   for (const auto& stat : stats_) {
     const std::string& type = stat.first;
     const std::unordered_map<std::string, StatData>& mm = stat.second;
-    bool is_memory = (type == "Device Storage"  || type == "Pool Memory");
+    bool is_memory = (type == "Device Storage"  || type == "Pool Memory" ||
+                      type == "Operator Memory");
     os << type << std::endl << "=================" << std::endl;
     os << std::setw(25) << std::left  << "Name"
         << std::setw(16) << std::right << "Total Count"
@@ -163,6 +240,7 @@ void AggregateStats::DumpTable(std::ostream& os, int sort_by, int ascending) {
     }
     os << std::endl;
   }
+  DumpMemoryTable(os);
   os << std::flush;
   os.copyfmt(state);
 }
@@ -177,7 +255,8 @@ void AggregateStats::DumpJson(std::ostream& os, int sort_by, int ascending) {
   for (const auto& stat : stats_) {
     const std::string& type = stat.first;
     const std::unordered_map<std::string, StatData>& mm = stat.second;
-    bool is_memory = (type == "Device Storage"  || type == "Pool Memory");
+    bool is_memory = (type == "Device Storage"  || type == "Pool Memory" ||
+                      type == "Operator Memory");
     ss = is_memory ? &memory_ss : &time_ss;
     if (ss->tellp() != std::streampos(0))
       *ss << "        ," << std::endl;
@@ -225,6 +304,34 @@ void AggregateStats::DumpJson(std::ostream& os, int sort_by, int ascending) {
     }
     *ss << "        }" << std::endl;
   }
+  std::stringstream operator_memory_ss;
+  for (const auto& dev : memory_) {
+    if (operator_memory_ss.tellp() != std::streampos(0))
+      operator_memory_ss << "        ," << std::endl;
+    operator_memory_ss << "        \"" << dev.first << "\": {" << std::endl
+                       << "            \"Peak\": " << std::setprecision(4)
+                       << ByteToKilobyte(dev.second.peak_) << "," << std::endl
+                       << "            \"Operators\": {" << std::endl;
+    bool first_op = true;
+    for (const auto& op : dev.second.ops_) {
+      if (!first_op)
+        operator_memory_ss << "                ," << std::endl;
+      first_op = false;
+      const MemoryUse& use = op.second;
+      operator_memory_ss << "                \"" << op.first << "\": {" << std::endl
+                         << "                    \"Count\": " << use.alloc_count_ << ","
+                         << std::endl
+                         << "                    \"Total\": " << std::setprecision(4)
+                         << ByteToKilobyte(use.alloc_bytes_) << "," << std::endl
+                         << "                    \"Peak\": " << std::setprecision(4)
+                         << ByteToKilobyte(use.peak_) << "," << std::endl
+                         << "                    \"AtDevicePeak\": " << std::setprecision(4)
+                         << ByteToKilobyte(use.at_device_peak_) << std::endl
+                         << "                }" << std::endl;
+    }
+    operator_memory_ss << "            }" << std::endl
+                       << "        }" << std::endl;
+  }
   os << "{" << std::endl
      << "    \"Time\": {" << std::endl
      << time_ss.str()
@@ -233,6 +340,10 @@ void AggregateStats::DumpJson(std::ostream& os, int sort_by, int ascending) {
      << "    \"Memory\": {" << std::endl
      << memory_ss.str()
      << "    }" << std::endl
+     << "    ," << std::endl
+     << "    \"Operator Memory\": {" << std::endl
+     << operator_memory_ss.str()
+     << "    }" << std::endl
      << "," << std::endl
      << "    \"Unit\": {" << std::endl
      << "        \"Time\": \"ms\"," << std::endl
@@ -246,6 +357,16 @@ void AggregateStats::DumpJson(std::ostream& os, int sort_by, int ascending) {
 void AggregateStats::clear() {
   std::unique_lock<std::mutex> lk(m_);
   stats_.clear();
+  // memory still allocated stays attributed, the peaks start over from it
+  for (auto& dev : memory_) {
+    dev.second.peak_ = dev.second.live_;
+    for (auto& op : dev.second.ops_) {
+      MemoryUse& use = op.second;
+      use.peak_ = use.at_device_peak_ = use.live_;
+      use.alloc_count_ = 0;
+      use.alloc_bytes_ = 0;
+    }
+  }
 }
 
 }  // namespace profiler
@@ -25,6 +25,7 @@
 #include <cstdint>
 #include <ostream>
 #include <mutex>
+#include <unordered_map>
 #include "./profiler.h"
 
 namespace mxnet {
@@ -56,6 +57,43 @@ class AggregateStats {
    * \param stat SIngle profile statistics to add to the accumulates statistics
    */
   void OnProfileStat(const ProfileStat& stat);
+  /*!
+   * \brief Record one duration directly, as a sampled operator does
+   * \param category Category of the duration
+   * \param name Name of the duration
+   * \param duration Duration in microseconds
+   */
+  void OnDuration(const char *category, const char *name, uint64_t duration);
+  /*!
+   * \brief Memory attributed to one operator on one device
+   */
+  struct MemoryUse {
+    /*! \brief bytes currently allocated */
+    uint64_t live_ = 0;
+    /*! \brief most bytes allocated at once */
+    uint64_t peak_ = 0;
+    /*! \brief bytes allocated when the device reached its peak */
+    uint64_t at_device_peak_ = 0;
+    /*! \brief number of allocations */
+    size_t alloc_count_ = 0;
+    /*! \brief bytes allocated over all allocations */
+    uint64_t alloc_bytes_ = 0;
+  };
+
+  /*!
+   * \brief Record an allocation made on behalf of an operator
+   * \param device Name of the device
+   * \param op Name of the operator
+   * \param bytes Size of the allocation
+   */
+  void OnMemoryAlloc(const std::string& device, const std::string& op, uint64_t bytes);
+  /*!
+   * \brief Record the release of an allocation made on behalf of an operator
+   * \param device Name of the device
+   * \param op Name of the operator
+   * \param bytes Size of the allocation
+   */
+  void OnMemoryFree(const std::string& device, const std::string& op, uint64_t bytes);
   /*!
    * \brief Print profliing statistics to console in a tabular format
    * \param sort_by by which stat to sort the entries, can be "avg", "min", "max", or "count"
@@ -82,6 +120,16 @@ class AggregateStats {
   std::mutex m_;
   /* !\brief Stat type -> State name -> Stats */
   std::map<std::string, std::unordered_map<std::string, StatData>> stats_;
+  /*! \brief Memory use of one device and of the operators allocating on it */
+  struct DeviceMemory {
+    uint64_t live_ = 0;
+    uint64_t peak_ = 0;
+    std::unordered_map<std::string, MemoryUse> ops_;
+  };
+  /*! \brief Device name -> memory use */
+  std::map<std::string, DeviceMemory> memory_;
+  /*! \brief Print the operators of every device by peak memory use */
+  void DumpMemoryTable(std::ostream& os);
 };
 
 }  // namespace profiler
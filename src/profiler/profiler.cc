@@ -128,7 +128,9 @@ void Profiler::SetConfig(int mode,
                          std::string output_filename,
                          bool continuous_dump,
                          float dump_period,
-                         bool aggregate_stats) {
+                         bool aggregate_stats,
+                         uint32_t sample_period,
+                         uint64_t sample_interval_us) {
   CHECK(!continuous_dump || dump_period > 0);
   std::lock_guard<std::recursive_mutex> lock{this->m_};
   this->mode_ = mode;
@@ -138,14 +140,23 @@ void Profiler::SetConfig(int mode,
     ::unlink(this->filename_.c_str());
   }
   SetContinuousProfileDump(continuous_dump, dump_period);
-  // Adjust whether storing aggregate stats as necessary
-  if (aggregate_stats) {
-    if (!aggregate_stats_) {
-      aggregate_stats_ = std::make_shared<AggregateStats>();
+  // Samples left from the previous configuration go to the stats they were taken for
+  FlushSamples();
+  this->sample_period_ = sample_period;
+  this->sample_interval_us_ = sample_interval_us;
+  // Adjust whether storing aggregate stats as necessary, samples have nowhere else to go
+  {
+    // The sample flusher copies aggregate_stats_ without holding m_
+    std::lock_guard<std::mutex> sample_lock{this->sample_mutex_};
+    if (aggregate_stats || IsSampling()) {
+      if (!aggregate_stats_) {
+        aggregate_stats_ = std::make_shared<AggregateStats>();
+      }
+    } else if (aggregate_stats_) {
+      aggregate_stats_.reset();
     }
-  } else if (aggregate_stats_) {
-    aggregate_stats_.reset();
   }
+  SetSampleFlush(IsSampling());
 }
 
 /*
@@ -294,5 +305,69 @@ void Profiler::SetContinuousProfileDump(bool continuous_dump, float delay_in_sec
   }
 }
 
+SampleRing *Profiler::NewSampleRing() {
+  std::lock_guard<std::mutex> lock{this->sample_mutex_};
+  // rings are never freed, the flusher may still read one after its thread exits
+  sample_rings_.emplace_back(std::make_shared<SampleRing>());
+  return sample_rings_.back().get();
+}
+
+void Profiler::FlushSamples() {
+  std::lock_guard<std::mutex> lock{this->sample_mutex_};
+  // Hold ref in case SetConfig() resets aggregate_stats_
+  std::shared_ptr<AggregateStats> ptr_aggregate_stats = aggregate_stats_;
+  uint64_t dropped = 0;
+  for (const auto &ring : sample_rings_) {
+    ring->Drain([&ptr_aggregate_stats](const SampleRing::Sample &sample) {
+      if (ptr_aggregate_stats) {
+        ptr_aggregate_stats->OnDuration(sample.category_, sample.name_.c_str(),
+                                        sample.duration_);
+      }
+    });
+    dropped += ring->dropped_.load(std::memory_order_relaxed);
+  }
+  if (dropped > samples_dropped_) {
+    LOG(WARNING) << "Profiler dropped " << dropped - samples_dropped_ << " operator samples, "
+                 << "increase sample_period or sample_interval_us";
+    samples_dropped_ = dropped;
+  }
+}
+
+static constexpr char SAMPLE_THREAD_NAME[] = "FlushSamplesTimer";
+/*! \brief period of the background flush of samples, in milliseconds */
+static constexpr size_t SAMPLE_FLUSH_PERIOD_MS = 100;
+
+void Profiler::SetSampleFlush(bool enable) {
+  std::lock_guard<std::recursive_mutex> lock{this->m_};
+  std::shared_ptr<dmlc::ThreadGroup::Thread> old_thread =
+    thread_group_->thread_by_name(SAMPLE_THREAD_NAME);
+  if (enable) {
+    if (old_thread && old_thread->is_shutdown_requested()) {
+      // Still winding down from a previous configuration, wait for it
+      if (old_thread->joinable()) {
+        old_thread->join();
+      } else {
+        do {
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        } while (thread_group_->thread_by_name(SAMPLE_THREAD_NAME));
+      }
+      old_thread.reset();
+    }
+    if (!old_thread) {
+      dmlc::CreateTimer(
+        SAMPLE_THREAD_NAME,
+        std::chrono::milliseconds(SAMPLE_FLUSH_PERIOD_MS),
+        thread_group_.get(),
+        [this]() -> int {
+          FlushSamples();
+          return 0;
+        });
+    }
+  } else if (old_thread) {
+    // Signal it to finish asynchronously
+    old_thread->request_shutdown();
+  }
+}
+
 }  // namespace profiler
 }  // namespace mxnet
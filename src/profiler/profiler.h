@@ -33,6 +33,7 @@
 #include <mutex>
 #include <memory>
 #include <array>
+#include <atomic>
 #include "./vtune.h"
 #include "./aggregate_stats.h"
 #include "./nvtx.h"
@@ -236,6 +237,62 @@ struct DeviceStats {
   std::shared_ptr<TQueue> opr_exec_stats_ = std::make_shared<TQueue>();
 };
 
+/*!
+ * \brief Fixed size ring of sampled operator durations. Written by one thread
+ *  (the one running the operators), read by the flusher, without locks.
+ */
+struct SampleRing {
+  /*! \brief One sampled operator execution */
+  struct Sample {
+    /*! \brief category, the name of a static profile domain */
+    const char *category_;
+    profile_stat_string name_;
+    uint64_t duration_;
+  };
+  /*! \brief number of samples held between two flushes, a power of two */
+  static constexpr size_t kCapacity = 1024;
+
+  /*!
+   * \brief Record a sample, called by the owning thread only
+   * \return false if the ring is full and the sample was dropped
+   */
+  inline bool Push(const char *category, const char *name, uint64_t duration) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == kCapacity) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    Sample &sample = samples_[head & (kCapacity - 1)];
+    sample.category_ = category;
+    sample.name_.set(name);
+    sample.duration_ = duration;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+  /*!
+   * \brief Hand every recorded sample to fn, called by one reader at a time
+   * \return number of samples read
+   */
+  template<typename Fn>
+  inline size_t Drain(Fn fn) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t head = head_.load(std::memory_order_acquire);
+    for (size_t i = tail; i != head; ++i) {
+      fn(samples_[i & (kCapacity - 1)]);
+    }
+    tail_.store(head, std::memory_order_release);
+    return head - tail;
+  }
+
+  std::array<Sample, kCapacity> samples_;
+  /*! \brief next slot to write */
+  std::atomic<size_t> head_{0};
+  /*! \brief next slot to read */
+  std::atomic<size_t> tail_{0};
+  /*! \brief samples lost because the flusher fell behind */
+  std::atomic<uint64_t> dropped_{0};
+};
+
 /*!
  *  _____              __  _  _
  * |  __ \            / _|(_)| |
@@ -273,11 +330,17 @@ class Profiler {
    * \param output_filename profile output file name
    * \param continuous_dump true if profile information should be periodically dumped
    * \param dump_period Period (in seconds) of profile info dumping
+   * \param aggregate_stats whether to maintain aggregate stats
+   * \param sample_period if not 0, only profile one in every sample_period operators
+   * \param sample_interval_us if not 0, profile an operator at least this often (microseconds)
+   * \note Sampled operators only feed the aggregate stats, which are then always kept
    */
   void SetConfig(int mode, std::string output_filename,
                  bool continuous_dump,
                  float dump_period,
-                 bool aggregate_stats);
+                 bool aggregate_stats,
+                 uint32_t sample_period = 0,
+                 uint64_t sample_interval_us = 0);
 
   /*! \return mode of profiler */
   inline int GetMode() const {
@@ -288,6 +351,46 @@ class Profiler {
     return GetState() == kRunning && (GetMode() & pm) == pm;
   }
 
+  /*! \return whether operators are sampled instead of all traced */
+  inline bool IsSampling() const {
+    return sample_period_ != 0 || sample_interval_us_ != 0;
+  }
+
+  /*!
+   * \brief Decide whether the operator the calling thread is about to push is sampled:
+   *  the sample_period-th operator since the last sample is, and so is the first one
+   *  sample_interval_us after it
+   */
+  inline bool SampleNext() {
+    static MX_THREAD_LOCAL uint32_t since_sample = 0;
+    static MX_THREAD_LOCAL uint64_t last_sample_time = 0;
+    bool sample = sample_period_ != 0 && ++since_sample >= sample_period_;
+    if (sample_interval_us_ != 0) {
+      const uint64_t now = ProfileStat::NowInMicrosec();
+      sample = sample || now - last_sample_time >= sample_interval_us_;
+      if (sample) last_sample_time = now;
+    }
+    if (sample) since_sample = 0;
+    return sample;
+  }
+
+  /*!
+   * \brief Record the duration of a sampled operator into the ring of the calling thread
+   * \param category category of the operator, must outlive the profiler
+   * \param name name of the operator
+   * \param duration execution time in microseconds
+   */
+  inline void RecordSample(const char *category, const char *name, uint64_t duration) {
+    static MX_THREAD_LOCAL SampleRing *ring = nullptr;
+    if (ring == nullptr) {
+      ring = NewSampleRing();
+    }
+    ring->Push(category, name, duration);
+  }
+
+  /*! \brief Move the samples of every thread into the aggregate stats */
+  void FlushSamples();
+
   /*! \return whether the profiler is enabled to output */
   inline bool IsEnableOutput() const {
     return this->enable_output_;
@@ -439,6 +542,15 @@ class Profiler {
    */
   void SetContinuousProfileDump(bool continuous_dump, float delay_in_seconds);
 
+  /*!
+   * \brief Start or stop the timer flushing samples in the background
+   * \param enable Whether samples are being recorded
+   */
+  void SetSampleFlush(bool enable);
+
+  /*! \brief Create and register the sample ring of the calling thread */
+  SampleRing *NewSampleRing();
+
   /*! \brief internal mutex of the profiler */
   std::recursive_mutex m_;
   /*! \brief indicate whether the profiler is running */
@@ -476,6 +588,17 @@ class Profiler {
   std::shared_ptr<dmlc::ThreadGroup> thread_group_ = std::make_shared<dmlc::ThreadGroup>();
   /* !\brief pids */
   std::unordered_set<uint32_t> process_ids_;
+  /*! \brief profile one in every sample_period_ operators, 0 to not sample by count */
+  volatile uint32_t sample_period_ = 0;
+  /*! \brief profile an operator every sample_interval_us_, 0 to not sample by time */
+  volatile uint64_t sample_interval_us_ = 0;
+  /*! \brief guards sample_rings_ and serializes their readers, also taken with m_ to
+   *  change aggregate_stats_ */
+  std::mutex sample_mutex_;
+  /*! \brief sample rings of every thread that ran a sampled operator */
+  std::vector<std::shared_ptr<SampleRing>> sample_rings_;
+  /*! \brief samples dropped so far, reported once at every flush losing some */
+  uint64_t samples_dropped_ = 0;
 };
 
 #ifdef MXNET_USE_VTUNE
@@ -1163,7 +1286,8 @@ struct ProfileOperator : public ProfileEvent {
       , as_task_(name, &domain_)
       , name_(name)
       , attributes_(attributes)
-      , profiling_(!IsDeprecatedOperator(name)) {
+      , profiling_(!IsDeprecatedOperator(name))
+      , sampled_(Profiler::Get()->IsSampling()) {
     if (IsSubOperatorOfCustom(name)) {
       as_task_.setDomain(&custom_op_domain);
       SetCategories(custom_op_domain.name());
@@ -1181,7 +1305,9 @@ struct ProfileOperator : public ProfileEvent {
   void startForDevice(mxnet::Context::DeviceType dev_type, uint32_t dev_id) {
     dev_type_ = dev_type;
     dev_id_ = dev_id;
-    if (profiling_) {
+    if (profiling_ && sampled_) {
+      start_time_ = ProfileStat::NowInMicrosec();
+    } else if (profiling_) {
       ProfileEvent::start();
       as_task_.start();
     }
@@ -1190,7 +1316,12 @@ struct ProfileOperator : public ProfileEvent {
    * \brief Stop the profiling scope
    */
   void stop() override {
-    if (profiling_) {
+    if (profiling_ && sampled_) {
+      // a sample only goes to the aggregate stats, through the ring of this thread
+      Profiler::Get()->RecordSample(IsSubOperatorOfCustom(name_.c_str()) ?
+                                      custom_op_domain.name() : domain_.name(),
+                                    name_.c_str(), ProfileStat::NowInMicrosec() - start_time_);
+    } else if (profiling_) {
       as_task_.stop();
       ProfileEvent::stop();
     }
@@ -1270,6 +1401,32 @@ struct ProfileOperator : public ProfileEvent {
   std::unique_ptr<Attributes> attributes_;
   /*! \brief Whether to profile or not */
   const bool profiling_;
+  /*! \brief Whether to record a sample instead of trace events */
+  const bool sampled_;
+};
+
+/*!
+ * \brief Names the operator the current thread allocates memory for, so that the
+ *  storage profiler can attribute allocations to it. Scopes nest; a scope without
+ *  a name keeps the enclosing one.
+ */
+class MemoryScope {
+ public:
+  explicit MemoryScope(const char *name) : prev_(Current()) {
+    if (name != nullptr) Current() = name;
+  }
+  ~MemoryScope() {
+    Current() = prev_;
+  }
+  /*! \brief name of the innermost scope of this thread, nullptr outside of any */
+  static const char *&Current() {
+    static MX_THREAD_LOCAL const char *name = nullptr;
+    return name;
+  }
+
+ private:
+  /*! \brief name of the enclosing scope */
+  const char *prev_;
 };
 
 /*
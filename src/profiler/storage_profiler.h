@@ -20,7 +20,11 @@
 #define MXNET_PROFILER_STORAGE_PROFILER_H_
 
 #include <mxnet/storage.h>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include "./profiler.h"
 
@@ -29,6 +33,9 @@ namespace storage {
 
 /*!
  * \brief Storage allocation/deallocation profiling via ProfileCounters
+ *  Every allocation is also attributed to the operator running on the allocating
+ *  thread (see profiler::MemoryScope): a counter per operator and device draws its
+ *  live bytes in the trace, and the aggregate stats keep its peak.
  */
 class DeviceStorageProfiler {
  public:
@@ -51,6 +58,7 @@ class DeviceStorageProfiler {
         const size_t idx = prof->DeviceIndex(handle.ctx.dev_type, handle.ctx.dev_id);
         CHECK_LT(idx, mem_counters_.size()) << "Invalid device index: " << idx;
         *mem_counters_[idx] += handle.size;
+        Attribute(handle, idx, prof);
       }
     }
   }
@@ -71,6 +79,7 @@ class DeviceStorageProfiler {
         } else {
             *mem_counters_[idx] = 0;
         }
+        Release(handle, prof);
       }
     }
   }
@@ -98,12 +107,77 @@ class DeviceStorageProfiler {
     }
   }
 
+  /*! \brief An allocation and the operator it is attributed to */
+  struct Attribution {
+    size_t dev_idx;
+    size_t size;
+    std::string op;
+  };
+
+  /*!
+   * \brief Attribute an allocation to the operator of the current memory scope
+   */
+  void Attribute(const Storage::Handle &handle, size_t idx, profiler::Profiler *prof) {
+    const char *scope = profiler::MemoryScope::Current();
+    std::string op = scope != nullptr ? scope : "<other>";
+    std::shared_ptr<profiler::AggregateStats> stats = prof->GetAggregateStats();
+    if (stats) stats->OnMemoryAlloc(prof->DeviceName(idx), op, handle.size);
+    std::lock_guard<std::mutex> lk(op_mutex_);
+    *OpCounter(idx, op, prof) += handle.size;
+    live_[handle.dptr] = Attribution{idx, handle.size, std::move(op)};
+  }
+
+  /*!
+   * \brief Release an allocation from the operator it was attributed to
+   */
+  void Release(const Storage::Handle &handle, profiler::Profiler *prof) {
+    Attribution freed;
+    {
+      std::lock_guard<std::mutex> lk(op_mutex_);
+      auto it = live_.find(handle.dptr);
+      // allocated before profiling started
+      if (it == live_.end()) return;
+      freed = std::move(it->second);
+      live_.erase(it);
+      profiler::ProfileCounter *counter = OpCounter(freed.dev_idx, freed.op, prof);
+      if (*counter >= static_cast<int64_t>(freed.size)) {
+        *counter -= freed.size;
+      } else {
+        *counter = 0;
+      }
+    }
+    std::shared_ptr<profiler::AggregateStats> stats = prof->GetAggregateStats();
+    if (stats) stats->OnMemoryFree(prof->DeviceName(freed.dev_idx), freed.op, freed.size);
+  }
+
+  /*!
+   * \brief The counter of the live bytes of an operator on a device, made on first use
+   * \note op_mutex_ must be held
+   */
+  profiler::ProfileCounter *OpCounter(size_t idx, const std::string &op,
+                                      profiler::Profiler *prof) {
+    std::string name = prof->DeviceName(idx);
+    name += ": ";
+    name += op;
+    std::unique_ptr<profiler::ProfileCounter> &counter = op_counters_[name];
+    if (!counter) counter.reset(new profiler::ProfileCounter(name.c_str(), &op_domain_));
+    return counter.get();
+  }
+
   /*! \brief Domain of the memory profiling information */
   profiler::ProfileDomain domain_;
   /*! \brief Mutex for lazy init */
   std::mutex init_mutex_;
   /*! \brief Constant-sized vector of memory profile counters */
   std::vector<std::shared_ptr<profiler::ProfileCounter>> mem_counters_;
+  /*! \brief Domain of the per operator memory counters */
+  profiler::ProfileDomain op_domain_{"Operator Memory"};
+  /*! \brief Guards the per operator bookkeeping */
+  std::mutex op_mutex_;
+  /*! \brief "device: operator" -> live bytes */
+  std::unordered_map<std::string, std::unique_ptr<profiler::ProfileCounter>> op_counters_;
+  /*! \brief Live allocations made while profiling */
+  std::unordered_map<void*, Attribution> live_;
 };
 
 }  // namespace storage
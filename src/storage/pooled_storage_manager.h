@@ -33,10 +33,13 @@
 #include <mxnet/storage.h>
 #include <unordered_map>
 #include <algorithm>
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <mutex>
 #include <new>
 #include "./storage_manager.h"
+#include "./cpu_device_storage.h"
 #include "../common/cuda_utils.h"
 #include "../common/utils.h"
 
@@ -44,6 +47,239 @@
 namespace mxnet {
 namespace storage {
 
+/*!
+ * \brief Storage manager with a size-class memory pool on CPU.
+ *
+ * Requested sizes are rounded with the same scheme as GPUPooledRoundedStorageManager:
+ * powers of 2 up to 2 ** cut_off_, multiples of 2 ** cut_off_ above it. Freed blocks
+ * are first kept in a per-thread free list, so that the common alloc/free pattern of
+ * the engine worker threads only takes an uncontended per-thread lock. Once a thread has
+ * cached more than MXNET_CPU_MEM_POOL_THREAD_CACHE_SIZE bytes, further blocks go to a
+ * shared pool guarded by a mutex, from which every thread can refill.
+ *
+ * The per-thread free lists are owned by the manager and kept in a registry, so that
+ * ReleaseAll and the destructor can drain the lists of every thread. The free list of
+ * an exited thread is handed over to the next thread that starts allocating.
+ */
+class CPUPooledRoundedStorageManager final : public StorageManager {
+ public:
+  /*!
+   * \brief Default constructor.
+   */
+  CPUPooledRoundedStorageManager() : id_(NextId()) {
+    page_size_ = dmlc::GetEnv("MXNET_CPU_MEM_POOL_PAGE_SIZE", 64);
+    cut_off_ = dmlc::GetEnv("MXNET_CPU_MEM_POOL_ROUND_LINEAR_CUTOFF", 24);
+    thread_cache_size_ = dmlc::GetEnv("MXNET_CPU_MEM_POOL_THREAD_CACHE_SIZE",
+                                      static_cast<size_t>(16 * 1024 * 1024));
+    if (page_size_ < 16) {
+      LOG(FATAL) << "MXNET_CPU_MEM_POOL_PAGE_SIZE cannot be set to a value smaller than 16. " \
+                 << "Got: " << page_size_ << ".";
+    }
+    if (page_size_ != 1ul << common::ilog2ul(page_size_ - 1)) {
+      LOG(FATAL) << "MXNET_CPU_MEM_POOL_PAGE_SIZE must be a power of 2. Got: " << page_size_ << ".";
+    }
+    page_size_ = common::ilog2ul(page_size_ - 1);
+    if (cut_off_ < 20 || cut_off_ > LOG2_MAX_MEM) {
+      LOG(FATAL) << "MXNET_CPU_MEM_POOL_ROUND_LINEAR_CUTOFF cannot be set to a value " \
+                 << "smaller than 20 or greater than " << LOG2_MAX_MEM << ". Got: " \
+                 << cut_off_ << ".";
+    }
+    memory_pool_ = std::vector<std::vector<void*>>((1ul << (LOG2_MAX_MEM - cut_off_)) + cut_off_);
+  }
+  /*!
+   * \brief Default destructor.
+   */
+  ~CPUPooledRoundedStorageManager() {
+    ReleaseAll();
+  }
+
+  void Alloc(Storage::Handle* handle) override {
+    // Set dptr to nullptr when handle size is 0.
+    if (handle->size == 0) {
+      handle->dptr = nullptr;
+      return;
+    }
+    if (handle->size > (1ul << LOG2_MAX_MEM)) {
+      CPUDeviceStorage::Alloc(handle);
+      return;
+    }
+    int bucket = get_bucket(handle->size);
+    ThreadCache* cache = GetThreadCache();
+    {
+      std::lock_guard<std::mutex> lock(cache->mutex);
+      if (cache->pool.size() > static_cast<size_t>(bucket) && !cache->pool[bucket].empty()) {
+        handle->dptr = cache->pool[bucket].back();
+        cache->pool[bucket].pop_back();
+        cache->bytes -= get_size(bucket);
+        return;
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto&& reuse_pool = memory_pool_[bucket];
+      if (!reuse_pool.empty()) {
+        handle->dptr = reuse_pool.back();
+        reuse_pool.pop_back();
+        return;
+      }
+    }
+    Storage::Handle rounded = *handle;
+    rounded.size = get_size(bucket);
+    CPUDeviceStorage::Alloc(&rounded);
+    handle->dptr = rounded.dptr;
+  }
+
+  void Free(Storage::Handle handle) override {
+    // Do nothing if dptr is nullptr. Otherwise, nullptr may be reused.
+    if (handle.dptr == nullptr) return;
+    if (handle.size > (1ul << LOG2_MAX_MEM)) {
+      CPUDeviceStorage::Free(handle);
+      return;
+    }
+    int bucket = get_bucket(handle.size);
+    size_t size = get_size(bucket);
+    ThreadCache* cache = GetThreadCache();
+    {
+      std::lock_guard<std::mutex> lock(cache->mutex);
+      if (cache->bytes + size <= thread_cache_size_) {
+        if (cache->pool.size() <= static_cast<size_t>(bucket)) {
+          cache->pool.resize(memory_pool_.size());
+        }
+        cache->pool[bucket].push_back(handle.dptr);
+        cache->bytes += size;
+        return;
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    memory_pool_[bucket].push_back(handle.dptr);
+  }
+
+  void DirectFree(Storage::Handle handle) override {
+    CPUDeviceStorage::Free(handle);
+  }
+
+  /*!
+   * \brief Release the shared pool and the free lists of all threads.
+   */
+  void ReleaseAll() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto&& cache : caches_) {
+      std::lock_guard<std::mutex> cache_lock(cache->mutex);
+      cache->Release();
+    }
+    for (auto&& reuse_pool : memory_pool_) {
+      for (auto&& ptr : reuse_pool) {
+        Storage::Handle handle;
+        handle.dptr = ptr;
+        CPUDeviceStorage::Free(handle);
+      }
+      reuse_pool.clear();
+    }
+  }
+
+ private:
+  /*! \brief free lists of one thread, indexed by bucket */
+  struct ThreadCache {
+    // taken by the owning thread, and by ReleaseAll while draining the lists
+    std::mutex mutex;
+    std::vector<std::vector<void*>> pool;
+    size_t bytes = 0;
+    // false once the owning thread has exited, guarded by mutex
+    bool in_use = true;
+    void Release() {
+      for (auto&& reuse_pool : pool) {
+        for (auto&& ptr : reuse_pool) {
+          Storage::Handle handle;
+          handle.dptr = ptr;
+          CPUDeviceStorage::Free(handle);
+        }
+        reuse_pool.clear();
+      }
+      bytes = 0;
+    }
+  };
+
+  /*! \brief thread local references to the free lists of the calling thread, by manager id */
+  struct ThreadCacheRef {
+    std::unordered_map<uint64_t, std::shared_ptr<ThreadCache>> caches;
+    uint64_t last_id = 0;
+    ThreadCache* last = nullptr;
+    ~ThreadCacheRef() {
+      // only the caches are touched here, the managers may already be destroyed
+      for (auto&& kv : caches) {
+        std::lock_guard<std::mutex> lock(kv.second->mutex);
+        kv.second->in_use = false;
+      }
+    }
+  };
+
+  static uint64_t NextId() {
+    static std::atomic<uint64_t> next_id(1);
+    return next_id++;
+  }
+
+  ThreadCache* GetThreadCache() {
+    static thread_local ThreadCacheRef ref;
+    if (ref.last_id == id_) return ref.last;
+    std::shared_ptr<ThreadCache>& cache = ref.caches[id_];
+    if (!cache) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto&& c : caches_) {
+        std::lock_guard<std::mutex> cache_lock(c->mutex);
+        if (!c->in_use) {
+          c->in_use = true;
+          cache = c;
+          break;
+        }
+      }
+      if (!cache) {
+        cache = std::make_shared<ThreadCache>();
+        caches_.push_back(cache);
+      }
+    }
+    ref.last_id = id_;
+    ref.last = cache.get();
+    return ref.last;
+  }
+
+  inline int div_pow2_round_up(size_t s, int divisor_log2) {
+    size_t result = s >> divisor_log2;
+    return static_cast<int>(result + (s > (result << divisor_log2) ? 1 : 0));
+  }
+  inline int get_bucket(size_t s) {
+    int log_size = common::ilog2ul(s - 1);
+    if (log_size > static_cast<int>(cut_off_))
+      return div_pow2_round_up(s, cut_off_) - 1 + cut_off_;
+    else
+      return std::max(log_size, static_cast<int>(page_size_));
+  }
+  inline size_t get_size(int bucket) {
+    if (bucket <= static_cast<int>(cut_off_))
+      return 1ul << bucket;
+    else
+      return (bucket - cut_off_ + 1) * (1ul << cut_off_);
+  }
+
+ private:
+  // log2 of maximum pooled size. 16GB, larger requests bypass the pool
+  const size_t LOG2_MAX_MEM = 34;
+  // log2 of the smallest block size
+  size_t page_size_;
+  // log2 of memory size before switching to exponential mode to linear mode
+  size_t cut_off_;
+  // maximum number of bytes kept in the free lists of one thread
+  size_t thread_cache_size_;
+  // unique id, keys the thread local references to the free lists
+  const uint64_t id_;
+  // mutex guarding the shared pool and the registry of free lists
+  std::mutex mutex_;
+  // shared memory pool
+  std::vector<std::vector<void*>> memory_pool_;
+  // free lists of all threads that allocated from this manager
+  std::vector<std::shared_ptr<ThreadCache>> caches_;
+  DISALLOW_COPY_AND_ASSIGN(CPUPooledRoundedStorageManager);
+};  // class CPUPooledRoundedStorageManager
+
 #if MXNET_USE_CUDA
 /*!
  * \brief Storage manager with a memory pool on gpu. Memory chunks are reused based on exact size
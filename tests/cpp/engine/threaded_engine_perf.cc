@@ -0,0 +1,96 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2019 by Contributors
+ * \file threaded_engine_perf.cc
+ * \brief throughput of pushing small operators to the threaded engines
+*/
+#include <dmlc/logging.h>
+#include <dmlc/timer.h>
+#include <gtest/gtest.h>
+#include <mxnet/engine.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/engine/engine_impl.h"
+#include "../include/test_util.h"
+
+namespace {
+
+/*!
+ * \brief Push num_ops empty operators from each of num_pushers threads.
+ *  Every operator reads one variable shared by all pushers and writes one
+ *  variable owned by its pusher, so both the uncontended and the contended
+ *  paths of the variable dependency queues are exercised.
+ * \return pushes per second, measured until all operators completed
+ */
+double PushThroughput(mxnet::Engine* engine, int num_pushers, int num_ops) {
+  auto shared_var = engine->NewVariable();
+  std::vector<mxnet::Engine::VarHandle> own_vars(num_pushers);
+  for (auto& var : own_vars) var = engine->NewVariable();
+
+  const double start = dmlc::GetTime();
+  std::vector<std::thread> pushers;
+  for (int t = 0; t < num_pushers; ++t) {
+    pushers.emplace_back([engine, shared_var, &own_vars, t, num_ops]() {
+      for (int i = 0; i < num_ops; ++i) {
+        engine->PushSync([](mxnet::RunContext) {}, mxnet::Context::CPU(),
+                         {shared_var}, {own_vars[t]});
+      }
+    });
+  }
+  for (auto& t : pushers) t.join();
+  engine->WaitForAll();
+  const double elapsed = dmlc::GetTime() - start;
+
+  engine->DeleteVariable([](mxnet::RunContext) {}, mxnet::Context::CPU(), shared_var);
+  for (auto& var : own_vars) {
+    engine->DeleteVariable([](mxnet::RunContext) {}, mxnet::Context::CPU(), var);
+  }
+  engine->WaitForAll();
+  return static_cast<double>(num_pushers) * num_ops / elapsed;
+}
+
+}  // namespace
+
+TEST(ENGINE_PERF, PushThroughput) {
+  const int max_pushers = mxnet::test::performance_run
+                          ? std::max(1, static_cast<int>(std::thread::hardware_concurrency()))
+                          : 2;
+  const int num_ops = mxnet::test::performance_run ? 100000 : 1000;
+  std::vector<std::string> type_names = {"ThreadedEnginePooled", "ThreadedEnginePerDevice",
+                                         "ThreadedEnginePerDeviceWorkStealing"};
+  std::vector<mxnet::Engine*> engines = {
+    mxnet::engine::CreateThreadedEnginePooled(),
+    mxnet::engine::CreateThreadedEnginePerDevice(),
+    mxnet::engine::CreateThreadedEnginePerDeviceWorkStealing()
+  };
+
+  for (size_t k = 0; k < engines.size(); ++k) {
+    for (int num_pushers = 1; num_pushers <= max_pushers; num_pushers *= 2) {
+      const double rate = PushThroughput(engines[k], num_pushers, num_ops);
+      EXPECT_GT(rate, 0.0);
+      LOG(INFO) << type_names[k] << "\t" << num_pushers << " pusher(s)\t"
+                << static_cast<int64_t>(rate) << " pushes/sec";
+    }
+  }
+}
@@ -124,12 +124,14 @@ double EvaluateWorkloads(const std::vector<Workload>& workloads,
 }
 
 TEST(Engine, start_stop) {
-  const int num_engine = 3;
+  const int num_engine = 4;
   std::vector<mxnet::Engine*> engine(num_engine);
   engine[0] = mxnet::engine::CreateNaiveEngine();
   engine[1] = mxnet::engine::CreateThreadedEnginePooled();
   engine[2] = mxnet::engine::CreateThreadedEnginePerDevice();
-  std::string type_names[3] = {"NaiveEngine", "ThreadedEnginePooled", "ThreadedEnginePerDevice"};
+  engine[3] = mxnet::engine::CreateThreadedEnginePerDeviceWorkStealing();
+  std::string type_names[4] = {"NaiveEngine", "ThreadedEnginePooled", "ThreadedEnginePerDevice",
+                               "ThreadedEnginePerDeviceWorkStealing"};
 
   for (int i = 0; i < num_engine; ++i) {
     LOG(INFO) << "Stopping: " << type_names[i];
@@ -143,7 +145,7 @@ TEST(Engine, start_stop) {
 TEST(Engine, RandSumExpr) {
   std::vector<Workload> workloads;
   int num_repeat = 5;
-  const int num_engine = 4;
+  const int num_engine = 5;
 
   std::vector<double> t(num_engine, 0.0);
   std::vector<mxnet::Engine*> engine(num_engine);
@@ -152,6 +154,7 @@ TEST(Engine, RandSumExpr) {
   engine[1] = mxnet::engine::CreateNaiveEngine();
   engine[2] = mxnet::engine::CreateThreadedEnginePooled();
   engine[3] = mxnet::engine::CreateThreadedEnginePerDevice();
+  engine[4] = mxnet::engine::CreateThreadedEnginePerDeviceWorkStealing();
 
   for (int repeat = 0; repeat < num_repeat; ++repeat) {
     srand(time(NULL) + repeat);
@@ -174,6 +177,7 @@ TEST(Engine, RandSumExpr) {
   LOG(INFO) << "NaiveEngine\t\t"  << t[1] << " sec";
   LOG(INFO) << "ThreadedEnginePooled\t" << t[2] << " sec";
   LOG(INFO) << "ThreadedEnginePerDevice\t" << t[3] << " sec";
+  LOG(INFO) << "ThreadedEnginePerDeviceWorkStealing\t" << t[4] << " sec";
 }
 
 void Foo(mxnet::RunContext, int i) { printf("The fox says %d\n", i); }
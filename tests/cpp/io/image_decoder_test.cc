@@ -0,0 +1,76 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2019 by Contributors
+ * \file image_decoder_test.cc
+ * \brief scaled and region of interest image decoding tests
+*/
+
+#if MXNET_USE_OPENCV
+#include <gtest/gtest.h>
+#include <vector>
+#include "../src/io/image_decoder.h"
+
+TEST(ImageDecoder, ScaledRegion) {
+  using mxnet::io::ImageAugmenter;
+  cv::Mat img(480, 640, CV_8UC3);
+  cv::randu(img, cv::Scalar::all(0), cv::Scalar::all(255));
+  std::vector<uchar> encoded;
+  ASSERT_TRUE(cv::imencode(".jpg", img, encoded));
+  cv::Mat buf(1, encoded.size(), CV_8U, encoded.data());
+
+  int width = 0, height = 0;
+  ASSERT_TRUE(mxnet::io::JPEGImageSize(encoded.data(), encoded.size(), &width, &height));
+  EXPECT_EQ(width, 640);
+  EXPECT_EQ(height, 480);
+  EXPECT_EQ(mxnet::io::DecodeScaleDenom(4000, 3000, 224, 224), 8);
+  EXPECT_EQ(mxnet::io::DecodeScaleDenom(1000, 500, 224, 224), 2);
+  EXPECT_EQ(mxnet::io::DecodeScaleDenom(224, 224, 224, 224), 1);
+
+  cv::Mat full = mxnet::io::DecodeImage(buf, 1, nullptr);
+  EXPECT_EQ(full.cols, 640);
+  EXPECT_EQ(full.rows, 480);
+
+  ImageAugmenter::DecodeHint hint;
+  hint.min_width = 150;
+  hint.min_height = 100;
+  cv::Mat scaled = mxnet::io::DecodeImage(buf, 1, &hint);
+  EXPECT_EQ(scaled.cols, 160);
+  EXPECT_EQ(scaled.rows, 120);
+
+  hint.roi = cv::Rect(100, 50, 300, 200);
+  hint.min_width = 64;
+  hint.min_height = 64;
+  cv::Mat region = mxnet::io::DecodeImage(buf, 0, &hint);
+  EXPECT_EQ(region.channels(), 1);
+  EXPECT_EQ(region.cols, 150);
+  EXPECT_EQ(region.rows, 100);
+
+  // without downscaling the region matches a crop of the full decode
+  hint.min_width = 300;
+  hint.min_height = 200;
+  cv::Mat exact = mxnet::io::DecodeImage(buf, 1, &hint);
+  ASSERT_EQ(exact.cols, 300);
+  ASSERT_EQ(exact.rows, 200);
+  // chroma upsampling may differ along the cut, compare the interior
+  cv::Rect inner(8, 8, 284, 184);
+  EXPECT_EQ(cv::norm(exact(inner), full(hint.roi)(inner), cv::NORM_INF), 0);
+}
+#endif  // MXNET_USE_OPENCV
@@ -0,0 +1,106 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2019 by Contributors
+ * \file mmap_recordio_test.cc
+ * \brief memory mapped RecordIO source tests
+*/
+
+#ifndef _WIN32
+#include <gtest/gtest.h>
+#include <dmlc/io.h>
+#include <dmlc/recordio.h>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "../src/io/mmap_recordio.h"
+
+namespace {
+// read every batch of a split and return the records in visiting order
+std::vector<std::string> ReadAll(mxnet::io::MMapRecordIOSplit *split, size_t batch_size) {
+  std::vector<std::string> ret;
+  std::vector<dmlc::InputSplit::Blob> batch;
+  while (split->NextBatch(batch_size, &batch)) {
+    EXPECT_LE(batch.size(), batch_size);
+    for (const auto& blob : batch) {
+      ret.emplace_back(static_cast<const char*>(blob.dptr), blob.size);
+    }
+  }
+  return ret;
+}
+}  // namespace
+
+TEST(MMapRecordIO, ReadBack) {
+  const std::string rec_path = "mmap_recordio_test.rec";
+  const std::string idx_path = "mmap_recordio_test.idx";
+  const uint32_t magic = dmlc::RecordIOWriter::kMagic;
+  std::vector<std::string> records;
+  {
+    std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create(rec_path.c_str(), "w"));
+    dmlc::RecordIOWriter writer(fo.get());
+    std::ofstream idx(idx_path.c_str());
+    for (size_t i = 0; i < 37; ++i) {
+      std::string rec(i * 7 + 1, static_cast<char>('a' + i % 26));
+      if (i % 5 == 0) {
+        // embedded magic forces the writer to split the record
+        rec.insert(rec.size() / 2, reinterpret_cast<const char*>(&magic), sizeof(magic));
+      }
+      idx << i << '\t' << writer.Tell() << '\n';
+      writer.WriteRecord(rec);
+      records.push_back(rec);
+    }
+  }
+  {
+    mxnet::io::MMapRecordIOSplit split(rec_path, "", 0, 1, false, 0);
+    EXPECT_EQ(ReadAll(&split, 4), records);
+    split.BeforeFirst();
+    EXPECT_EQ(ReadAll(&split, 64), records);
+  }
+  {
+    mxnet::io::MMapRecordIOSplit split(rec_path, idx_path, 0, 1, false, 0);
+    EXPECT_EQ(ReadAll(&split, 5), records);
+  }
+  {
+    mxnet::io::MMapRecordIOSplit split(rec_path, idx_path, 0, 1, true, 3);
+    std::vector<std::string> first = ReadAll(&split, 6);
+    split.BeforeFirst();
+    std::vector<std::string> second = ReadAll(&split, 6);
+    EXPECT_NE(first, records);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(std::multiset<std::string>(first.begin(), first.end()),
+              std::multiset<std::string>(records.begin(), records.end()));
+  }
+  for (const std::string& idx : {std::string(), idx_path}) {
+    // the parts are disjoint and cover the file
+    std::vector<std::string> all;
+    for (unsigned part = 0; part < 3; ++part) {
+      mxnet::io::MMapRecordIOSplit split(rec_path, idx, part, 3, false, 0);
+      std::vector<std::string> recs = ReadAll(&split, 4);
+      all.insert(all.end(), recs.begin(), recs.end());
+    }
+    EXPECT_EQ(all, records);
+  }
+  std::remove(rec_path.c_str());
+  std::remove(idx_path.c_str());
+}
+#endif  // _WIN32
@@ -0,0 +1,131 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2019 by Contributors
+ * \file text_chunk_reader_test.cc
+ * \brief number parsing of the parallel text iterators
+*/
+
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "../src/io/text_chunk_reader.h"
+
+TEST(TextChunkReader, ParseNumberMatchesStrtod) {
+  const std::vector<std::string> inputs = {
+    "0", "-0", "1", "-17", "+3", "3.25", ".5", "5.", "-0.001", "1e3", "1E-3",
+    "6.02214076e23", "1.7976931348623157e308", "4.9e-324", "123456789012345678901234",
+    "0.000000000000000000000000012345", "0x1p4", "inf", "-nan", "2.5e"
+  };
+  for (const std::string& s : inputs) {
+    double expected = std::strtod(s.c_str(), nullptr);
+    double actual = -1;
+    const char *end = s.c_str() + s.size();
+    const char *stop = mxnet::io::ParseNumber(s.c_str(), end, &actual);
+    char *expected_stop = nullptr;
+    std::strtod(s.c_str(), &expected_stop);
+    EXPECT_EQ(stop, expected_stop) << s;
+    if (expected != expected) {
+      EXPECT_NE(actual, actual) << s;
+    } else {
+      EXPECT_EQ(actual, expected) << s;
+    }
+  }
+}
+
+TEST(TextChunkReader, ParseNumberStopsAtDelimiters) {
+  const std::string line = "12:0.5, -3 7";
+  const char *p = line.c_str(), *end = p + line.size();
+  int64_t index = 0;
+  float value = 0;
+  p = mxnet::io::ParseNumber(p, end, &index);
+  EXPECT_EQ(index, 12);
+  ASSERT_EQ(*p, ':');
+  p = mxnet::io::ParseNumber(p + 1, end, &value);
+  EXPECT_EQ(value, 0.5f);
+  ASSERT_EQ(*p, ',');
+  p = mxnet::io::ParseNumber(mxnet::io::SkipBlank(p + 1, end), end, &value);
+  EXPECT_EQ(value, -3.0f);
+  p = mxnet::io::ParseNumber(mxnet::io::SkipBlank(p, end), end, &index);
+  EXPECT_EQ(index, 7);
+  EXPECT_EQ(p, end);
+  // no number at all leaves the output alone
+  EXPECT_EQ(mxnet::io::ParseNumber(p, end, &index), end);
+  EXPECT_EQ(index, 7);
+}
+
+#ifndef _WIN32
+TEST(TextChunkReader, LinesInFileOrder) {
+  const std::string path = "text_chunk_reader_test.txt";
+  std::vector<std::string> expected;
+  {
+    FILE *fp = std::fopen(path.c_str(), "wb");
+    ASSERT_TRUE(fp != nullptr);
+    for (int i = 0; i < 500; ++i) {
+      expected.push_back(std::to_string(i) + std::string(i % 7, 'x'));
+      // blank lines and windows line breaks are dropped
+      std::fprintf(fp, "%s%s\n", expected.back().c_str(), i % 3 == 0 ? " \r" : "");
+      if (i % 11 == 0) std::fprintf(fp, "\n");
+    }
+    std::fclose(fp);
+  }
+  for (int nthread : {1, 3, 8}) {
+    std::vector<std::string> lines;
+    for (unsigned part = 0; part < 3; ++part) {
+      mxnet::io::TextLineReader reader(path, part, 3, nthread);
+      for (int pass = 0; pass < 2; ++pass) {
+        reader.BeforeFirst();
+        const mxnet::io::TextLine *taken;
+        std::vector<std::string> part_lines;
+        for (size_t n; (n = reader.Take(13, &taken)) != 0;) {
+          EXPECT_LE(n, 13U);
+          for (size_t i = 0; i < n; ++i) {
+            part_lines.emplace_back(taken[i].first, taken[i].second);
+          }
+        }
+        if (pass == 1) lines.insert(lines.end(), part_lines.begin(), part_lines.end());
+      }
+    }
+    EXPECT_EQ(lines, expected) << nthread;
+  }
+  std::remove(path.c_str());
+}
+
+TEST(TextChunkReader, CommentsDropped) {
+  const std::string path = "text_chunk_reader_comment_test.txt";
+  {
+    FILE *fp = std::fopen(path.c_str(), "wb");
+    ASSERT_TRUE(fp != nullptr);
+    std::fprintf(fp, "# header\n1 0:1 # first\n  # indented\n2 1:2\t#\n3\n");
+    std::fclose(fp);
+  }
+  mxnet::io::TextLineReader reader(path, 0, 1, 2, '#');
+  const mxnet::io::TextLine *taken;
+  std::vector<std::string> lines;
+  for (size_t n; (n = reader.Take(10, &taken)) != 0;) {
+    for (size_t i = 0; i < n; ++i) lines.emplace_back(taken[i].first, taken[i].second);
+  }
+  EXPECT_EQ(lines, std::vector<std::string>({"1 0:1", "2 1:2", "3"}));
+  std::remove(path.c_str());
+}
+#endif  // _WIN32
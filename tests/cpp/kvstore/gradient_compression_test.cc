@@ -0,0 +1,73 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2019 by Contributors
+ * \file gradient_compression_test.cc
+ * \brief gradient compression kernel tests
+*/
+
+#include <gtest/gtest.h>
+#include <mxnet/base.h>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "../src/kvstore/gradient_compression-inl.h"
+
+/*
+ * With error feedback, what is sent plus what stays in the residual must add up
+ * to the residual of the previous step plus the new gradient.
+ */
+TEST(GradientCompression, ErrorFeedback) {
+  using namespace mxnet;
+  using namespace mxnet::kvstore;
+  mshadow::Stream<cpu> *s = nullptr;
+  std::mt19937 gen(1);
+  std::normal_distribution<float> dis;
+  const std::vector<std::pair<CompressionType, int>> types = {
+    {CompressionType::kTwoBit, 16}, {CompressionType::kOneBit, kOneBitBlock},
+    {CompressionType::kTopK, TopKBlockSize(0.05)}, {CompressionType::kFloat16, 2},
+    {CompressionType::kBFloat16, 2}};
+  for (const auto& type : types) {
+    const int block_size = type.second;
+    const int compr_block = type.first == CompressionType::kOneBit ? kOneBitComprBlock :
+                            type.first == CompressionType::kTopK ? 2 * kTopKPairs : 1;
+    for (int size : {1, 7, 1000, 5001}) {
+      const int compr_size = (size + block_size - 1) / block_size * compr_block;
+      std::vector<float> grad(size), residual(size, 0.f), out(size), compr(compr_size);
+      const TShape shape = mshadow::Shape1(size);
+      const TBlob grad_blob(grad.data(), shape, cpu::kDevMask);
+      const TBlob residual_blob(residual.data(), shape, cpu::kDevMask);
+      const TBlob out_blob(out.data(), shape, cpu::kDevMask);
+      const TBlob compr_blob(compr.data(), mshadow::Shape1(compr_size), cpu::kDevMask);
+      for (int step = 0; step < 10; ++step) {
+        std::vector<float> expected(size);
+        for (int i = 0; i < size; ++i) {
+          grad[i] = dis(gen);
+          expected[i] = residual[i] + grad[i];
+        }
+        QuantizeImpl(s, {grad_blob, residual_blob, compr_blob}, type.first, 0.5f, block_size);
+        DequantizeImpl(s, {compr_blob, out_blob}, type.first, 0.5f, block_size);
+        for (int i = 0; i < size; ++i) {
+          EXPECT_NEAR(out[i] + residual[i], expected[i], 1e-5 * (1 + std::fabs(expected[i])));
+        }
+      }
+    }
+  }
+}
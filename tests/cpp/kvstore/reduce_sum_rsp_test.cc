@@ -0,0 +1,88 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2019 by Contributors
+ * \file reduce_sum_rsp_test.cc
+ * \brief row sparse reduce kernel tests
+*/
+
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+#include <vector>
+#include "../src/kvstore/reduce_sum_rsp_cpu-inl.h"
+
+TEST(KVStore, ReduceSumRowSparse) {
+  using namespace mxnet::kvstore;
+  std::mt19937 gen(1);
+  const size_t row_length = 3;
+  for (size_t num_inputs : {1, 2, 5}) {
+    for (size_t nparts : {1, 3, 16}) {
+      std::vector<std::vector<int64_t>> idx(num_inputs);
+      std::vector<std::vector<float>> val(num_inputs);
+      std::map<int64_t, std::vector<float>> expected;
+      for (size_t i = 0; i < num_inputs; ++i) {
+        // skewed row ids; input 1 is empty and input 2 holds every row
+        if (i == 1) continue;
+        std::uniform_int_distribution<int64_t> dis(0, i == 2 ? 0 : 100 * (i + 1));
+        for (int64_t r = dis(gen); r < 1000; r += 1 + dis(gen)) {
+          idx[i].push_back(r);
+          auto& sum = expected[r];
+          sum.resize(row_length, 0.f);
+          for (size_t j = 0; j < row_length; ++j) {
+            val[i].push_back(static_cast<float>(r + i + j));
+            sum[j] += val[i].back();
+          }
+        }
+      }
+      std::vector<const int64_t*> in_idx;
+      std::vector<const float*> in_val;
+      std::vector<size_t> num_rows;
+      for (size_t i = 0; i < num_inputs; ++i) {
+        in_idx.push_back(idx[i].data());
+        in_val.push_back(val[i].data());
+        num_rows.push_back(idx[i].size());
+      }
+      std::vector<size_t> bounds;
+      PartitionRowSparse(in_idx, num_rows, nparts, &bounds);
+      std::vector<size_t> offsets(nparts + 1, 0);
+      for (size_t p = 0; p < nparts; ++p) {
+        offsets[p + 1] = offsets[p] + MergeRowSparseRange<float, int64_t>(
+            in_idx, in_val, bounds, p, row_length, nullptr, nullptr);
+      }
+      ASSERT_EQ(offsets[nparts], expected.size());
+      std::vector<int64_t> out_idx(offsets[nparts]);
+      std::vector<float> out_val(offsets[nparts] * row_length);
+      for (size_t p = 0; p < nparts; ++p) {
+        MergeRowSparseRange<float, int64_t>(in_idx, in_val, bounds, p, row_length,
+                                            out_idx.data() + offsets[p],
+                                            out_val.data() + offsets[p] * row_length);
+      }
+      size_t n = 0;
+      for (const auto& kv : expected) {
+        EXPECT_EQ(out_idx[n], kv.first);
+        for (size_t j = 0; j < row_length; ++j) {
+          EXPECT_EQ(out_val[n * row_length + j], kv.second[j]);
+        }
+        ++n;
+      }
+    }
+  }
+}
@@ -26,7 +26,10 @@
 #include <dmlc/logging.h>
 #include <mxnet/storage.h>
 #include <cstdio>
+#include <thread>
+#include <vector>
 #include "test_util.h"
+#include "storage/pooled_storage_manager.h"
 
 TEST(Storage, Basic_CPU) {
   constexpr size_t kSize = 1024;
@@ -47,6 +50,74 @@ TEST(Storage, Basic_CPU) {
   storage->Free(handle);
 }
 
+TEST(Storage, Pooled_CPU) {
+  mxnet::storage::CPUPooledRoundedStorageManager manager;
+  mxnet::Context context_cpu{};
+  mxnet::Storage::Handle handle;
+  handle.ctx = context_cpu;
+  handle.size = 32;
+  manager.Alloc(&handle);
+  auto ptr = handle.dptr;
+  EXPECT_NE(ptr, nullptr);
+  manager.Free(handle);
+
+  // 32 and 64 bytes both round up to the smallest 64 byte block
+  handle.size = 64;
+  manager.Alloc(&handle);
+  EXPECT_EQ(handle.dptr, ptr);
+  manager.Free(handle);
+
+  mxnet::Storage::Handle handle2;
+  handle2.ctx = context_cpu;
+  handle2.size = 2097153;
+  manager.Alloc(&handle2);
+  auto ptr2 = handle2.dptr;
+  manager.Free(handle2);
+  handle2.size = 4194304;
+  manager.Alloc(&handle2);
+  EXPECT_EQ(handle2.dptr, ptr2);
+  manager.Free(handle2);
+
+  handle.size = 0;
+  manager.Alloc(&handle);
+  EXPECT_EQ(handle.dptr, nullptr);
+  manager.Free(handle);
+  manager.ReleaseAll();
+}
+
+TEST(Storage, Pooled_CPU_Threads) {
+  constexpr int kThreads = 8;
+  constexpr int kIters = 1000;
+  mxnet::storage::CPUPooledRoundedStorageManager manager;
+  auto worker = [&manager]() {
+    mxnet::Storage::Handle handle;
+    handle.ctx = mxnet::Context{};
+    for (int i = 0; i < kIters; ++i) {
+      handle.size = 64ul << (i % 16);
+      manager.Alloc(&handle);
+      ASSERT_NE(handle.dptr, nullptr);
+      static_cast<char*>(handle.dptr)[handle.size - 1] = 1;
+      manager.Free(handle);
+    }
+  };
+  // the second round reuses the free lists left behind by the exited threads of the first
+  for (int round = 0; round < 2; ++round) {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+      threads.emplace_back(worker);
+    }
+    // drain the free lists of the other threads while they are running
+    for (int i = 0; i < 10; ++i) {
+      manager.ReleaseAll();
+    }
+    for (auto&& thread : threads) {
+      thread.join();
+    }
+    manager.ReleaseAll();
+  }
+  worker();
+}
+
 #if MXNET_USE_CUDA
 TEST(Storage_GPU, Basic_GPU) {
   if (mxnet::test::unitTestsWithCuda) {
@@ -433,6 +433,77 @@ def test_gluon_trainer_sparse_step():
     check_trainer_sparse_step()
     print('worker ' + str(my_rank) + ' passed test_gluon_trainer_sparse_step')
 
+def test_server_apply_threads(nrepeat):
+    # run with MXNET_KVSTORE_SERVER_APPLY_THREADS set, so that keys are spread over shards
+    keys = [str(i) for i in range(2000, 2040)] + ['2099']
+    shapes = [shape] * 40 + [big_shape]
+    kv.init(keys, [mx.nd.zeros(s) for s in shapes])
+    # without an updater the last push of a round replaces the stored value, so the
+    # pushes of a key, all sent before any pull, must be handled in order
+    for i in range(nrepeat):
+        for j, (k, s) in enumerate(zip(keys, shapes)):
+            kv.push(k, mx.nd.ones(s) * (my_rank + 1) * (i + j + 1))
+    for j, (k, s) in enumerate(zip(keys, shapes)):
+        val = mx.nd.zeros(s)
+        kv.pull(k, out=val)
+        check_diff(val, (nworker + 1) * nworker / 2 * (nrepeat + j), my_rank)
+    # the updater sums all rounds
+    kv.set_optimizer(mx.optimizer.create('test', rescale_grad=rate, multi_precision=False))
+    for i in range(nrepeat):
+        for k, s in zip(keys, shapes):
+            kv.push(k, mx.nd.ones(s) * (my_rank + 1))
+    for j, (k, s) in enumerate(zip(keys, shapes)):
+        val = mx.nd.zeros(s)
+        kv.pull(k, out=val)
+        num = (nworker + 1) * nworker / 2 * (nrepeat + j + rate * nrepeat)
+        check_diff(val, num, my_rank)
+    print('worker ' + str(my_rank) + ' passed test_server_apply_threads')
+
+def test_fused_keys(nrepeat):
+    # run with and without MXNET_KVSTORE_FUSION_BUCKET_SIZE set, the unfused run gives the
+    # reference: both must reach the same values. Each float32 key gets its own multiple of
+    # the gradient, so that a value applied to the wrong key of a bucket is caught; float16
+    # keys keep a factor of 1 to stay exact.
+    small_shapes = [(2, 3), (5,), (4, 7), (1, 1)]
+    keys = [str(i) for i in range(3000, 3064)] + ['3099']
+    shapes = [small_shapes[j % len(small_shapes)] for j in range(64)] + [big_shape]
+    dtypes = ['float16' if j % 8 == 7 else 'float32' for j in range(64)] + ['float32']
+    kv.init(keys, [mx.nd.ones(s, dtype=d) for s, d in zip(shapes, dtypes)])
+    kv.set_optimizer(mx.optimizer.create('test', rescale_grad=rate, multi_precision=False))
+    factors = [1 if d == 'float16' else j % 7 + 1 for j, d in enumerate(dtypes)]
+    grads = [mx.nd.ones(s, dtype=d) * (my_rank + 1) * f
+             for s, d, f in zip(shapes, dtypes, factors)]
+
+    def expected(j, nstep):
+        return 1 + (nworker + 1) * nworker / 2 * rate * factors[j] * nstep
+
+    def check_vals(vals, nstep):
+        for j, val in enumerate(vals):
+            check_diff(val, expected(j, nstep), (my_rank, keys[j]))
+
+    # push and pull all keys in one call, so that the small keys are fused
+    for i in range(nrepeat):
+        kv.push(keys, grads)
+        vals = [mx.nd.zeros(s, dtype=d) for s, d in zip(shapes, dtypes)]
+        kv.pull(keys, out=vals)
+        check_vals(vals, i + 1)
+    # pushpull returns the updated values of all keys
+    for i in range(nrepeat):
+        vals = [mx.nd.zeros(s, dtype=d) for s, d in zip(shapes, dtypes)]
+        kv.pushpull(keys, grads, out=vals)
+        check_vals(vals, nrepeat + i + 1)
+    vals = [mx.nd.zeros(s, dtype=d) for s, d in zip(shapes, dtypes)]
+    kv.pull(keys, out=vals)
+    check_vals(vals, 2 * nrepeat)
+    # a call with a part of the keys only, the buckets are sent partially filled
+    part = list(range(0, 65, 3))
+    kv.push([keys[j] for j in part], [grads[j] for j in part])
+    vals = [mx.nd.zeros(s, dtype=d) for s, d in zip(shapes, dtypes)]
+    kv.pull(keys, out=vals)
+    for j, val in enumerate(vals):
+        check_diff(val, expected(j, 2 * nrepeat + (1 if j in part else 0)), (my_rank, keys[j]))
+    print('worker ' + str(my_rank) + ' passed test_fused_keys')
+
 if __name__ == "__main__":
     parser = argparse.ArgumentParser(description='test distributed kvstore in dist_sync mode')
     parser.add_argument('--nrepeat', type=int, default=7)
@@ -454,6 +525,10 @@ if __name__ == "__main__":
         kv = init_kv()
         kv = set_optimizer(use_multiprecision=opt.multiprecision)
         test_sync_push_pull(opt.nrepeat)
+    elif opt.type == 'apply_threads_cpu':
+        test_server_apply_threads(opt.nrepeat)
+    elif opt.type == 'fused_keys_cpu':
+        test_fused_keys(opt.nrepeat)
     elif opt.type == 'compressed_cpu':
         kv, threshold = init_kv_compressed(kv)
         kv = set_optimizer(use_multiprecision=opt.multiprecision)
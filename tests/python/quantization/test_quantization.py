@@ -23,11 +23,10 @@ import mxnet as mx
 import numpy as np
 from mxnet.gluon.model_zoo import vision
 from mxnet.test_utils import assert_almost_equal, assert_exception, rand_ndarray, rand_shape_nd, same, DummyIter
-from common import with_seed
+from common import with_seed, run_in_spawned_process
 from mxnet.module import Module
 from mxnet.io import NDArrayIter
 import unittest
-import operator
 
 def is_test_for_gpu():
     return mx.current_context().device_type == 'gpu'
@@ -197,10 +196,7 @@ def test_requantize_int32_to_int8():
 @with_seed()
 def test_quantized_conv():
     def check_quantized_conv(data_shape, kernel, num_filter, pad, stride, no_bias, qdtype):
-        if is_test_for_native_cpu():
-            print('skipped testing quantized_conv for native cpu since it is not supported yet')
-            return
-        elif qdtype == 'int8' and is_test_for_mkldnn():
+        if qdtype == 'int8' and is_test_for_mkldnn():
             print('skipped testing quantized_conv for mkldnn cpu int8 since it is not supported yet')
             return
         elif qdtype == 'uint8' and is_test_for_gpu():
@@ -344,10 +340,7 @@ def test_quantized_elemwise_add():
 @with_seed()
 def test_quantized_pooling():
     def check_quantized_pooling(data_shape, kernel, pool_type, pad, stride, global_pool, qdtype, convention='valid'):
-        if is_test_for_native_cpu():
-            print('skipped testing quantized_pooling for native cpu since it is not supported yet')
-            return
-        elif qdtype == 'uint8' and is_test_for_gpu():
+        if qdtype == 'uint8' and is_test_for_gpu():
             print('skipped testing quantized_pooling for gpu uint8 since it is not supported yet')
             return
 
@@ -406,17 +399,7 @@ def test_quantized_pooling():
 @with_seed()
 def test_quantized_fc():
     def check_quantized_fc(data_shape, num_hidden, no_bias, qdtype, flatten=True):
-        if is_test_for_native_cpu():
-            hasMKL = False;
-            for key in os.environ.keys():
-                if operator.eq(key, "BUILD_TAG"):
-                    if os.environ['BUILD_TAG'].find("MKL") != -1:
-                        hasMKL = True
-                    break
-            if hasMKL == False:
-                print('skipped testing quantized_fc on cpu since s8u8s32 is only supported by MKL BLAS library')
-                return
-        elif qdtype == 'uint8' and is_test_for_gpu():
+        if qdtype == 'uint8' and is_test_for_gpu():
             print('skipped testing quantized_fc for gpu uint8 since it is not supported yet')
             return
 
@@ -516,6 +499,29 @@ def test_quantized_fc():
         check_quantized_fc((256, 2048, 2, 2), 800, True, qdtype)
         check_quantized_fc((256, 111, 2, 2), 800, True, qdtype)
 
+@with_seed()
+def test_quantized_fc_weight_update():
+    if not is_test_for_native_cpu():
+        print('skipped testing the packed weights of quantized_fc outside native cpu')
+        return
+    # the packed weights of the bound operator follow updates of its weight array
+    data_shape, num_hidden = (5, 37), 19
+    fc_int8 = mx.sym.contrib.quantized_fully_connected(data=mx.sym.Variable('qdata', dtype='int8'),
+                                                       num_hidden=num_hidden, no_bias=True)
+    qarg_names = fc_int8.list_arguments()
+    exe = fc_int8.simple_bind(ctx=mx.current_context(), grad_req='null',
+                              qdata=data_shape, type_dict={qarg_names[1]: 'int8'})
+    data = np.random.randint(-127, 128, size=data_shape)
+    exe.arg_dict[qarg_names[0]][:] = data
+    for name in qarg_names[2:]:
+        exe.arg_dict[name][:] = 127.0 if name.startswith('max') else -127.0
+    for _ in range(2):
+        weight = np.random.randint(-127, 128, size=(num_hidden, data_shape[1]))
+        exe.arg_dict[qarg_names[1]][:] = weight
+        qoutput = exe.forward()[0]
+        assert same(qoutput.asnumpy(), np.dot(data, weight.T))
+
+
 @with_seed()
 def test_quantized_flatten():
     def check_quantized_flatten(shape, qdtype):
@@ -1126,6 +1132,19 @@ def test_get_optimal_thresholds():
         assert 'layer1' in th_dict
         assert_almost_equal(np.array([th_dict['layer1'][1]]), expected_threshold, rtol=1e-2, atol=1e-4)
 
+def _check_quantized_gemm_isa(seed):
+    test_quantized_fc()
+    test_quantized_conv()
+
+@with_seed()
+def test_quantized_gemm_isa():
+    if not is_test_for_native_cpu():
+        print('skipped testing the int8 gemm kernels, they are only used by the native cpu operators')
+        return
+    # MXNET_QUANTIZED_GEMM_ISA is read once per process, kernels the CPU lacks fall back
+    # to the detected one
+    for isa in ['scalar', 'avx2', 'vnni']:
+        run_in_spawned_process(_check_quantized_gemm_isa, {'MXNET_QUANTIZED_GEMM_ISA': isa})
 
 if __name__ == "__main__":
     import nose
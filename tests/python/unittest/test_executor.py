@@ -15,10 +15,12 @@
 # specific language governing permissions and limitations
 # under the License.
 
+import os
 import numpy as np
 import mxnet as mx
-from common import setup_module, with_seed, teardown
+from common import setup_module, with_seed, teardown, run_in_spawned_process
 from mxnet.test_utils import assert_almost_equal
+from mxnet.runtime import Features
 
 
 def check_bind_with_uniform(uf, gf, dim, sf=None, lshape=None, rshape=None):
@@ -165,6 +167,78 @@ def test_reshape():
     assert np.all(new_exe.arg_arrays[1].asnumpy() == 1)
 
 
+@with_seed()
+def test_backward_mirror_budget():
+    data = mx.sym.Variable('data')
+    net = data
+    for i in range(6):
+        net = mx.sym.FullyConnected(net, num_hidden=512, name='fc%d' % i)
+        net = mx.sym.Activation(net, act_type='tanh', name='tanh%d' % i)
+    shape = (256, 512)
+    arg_shapes, out_shapes, _ = net.infer_shape(data=shape)
+    args = [mx.nd.random.uniform(-0.1, 0.1, s) for s in arg_shapes]
+    head_grad = mx.nd.random.uniform(shape=out_shapes[0])
+
+    def run(budget_mb):
+        if budget_mb:
+            os.environ['MXNET_BACKWARD_MIRROR_BUDGET_MB'] = str(budget_mb)
+        try:
+            exe = net.simple_bind(mx.cpu(), data=shape)
+        finally:
+            os.environ.pop('MXNET_BACKWARD_MIRROR_BUDGET_MB', None)
+        for arr, value in zip(exe.arg_arrays, args):
+            value.copyto(arr)
+        exe.forward(is_train=True)
+        exe.backward([head_grad])
+        return exe, [exe.outputs[0].asnumpy()] + [g.asnumpy() for g in exe.grad_arrays]
+
+    exe, expected = run(0)
+    assert '_mirror' not in exe.debug_str()
+    # 6 tanh outputs of 512 KB each are kept for backward without mirroring
+    exe, mirrored = run(1)
+    assert '_mirror' in exe.debug_str()
+    for a, b in zip(expected, mirrored):
+        assert_almost_equal(a, b, rtol=1e-4, atol=1e-5)
+
+
+def _memory_arena_net():
+    data = mx.sym.Variable('data')
+    fc0 = mx.sym.FullyConnected(data, num_hidden=64, name='fc0')
+    # float16 data in the same arena, at offsets that are not multiples of 4 elements
+    half = mx.sym.Cast(fc0, dtype='float16')
+    half = mx.sym.tanh(half) + mx.sym.sigmoid(half)
+    net = mx.sym.Activation(mx.sym.Cast(half, dtype='float32') + fc0, act_type='relu')
+    return mx.sym.FullyConnected(net, num_hidden=16, name='fc1')
+
+def _run_memory_arena_net(args, head_grad):
+    net = _memory_arena_net()
+    exe = net.simple_bind(mx.cpu(), data=args[0].shape)
+    for arr, value in zip(exe.arg_arrays, args):
+        arr[:] = value
+    exe.forward(is_train=True)
+    exe.backward([mx.nd.array(head_grad)])
+    return exe, [exe.outputs[0].asnumpy()] + [g.asnumpy() for g in exe.grad_arrays]
+
+def _check_memory_arena_in_process(seed, args, head_grad, expected):
+    exe, results = _run_memory_arena_net(args, head_grad)
+    if not Features().is_enabled('MKLDNN'):
+        assert 'planned by live interval packing' in exe.debug_str()
+    for a, b in zip(expected, results):
+        assert_almost_equal(a, b, rtol=1e-3, atol=1e-4)
+
+@with_seed()
+def test_memory_arena():
+    shape = (7, 33)
+    arg_shapes, out_shapes, _ = _memory_arena_net().infer_shape(data=shape)
+    args = [np.random.uniform(-1, 1, s).astype(np.float32) for s in arg_shapes]
+    head_grad = np.random.uniform(size=out_shapes[0]).astype(np.float32)
+    exe, expected = _run_memory_arena_net(args, head_grad)
+    assert 'planned by live interval packing' not in exe.debug_str()
+    # MXNET_EXEC_MEMORY_ARENA is read once per process
+    run_in_spawned_process(_check_memory_arena_in_process, {'MXNET_EXEC_MEMORY_ARENA': 1},
+                           args, head_grad, expected)
+
+
 if __name__ == "__main__":
     import nose
     nose.runmodule()
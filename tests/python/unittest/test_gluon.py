@@ -15,16 +15,18 @@
 # specific language governing permissions and limitations
 # under the License.
 
+import ctypes
 import os
 import tempfile
 
 import mxnet as mx
 from mxnet import gluon
 from mxnet.gluon import nn
+from mxnet.base import _LIB, check_call, SymbolHandle
 from mxnet.test_utils import assert_almost_equal
 from mxnet.ndarray.ndarray import _STORAGE_TYPE_STR_TO_ID
 from common import (setup_module, with_seed, assertRaises, teardown,
-                    assert_raises_cudnn_not_satisfied)
+                    assert_raises_cudnn_not_satisfied, random_seed, run_in_spawned_process)
 import numpy as np
 from numpy.testing import assert_array_equal
 from nose.tools import raises, assert_raises
@@ -1445,6 +1447,43 @@ def test_hybrid_static_memory():
     check_hybrid_static_memory(static_alloc=True)
     check_hybrid_static_memory(static_alloc=True, static_shape=True)
 
+def _check_hybrid_backward_mirror_in_process(seed, static_alloc):
+    with random_seed(seed):
+        net = nn.HybridSequential()
+        with net.name_scope():
+            for _ in range(6):
+                net.add(nn.Dense(512, activation='tanh'))
+        net.initialize()
+        x = mx.nd.random.uniform(shape=(256, 512))
+        x.attach_grad()
+
+    def run(**kwargs):
+        if kwargs:
+            net.hybridize(**kwargs)
+        with mx.autograd.record():
+            y = net(x)
+        y.backward()
+        return [y.asnumpy(), x.grad.asnumpy()] + \
+               [p.grad().asnumpy() for p in net.collect_params().values()]
+
+    expected = run()
+    # 6 tanh outputs of 512 KB each are kept for backward without mirroring
+    mirrored = run(static_alloc=static_alloc, backward_mirror_budget_mb=1)
+    for a, b in zip(expected, mirrored):
+        assert_almost_equal(a, b, rtol=1e-4, atol=1e-5)
+    # recomputed forward nodes are copied into the backward graph with a _mirror suffix
+    handle = SymbolHandle()
+    check_call(_LIB.MXCachedOpGetFullSymbol(net._cached_op.handle, ctypes.byref(handle)))
+    full = mx.sym.Symbol(handle)
+    assert any('_mirror' in name for name in full.get_internals().list_outputs())
+
+@with_seed()
+def test_hybrid_backward_mirror():
+    check_hybrid_static_memory(backward_mirror_budget_mb=1)
+    check_hybrid_static_memory(static_alloc=True, backward_mirror_budget_mb=1)
+    for static_alloc in [False, True]:
+        run_in_spawned_process(_check_hybrid_backward_mirror_in_process, {}, static_alloc)
+
 def check_hybrid_static_memory_switching(**kwargs):
     net = gluon.model_zoo.vision.get_resnet(
         1, 18, pretrained=True, ctx=mx.context.current_context())
@@ -68,6 +68,30 @@ def test_MNISTIter():
     assert(sum(label_0 - label_1) == 0)
 
 
+@unittest.skipIf(sys.platform.startswith('win'), "MultiProcessIter is not available on Windows")
+def test_MultiProcessIter():
+    get_mnist_ubyte()
+
+    batch_size = 100
+    kwargs = dict(image="data/train-images-idx3-ubyte",
+                  label="data/train-labels-idx1-ubyte",
+                  data_shape=(784,), batch_size=batch_size, shuffle=0, flat=1, silent=1)
+    # batches come from the workers in turn, each reading one part
+    expected = []
+    parts = [[batch.label[0].asnumpy()
+              for batch in mx.io.MNISTIter(num_parts=2, part_index=i, **kwargs)]
+             for i in range(2)]
+    for pair in zip_longest(*parts):
+        expected.extend([label for label in pair if label is not None])
+    dataiter = mx.io.MultiProcessIter(worker_iter='MNISTIter', num_workers=2, **kwargs)
+    for epoch in range(2):
+        labels = [batch.label[0].asnumpy() for batch in dataiter]
+        assert len(labels) == len(expected)
+        for label, expected_label in zip(labels, expected):
+            assert_almost_equal(label, expected_label)
+        dataiter.reset()
+
+
 def test_Cifar10Rec():
     get_cifar10()
     dataiter = mx.io.ImageRecordIter(
@@ -312,6 +336,24 @@ def test_NDArrayIter_csr():
         begin += batch_size
 
 
+def _collect_batches(data_iter, num_epochs=2):
+    batches = []
+    for _ in range(num_epochs):
+        data_iter.reset()
+        for batch in data_iter:
+            batches.append((batch.data[0].asnumpy(), batch.label[0].asnumpy(), batch.pad))
+    return batches
+
+
+def _check_same_batches(expected, actual):
+    assert len(expected) == len(actual), (len(expected), len(actual))
+    for (data, label, pad), (actual_data, actual_label, actual_pad) in zip(expected, actual):
+        assert pad == actual_pad
+        assert data.dtype == actual_data.dtype
+        assert_almost_equal(data, actual_data)
+        assert_almost_equal(label, actual_label)
+
+
 def test_LibSVMIter():
 
     def check_libSVMIter_synthetic():
@@ -397,8 +439,47 @@ def test_LibSVMIter():
         for batch in iter(data_train):
             data_train.get_data().asnumpy()
 
+    def check_libSVMIter_parse_threads():
+        cwd = os.getcwd()
+        data_path = os.path.join(cwd, 'data.t')
+        label_path = os.path.join(cwd, 'label.t')
+        num_rows, num_features = 97, 50
+        for path in (data_path, label_path):
+            with open(path, 'w') as fout:
+                for _ in range(num_rows):
+                    nnz = np.random.randint(0, 6)
+                    indices = np.sort(np.random.choice(num_features, nnz, replace=False))
+                    features = ['%d:%g' % (i, np.random.uniform(-2, 2)) for i in indices]
+                    fout.write(' '.join(['%d' % np.random.randint(1, 5)] + features) + '\n')
+
+        for label_libsvm in ['NULL', label_path]:
+            label_shape = (1, ) if label_libsvm == 'NULL' else (num_features, )
+            def batches(**kwargs):
+                data_iter = mx.io.LibSVMIter(data_libsvm=data_path, label_libsvm=label_libsvm,
+                                             data_shape=(num_features, ),
+                                             label_shape=label_shape, batch_size=10, **kwargs)
+                return _collect_batches(data_iter)
+            expected = batches()
+            for parse_threads in [1, 3, -1]:
+                _check_same_batches(expected, batches(parse_threads=parse_threads))
+
+        # comments and the qid of ranking data are skipped like by the default parser
+        with open(data_path, 'w') as fout:
+            fout.write('# label qid features\n')
+            fout.write('1 qid:3 0:0.5 2:1.2 # first\n')
+            fout.write('2 qid:3\n')
+            fout.write('  # no row\n')
+            fout.write('3 1:2.4\n')
+        data_iter = mx.io.LibSVMIter(data_libsvm=data_path, data_shape=(3, ), batch_size=3,
+                                     parse_threads=2)
+        batch = data_iter.next()
+        assert_almost_equal(batch.data[0].asnumpy(),
+                            np.array([[0.5, 0., 1.2], [0., 0., 0.], [0., 2.4, 0.]]))
+        assert_almost_equal(batch.label[0].asnumpy(), np.array([1., 2., 3.]))
+
     check_libSVMIter_synthetic()
     check_libSVMIter_news_data()
+    check_libSVMIter_parse_threads()
     assertRaises(MXNetError, check_libSVMIter_exception)
 
 
@@ -440,8 +521,57 @@ def test_CSVIter():
             assert_almost_equal(data_batch.asnumpy(), expected.asnumpy())
             assert data_batch.asnumpy().dtype == expected.asnumpy().dtype
 
+    def check_CSVIter_parse_threads(dtype='float32'):
+        cwd = os.getcwd()
+        data_path = os.path.join(cwd, 'data.t')
+        label_path = os.path.join(cwd, 'label.t')
+        num_rows = 103
+        with open(data_path, 'w') as fout:
+            for _ in range(num_rows):
+                if dtype == 'float32':
+                    row = ['%g' % v for v in np.random.uniform(-100, 100, 12)]
+                else:
+                    row = ['%d' % v for v in np.random.randint(-10**6, 10**6, 12)]
+                fout.write(','.join(row) + '\n')
+        with open(label_path, 'w') as fout:
+            for _ in range(num_rows):
+                fout.write('%g\n' % np.random.uniform())
+
+        for label_csv in ['NULL', label_path]:
+            def batches(**kwargs):
+                data_iter = mx.io.CSVIter(data_csv=data_path, data_shape=(3, 4),
+                                          label_csv=label_csv, batch_size=10, dtype=dtype,
+                                          **kwargs)
+                return _collect_batches(data_iter)
+            expected = batches()
+            for parse_threads in [1, 3, -1]:
+                _check_same_batches(expected, batches(parse_threads=parse_threads))
+
     for dtype in ['int32', 'int64', 'float32']:
         check_CSVIter_synthetic(dtype=dtype)
+        check_CSVIter_parse_threads(dtype=dtype)
+
+def test_prefetcher_modes():
+    cwd = os.getcwd()
+    data_path = os.path.join(cwd, 'data.t')
+    label_path = os.path.join(cwd, 'label.t')
+    num_rows = 205
+    with open(data_path, 'w') as fout:
+        for _ in range(num_rows):
+            fout.write(','.join(['%g' % v for v in np.random.uniform(-1, 1, 37)]) + '\n')
+    with open(label_path, 'w') as fout:
+        for i in range(num_rows):
+            fout.write('%d\n' % i)
+
+    def batches(**kwargs):
+        data_iter = mx.io.CSVIter(data_csv=data_path, data_shape=(37, ), label_csv=label_path,
+                                  batch_size=16, **kwargs)
+        return _collect_batches(data_iter, num_epochs=3)
+    expected = batches()
+    for kwargs in [{'load_buffer': 2}, {'copy_threads': 3}, {'pin_memory': True},
+                   {'load_buffer': 1, 'copy_threads': 4, 'pin_memory': True}]:
+        _check_same_batches(expected, batches(**kwargs))
+
 
 def test_ImageRecordIter_seed_augmentation():
     get_cifar10()
@@ -573,6 +703,7 @@ if __name__ == "__main__":
     if h5py:
         test_NDArrayIter_h5py()
     test_MNISTIter()
+    test_MultiProcessIter()
     test_Cifar10Rec()
     test_LibSVMIter()
     test_NDArrayIter_csr()
@@ -20,7 +20,7 @@ import mxnet as mx
 import numpy as np
 import unittest
 from mxnet.test_utils import rand_ndarray, assert_almost_equal
-from common import setup_module, with_seed, assertRaises, teardown
+from common import setup_module, with_seed, assertRaises, teardown, random_seed, run_in_spawned_process
 from mxnet.base import py_str, MXNetError
 
 shape = (4, 4)
@@ -344,6 +344,40 @@ def test_invalid_pull():
         check_invalid_key_types_single(kvs[i], single_keys[1 - i])
         check_invalid_key_types_list(kvs[i], list_keys[1 - i])
 
+def _check_cpu_reduce(seed=None):
+    # lengths off multiples of the 4-wide SIMD step and of the 4K chunks of the reduction threads
+    sizes = [1, 3, 7, 1023, 4097, 3 * 4096 + 5, 100003]
+    with random_seed(seed):
+        kv = mx.kv.create()
+        key = 0
+        for dtype in ['float32', 'float16']:
+            for size in sizes:
+                for num_devs in [2, 3, 5]:
+                    devs = [mx.Context('cpu', i) for i in range(num_devs)]
+                    if dtype == 'float16':
+                        # small integers, so that the float16 sums are exact in any order
+                        vals = [np.random.randint(-8, 8, size).astype(dtype) for _ in devs]
+                    else:
+                        vals = [np.random.uniform(-1, 1, size).astype(dtype) for _ in devs]
+                    kv.init(key, mx.nd.zeros(size, dtype=dtype))
+                    kv.push(key, [mx.nd.array(v, ctx=d, dtype=dtype) for v, d in zip(vals, devs)])
+                    out = mx.nd.zeros(size, dtype=dtype)
+                    kv.pull(key, out=out)
+                    expected = np.sum(np.stack(vals).astype(np.float64), axis=0)
+                    assert_almost_equal(out.asnumpy().astype(np.float64), expected,
+                                        rtol=1e-5, atol=1e-5)
+                    key += 1
+
+@with_seed()
+def test_cpu_reduce():
+    """reduce dense float32 and float16 arrays of several cpu devices"""
+    _check_cpu_reduce()
+    # the bounds are read once per process, lower them to go through the multi-threaded
+    # and streaming store paths
+    run_in_spawned_process(_check_cpu_reduce, {'MXNET_KVSTORE_REDUCTION_STREAM_BOUND': 4096,
+                                               'MXNET_KVSTORE_BIGARRAY_BOUND': 4096,
+                                               'MXNET_KVSTORE_REDUCTION_NTHREADS': 3})
+
 if __name__ == '__main__':
     import nose
     nose.runmodule()
@@ -396,6 +396,84 @@ def test_ndarray_saveload():
     os.remove(fname)
 
 
+@with_seed()
+def test_ndarray_chunked_saveload():
+    fname = 'tmp_chunked.bin'
+    data = [random_ndarray(np.random.randint(1, 5)) for i in range(10)]
+    data.append(mx.nd.array([[1, 0], [0, 2]]).tostype('csr'))
+    data.append(mx.nd.zeros((3, 2), dtype='int32'))
+    dmap = {'ndarray xx %s' % i : x for i, x in enumerate(data)}
+    for checksum in [False, True]:
+        mx.nd.save(fname, data, chunked=True, checksum=checksum)
+        for data2 in [mx.nd.load(fname), mx.nd.load(fname, ctx=mx.cpu(1)),
+                      mx.nd.load(fname, mapped=True),
+                      mx.nd.load(fname, mapped=True, verify=True),
+                      mx.nd.load(fname, mapped=True, ctx=mx.cpu(1))]:
+            assert len(data) == len(data2)
+            for x, y in zip(data, data2):
+                assert x.stype == y.stype and x.dtype == y.dtype
+                assert np.sum(x.asnumpy() != y.asnumpy()) == 0
+        # arrays mapped from the file are private to the process
+        mapped = mx.nd.load(fname, mapped=True)
+        mapped[0][:] = -1
+        assert np.sum(mx.nd.load(fname)[0].asnumpy() != data[0].asnumpy()) == 0
+        # saving again replaces the file, the mapped arrays keep the old data
+        mapped = mx.nd.load(fname, mapped=True)
+        mx.nd.save(fname, [x + 1 for x in data[:2]], chunked=True, checksum=checksum)
+        for x, y in zip(data, mapped):
+            assert np.sum(x.asnumpy() != y.asnumpy()) == 0
+        for x, y in zip(data, mx.nd.load(fname, mapped=True)):
+            assert np.sum((x + 1).asnumpy() != y.asnumpy()) == 0
+        del mapped
+        mx.nd.save(fname, data, chunked=True, checksum=checksum)
+        # the buffer reader handles the format too
+        with open(fname, 'rb') as fin:
+            data2 = mx.nd.load_frombuffer(fin.read())
+        for x, y in zip(data, data2):
+            assert np.sum(x.asnumpy() != y.asnumpy()) == 0
+        mx.nd.save(fname, dmap, chunked=True, checksum=checksum)
+        for mapped in [False, True]:
+            per_ctx = mx.nd.load(fname, ctx=[mx.cpu(0), mx.cpu(1)], mapped=mapped)
+            assert len(per_ctx) == 2
+            for dmap2, ctx in zip(per_ctx, [mx.cpu(0), mx.cpu(1)]):
+                assert len(dmap2) == len(dmap)
+                for k, x in dmap.items():
+                    assert dmap2[k].context == ctx
+                    assert np.sum(x.asnumpy() != dmap2[k].asnumpy()) == 0
+        del per_ctx
+    # a flipped byte of the first array is caught, it follows the header and the index
+    with open(fname, 'r+b') as fout:
+        index_size = int(np.frombuffer(fout.read(32), dtype=np.uint64)[2])
+        offset = (32 + index_size + 63) // 64 * 64
+        fout.seek(offset)
+        byte = bytearray(fout.read(1))
+        fout.seek(offset)
+        fout.write(bytes(bytearray([(byte[0] + 1) % 256])))
+    assertRaises(mx.MXNetError, mx.nd.load, fname, mapped=True, verify=True)
+    assertRaises(mx.MXNetError, mx.nd.load, fname)
+    os.remove(fname)
+
+
+@with_seed()
+def test_ndarray_chunked_mapped_embedding():
+    fname = 'tmp_mapped_embedding.bin'
+    weight = mx.nd.random.uniform(shape=(5000, 16))
+    mx.nd.save(fname, {'embed_weight': weight}, chunked=True)
+    mapped = mx.nd.load(fname, mapped=True)
+    data = mx.nd.array(np.random.randint(-10, 5010, size=(32, 8)))
+    # bound as is, the executor gathers straight from the file mapping
+    sym = mx.sym.Embedding(mx.sym.var('data'), mx.sym.var('embed_weight'),
+                           input_dim=5000, output_dim=16)
+    exe = sym.bind(mx.cpu(), args={'data': data, 'embed_weight': mapped['embed_weight']})
+    expected = mx.nd.Embedding(data, weight, input_dim=5000, output_dim=16)
+    assert_almost_equal(exe.forward()[0].asnumpy(), expected.asnumpy())
+    for mode in ['clip', 'wrap']:
+        assert_almost_equal(mx.nd.take(mapped['embed_weight'], data, mode=mode).asnumpy(),
+                            mx.nd.take(weight, data, mode=mode).asnumpy())
+    del exe, mapped
+    os.remove(fname)
+
+
 @with_seed()
 def test_ndarray_legacy_load():
     data = []
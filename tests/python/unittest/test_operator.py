@@ -5723,6 +5723,78 @@ def test_div_sqrt_dim():
     check_symbolic_forward(test, [data_tmp], [data_tmp / np.sqrt(data_tmp.shape[-1])])
 
 
+@with_seed()
+def test_multihead_selfatt():
+    def np_selfatt(qkv, heads, mask, valid_length, out_grad=None):
+        # the output, or the gradient of qkv if out_grad is given
+        seq_len, batch_size, width = qkv.shape
+        head_dim = width // (3 * heads)
+        qkv = qkv.reshape(seq_len, batch_size, heads, 3, head_dim).transpose(3, 1, 2, 0, 4)
+        q, k, v = qkv[0], qkv[1], qkv[2]
+        scores = np.matmul(q, k.transpose(0, 1, 3, 2)) / np.sqrt(head_dim)
+        keep = np.ones((batch_size, seq_len, seq_len), dtype=bool)
+        if mask is not None:
+            keep &= mask != 0
+        if valid_length is not None:
+            keep &= np.arange(seq_len)[None, None, :] < valid_length[:, None, None]
+        keep = np.broadcast_to(keep[:, None], scores.shape)
+        scores = np.where(keep, scores, -np.inf)
+        row_max = scores.max(axis=-1, keepdims=True)
+        row_max[np.isinf(row_max)] = 0
+        probs = np.exp(scores - row_max)
+        denom = probs.sum(axis=-1, keepdims=True)
+        probs = probs / np.where(denom > 0, denom, 1)
+        if out_grad is None:
+            out = np.matmul(probs, v)
+            return out.transpose(2, 0, 1, 3).reshape(seq_len, batch_size, heads * head_dim)
+        dout = out_grad.reshape(seq_len, batch_size, heads, head_dim).transpose(1, 2, 0, 3)
+        dv = np.matmul(probs.transpose(0, 1, 3, 2), dout)
+        dprobs = np.matmul(dout, v.transpose(0, 1, 3, 2))
+        # masked scores have zero probability and get no gradient
+        dscores = probs * (dprobs - (dprobs * probs).sum(axis=-1, keepdims=True))
+        dscores /= np.sqrt(head_dim)
+        dq = np.matmul(dscores, k)
+        dk = np.matmul(dscores.transpose(0, 1, 3, 2), q)
+        return np.stack([dq, dk, dv]).transpose(3, 1, 2, 0, 4).reshape(qkv.shape)
+
+    for seq_len, batch_size, heads, head_dim in [(7, 2, 2, 3), (150, 2, 1, 4)]:
+        for use_mask in [False, True]:
+            for use_valid_length in [False, True]:
+                qkv_np = np.random.normal(0, 1, (seq_len, batch_size, heads * 3 * head_dim))
+                mask_np = (np.random.uniform(size=(batch_size, seq_len, seq_len)) > 0.3) * 1.0
+                mask_np[0, 1, :] = 0
+                valid_length_np = np.random.randint(1, seq_len + 1, size=(batch_size,)) * 1.0
+                location = {'queries_keys_values': qkv_np}
+                if use_mask:
+                    location['mask'] = mask_np
+                if use_valid_length:
+                    location['valid_length'] = valid_length_np
+                sym = mx.sym.contrib.multihead_selfatt(
+                    mx.sym.Variable('queries_keys_values'),
+                    mx.sym.Variable('mask') if use_mask else None,
+                    mx.sym.Variable('valid_length') if use_valid_length else None,
+                    heads=heads, use_mask=use_mask, use_valid_length=use_valid_length)
+                expected = np_selfatt(qkv_np, heads, mask_np if use_mask else None,
+                                      valid_length_np if use_valid_length else None)
+                # the operator only has a CPU implementation
+                check_symbolic_forward(sym, location, [expected], rtol=1e-5, atol=1e-6,
+                                       ctx=mx.cpu(), dtype=np.float64)
+                out_grad = np.random.normal(0, 1, expected.shape)
+                expected_grad = np_selfatt(qkv_np, heads, mask_np if use_mask else None,
+                                           valid_length_np if use_valid_length else None,
+                                           out_grad)
+                check_symbolic_backward(sym, location, [out_grad],
+                                        {'queries_keys_values': expected_grad},
+                                        rtol=1e-5, atol=1e-6,
+                                        grad_req={'queries_keys_values': 'write'},
+                                        ctx=mx.cpu(), dtype=np.float64)
+                # finite differences are too slow for the long sequence
+                if seq_len < 10:
+                    check_numeric_gradient(sym, location, grad_nodes=['queries_keys_values'],
+                                           numeric_eps=1e-6, rtol=1e-4, atol=1e-5,
+                                           ctx=mx.cpu(), dtype=np.float64)
+
+
 @with_seed()
 def test_reciprocal_op():
     eps = 2**(-11)
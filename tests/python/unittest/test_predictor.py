@@ -17,9 +17,10 @@
 
 from __future__ import print_function
 import sys, os
+import threading
 curr_path = os.path.dirname(os.path.abspath(os.path.expanduser(__file__)))
 sys.path.append(os.path.join(curr_path, "../../../amalgamation/python/"))
-from mxnet_predict import Predictor, load_ndarray_file
+from mxnet_predict import Predictor, BatchedPredictor, load_ndarray_file
 
 import numpy as np
 import mxnet as mx
@@ -27,6 +28,7 @@ import mxnet.ndarray as nd
 from mxnet import gluon
 from mxnet.test_utils import assert_almost_equal
 from common import setup_module, with_seed, teardown
+from nose.tools import assert_raises
 
 @with_seed()
 def test_predictor():
@@ -67,6 +69,113 @@ def test_predictor():
     # destroy the predictor
     del predictor
 
+@with_seed()
+def test_predictor_reshape_in_place():
+    prefix = 'test_predictor_reshape_in_place'
+    symbol_file = "%s-symbol.json" % prefix
+    param_file = "%s-0000.params" % prefix
+
+    block = gluon.nn.HybridSequential()
+    block.add(gluon.nn.Dense(7))
+    block.add(gluon.nn.Dense(3))
+    block.hybridize()
+    block.initialize()
+    inputs = [np.random.uniform(size=(n, 3)) for n in (1, 16, 1, 4, 16)]
+    outputs = [block.forward(nd.array(x)).asnumpy() for x in inputs]
+    block.export(prefix)
+
+    predictor = Predictor(open(symbol_file, "r").read(),
+                          open(param_file, "rb").read(),
+                          {'data':inputs[0].shape})
+    for cache_size in (0, 2):
+        predictor.set_executor_cache_size(cache_size)
+        # small, large and small again, the cached executors must see their own inputs
+        for x, out in zip(inputs, outputs):
+            predictor.reshape_in_place({'data':x.shape})
+            predictor.forward(data=x)
+            assert_almost_equal(out, predictor.get_output(0), rtol=1e-5, atol=1e-6)
+    del predictor
+
+def _export_dense_block(prefix, inputs):
+    block = gluon.nn.HybridSequential()
+    block.add(gluon.nn.Dense(7))
+    block.add(gluon.nn.Dense(3))
+    block.hybridize()
+    block.initialize()
+    outputs = [block.forward(nd.array(x)).asnumpy() for x in inputs]
+    block.export(prefix)
+    return open("%s-symbol.json" % prefix, "r").read(), \
+           open("%s-0000.params" % prefix, "rb").read(), outputs
+
+def _aligned_empty(shape, offset=0, alignment=64):
+    size = int(np.prod(shape)) * 4
+    buf = np.empty(size + 2 * alignment, dtype=np.uint8)
+    start = -buf.ctypes.data % alignment + offset
+    return buf[start:start + size].view(np.float32).reshape(shape)
+
+@with_seed()
+def test_predictor_set_input_ptr():
+    inputs = [np.random.uniform(size=(4, 3)).astype(np.float32) for _ in range(3)]
+    symbol, params, outputs = _export_dense_block('test_predictor_set_input_ptr', inputs)
+    predictor = Predictor(symbol, params, {'data':inputs[0].shape})
+
+    data = _aligned_empty(inputs[0].shape)
+    data[:] = inputs[0]
+    predictor.set_input_ptr('data', data)
+    predictor.forward()
+    assert_almost_equal(outputs[0], predictor.get_output(0), rtol=1e-5, atol=1e-6)
+    # the predictor reads the buffer itself, writes to it are seen without setting it again
+    data[:] = inputs[1]
+    predictor.forward()
+    assert_almost_equal(outputs[1], predictor.get_output(0), rtol=1e-5, atol=1e-6)
+    # another buffer only replaces the data pointer
+    other = _aligned_empty(inputs[0].shape)
+    other[:] = inputs[2]
+    predictor.set_input_ptr('data', other)
+    predictor.forward()
+    assert_almost_equal(outputs[2], predictor.get_output(0), rtol=1e-5, atol=1e-6)
+
+    assert_raises(RuntimeError, predictor.set_input_ptr, 'data',
+                  _aligned_empty(inputs[0].shape, offset=16))
+    assert_raises(RuntimeError, predictor.set_input_ptr, 'data', _aligned_empty((3, 3)))
+    del predictor
+
+@with_seed()
+def test_batched_predictor():
+    max_batch_size = 8
+    num_threads = 6
+    requests = [[np.random.uniform(size=(np.random.randint(1, 5), 3)).astype(np.float32)
+                 for _ in range(5)] for _ in range(num_threads)]
+    symbol, params, outputs = _export_dense_block(
+        'test_batched_predictor', [x for thread in requests for x in thread])
+    predictor = BatchedPredictor(symbol, params, {'data':(3,)}, [(3,)],
+                                 max_batch_size, max_delay_us=5000)
+
+    results = [[] for _ in range(num_threads)]
+    errors = []
+    def run(i):
+        try:
+            for x in requests[i]:
+                results[i].append(predictor.forward(data=x)[0])
+        except Exception as e:
+            errors.append(e)
+    threads = [threading.Thread(target=run, args=(i,)) for i in range(num_threads)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    assert not errors, errors
+
+    # every request gets its own rows back, whatever the batches it was joined into
+    expected = iter(outputs)
+    for thread in results:
+        for out in thread:
+            assert_almost_equal(next(expected), out, rtol=1e-5, atol=1e-6)
+
+    assert_raises(RuntimeError, predictor.forward,
+                  data=np.zeros((max_batch_size + 1, 3), dtype=np.float32))
+    del predictor
+
 @with_seed()
 def test_load_ndarray():
     nd_file = 'test_predictor_load_ndarray.params'
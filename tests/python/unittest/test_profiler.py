@@ -303,6 +303,44 @@ def test_aggregate_duplication():
     profiler.set_state('stop')
 
 
+def test_aggregate_operator_memory():
+    file_name = 'test_aggregate_operator_memory.json'
+    enable_profiler(profile_filename=file_name, run=True, continuous_dump=True, \
+                    aggregate_stats=True)
+    profiler.dumps(reset=True)
+    x = mx.nd.ones(shape=(256, 256))
+    y = mx.nd.dot(x, x)
+    mx.nd.waitall()
+    profiler.dump(False)
+    target_dict = json.loads(profiler.dumps(format='json'))
+    device = target_dict['Operator Memory']['cpu/0']
+    # the output of dot is held by dot
+    assert device['Operators']['dot']['Count'] >= 1
+    assert device['Operators']['dot']['Peak'] >= 256 * 256 * 4 / 1000.
+    assert device['Peak'] >= device['Operators']['dot']['Peak']
+    assert 'Top Memory Consumers: cpu/0' in profiler.dumps()
+    profiler.set_state('stop')
+
+
+def test_sampled_operator_profiling():
+    profiler.set_config(profile_symbolic=True, profile_imperative=True,
+                        filename='test_sampled_operator_profiling.json',
+                        continuous_dump=False, sample_period=7)
+    profiler.set_state('run')
+    profiler.dumps(reset=True)
+    x = mx.nd.ones(shape=(16, 16))
+    for _ in range(2):
+        for _ in range(100):
+            x = mx.nd.sqrt(x)
+        mx.nd.waitall()
+        # samples are pulled while the profiler keeps running
+        target_dict = json.loads(profiler.dumps(format='json', reset=True))
+        count = target_dict['Time']['operator']['sqrt']['Count']
+        assert 0 < count < 100
+    profiler.set_state('stop')
+    profiler.set_config(sample_period=0)
+
+
 def test_custom_operator_profiling(seed=None, file_name=None):
     class Sigmoid(mx.operator.CustomOp):
         def forward(self, is_train, req, in_data, out_data, aux):
@@ -1907,6 +1907,50 @@ def test_sparse_embedding():
             check_sparse_embedding(in_dim, out_dim, batch, densities, sparse_grad, weight_stype)
             check_sparse_embedding(in_dim, out_dim, batch, densities, sparse_grad, weight_stype)
 
+@with_seed()
+def test_sparse_embedding_fused_update():
+    in_dim, out_dim = 50, 4
+    # fewer indices than rows go through the hash grouping, more through the row flags
+    for batch in [8, 200]:
+        data = mx.nd.array(np.random.randint(0, in_dim, size=(batch, 2)))
+        weight = mx.nd.random.uniform(shape=(in_dim, out_dim))
+        ograd = mx.nd.random.uniform(-1, 1, shape=(batch, 2, out_dim))
+        data.attach_grad()
+        weight.attach_grad(stype='row_sparse')
+        with mx.autograd.record():
+            out = mx.nd.Embedding(data, weight, input_dim=in_dim, output_dim=out_dim,
+                                  sparse_grad=True)
+        out.backward(ograd)
+        rsp_grad = weight.grad
+        assert rsp_grad.stype == 'row_sparse'
+        onehot = np.zeros((batch * 2, in_dim))
+        onehot[np.arange(batch * 2), data.asnumpy().reshape(-1).astype(int)] = 1
+        dense_grad = np.dot(onehot.T, ograd.asnumpy().reshape(-1, out_dim))
+        assert_almost_equal(rsp_grad.asnumpy(), dense_grad, atol=1e-4)
+        assert np.array_equal(rsp_grad.indices.asnumpy(), np.unique(data.asnumpy()))
+
+        sgd_args = {'lr': 0.1, 'wd': 0.01, 'rescale_grad': 0.5, 'clip_gradient': 0.3}
+        expected = weight.copy()
+        mx.nd.sgd_update(expected, rsp_grad, out=expected, lazy_update=True, **sgd_args)
+        fused = weight.copy()
+        mx.nd.contrib.embedding_sgd_update(fused, data, ograd, out=fused, **sgd_args)
+        assert_almost_equal(fused.asnumpy(), expected.asnumpy(), atol=1e-5)
+
+        adagrad_args = {'lr': 0.1, 'epsilon': 1e-7, 'rescale_grad': 0.5}
+        expected, history = weight.copy(), mx.nd.ones_like(weight)
+        mx.nd.sparse.adagrad_update(expected, rsp_grad, history, out=expected, **adagrad_args)
+        fused, fused_history = weight.copy(), mx.nd.ones_like(weight)
+        mx.nd.contrib.embedding_adagrad_update(fused, data, ograd, fused_history, out=fused,
+                                               **adagrad_args)
+        assert_almost_equal(fused.asnumpy(), expected.asnumpy(), atol=1e-5)
+        assert_almost_equal(fused_history.asnumpy(), history.asnumpy(), atol=1e-5)
+
+    bad = mx.nd.array([[0, in_dim]])
+    weight = mx.nd.zeros((in_dim, out_dim))
+    assertRaises(MXNetError, lambda: mx.nd.contrib.embedding_sgd_update(
+        weight, bad, mx.nd.ones((1, 2, out_dim)), lr=0.1, out=weight).wait_to_read())
+
+
 @with_seed()
 def test_sparse_broadcast_add_sub():
     def check_broadcast_add(mx_lhs, mx_rhs, np_lhs, np_rhs, dtype):
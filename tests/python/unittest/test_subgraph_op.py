@@ -364,6 +364,60 @@ def test_subgraph_exe():
 def test_subgraph_v2_exe():
     _test_subgraph_exe('default_v2')
 
+def _bind_elemwise_fusion(sym, shapes, args, type_dict=None):
+    os.environ['MXNET_SUBGRAPH_BACKEND'] = 'ELEMWISE_FUSION'
+    try:
+        exe = sym.simple_bind(mx.cpu(), grad_req='null', type_dict=type_dict, **shapes)
+    finally:
+        del os.environ['MXNET_SUBGRAPH_BACKEND']
+    exe.copy_params_from(args)
+    return exe, [out.asnumpy() for out in exe.forward()]
+
+def test_elemwise_fusion():
+    data = mx.sym.Variable('data')
+    bias = mx.sym.Variable('bias')
+    residual = mx.sym.Variable('residual')
+    x = mx.sym.broadcast_add(data * 0.5, bias)
+    x = mx.sym.Activation(x, act_type='relu')
+    out = mx.sym.clip(x + residual, 0, 6)
+    shapes = {'data': (4, 8, 5, 5), 'bias': (1, 8, 1, 1), 'residual': (4, 8, 5, 5)}
+    args = {k: mx.nd.random.uniform(-2, 2, shape=v) for k, v in shapes.items()}
+
+    # one output, and two outputs of the same shape from one loop
+    for sym in [out, mx.sym.Group([out, x * 2])]:
+        expected = [o.asnumpy() for o in sym.bind(mx.cpu(), args=args, grad_req='null').forward()]
+        exe, ret = _bind_elemwise_fusion(sym, shapes, args)
+        assert '_sg_elemwise_fused' in exe.debug_str()
+        assert len(ret) == len(expected)
+        for r, e in zip(ret, expected):
+            assert_almost_equal(r, e, rtol=1e-5, atol=1e-6)
+
+    # declined chains are reconnected to their inputs: without inferred types,
+    # with outputs of different shapes, and with an integer type
+    scale = bias * 2
+    scaled = mx.sym.clip(mx.sym.broadcast_add(data * 0.5, scale) + residual, 0, 6)
+    declined = [(out, shapes, args, None, True),
+                (mx.sym.Group([scaled, scale]), shapes, args, None, False),
+                ((data + residual) * 2, {'data': (3, 4), 'residual': (3, 4)},
+                 {'data': mx.nd.array(np.arange(12).reshape(3, 4), dtype='int32'),
+                  'residual': mx.nd.ones((3, 4), dtype='int32')},
+                 {'data': 'int32', 'residual': 'int32'}, False)]
+    for sym, sym_shapes, sym_args, type_dict, backend_symbol in declined:
+        expected = [o.asnumpy() for o in
+                    sym.bind(mx.cpu(), args=sym_args, grad_req='null').forward()]
+        if backend_symbol:
+            part = sym.get_backend_symbol('ELEMWISE_FUSION')
+            assert '_sg_elemwise_fused' not in part.tojson()
+            part = mx.sym.load_json(part.tojson())
+            ret = [o.asnumpy() for o in
+                   part.bind(mx.cpu(), args=sym_args, grad_req='null').forward()]
+        else:
+            exe, ret = _bind_elemwise_fusion(sym, sym_shapes, sym_args, type_dict)
+            assert '_sg_elemwise_fused' not in exe.debug_str()
+        assert len(ret) == len(expected)
+        for r, e in zip(ret, expected):
+            assert_almost_equal(r, e, rtol=1e-5, atol=1e-6)
+
 if __name__ == '__main__':
     import nose
     nose.runmodule()
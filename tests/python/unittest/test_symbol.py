@@ -323,6 +323,26 @@ def test_zero_prop():
     assert big > small2
     assert small1 == small2
 
+def test_plan_memory_dtype():
+    data = mx.sym.Variable('data')
+    out = data
+    for _ in range(5):
+        out = mx.sym.sin(out) * out
+
+    def plan(dtype):
+        exe = out.simple_bind(ctx=mx.cpu(), data=(64, 1024, 256), grad_req='null',
+                              type_dict={'data': dtype})
+        debug_str = exe.debug_str()
+        return [int(re.search('Total (\d+) MB %s' % kind, debug_str).group(1))
+                for kind in ('allocated', 'planned')]
+
+    allocated32, planned32 = plan('float32')
+    allocated16, planned16 = plan('float16')
+    # sizes follow the dtype
+    assert allocated16 * 2 == allocated32
+    assert planned16 * 2 == planned32
+    assert 0 < planned32 <= allocated32
+
 def test_zero_prop2():
     x = mx.sym.Variable('x')
     idx = mx.sym.Variable('idx')